@@ -0,0 +1,104 @@
+
+#include <random>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/NBody/BarnesHut.hpp"
+
+
+namespace Syn
+{
+	// a rotating unit ball with half of the bodies in a small dense cluster, unit total mass
+	static void nbodyFill(BarnesHut& _nbody, uint32_t _count)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		_nbody.reserve(_count);
+		for (uint32_t i = 0; i < _count; i++)
+		{
+			glm::vec3 p;
+			do
+				p = glm::vec3(uniform(rng), uniform(rng), uniform(rng));
+			while (glm::dot(p, p) > 1.0f);
+			if (i % 2)
+				p = p * 0.1f + glm::vec3(0.5f, 0.0f, 0.0f);
+			_nbody.addBody(p, glm::vec3(-p.y, p.x, 0.0f) * 0.3f, 1.0f / _count);
+		}
+	}
+
+}
+
+
+//
+SYN_BENCH(barnes_hut, "BarnesHut: accuracy against direct summation and step time over n")
+{
+	using namespace Syn;
+
+	bool passed = true;
+
+	// accuracy at the default theta, all bodies compared to computeDirect()
+	{
+		NBodyParameters params;
+		BarnesHut nbody(params);
+		nbodyFill(nbody, 20000);
+		nbody.computeForces();
+		float maxError;
+		float rms = nbody.accuracy(0, &maxError);
+
+		std::vector<glm::vec3> direct;
+		nbody.computeDirect(direct);
+		double sumSq = 0.0;
+		for (uint32_t i = 0; i < nbody.getCount(); i++)
+		{
+			float norm = glm::length(direct[i]);
+			float e = norm > 0.0f ? glm::length(nbody.getAcceleration(i) - direct[i]) / norm : 0.0f;
+			sumSq += (double)e * e;
+		}
+		float rmsDirect = (float)std::sqrt(sumSq / nbody.getCount());
+
+		benchPrint("20000 bodies, theta %.2f: RMS relative error %.2e (max %.2e), %.0f interactions/body",
+				   params.theta, rms, maxError, nbody.getStats().interactionsPerBody);
+		passed &= benchCheck(rms < 1e-2f, "RMS relative error below 1e-2");
+		passed &= benchCheck(fabsf(rms - rmsDirect) <= 1e-3f * rms, "accuracy() matches computeDirect()");
+	}
+
+	// past theta = 2/sqrt(3) the distance from a cell center alone would accept the root
+	// for a leaf in a corner, its own body included; with one body per leaf and only
+	// single bodies to approximate, every cell that is used must then be exact
+	{
+		NBodyParameters params;
+		params.theta = 1.5f;
+		params.leafSize = 1;
+		BarnesHut nbody(params);
+		nbody.addBody(glm::vec3(0.0f), glm::vec3(0.0f), 1.0f);
+		nbody.addBody(glm::vec3(0.01f, 0.0f, 0.0f), glm::vec3(0.0f), 1.0f);
+		nbody.addBody(glm::vec3(1.0f), glm::vec3(0.0f), 1.0f);
+		nbody.computeForces();
+		float maxError;
+		nbody.accuracy(0, &maxError);
+		benchPrint("3 bodies, theta %.2f: max relative error %.2e", params.theta, maxError);
+		passed &= benchCheck(maxError < 1e-4f, "theta 1.5: no leaf merged into a monopole of its own cell");
+	}
+
+	// time per step
+	for (uint32_t n : { 1000u, 10000u, 100000u, 1000000u })
+	{
+		NBodyParameters params;
+		BarnesHut nbody(params);
+		nbodyFill(nbody, n);
+		nbody.step(0.001f);
+		uint32_t steps = n >= 1000000 ? 2 : (n >= 100000 ? 5 : 20);
+		float stepMs = 0.0f;
+		for (uint32_t s = 0; s < steps; s++)
+		{
+			nbody.step(0.001f);
+			stepMs += nbody.getStats().stepMs;
+		}
+		stepMs /= steps;
+		const NBodyStats& stats = nbody.getStats();
+		benchPrint("%7u bodies: %8.2f ms/step (sort %.1f, tree %.1f, force %.1f ms), %.0f interactions/body",
+				   n, stepMs, stats.sortMs, stats.treeMs, stats.forceMs, stats.interactionsPerBody);
+	}
+
+	return passed;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstdio>
+#include <cstdarg>
+
+#include "SynapseCore/Utils/Timer/Timer.hpp"
+
+
+namespace Syn
+{
+	/* A benchmark case: prints its measurements and returns false if any of its
+	 * checks failed. Cases register themselves through SYN_BENCH() and are run
+	 * by name from main.cpp.
+	 */
+	struct BenchCase
+	{
+		std::string name;
+		std::string description;
+		std::function<bool()> fnc;
+	};
+
+	//
+	class BenchRegistry
+	{
+	public:
+		static std::vector<BenchCase>& cases()
+		{
+			static std::vector<BenchCase> s_cases;
+			return s_cases;
+		}
+
+		static bool add(const char* _name, const char* _description, const std::function<bool()>& _fnc)
+		{
+			cases().push_back({ _name, _description, _fnc });
+			return true;
+		}
+	};
+
+	/* Prints a line of measurements. */
+	inline void benchPrint(const char* _fmt, ...)
+	{
+		va_list args;
+		va_start(args, _fmt);
+		printf("    ");
+		vprintf(_fmt, args);
+		printf("\n");
+		va_end(args);
+	}
+
+	/* Prints a check and whether it passed, returns _passed. */
+	inline bool benchCheck(bool _passed, const char* _fmt, ...)
+	{
+		va_list args;
+		va_start(args, _fmt);
+		printf("    [%s] ", _passed ? "PASS" : "FAIL");
+		vprintf(_fmt, args);
+		printf("\n");
+		va_end(args);
+		return _passed;
+	}
+
+	/* Best wall time of _repeats calls to _fnc, in milliseconds. */
+	inline float benchTimeMs(const std::function<void()>& _fnc, uint32_t _repeats=3)
+	{
+		float best = std::numeric_limits<float>::max();
+		for (uint32_t i = 0; i < _repeats; i++)
+		{
+			Timer timer;
+			_fnc();
+			best = std::min(best, timer.getDeltaTimeMs());
+		}
+		return best;
+	}
+
+}
+
+
+//
+#define SYN_BENCH(name, description) \
+	static bool name##_bench(); \
+	[[maybe_unused]] static bool name##_registered = Syn::BenchRegistry::add(#name, description, name##_bench); \
+	static bool name##_bench()
+
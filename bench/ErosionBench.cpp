@@ -0,0 +1,81 @@
+
+#include <cstring>
+#include <thread>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Terrain/Erosion.hpp"
+#include "SynapseCore/Utils/Noise/Noise.hpp"
+#include "SynapseCore/Utils/Thread/ThreadPool.hpp"
+
+
+//
+SYN_BENCH(erosion, "Erosion: hydraulic droplets/s at 0..N pool threads, bit-identical results, thermal mass")
+{
+	using namespace Syn;
+
+	// 512^2 fBm field in [0, 1]
+	const uint32_t N = 512;
+	const uint64_t droplets = 200000;
+	std::vector<float> heights(N * N);
+	Linspace<float> x(0.0f, (float)(N - 1), N), z(0.0f, (float)(N - 1), N);
+	NoiseParameters saved = Noise::get_noise_parameters();
+	Noise::set_param_octave_count(6);
+	Noise::evalGrid(x, z, heights.data());
+	Noise::set_noise_parameters(saved);
+	for (auto& h : heights)
+		h = h * 0.5f + 0.5f;
+
+	// thread counts: inline, powers of two, all cores
+	size_t poolThreads = ThreadPool::get().threadCount();
+	size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<size_t> threadCounts = { 0, 1, 2, 4 };
+	for (size_t n = 8; n < cores; n *= 2)
+		threadCounts.push_back(n);
+	threadCounts.push_back(cores);
+	std::sort(threadCounts.begin(), threadCounts.end());
+	threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+	std::vector<float> reference;
+	bool identical = true;
+	float inlineRate = 0.0f;
+	for (size_t threads : threadCounts)
+	{
+		ThreadPool::get().init(threads);
+		Erosion erosion(N, N, heights.data());
+		erosion.hydraulic(droplets, 7);
+		const ErosionStats& stats = erosion.getStats();
+		if (threads == 0)
+		{
+			reference.assign(erosion.getHeights(), erosion.getHeights() + N * N);
+			inlineRate = stats.dropletsPerSecond;
+		}
+		else
+			identical &= (memcmp(reference.data(), erosion.getHeights(), N * N * sizeof(float)) == 0);
+		benchPrint("%2zu threads: %.2fM droplets/s (%.2fx), %.0f ms, %u tiles",
+				   threads, stats.dropletsPerSecond / 1e6f, stats.dropletsPerSecond / inlineRate, stats.hydraulicMs, stats.tiles);
+	}
+	ThreadPool::get().init(poolThreads);
+	benchPrint("%zu hardware threads", cores);
+	bool passed = benchCheck(identical, "hydraulic erosion is bit-identical for every thread count");
+
+	// another seed gives another result
+	Erosion other(N, N, heights.data());
+	other.hydraulic(droplets, 8);
+	passed &= benchCheck(memcmp(reference.data(), other.getHeights(), N * N * sizeof(float)) != 0, "results depend on the seed");
+
+	// thermal erosion moves material, but conserves it
+	Erosion thermal(N, N, reference.data());
+	double before = 0.0, after = 0.0;
+	for (uint32_t i = 0; i < N * N; i++)
+		before += thermal.getHeights()[i];
+	thermal.thermal(50);
+	for (uint32_t i = 0; i < N * N; i++)
+		after += thermal.getHeights()[i];
+	double drift = fabs(after - before) / before;
+	benchPrint("thermal, 50 iterations: %.0f ms, relative mass drift %.1e", thermal.getStats().thermalMs, drift);
+	passed &= benchCheck(drift < 1e-6, "thermal erosion conserves mass");
+
+	return passed;
+}
+
@@ -0,0 +1,177 @@
+
+#include <cstring>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Fluid/FluidSolverCPU.hpp"
+
+
+namespace Syn
+{
+	// a swirling jet from the bottom wall, splatted every step
+	static void fluidRun(FluidSolverCPU& _solver, uint32_t _steps)
+	{
+		float w = (float)_solver.getWidth();
+		float h = (float)_solver.getHeight();
+		for (uint32_t i = 0; i < _steps; i++)
+		{
+			_solver.addSplat({ w * (0.5f + 0.15f * sinf(i * 0.1f)), h * 0.25f },
+							 { 0.08f * w * cosf(i * 0.3f), 0.25f * h }, 1.0f, w / 40.0f);
+			_solver.update(1.0f / 60.0f);
+		}
+	}
+
+	//
+	static double fluidSum(const CPUSurface& _surface, uint32_t _channel)
+	{
+		double sum = 0.0;
+		for (uint32_t y = 1; y < _surface.height - 1; y++)
+			for (uint32_t x = 1; x < _surface.width - 1; x++)
+				sum += _surface.row(_channel, y)[x];
+		return sum;
+	}
+
+	// RMS of the central difference divergence over the interior, as computed by the solver
+	static double fluidDivergenceRMS(const CPUSurface& _velocity)
+	{
+		double sum = 0.0;
+		for (uint32_t y = 1; y < _velocity.height - 1; y++)
+		{
+			for (uint32_t x = 1; x < _velocity.width - 1; x++)
+			{
+				double d = 0.5 * (_velocity.row(0, y)[x+1] - _velocity.row(0, y)[x-1] +
+								  _velocity.row(1, y+1)[x] - _velocity.row(1, y-1)[x]);
+				sum += d * d;
+			}
+		}
+		return std::sqrt(sum / ((_velocity.width - 2) * (_velocity.height - 2)));
+	}
+
+	//
+	static double fluidRMS(const CPUSurface& _surface, uint32_t _channel)
+	{
+		double sum = 0.0;
+		for (uint32_t y = 1; y < _surface.height - 1; y++)
+			for (uint32_t x = 1; x < _surface.width - 1; x++)
+				sum += (double)_surface.row(_channel, y)[x] * _surface.row(_channel, y)[x];
+		return std::sqrt(sum / ((_surface.width - 2) * (_surface.height - 2)));
+	}
+
+	//
+	static bool fluidIdentical(const CPUSurface& _a, const CPUSurface& _b)
+	{
+		return _a.data.size() == _b.data.size() && memcmp(_a.data.data(), _b.data.data(), _a.data.size() * sizeof(float)) == 0;
+	}
+
+}
+
+
+//
+SYN_BENCH(fluid_cpu, "FluidSolverCPU: mass, divergence after projection, AVX2 vs. scalar and steps/s")
+{
+	using namespace Syn;
+
+	bool passed = true;
+
+	// density is only moved (no dissipation, no sources). Semi-Lagrangian advection
+	// preserves a uniform field exactly, but is not mass conserving : a vortex ring loses
+	// a few percent of its density over 100 steps, growing with the speed.
+	{
+		FluidParameters params;
+		params.densityDissipation = 1.0f;
+		FluidSolverCPU uniform(256, 256, params);
+		FluidSolverCPU ring(256, 256, params);
+		for (uint32_t k = 0; k < 16; k++)
+		{
+			float a = k * 6.2831853f / 16.0f;
+			glm::vec2 position(128.0f + 30.0f * cosf(a), 128.0f + 30.0f * sinf(a));
+			glm::vec2 velocity(-20.0f * sinf(a), 20.0f * cosf(a));
+			uniform.addSplat(position, velocity, 0.0f, 8.0f);
+			ring.addSplat(position, velocity, 1.0f, 8.0f);
+		}
+		CPUSurface& density = *uniform.getDensity();
+		std::fill(density.data.begin(), density.data.end(), 1.0f);
+
+		double before = fluidSum(*ring.getDensity(), 0);
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			uniform.update(1.0f / 60.0f);
+			ring.update(1.0f / 60.0f);
+		}
+		double after = fluidSum(*ring.getDensity(), 0);
+		double drift = fabs(after - before) / before;
+		float deviation = 0.0f;
+		for (uint32_t y = 1; y < 255; y++)
+			for (uint32_t x = 1; x < 255; x++)
+				deviation = std::max(deviation, fabsf(uniform.getDensity()->row(0, y)[x] - 1.0f));
+
+		benchPrint("density of a vortex ring over 100 steps: %.1f -> %.1f (%.2f%%)", before, after, 100.0 * (after - before) / before);
+		passed &= benchCheck(deviation < 1e-6f, "uniform density stays uniform");
+		passed &= benchCheck(drift < 0.1, "vortex ring density within 10%%");
+	}
+
+	// projection removes the divergence of the advected field; 40 Jacobi iterations only
+	// reduce it, multigrid solves to the tolerance (the rest is the mismatch of the wide
+	// divergence/gradient stencils and the compact Laplacian)
+	for (FluidPressureSolver pressure : { FluidPressureSolver::Multigrid, FluidPressureSolver::Jacobi })
+	{
+		bool multigrid = (pressure == FluidPressureSolver::Multigrid);
+		const char* name = multigrid ? "multigrid" : "Jacobi";
+		FluidParameters params;
+		params.pressureSolver = pressure;
+		FluidSolverCPU solver(256, 256, params);
+		fluidRun(solver, 100);
+		double before = fluidRMS(*solver.getDivergence(), 0);
+		double after = fluidDivergenceRMS(*solver.getVelocity());
+		benchPrint("%s: RMS divergence %.3e before projection, %.3e after (%.1f%%)", name, before, after, 100.0 * after / before);
+		if (multigrid)
+			passed &= benchCheck(after < 0.1 * before, "multigrid: projection removes 90%% of the divergence");
+		else
+			passed &= benchCheck(after < before, "Jacobi: projection reduces the divergence");
+	}
+
+	// the AVX2 kernels follow the scalar operation order
+	for (FluidPressureSolver pressure : { FluidPressureSolver::Multigrid, FluidPressureSolver::Jacobi })
+	{
+		const char* name = pressure == FluidPressureSolver::Multigrid ? "multigrid" : "Jacobi";
+		FluidParameters params;
+		params.pressureSolver = pressure;
+		FluidSolverCPU simd(256, 256, params);
+		params.simd = false;
+		FluidSolverCPU scalar(256, 256, params);
+		fluidRun(simd, 50);
+		fluidRun(scalar, 50);
+		bool identical = fluidIdentical(*simd.getVelocity(), *scalar.getVelocity()) &&
+						 fluidIdentical(*simd.getDensity(), *scalar.getDensity()) &&
+						 fluidIdentical(*simd.getPressure(), *scalar.getPressure());
+		passed &= benchCheck(identical, "%s: %s and scalar kernels bit-identical", name, simd.getStats().kernels);
+	}
+
+	// throughput
+	for (FluidPressureSolver pressure : { FluidPressureSolver::Jacobi, FluidPressureSolver::Multigrid })
+	{
+		for (uint32_t n : { 256u, 1024u, 2048u })
+		{
+			uint32_t steps = n == 256 ? 50 : (n == 1024 ? 5 : 2);
+			float stepsPerSecond[2];
+			const char* kernels = "";
+			for (int simd = 1; simd >= 0; simd--)
+			{
+				FluidParameters params;
+				params.pressureSolver = pressure;
+				params.simd = (simd == 1);
+				FluidSolverCPU solver(n, n, params);
+				fluidRun(solver, 2);
+				float ms = benchTimeMs([&]() { fluidRun(solver, steps); }, 1);
+				stepsPerSecond[simd] = steps * 1000.0f / ms;
+				if (simd)
+					kernels = solver.getStats().kernels;
+			}
+			benchPrint("%-9s %4u^2: %6.1f steps/s %s, %6.1f steps/s scalar",
+					   pressure == FluidPressureSolver::Jacobi ? "Jacobi" : "multigrid", n, stepsPerSecond[1], kernels, stepsPerSecond[0]);
+		}
+	}
+
+	return passed;
+}
+
@@ -0,0 +1,125 @@
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Renderer/Mesh/MeshNormals.hpp"
+
+
+namespace Syn
+{
+	/* The per-vertex loop createShapeMeshgrid() used before the MeshNormals kernels
+	 * (MESH_NORMALS_APPROX_FAST), borders included, as the reference.
+	 */
+	static void normalsReference(const float* _y, const float* _x, const float* _z, int _nx, int _nz, glm::vec3* _normals)
+	{
+		for (int i = 0; i < _nz; i++)
+		{
+			for (int j = 0; j < _nx; j++)
+			{
+				int k = i * _nx + j, L = k - 1, R = k + 1, U = k - _nx, D = k + _nx;
+				glm::vec3 sum;
+				if (i > 0 && i < _nz - 1 && j > 0 && j < _nx - 1)
+				{
+					glm::vec3 UD(0.0f, _y[D] - _y[U], _z[i+1] - _z[i-1]);
+					glm::vec3 LR(_x[j+1] - _x[j-1], _y[R] - _y[L], 0.0f);
+					sum = glm::cross(UD, LR);
+				}
+				else if (i > 0 && i < _nz - 1)
+				{
+					glm::vec3 PX = (j == 0) ? glm::vec3(_x[1] - _x[0], _y[R] - _y[k], 0.0f)
+											: glm::vec3(_x[_nx-1] - _x[_nx-2], _y[k] - _y[L], 0.0f);
+					glm::vec3 UP(0.0f, _y[k] - _y[U], _z[i] - _z[i-1]);
+					glm::vec3 PD(0.0f, _y[D] - _y[k], _z[i+1] - _z[i]);
+					sum = glm::cross(UP, PX) + glm::cross(PD, PX);
+				}
+				else if (j > 0 && j < _nx - 1)
+				{
+					glm::vec3 PZ = (i == 0) ? glm::vec3(0.0f, _y[D] - _y[k], _z[1] - _z[0])
+											: glm::vec3(0.0f, _y[k] - _y[U], _z[_nz-1] - _z[_nz-2]);
+					glm::vec3 PR(_x[j+1] - _x[j], _y[R] - _y[k], 0.0f);
+					glm::vec3 LP(_x[j] - _x[j-1], _y[k] - _y[L], 0.0f);
+					sum = glm::cross(PZ, LP) + glm::cross(PZ, PR);
+				}
+				else
+				{
+					// corners
+					glm::vec3 PZ = (i == 0) ? glm::vec3(0.0f, _y[D] - _y[k], _z[1] - _z[0])
+											: glm::vec3(0.0f, _y[k] - _y[U], _z[_nz-1] - _z[_nz-2]);
+					glm::vec3 PX = (j == 0) ? glm::vec3(_x[1] - _x[0], _y[R] - _y[k], 0.0f)
+											: glm::vec3(_x[_nx-1] - _x[_nx-2], _y[k] - _y[L], 0.0f);
+					sum = glm::cross(PZ, PX);
+				}
+				_normals[k] = glm::normalize(sum);
+			}
+		}
+	}
+
+	//
+	static float normalsMaxDeviation(const std::vector<glm::vec3>& _a, const std::vector<glm::vec3>& _b)
+	{
+		float deviation = 0.0f;
+		for (size_t k = 0; k < _a.size(); k++)
+			deviation = std::max(deviation, glm::length(_a[k] - _b[k]));
+		return deviation;
+	}
+
+}
+
+
+//
+SYN_BENCH(mesh_normals, "MeshNormals: grid and analytic kernels vs. the per-vertex loop, 2048x2048")
+{
+	using namespace Syn;
+
+	const int nx = 2048, nz = 2048;
+	const float dx = 0.01f, dz = 0.02f;
+	std::vector<float> x(nx), z(nz), heights(nx * nz);
+	std::vector<glm::vec2> gradients(nx * nz);
+	for (int j = 0; j < nx; j++)
+		x[j] = j * dx;
+	for (int i = 0; i < nz; i++)
+		z[i] = i * dz;
+	for (int i = 0; i < nz; i++)
+	{
+		for (int j = 0; j < nx; j++)
+		{
+			heights[i * nx + j] = 0.5f * sinf(3.0f * x[j]) * cosf(2.0f * z[i]);
+			gradients[i * nx + j] = glm::vec2( 1.5f * cosf(3.0f * x[j]) * cosf(2.0f * z[i]),
+											  -1.0f * sinf(3.0f * x[j]) * sinf(2.0f * z[i]));
+		}
+	}
+
+	std::vector<glm::vec3> reference(nx * nz), grid(nx * nz), analytic(nx * nz);
+	float msReference = benchTimeMs([&]() { normalsReference(heights.data(), x.data(), z.data(), nx, nz, reference.data()); });
+	float msGrid = benchTimeMs([&]() { MeshNormals::computeGridNormals(heights.data(), nx, nz, dx, dz, grid.data()); });
+	float msAnalytic = benchTimeMs([&]() { MeshNormals::computeNormalsFromGradients(gradients.data(), nx * nz, analytic.data()); });
+	float devGrid = normalsMaxDeviation(reference, grid);
+	// one-sided differences on the borders are first order, compare the interior
+	float devAnalytic = 0.0f;
+	for (int i = 1; i < nz - 1; i++)
+		for (int j = 1; j < nx - 1; j++)
+			devAnalytic = std::max(devAnalytic, glm::length(analytic[i * nx + j] - grid[i * nx + j]));
+
+	benchPrint("%s, single thread: per-vertex loop %.1f ms, grid kernel %.1f ms, analytic kernel %.1f ms",
+			   MeshNormals::getSIMDPath(), msReference, msGrid, msAnalytic);
+	benchPrint("max deviation: grid vs. loop %.1e, analytic vs. grid (interior) %.1e", devGrid, devAnalytic);
+	bool passed = benchCheck(devGrid < 1e-4f, "grid kernel matches the per-vertex loop");
+	passed &= benchCheck(devAnalytic < 1e-3f, "analytic kernel matches finite differences");
+
+	// odd sized grid computed in two row ranges, exercising the SIMD tails and borders
+	const int mx = 13, mz = 5;
+	std::vector<float> xs(mx), zs(mz), hs(mx * mz);
+	for (int j = 0; j < mx; j++)
+		xs[j] = j * dx;
+	for (int i = 0; i < mz; i++)
+		zs[i] = i * dz;
+	for (int k = 0; k < mx * mz; k++)
+		hs[k] = 0.01f * (float)((k * 7919) % 13);
+	std::vector<glm::vec3> smallReference(mx * mz), smallGrid(mx * mz);
+	normalsReference(hs.data(), xs.data(), zs.data(), mx, mz, smallReference.data());
+	MeshNormals::computeGridNormals(hs.data(), mx, mz, dx, dz, smallGrid.data(), 0, 3);
+	MeshNormals::computeGridNormals(hs.data(), mx, mz, dx, dz, smallGrid.data() + 3 * mx, 3);
+	passed &= benchCheck(normalsMaxDeviation(smallReference, smallGrid) < 1e-4f, "13x5 grid in two row ranges matches the loop");
+
+	return passed;
+}
+
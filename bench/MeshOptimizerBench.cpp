@@ -0,0 +1,134 @@
+
+#include <random>
+#include <array>
+#include <set>
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Renderer/Mesh/MeshOptimizer.hpp"
+#include "SynapseCore/Utils/MathUtils.hpp"
+
+
+namespace Syn
+{
+	// binary16 to float, for measuring the half float reference error
+	static float optimizerHalfToFloat(uint16_t _h)
+	{
+		int32_t exponent = (_h >> 10) & 0x1f;
+		float mantissa = (float)(_h & 0x3ff);
+		float f = (exponent == 0) ? std::ldexp(mantissa, -24) : std::ldexp(1024.0f + mantissa, exponent - 25);
+		return (_h & 0x8000) ? -f : f;
+	}
+
+}
+
+
+//
+SYN_BENCH(mesh_optimizer, "MeshOptimizer: ACMR of a shuffled grid and fetch reorder")
+{
+	using namespace Syn;
+
+	const uint32_t n = 100;
+	std::vector<uint32_t> grid;
+	for (uint32_t j = 0; j < n - 1; j++)
+	{
+		for (uint32_t i = 0; i < n - 1; i++)
+		{
+			uint32_t a = j * n + i, b = a + 1, c = a + n, d = c + 1;
+			grid.insert(grid.end(), { a, c, b, b, c, d });
+		}
+	}
+
+	// shuffled triangle order, as from an unoptimized exporter
+	std::vector<uint32_t> order(grid.size() / 3);
+	for (uint32_t t = 0; t < order.size(); t++)
+		order[t] = t;
+	std::shuffle(order.begin(), order.end(), std::mt19937(1));
+	std::vector<uint32_t> shuffled;
+	for (uint32_t t : order)
+		shuffled.insert(shuffled.end(), { grid[3*t], grid[3*t+1], grid[3*t+2] });
+
+	std::vector<uint32_t> optimized;
+	float ms = benchTimeMs([&]() {
+		optimized = shuffled;
+		MeshOptimizer::optimizeVertexCache(optimized.data(), (uint32_t)optimized.size(), n * n);
+	});
+	float acmrGrid = MeshOptimizer::computeACMR(grid.data(), (uint32_t)grid.size(), n * n);
+	float acmrShuffled = MeshOptimizer::computeACMR(shuffled.data(), (uint32_t)shuffled.size(), n * n);
+	float acmrOptimized = MeshOptimizer::computeACMR(optimized.data(), (uint32_t)optimized.size(), n * n);
+	benchPrint("%u tris: ACMR row order %.3f, shuffled %.3f, optimized %.3f (%.2f ms)",
+			   (uint32_t)order.size(), acmrGrid, acmrShuffled, acmrOptimized, ms);
+	bool passed = benchCheck(acmrOptimized < 0.75f && acmrOptimized < acmrGrid, "optimized ACMR below 0.75 and row order");
+
+	// the vertex payload is the original index, so each triangle must fetch the same
+	// corners after the reorder (up to rotation of the winding)
+	std::vector<uint32_t> payload(n * n);
+	for (uint32_t v = 0; v < n * n; v++)
+		payload[v] = v;
+	std::vector<uint32_t> fetched = optimized;
+	uint32_t used = MeshOptimizer::optimizeVertexFetch(payload.data(), n * n, sizeof(uint32_t), fetched.data(), (uint32_t)fetched.size());
+	auto canonical = [](uint32_t _a, uint32_t _b, uint32_t _c) -> std::array<uint32_t, 3>
+	{
+		if (_b < _a && _b < _c) return { _b, _c, _a };
+		if (_c < _a && _c < _b) return { _c, _a, _b };
+		return { _a, _b, _c };
+	};
+	std::multiset<std::array<uint32_t, 3>> before, after;
+	for (size_t i = 0; i < optimized.size(); i += 3)
+	{
+		before.insert(canonical(optimized[i], optimized[i+1], optimized[i+2]));
+		after.insert(canonical(payload[fetched[i]], payload[fetched[i+1]], payload[fetched[i+2]]));
+	}
+	float acmrFetched = MeshOptimizer::computeACMR(fetched.data(), (uint32_t)fetched.size(), n * n);
+	benchPrint("fetch reorder: %u vertices used, ACMR %.3f", used, acmrFetched);
+	passed &= benchCheck(before == after && used == n * n, "fetch reorder preserves triangles");
+	passed &= benchCheck(acmrFetched == acmrOptimized, "fetch reorder keeps ACMR");
+
+	return passed;
+}
+
+//
+SYN_BENCH(vertex_packing, "packVertices: unorm16 position error vs half floats")
+{
+	using namespace Syn;
+
+	bool passed = true;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	struct Case { float extent; float center; };
+	for (const Case& c : { Case{ 1.0f, 0.0f }, Case{ 50.0f, 100.0f }, Case{ 500.0f, 1000.0f } })
+	{
+		std::vector<VertexBase> vertices(10000);
+		for (auto& v : vertices)
+		{
+			v.position = glm::vec3(c.center) + c.extent * (glm::vec3(unit(rng), unit(rng), unit(rng)) - 0.5f);
+			v.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+
+		std::vector<VertexPacked> packed(vertices.size());
+		glm::vec3 scale, offset;
+		MeshOptimizer::packVertices(vertices.data(), (uint32_t)vertices.size(), packed.data(), scale, offset);
+
+		float errUnorm = 0.0f;
+		float errHalf = 0.0f;
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				float p = vertices[i].position[k];
+				float q = offset[k] + scale[k] * (packed[i].position[k] / 65535.0f);
+				errUnorm = std::max(errUnorm, std::fabs(q - p));
+				errHalf = std::max(errHalf, std::fabs(optimizerHalfToFloat(float_to_half(p)) - p));
+			}
+		}
+		float bound = c.extent / 131070.0f;
+		benchPrint("extent %g at %g: max error unorm16 %.1e, half %.1e", c.extent, c.center, errUnorm, errHalf);
+		passed &= benchCheck(errUnorm <= 1.1f * bound + 1e-6f * c.center, "extent %g: unorm16 error within extent / 131070", c.extent);
+		passed &= benchCheck(errUnorm < errHalf, "extent %g: unorm16 beats half", c.extent);
+	}
+	passed &= benchCheck(sizeof(VertexPacked) == 24, "VertexPacked is 24 bytes");
+
+	return passed;
+}
+
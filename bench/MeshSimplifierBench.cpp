@@ -0,0 +1,92 @@
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Renderer/Mesh/MeshSimplifier.hpp"
+
+
+namespace Syn
+{
+	// wavy heightfield grid of _n x _n vertices
+	static void simplifierGrid(uint32_t _n, std::vector<glm::vec3>& _positions, std::vector<uint32_t>& _indices)
+	{
+		for (uint32_t j = 0; j < _n; j++)
+		{
+			for (uint32_t i = 0; i < _n; i++)
+			{
+				float x = i / (float)(_n - 1);
+				float z = j / (float)(_n - 1);
+				_positions.push_back(glm::vec3(x, 0.05f * sinf(6.0f * x) * cosf(5.0f * z), z));
+			}
+		}
+		for (uint32_t j = 0; j < _n - 1; j++)
+		{
+			for (uint32_t i = 0; i < _n - 1; i++)
+			{
+				uint32_t a = j * _n + i;
+				uint32_t b = a + 1;
+				uint32_t c = a + _n;
+				uint32_t d = c + 1;
+				_indices.insert(_indices.end(), { a, c, b, b, c, d });
+			}
+		}
+	}
+
+	// all indices in range, no degenerate triangles and every border vertex kept
+	static bool simplifierValid(uint32_t _n, const std::vector<uint32_t>& _indices)
+	{
+		std::vector<bool> used(_n * _n, false);
+		for (size_t t = 0; t < _indices.size(); t += 3)
+		{
+			uint32_t a = _indices[t], b = _indices[t+1], c = _indices[t+2];
+			if (a >= _n * _n || b >= _n * _n || c >= _n * _n || a == b || b == c || a == c)
+				return false;
+			used[a] = used[b] = used[c] = true;
+		}
+		for (uint32_t k = 0; k < _n; k++)
+			if (!used[k] || !used[(_n - 1) * _n + k] || !used[k * _n] || !used[k * _n + _n - 1])
+				return false;
+		return true;
+	}
+
+}
+
+
+//
+SYN_BENCH(mesh_simplifier, "MeshSimplifier: triangle budgets, error bound and throughput on a 256x256 grid")
+{
+	using namespace Syn;
+
+	const uint32_t n = 256;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	simplifierGrid(n, positions, indices);
+	size_t triangles = indices.size() / 3;
+	bool passed = true;
+
+	for (float ratio : { 0.5f, 0.25f, 0.1f })
+	{
+		uint32_t target = uint32_t(indices.size() * ratio) / 3 * 3;
+		std::vector<uint32_t> result;
+		float error = 0.0f;
+		float ms = benchTimeMs([&]() {
+			result = MeshSimplifier::simplify(&positions[0].x, (uint32_t)positions.size(), sizeof(glm::vec3),
+											  indices.data(), (uint32_t)indices.size(), target,
+											  std::numeric_limits<float>::max(), &error);
+		}, 1);
+		benchPrint("ratio %.2f: %zu -> %zu tris, error %.2e, %.1f ms (%.2f Mtris/s)",
+				   ratio, triangles, result.size() / 3, error, ms, triangles / (ms * 1e3f));
+		passed &= benchCheck(result.size() <= target, "ratio %.2f: within triangle budget", ratio);
+		passed &= benchCheck(simplifierValid(n, result), "ratio %.2f: valid indices, borders locked", ratio);
+	}
+
+	const float bound = 1e-3f;
+	float error = 0.0f;
+	std::vector<uint32_t> result = MeshSimplifier::simplify(&positions[0].x, (uint32_t)positions.size(), sizeof(glm::vec3),
+															indices.data(), (uint32_t)indices.size(), 0, bound, &error);
+	benchPrint("error bound %.0e: %zu -> %zu tris, error %.2e", bound, triangles, result.size() / 3, error);
+	passed &= benchCheck(error <= bound && result.size() < indices.size(), "error bound respected");
+	passed &= benchCheck(simplifierValid(n, result), "error bound: valid indices, borders locked");
+
+	return passed;
+}
+
@@ -0,0 +1,167 @@
+
+#include <cstring>
+#include <random>
+
+#include "Bench.hpp"
+
+#include <GLFW/glfw3.h>
+
+#include "SynapseCore/Renderer/Renderer.hpp"
+#include "SynapseAddons/Fluid/Grid2D.hpp"
+#include "SynapseAddons/Fluid/Multigrid.hpp"
+#include "SynapseAddons/Fluid/MultigridGPU.hpp"
+#include "SynapseAddons/Fluid/FluidSolverCPU.hpp"
+
+
+namespace Syn
+{
+	// a grid for the surfaces and slabs of the solver, nothing to update or render
+	class MultigridBenchGrid : public Grid2D
+	{
+	public:
+		virtual void update(float _dt) override {}
+		virtual void render(float _dt, float _x, float _y) override {}
+	};
+
+	/* Hidden window for a GL context, as in Window::init(). Returns nullptr where there
+	 * is no display or no driver. */
+	static GLFWwindow* multigridCreateContext()
+	{
+		if (!glfwInit())
+			return nullptr;
+
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		GLFWwindow* window = glfwCreateWindow(64, 64, "bench", NULL, NULL);
+		if (!window)
+		{
+			glfwTerminate();
+			return nullptr;
+		}
+
+		glfwMakeContextCurrent(window);
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+		{
+			glfwDestroyWindow(window);
+			glfwTerminate();
+			return nullptr;
+		}
+		return window;
+	}
+
+	//
+	static std::vector<float> multigridReadback(const Ref<Framebuffer>& _surface, uint32_t _width, uint32_t _height)
+	{
+		std::vector<float> data((size_t)_width * _height);
+		glBindFramebuffer(GL_FRAMEBUFFER, _surface->getFramebufferID());
+		glReadPixels(0, 0, _width, _height, GL_RED, GL_FLOAT, data.data());
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return data;
+	}
+
+}
+
+
+//
+SYN_BENCH(multigrid_gpu, "MultigridGPU vs. MultigridCPU on the same divergence (needs a GL context)")
+{
+	using namespace Syn;
+
+	GLFWwindow* window = multigridCreateContext();
+	if (!window)
+	{
+		benchPrint("skipped: no GL context");
+		return true;
+	}
+
+	bool passed = true;
+	{
+		Renderer::create();
+		MultigridBenchGrid grid;
+
+		// same V-cycles on both sides, a fixed number of them; the offset gives the
+		// divergence a mean, which the solvers remove (pure Neumann problem)
+		MultigridParameters params;
+		params.tolerance = 0.0f;
+		params.maxCycles = 6;
+
+		for (uint32_t n : { 64u, 100u, 257u })
+		{
+			std::mt19937 rng(3);
+			std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+			std::vector<float> divergence((size_t)n * n);
+			for (auto& d : divergence)
+				d = uniform(rng) + 0.3f;
+
+			// CPU, surfaces with a one cell border
+			CPUSurface pressure, rhs;
+			pressure.width = rhs.width = n + 2;
+			pressure.height = rhs.height = n + 2;
+			pressure.channels = rhs.channels = 1;
+			pressure.data.assign((size_t)(n + 2) * (n + 2), 0.0f);
+			rhs.data = pressure.data;
+			for (uint32_t y = 0; y < n; y++)
+				memcpy(rhs.row(0, y + 1) + 1, &divergence[(size_t)y * n], n * sizeof(float));
+			MultigridCPU cpu(params);
+			cpu.solve(pressure, rhs, 1.0f);
+
+			// GPU
+			MultigridGPU gpu(&grid, params);
+			gpu.setReadbackResidual(true);
+			// errors from building the shader are the shader library's, check the solve only
+			while (glGetError() != GL_NO_ERROR);
+			Slab slab = grid.createSlab(n, n, ColorFormat::R32F, "multigrid_bench_pressure");
+			Ref<Framebuffer> surface = grid.createSurface(n, n, ColorFormat::R32F, "multigrid_bench_divergence");
+			grid.clearSurface(slab.frontSurface, 0.0f);
+			grid.clearSurface(slab.backSurface, 0.0f);
+			Renderer::executeRenderCommands();
+			glBindTexture(GL_TEXTURE_2D, surface->getColorAttachmentIDn(0));
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, n, n, GL_RED, GL_FLOAT, divergence.data());
+			glBindTexture(GL_TEXTURE_2D, 0);
+			gpu.solve(&slab, surface, 1.0f);
+			Renderer::executeRenderCommands();
+			std::vector<float> result = multigridReadback(slab.frontSurface, n, n);
+			bool glErrors = (glGetError() != GL_NO_ERROR);
+
+			// the pressure is defined up to a constant, compare without the means
+			double meanCPU = 0.0, meanGPU = 0.0;
+			for (uint32_t y = 0; y < n; y++)
+			{
+				for (uint32_t x = 0; x < n; x++)
+				{
+					meanCPU += pressure.row(0, y + 1)[x + 1];
+					meanGPU += result[(size_t)y * n + x];
+				}
+			}
+			meanCPU /= (double)n * n;
+			meanGPU /= (double)n * n;
+			double error = 0.0, norm = 0.0;
+			for (uint32_t y = 0; y < n; y++)
+			{
+				for (uint32_t x = 0; x < n; x++)
+				{
+					double c = pressure.row(0, y + 1)[x + 1] - meanCPU;
+					double g = result[(size_t)y * n + x] - meanGPU;
+					error += (c - g) * (c - g);
+					norm += c * c;
+				}
+			}
+			double relative = std::sqrt(error / norm);
+
+			const MultigridStats& cpuStats = cpu.getStats();
+			const MultigridStats& gpuStats = gpu.getStats();
+			benchPrint("%3u^2: %u levels, relative residual CPU %.3e, GPU %.3e, |p_gpu - p_cpu| / |p_cpu| = %.3e",
+					   n, gpuStats.levels, cpuStats.relativeResidual, gpuStats.relativeResidual, relative);
+			passed &= benchCheck(cpuStats.levels == gpuStats.levels, "%3u^2: same number of levels", n);
+			passed &= benchCheck(relative < 1e-4, "%3u^2: GPU pressure matches the CPU pressure", n);
+			passed &= benchCheck(!glErrors, "%3u^2: no GL errors", n);
+		}
+	}
+
+	glfwDestroyWindow(window);
+	glfwTerminate();
+
+	return passed;
+}
@@ -0,0 +1,72 @@
+
+#include <cstring>
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Utils/Noise/Noise.hpp"
+#include "SynapseCore/Types/Linspace.hpp"
+
+
+namespace Syn
+{
+	static uint32_t noiseGridMismatches(const std::vector<float>& _a, const std::vector<float>& _b)
+	{
+		uint32_t mismatches = 0;
+		for (size_t i = 0; i < _a.size(); i++)
+			mismatches += (memcmp(&_a[i], &_b[i], sizeof(float)) != 0);
+		return mismatches;
+	}
+
+}
+
+
+//
+SYN_BENCH(noise_eval_grid, "Noise::evalGrid vs. per-point fbm_perlin2/3, 1024^2 and 96^3, 6 octaves")
+{
+	using namespace Syn;
+
+	NoiseParameters saved = Noise::get_noise_parameters();
+	Noise::set_param_octave_count(6);
+	Noise::set_param_offset(glm::vec3(0.3f, -1.7f, 2.1f));
+	Noise::set_param_base_frequency(0.02f);
+	bool passed = true;
+
+	const uint32_t N = 1024;
+	Linspace<float> x(-200.0f, 300.0f, N), y(-50.0f, 450.0f, N);
+	std::vector<float> reference(N * N), grid(N * N);
+	for (bool rotate : { false, true })
+	{
+		float msPoint = benchTimeMs([&]() {
+			for (uint32_t j = 0; j < N; j++)
+				for (uint32_t i = 0; i < N; i++)
+					reference[j * N + i] = Noise::fbm_perlin2(glm::vec2(x[i], y[j]), rotate);
+		}, 1);
+		float msGrid = benchTimeMs([&]() { Noise::evalGrid(x, y, grid.data(), NoiseType::Perlin, rotate); }, 1);
+		benchPrint("2D %ux%u%s: per-point %.0f ms, evalGrid %.0f ms (%.2fx)",
+				   N, N, rotate ? ", rotated" : "", msPoint, msGrid, msPoint / msGrid);
+		passed &= benchCheck(noiseGridMismatches(reference, grid) == 0, "2D%s: bit-identical to the per-point function", rotate ? " rotated" : "");
+	}
+
+	// explicit parameters give the same grid as the current ones
+	std::vector<float> explicitGrid(N * N);
+	Noise::evalGrid(Noise::get_noise_parameters(), x, y, explicitGrid.data());
+	passed &= benchCheck(noiseGridMismatches(grid, explicitGrid) == 0, "2D: explicit parameters match the current ones");
+
+	const uint32_t M = 96;
+	Linspace<float> a(-20.0f, 30.0f, M), b(-5.0f, 40.0f, M), c(1.0f, 60.0f, M);
+	std::vector<float> reference3(M * M * M), grid3(M * M * M);
+	float msPoint = benchTimeMs([&]() {
+		for (uint32_t k = 0; k < M; k++)
+			for (uint32_t j = 0; j < M; j++)
+				for (uint32_t i = 0; i < M; i++)
+					reference3[(k * M + j) * M + i] = Noise::fbm_perlin3(glm::vec3(a[i], b[j], c[k]));
+	}, 1);
+	float msGrid = benchTimeMs([&]() { Noise::evalGrid(a, b, c, grid3.data()); }, 1);
+	benchPrint("3D %u^3: per-point %.0f ms, evalGrid %.0f ms (%.2fx)", M, msPoint, msGrid, msPoint / msGrid);
+	passed &= benchCheck(noiseGridMismatches(reference3, grid3) == 0, "3D: bit-identical to the per-point function");
+
+	Noise::set_noise_parameters(saved);
+
+	return passed;
+}
+
@@ -0,0 +1,165 @@
+
+#include <cstring>
+#include <random>
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Utils/Noise/Noise.hpp"
+#include "SynapseCore/Utils/Noise/NoiseGenerator.hpp"
+#include "SynapseCore/Utils/Noise/NoiseKernels.hpp"
+
+
+namespace Syn
+{
+	// the rotations between octaves, as in Noise::fbm_perlin2/3
+	static const float s_kernelRot2[4] = { 0.80f, 0.60f, -0.60f, 0.80f };
+	static const float s_kernelRot3[9] = { 0.00f, 0.80f, 0.60f, -0.80f, 0.36f, -0.48f, -0.60f, -0.48f, 0.64f };
+
+	/* fBm through the virtual NoiseGenerator::eval(), one call per octave and point; the
+	 * path the kernels replaced. */
+	template<typename V, typename M>
+	static float kernelVirtualFbm(NoiseGenerator<V>* _generator, V _p, const NoiseParameters& _param, const M& _rotation)
+	{
+		_p = _p + V(_param.offset);
+		float f = _param.baseFreq;
+		float a = _param.baseAmp;
+		float n = a * _generator->eval(_p, f);
+		for (int i = 1; i < _param.octaveCount; i++)
+		{
+			f *= _param.deltaFreq;
+			a *= _param.deltaAmp;
+			_p = _rotation * _p;
+			n += a * _generator->eval(_p, f);
+		}
+		return n;
+	}
+
+	/* Checks and times the kernels of one generator against kernelVirtualFbm(). */
+	template<typename V, typename M>
+	static bool kernelCase(const char* _name, NoiseType _type, NoiseGenerator<V>* _generator, const M& _rotation,
+						   const std::vector<float>& x, const std::vector<float>& y, const std::vector<float>& z,
+						   NoiseParameters& _param)
+	{
+		const uint32_t dim = V::length();
+		const uint32_t N = (uint32_t)x.size();
+		const float* rotation = (dim == 2) ? s_kernelRot2 : s_kernelRot3;
+		const NoiseTables tables = _generator->getTables();
+		std::vector<float> out(N), out2(N), derivatives(3 * N);
+		auto point = [&](uint32_t i) -> V
+		{
+			V p;
+			p[0] = x[i];
+			p[1] = y[i];
+			if constexpr (V::length() == 3)
+				p[2] = z[i];
+			return p;
+		};
+		bool passed = true;
+
+		// bit-identical to the virtual path for every octave count
+		uint32_t mismatches = 0;
+		for (int octaves = 1; octaves <= 10; octaves++)
+		{
+			_param.octaveCount = octaves;
+			NoiseKernels::get(dim, _type, octaves)(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), nullptr, N);
+			for (uint32_t i = 0; i < N; i += 3)
+				mismatches += (out[i] != kernelVirtualFbm(_generator, point(i), _param, _rotation));
+		}
+		passed &= benchCheck(mismatches == 0, "%s: identical to the virtual path, 1-10 octaves", _name);
+
+		// SIMD kernels bit-identical to the scalar ones, row lengths with and without a tail
+		mismatches = 0;
+		for (uint32_t n : { N, N - 5, 7u })
+			for (int octaves = 0; octaves <= 9; octaves++)
+			{
+				_param.octaveCount = octaves ? octaves : 4;
+				NoiseKernels::get(dim, _type, octaves, false, true)(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), nullptr, n);
+				NoiseKernels::get(dim, _type, octaves, false, false)(tables, _param, rotation, x.data(), y.data(), z.data(), out2.data(), nullptr, n);
+				for (uint32_t i = 0; i < n; i++)
+					mismatches += (memcmp(&out[i], &out2[i], sizeof(float)) != 0);
+			}
+		passed &= benchCheck(mismatches == 0, "%s: %s kernels bit-identical to the scalar ones", _name, NoiseKernels::simdPath());
+
+		// derivative kernels: same values, gradients vs. central differences
+		_param.octaveCount = 6;
+		NoiseRowFnc withDerivatives = NoiseKernels::get(dim, _type, 6, true);
+		NoiseRowFnc plain = NoiseKernels::get(dim, _type, 6, false);
+		withDerivatives(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), derivatives.data(), 2000);
+		plain(tables, _param, rotation, x.data(), y.data(), z.data(), out2.data(), nullptr, 2000);
+		mismatches = 0;
+		float maxRelative = 0.0f;
+		for (uint32_t i = 0; i < 2000; i++)
+		{
+			mismatches += (out[i] != out2[i]);
+			for (uint32_t k = 0; k < dim; k++)
+			{
+				const float h = 1e-2f;
+				float p1[3] = { x[i], y[i], z[i] };
+				float p0[3] = { x[i], y[i], z[i] };
+				p1[k] += h;
+				p0[k] -= h;
+				float n1, n0;
+				plain(tables, _param, rotation, &p1[0], &p1[1], &p1[2], &n1, nullptr, 1);
+				plain(tables, _param, rotation, &p0[0], &p0[1], &p0[2], &n0, nullptr, 1);
+				float numeric = (n1 - n0) / (2.0f * h);
+				float analytic = derivatives[i * dim + k];
+				maxRelative = std::max(maxRelative, fabsf(numeric - analytic) / (fabsf(analytic) + 0.05f));
+			}
+		}
+		passed &= benchCheck(mismatches == 0 && maxRelative < 0.01f,
+							 "%s: derivative kernel values identical, gradient within %.2f%% of central differences", _name, maxRelative * 100.0f);
+
+		// throughput at 8 octaves
+		_param.octaveCount = 8;
+		uint32_t n = (dim == 2) ? N : N / 2;
+		NoiseRowFnc simd = NoiseKernels::get(dim, _type, 8);
+		NoiseRowFnc specialized = NoiseKernels::get(dim, _type, 8, false, false);
+		NoiseRowFnc generic = NoiseKernels::get(dim, _type, 0, false, false);
+		float msSimd = benchTimeMs([&]() { simd(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), nullptr, n); });
+		float msSpecialized = benchTimeMs([&]() { specialized(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), nullptr, n); });
+		float msGeneric = benchTimeMs([&]() { generic(tables, _param, rotation, x.data(), y.data(), z.data(), out.data(), nullptr, n); });
+		float msVirtual = benchTimeMs([&]() {
+			for (uint32_t i = 0; i < n; i++)
+				out[i] = kernelVirtualFbm(_generator, point(i), _param, _rotation);
+		});
+		benchPrint("%-9s 8 octaves: %s kernel %.1f, kernel %.1f, generic kernel %.1f, virtual %.1f Mpoints/s",
+				   _name, NoiseKernels::simdPath(), n / msSimd / 1e3f, n / msSpecialized / 1e3f, n / msGeneric / 1e3f, n / msVirtual / 1e3f);
+
+		return passed;
+	}
+
+}
+
+
+//
+SYN_BENCH(noise_kernels, "NoiseKernels: specialized fBm kernels vs. the virtual per-octave path")
+{
+	using namespace Syn;
+
+	NoisePerlin2 perlin2;
+	NoisePerlin3 perlin3;
+	NoiseValue2 value2;
+	NoiseValue3 value3;
+	const glm::mat2 R2 = glm::mat2(0.80f, 0.60f, -0.60f, 0.80f);
+	const glm::mat3 R3 = glm::mat3(0.00f, 0.80f, 0.60f, -0.80f, 0.36f, -0.48f, -0.60f, -0.48f, 0.64f);
+
+	const uint32_t N = 1 << 16;
+	std::vector<float> x(N), y(N), z(N);
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> U(-300.0f, 300.0f);
+	for (uint32_t i = 0; i < N; i++)
+	{
+		x[i] = U(rng);
+		y[i] = U(rng);
+		z[i] = U(rng);
+	}
+	NoiseParameters param(5, 0.02f, 2.0f, 1.0f, 0.5f, glm::vec3(0.3f, -1.1f, 2.5f));
+
+	bool passed = kernelCase<glm::vec2>("2D value", NoiseType::Value, &value2, R2, x, y, z, param);
+	passed &= kernelCase<glm::vec2>("2D perlin", NoiseType::Perlin, &perlin2, R2, x, y, z, param);
+	passed &= kernelCase<glm::vec3>("3D value", NoiseType::Value, &value3, R3, x, y, z, param);
+	passed &= kernelCase<glm::vec3>("3D perlin", NoiseType::Perlin, &perlin3, R3, x, y, z, param);
+
+	return passed;
+}
+
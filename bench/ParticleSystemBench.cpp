@@ -0,0 +1,162 @@
+#include <cstring>
+#include <random>
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Renderer/Particles/ParticleSystem.hpp"
+
+
+namespace Syn
+{
+	// _count particles with random positions, velocities and ages (some dying on every
+	// step); the colors are ids from _id up, which survive the compaction
+	static void particleFill(ParticleSystem& _particles, uint32_t _count, uint32_t _seed, uint32_t _id=0)
+	{
+		std::mt19937 rng(_seed);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> age(0.0f, 2.0f);
+		uint32_t first = _particles.getCount();
+		uint32_t n = _particles.emit(_count);
+		const ParticleArrays& a = _particles.getArrays();
+		for (uint32_t i = first; i < first + n; i++)
+		{
+			a.px[i] = 10.0f * uniform(rng);	a.py[i] = 10.0f * uniform(rng);	a.pz[i] = 10.0f * uniform(rng);
+			a.vx[i] = uniform(rng);			a.vy[i] = 5.0f * uniform(rng);	a.vz[i] = uniform(rng);
+			a.age[i] = age(rng);
+			a.lifetime[i] = 2.0f;
+			a.color[i] = _id + (i - first);
+		}
+	}
+
+	//
+	static bool particleIdentical(const ParticleSystem& _a, const ParticleSystem& _b)
+	{
+		uint32_t n = _a.getCount();
+		if (n != _b.getCount())
+			return false;
+		const ParticleArrays& a = _a.getArrays();
+		const ParticleArrays& b = _b.getArrays();
+		const float* arraysA[8] = { a.px, a.py, a.pz, a.vx, a.vy, a.vz, a.age, a.lifetime };
+		const float* arraysB[8] = { b.px, b.py, b.pz, b.vx, b.vy, b.vz, b.age, b.lifetime };
+		bool identical = memcmp(a.color, b.color, sizeof(uint32_t) * n) == 0 &&
+						 memcmp(_a.getVertices(), _b.getVertices(), sizeof(ParticleVertex) * n) == 0;
+		for (uint32_t k = 0; k < 8; k++)
+			identical &= memcmp(arraysA[k], arraysB[k], sizeof(float) * n) == 0;
+		return identical;
+	}
+
+	// the staging vertices hold the positions and colors of the particles, in their order
+	static bool particleVerticesMatch(const ParticleSystem& _particles)
+	{
+		const ParticleArrays& a = _particles.getArrays();
+		const ParticleVertex* v = _particles.getVertices();
+		for (uint32_t i = 0; i < _particles.getCount(); i++)
+			if (v[i].position != glm::vec3(a.px[i], a.py[i], a.pz[i]) || v[i].color != a.color[i])
+				return false;
+		return true;
+	}
+
+}
+
+
+//
+SYN_BENCH(particle_system, "ParticleSystem: AVX2 vs. scalar integration, compaction and 4M particle updates")
+{
+	using namespace Syn;
+
+	bool passed = true;
+	const float dt = 1.0f / 60.0f;
+
+	// identical arrays and vertices on both paths, over several steps with deaths, drag
+	// and a count that leaves partial chunks and groups of 8
+	{
+		ParticleParameters params;
+		params.drag = 0.3f;
+		params.chunkSize = 4096;
+		ParticleSystem simd(100003, params);
+		params.simd = false;
+		ParticleSystem scalar(100003, params);
+		particleFill(simd, 100003, 1);
+		particleFill(scalar, 100003, 1);
+
+		bool identical = true;
+		bool vertices = true;
+		for (uint32_t s = 0; s < 30; s++)
+		{
+			simd.update(dt);
+			scalar.update(dt);
+			identical &= particleIdentical(simd, scalar);
+			vertices &= particleVerticesMatch(simd) && particleVerticesMatch(scalar);
+		}
+		benchPrint("100003 particles, 30 steps: %u alive", simd.getCount());
+		passed &= benchCheck(identical, "%s and scalar integration bit-identical, vertices included", simd.getStats().kernels);
+		passed &= benchCheck(vertices, "vertices match the particle arrays (%s transpose)", simd.getStats().kernels);
+	}
+
+	// compaction : exactly the particles reaching their lifetime are removed
+	{
+		ParticleParameters params;
+		params.chunkSize = 1024;
+		ParticleSystem particles(50000, params);
+		particleFill(particles, 50000, 2);
+
+		bool survivors = true;
+		bool counts = true;
+		bool unique = true;
+		uint32_t ids = 50000;
+		std::vector<uint8_t> expected(80000), seen(80000);
+		for (uint32_t s = 0; s < 60; s++)
+		{
+			// the particles alive after this step, by id
+			const ParticleArrays& a = particles.getArrays();
+			uint32_t before = particles.getCount();
+			std::fill(expected.begin(), expected.end(), 0);
+			for (uint32_t i = 0; i < before; i++)
+				expected[a.color[i]] = (a.age[i] + dt) < a.lifetime[i];
+
+			particles.update(dt);
+			const ParticleStats& stats = particles.getStats();
+			counts &= stats.alive == particles.getCount() && stats.alive + stats.killed == before;
+
+			std::fill(seen.begin(), seen.end(), 0);
+			for (uint32_t i = 0; i < particles.getCount(); i++)
+			{
+				survivors &= a.age[i] < a.lifetime[i];
+				seen[a.color[i]]++;
+			}
+			unique &= seen == expected;
+
+			// refill some of the dead
+			if (s % 10 == 0)
+			{
+				particleFill(particles, 5000, 3 + s, ids);
+				ids += 5000;
+			}
+		}
+		passed &= benchCheck(survivors, "no particle with age >= lifetime survives compact()");
+		passed &= benchCheck(counts, "alive + killed equals the previous count");
+		passed &= benchCheck(unique, "the survivors are exactly the particles below their lifetime, once each");
+	}
+
+	// update time at 4M particles (none dying, so it's integration and the vertices)
+	{
+		const uint32_t N = 4u << 20;
+		float ms[2];
+		const char* kernels = "";
+		for (int simd = 1; simd >= 0; simd--)
+		{
+			ParticleParameters params;
+			params.simd = (simd == 1);
+			ParticleSystem particles(N, params);
+			particles.emit(N);
+			std::fill(particles.getArrays().lifetime, particles.getArrays().lifetime + N, 1e6f);
+			particles.update(dt);
+			ms[simd] = benchTimeMs([&]() { particles.update(dt); }, 5);
+			if (simd)
+				kernels = particles.getStats().kernels;
+		}
+		benchPrint("4M particles: update %.1f ms %s, %.1f ms scalar", ms[1], kernels, ms[0]);
+	}
+
+	return passed;
+}
@@ -0,0 +1,176 @@
+
+#include <random>
+#include <memory>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Voxel/VxChunkStorage.hpp"
+#include "SynapseAddons/Voxel/Utility.hpp"
+
+
+namespace Syn
+{
+	static volatile uint32_t s_storageSink = 0;
+
+	// terrain-like chunk contents: four materials below y = 8, air above
+	static inline Voxel storageVoxel(uint32_t x, uint32_t y, uint32_t z)
+	{
+		return Voxel(y < 8 ? ((x * 7 + z * 3 + y) % 4) : 0);
+	}
+
+}
+
+
+//
+SYN_BENCH(vx_chunk_storage, "VxChunkStorage/VxPaletteChunk vs. 3D pointer arrays over 1024 chunks")
+{
+	using namespace Syn;
+
+	const uint32_t NX = VX_CHUNK_SIZE_XZ, NY = VX_CHUNK_SIZE_Y, NZ = VX_CHUNK_SIZE_XZ;
+	const uint32_t chunkCount = 1024;
+
+	std::vector<Voxel***> arrays(chunkCount);
+	std::vector<std::unique_ptr<VxChunkStorage>> flats(chunkCount);
+	std::vector<VxPaletteChunk> palettes(chunkCount);
+	for (uint32_t k = 0; k < chunkCount; k++)
+	{
+		ALLOCATE_3D_ARRAY(arrays[k], Voxel, NX, NY, NZ);
+		flats[k].reset(new VxChunkStorage());
+	}
+
+	float msFill3D = benchTimeMs([&]() {
+		for (uint32_t k = 0; k < chunkCount; k++)
+			for (uint32_t x = 0; x < NX; x++)
+				for (uint32_t y = 0; y < NY; y++)
+					for (uint32_t z = 0; z < NZ; z++)
+						arrays[k][x][y][z] = storageVoxel(x, y, z);
+	});
+	float msFillFlat = benchTimeMs([&]() {
+		for (uint32_t k = 0; k < chunkCount; k++)
+			for (uint32_t x = 0; x < NX; x++)
+				for (uint32_t y = 0; y < NY; y++)
+					for (uint32_t z = 0; z < NZ; z++)
+						flats[k]->at(x, y, z) = storageVoxel(x, y, z);
+	});
+	size_t paletteMemory = 0;
+	for (uint32_t k = 0; k < chunkCount; k++)
+	{
+		palettes[k].compress(*flats[k]);
+		paletteMemory += palettes[k].memoryUsage();
+	}
+
+	// 4M random reads, chunk picked from the high bits
+	std::mt19937 rng(1);
+	std::vector<uint32_t> samples(1 << 22);
+	for (auto& s : samples)
+		s = rng();
+	auto chunkOf = [&](uint32_t _s) { return (_s >> 12) % chunkCount; };
+	float msRead3D = benchTimeMs([&]() {
+		uint32_t sum = 0;
+		for (uint32_t s : samples)
+			sum += arrays[chunkOf(s)][s % NX][(s >> 4) % NY][(s >> 8) % NZ].data;
+		s_storageSink = sum;
+	});
+	float msReadFlat = benchTimeMs([&]() {
+		uint32_t sum = 0;
+		for (uint32_t s : samples)
+			sum += flats[chunkOf(s)]->at(s % NX, (s >> 4) % NY, (s >> 8) % NZ).data;
+		s_storageSink = sum;
+	});
+	float msReadPalette = benchTimeMs([&]() {
+		uint32_t sum = 0;
+		for (uint32_t s : samples)
+			sum += palettes[chunkOf(s)].get(s % NX, (s >> 4) % NY, (s >> 8) % NZ).data;
+		s_storageSink = sum;
+	});
+
+	// 6-neighbour sweep of the chunk interiors
+	float msSweep3D = benchTimeMs([&]() {
+		uint32_t sum = 0;
+		for (uint32_t k = 0; k < chunkCount; k++)
+		{
+			Voxel*** a = arrays[k];
+			for (uint32_t x = 1; x < NX - 1; x++)
+				for (uint32_t y = 1; y < NY - 1; y++)
+					for (uint32_t z = 1; z < NZ - 1; z++)
+						sum += a[x-1][y][z].data + a[x+1][y][z].data + a[x][y-1][z].data +
+							   a[x][y+1][z].data + a[x][y][z-1].data + a[x][y][z+1].data;
+		}
+		s_storageSink = sum;
+	});
+	float msSweepFlat = benchTimeMs([&]() {
+		uint32_t sum = 0;
+		for (uint32_t k = 0; k < chunkCount; k++)
+		{
+			const VxChunkStorage& c = *flats[k];
+			for (uint32_t x = 1; x < NX - 1; x++)
+				for (uint32_t y = 1; y < NY - 1; y++)
+					for (uint32_t z = 1; z < NZ - 1; z++)
+						sum += c.at(x-1, y, z).data + c.at(x+1, y, z).data + c.at(x, y-1, z).data +
+							   c.at(x, y+1, z).data + c.at(x, y, z-1).data + c.at(x, y, z+1).data;
+		}
+		s_storageSink = sum;
+	});
+
+	#ifdef VX_CHUNK_MORTON_ORDER
+	benchPrint("Morton order");
+	#endif
+	benchPrint("fill: 3D %.1f ms, flat %.1f ms", msFill3D, msFillFlat);
+	benchPrint("4M random reads: 3D %.1f ms, flat %.1f ms, palette %.1f ms", msRead3D, msReadFlat, msReadPalette);
+	benchPrint("6-neighbour sweep: 3D %.1f ms, flat %.1f ms", msSweep3D, msSweepFlat);
+	size_t flatMemory = chunkCount * sizeof(VxChunkStorage);
+	benchPrint("memory: flat %zu KB, palette %zu KB (%.1fx)", flatMemory / 1024, paletteMemory / 1024, (float)flatMemory / paletteMemory);
+
+	// round trip through the palette
+	bool roundTrip = true;
+	for (uint32_t k = 0; k < chunkCount && roundTrip; k++)
+	{
+		VxChunkStorage decompressed;
+		palettes[k].decompress(decompressed);
+		for (uint32_t i = 0; i < VxChunkStorage::size() && roundTrip; i++)
+			roundTrip = (decompressed[i].data == (*flats[k])[i].data) && (palettes[k].get(i).data == (*flats[k])[i].data);
+	}
+	bool passed = benchCheck(roundTrip, "palette compress/decompress round trip");
+	passed &= benchCheck(palettes[0].getPaletteSize() == 4 && palettes[0].getBitsPerIndex() == 2, "4 values use 2-bit indices");
+
+	for (uint32_t k = 0; k < chunkCount; k++)
+	{
+		FREE_3D_ARRAY(arrays[k], NX, NY);
+	}
+
+	return passed;
+}
+
+//
+SYN_BENCH(vx_palette_growth, "VxPaletteChunk: 300k sets of distinct values stay within 16-bit indices")
+{
+	using namespace Syn;
+
+	VxChunkStorage reference;
+	VxPaletteChunk palette;
+	std::mt19937 rng(3);
+	uint32_t maxPalette = 0;
+	uint32_t maxBits = 0;
+	bool matches = true;
+	for (uint32_t n = 0; n < 300000 && matches; n++)
+	{
+		uint32_t i = rng() % VxChunkStorage::size();
+		Voxel v((rng() % 8 == 0) ? 0 : n + 1);
+		reference[i] = v;
+		palette.set(i, v);
+		maxPalette = std::max(maxPalette, palette.getPaletteSize());
+		maxBits = std::max(maxBits, palette.getBitsPerIndex());
+		if (n % 10000 == 0)
+			for (uint32_t j = 0; j < VxChunkStorage::size() && matches; j++)
+				matches = (palette.get(j).data == reference[j].data);
+	}
+	for (uint32_t j = 0; j < VxChunkStorage::size() && matches; j++)
+		matches = (palette.get(j).data == reference[j].data);
+
+	benchPrint("peak palette %u entries, %u bits per index", maxPalette, maxBits);
+	bool passed = benchCheck(matches, "reads match the flat reference");
+	passed &= benchCheck(maxBits <= 16 && maxPalette <= (1u << 16), "indices stay within 16 bits");
+
+	return passed;
+}
+
@@ -0,0 +1,166 @@
+
+#include <random>
+#include <cstring>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Voxel/VxMesher.hpp"
+
+
+namespace Syn
+{
+	static const int s_mesherSize = VX_CHUNK_SIZE_XZ;
+
+	//
+	static bool mesherSolid(const VxChunkStorage& _chunk, int x, int y, int z)
+	{
+		return VX_DATA_GET_TYPE(_chunk.at(x, y, z).data) != 0;
+	}
+
+	// occupancy across the face neighbours, diagonal chunks count as empty
+	static bool mesherSolidNeighbours(const VxChunkStorage& _chunk, const VxChunkStorage* const* _neighbours, int x, int y, int z)
+	{
+		int p[3] = { x, y, z };
+		int outside = 0;
+		int dir = -1;
+		for (int a = 0; a < 3; a++)
+		{
+			if (p[a] < 0)			{ outside++; dir = a + 3; p[a] += s_mesherSize; }
+			else if (p[a] >= s_mesherSize)	{ outside++; dir = a; p[a] -= s_mesherSize; }
+		}
+		if (outside == 0)
+			return mesherSolid(_chunk, x, y, z);
+		if (outside > 1 || !_neighbours || !_neighbours[dir])
+			return false;
+		return mesherSolid(*_neighbours[dir], p[0], p[1], p[2]);
+	}
+
+	/* Brute-force check of a mesh: every visible face covered by exactly one quad of
+	 * the right data and occlusion, nothing else covered. Returns the number of errors.
+	 */
+	static uint32_t mesherCheck(const VxChunkStorage& _chunk, const VxChunkMesh& _mesh, const VxChunkStorage* const* _neighbours)
+	{
+		const int S = s_mesherSize;
+		static int cover[VX_CHUNK_SIZE_XZ][VX_CHUNK_SIZE_Y][VX_CHUNK_SIZE_XZ];
+		uint32_t errors = 0;
+
+		for (int dir = 0; dir < 6; dir++)
+		{
+			int a = dir % 3;
+			int s = (dir < 3) ? 1 : -1;
+			int u = (a == 0) ? 1 : 0;
+			int v = (a == 2) ? 1 : 2;
+			memset(cover, 0, sizeof(cover));
+
+			for (const VxQuad& q : _mesh.quads[dir])
+			{
+				for (int i = 0; i < q.h; i++)
+				{
+					for (int j = 0; j < q.w; j++)
+					{
+						int p[3] = { q.x, q.y, q.z };
+						p[u] += i;
+						p[v] += j;
+						cover[p[0]][p[1]][p[2]]++;
+						errors += (_chunk.at(p[0], p[1], p[2]).data != q.data);
+
+						// occlusion of the corners, in front of the face
+						int f[3] = { p[0], p[1], p[2] };
+						f[a] += s;
+						uint32_t ao = 0;
+						for (int k = 0; k < 4; k++)
+						{
+							int du = (k == 1 || k == 2) ? 1 : -1;
+							int dv = (k >= 2) ? 1 : -1;
+							int su[3] = { f[0], f[1], f[2] };
+							int sv[3] = { f[0], f[1], f[2] };
+							su[u] += du;
+							sv[v] += dv;
+							int sc[3] = { su[0], su[1], su[2] };
+							sc[v] += dv;
+							int s1 = mesherSolidNeighbours(_chunk, _neighbours, su[0], su[1], su[2]);
+							int s2 = mesherSolidNeighbours(_chunk, _neighbours, sv[0], sv[1], sv[2]);
+							int s3 = mesherSolidNeighbours(_chunk, _neighbours, sc[0], sc[1], sc[2]);
+							ao |= ((s1 && s2) ? 0 : 3 - (s1 + s2 + s3)) << (2 * k);
+						}
+						errors += (ao != q.ao);
+					}
+				}
+			}
+
+			for (int x = 0; x < S; x++)
+			{
+				for (int y = 0; y < S; y++)
+				{
+					for (int z = 0; z < S; z++)
+					{
+						int p[3] = { x, y, z };
+						p[a] += s;
+						bool visible = mesherSolid(_chunk, x, y, z);
+						if (visible && (p[a] < 0 || p[a] >= S))
+						{
+							const VxChunkStorage* neighbour = _neighbours ? _neighbours[dir] : nullptr;
+							p[a] = (p[a] + S) % S;
+							visible = !neighbour || !mesherSolid(*neighbour, p[0], p[1], p[2]);
+						}
+						else if (visible)
+							visible = !mesherSolid(_chunk, p[0], p[1], p[2]);
+						errors += (cover[x][y][z] != (visible ? 1 : 0));
+					}
+				}
+			}
+		}
+
+		return errors;
+	}
+
+}
+
+
+//
+SYN_BENCH(vx_mesher, "VxMesher: binary greedy meshing vs. a brute-force face check, per 16^3 chunk")
+{
+	using namespace Syn;
+
+	const int S = s_mesherSize;
+	std::mt19937 rng(3);
+	VxChunkStorage terrain, checker, noise, full;
+	for (int x = 0; x < S; x++)
+	{
+		for (int y = 0; y < S; y++)
+		{
+			for (int z = 0; z < S; z++)
+			{
+				int h = 8 + (int)(4.0f * sinf(x * 0.4f) * cosf(z * 0.3f));
+				terrain.at(x, y, z) = Voxel(y < h - 3 ? 1 : (y < h ? 2 : 0));
+				checker.at(x, y, z) = Voxel(y < h ? 1 + ((x / 4 + z / 4) & 1) : 0);
+				noise.at(x, y, z) = Voxel(rng() % 2 ? 1 + rng() % 3 : 0);
+				full.at(x, y, z) = Voxel(1);
+			}
+		}
+	}
+	const VxChunkStorage* neighbours[6] = { &full, nullptr, &terrain, &noise, &full, nullptr };
+
+	struct Case { const char* name; const VxChunkStorage* chunk; };
+	bool passed = true;
+	for (const Case& c : { Case{ "terrain", &terrain }, Case{ "checker", &checker }, Case{ "noise", &noise }, Case{ "full", &full } })
+	{
+		VxChunkMesh mesh, stitched;
+		VxMesher::mesh(*c.chunk, mesh);
+		VxMesher::mesh(*c.chunk, stitched, VX_CHUNK_REMESH_ALL, neighbours);
+		uint32_t errors = mesherCheck(*c.chunk, mesh, nullptr);
+		uint32_t errorsStitched = mesherCheck(*c.chunk, stitched, neighbours);
+
+		const uint32_t repeats = 2000;
+		float ms = benchTimeMs([&]() {
+			for (uint32_t r = 0; r < repeats; r++)
+				VxMesher::mesh(*c.chunk, mesh);
+		}, 1);
+
+		benchPrint("%-8s %5u quads (%5u stitched), %.1f us/chunk", c.name, mesh.getQuadCount(), stitched.getQuadCount(), ms * 1e3f / repeats);
+		passed &= benchCheck(errors == 0 && errorsStitched == 0, "%s: faces and occlusion match the brute force", c.name);
+	}
+
+	return passed;
+}
+
@@ -0,0 +1,93 @@
+
+#include <random>
+#include <cstring>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Voxel/VxNoise.hpp"
+
+
+//
+SYN_BENCH(vx_noise_batch, "VxNoise: batch fBm vs. the scalar functions, bit-exact and Mpoints/s")
+{
+	using namespace Syn;
+
+	const VxNoiseContext noise(1234);
+	const uint32_t N = 1 << 16;
+	std::vector<float> x(N), y(N), z(N), scalar(N), batch(N);
+
+	// include zero, negative, integer and small coordinates
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> U(-300.0f, 300.0f);
+	for (uint32_t i = 0; i < N; i++)
+	{
+		x[i] = U(rng);
+		y[i] = U(rng);
+		z[i] = U(rng);
+		if (i % 97 == 0) x[i] = 0.0f;
+		if (i % 89 == 0) y[i] = -1.0f;
+		if (i % 83 == 0) z[i] = (float)(int)z[i];
+		if (i < 1000)
+		{
+			x[i] *= 1e-3f;
+			y[i] *= 1e-3f;
+			z[i] *= 1e-3f;
+		}
+	}
+
+	benchPrint("SIMD path: %s", VxNoise::simd_path());
+	bool passed = true;
+	auto compare = [&](const char* _name, auto _scalar, auto _batch)
+	{
+		float msScalar = benchTimeMs([&]() {
+			for (uint32_t i = 0; i < N; i++)
+				scalar[i] = _scalar(i);
+		});
+		std::fill(batch.begin(), batch.end(), -1.0f);
+		float msBatch = benchTimeMs([&]() { _batch(batch.data()); });
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < N; i++)
+			mismatches += (memcmp(&scalar[i], &batch[i], sizeof(float)) != 0);
+		benchPrint("%-13s scalar %5.1f Mpoints/s, batch %5.1f Mpoints/s (%.1fx)",
+				   _name, N / msScalar / 1e3f, N / msBatch / 1e3f, msScalar / msBatch);
+		passed &= benchCheck(mismatches == 0, "%s: batch is bit-exact (%u mismatches)", _name, mismatches);
+	};
+
+	compare("value2_fbm",   [&](uint32_t i) { return noise.value2_fbm(x[i], y[i]); },
+							[&](float* _out) { noise.value2_fbm(x.data(), y.data(), _out, N); });
+	compare("value2_fbm_r", [&](uint32_t i) { return noise.value2_fbm_r(glm::vec2(x[i], y[i])); },
+							[&](float* _out) { noise.value2_fbm_r(x.data(), y.data(), _out, N); });
+	compare("value3_fbm",   [&](uint32_t i) { return noise.value3_fbm(x[i], y[i], z[i]); },
+							[&](float* _out) { noise.value3_fbm(x.data(), y.data(), z.data(), _out, N); });
+	compare("value3_fbm_r", [&](uint32_t i) { return noise.value3_fbm_r(glm::vec3(x[i], y[i], z[i])); },
+							[&](float* _out) { noise.value3_fbm_r(x.data(), y.data(), z.data(), _out, N); });
+	compare("perlin2_fbm",  [&](uint32_t i) { return noise.perlin2_fbm(x[i], y[i]); },
+							[&](float* _out) { noise.perlin2_fbm(x.data(), y.data(), _out, N); });
+	compare("perlin3_fbm",  [&](uint32_t i) { return noise.perlin3_fbm(x[i], y[i], z[i]); },
+							[&](float* _out) { noise.perlin3_fbm(x.data(), y.data(), z.data(), _out, N); });
+
+	// odd counts (scalar tails) and the grid helpers
+	uint32_t mismatches = 0;
+	std::vector<float> tail(1003);
+	noise.perlin3_fbm(x.data(), y.data(), z.data(), tail.data(), 1003);
+	for (uint32_t i = 0; i < 1003; i++)
+		mismatches += (tail[i] != noise.perlin3_fbm(x[i], y[i], z[i]));
+
+	std::vector<float> grid3(17 * 16 * 16);
+	noise.eval_grid3(&VxNoiseContext::value3_fbm_r, -3.1f, 0.5f, 2.0f, 0.0625f, 0.0625f, 0.0625f, 17, 16, 16, grid3.data());
+	for (uint32_t k = 0; k < 16; k++)
+		for (uint32_t j = 0; j < 16; j++)
+			for (uint32_t i = 0; i < 17; i++)
+				mismatches += (grid3[(k * 16 + j) * 17 + i] !=
+							   noise.value3_fbm_r(glm::vec3(-3.1f + (float)i * 0.0625f, 0.5f + (float)j * 0.0625f, 2.0f + (float)k * 0.0625f)));
+
+	std::vector<float> grid2(33 * 5);
+	noise.eval_grid2(&VxNoiseContext::value2_fbm, 1.0f, 2.0f, 0.1f, 0.2f, 33, 5, grid2.data());
+	for (uint32_t j = 0; j < 5; j++)
+		for (uint32_t i = 0; i < 33; i++)
+			mismatches += (grid2[j * 33 + i] != noise.value2_fbm(1.0f + (float)i * 0.1f, 2.0f + (float)j * 0.2f));
+	passed &= benchCheck(mismatches == 0, "tails and eval_grid2/3 match the scalar functions");
+
+	return passed;
+}
+
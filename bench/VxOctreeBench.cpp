@@ -0,0 +1,241 @@
+
+#include <random>
+#include <map>
+#include <tuple>
+
+#include "Bench.hpp"
+
+#include "SynapseAddons/Voxel/VxOctree.hpp"
+
+
+namespace Syn
+{
+	/* Dense reference world: a heightmap terrain over [-256, 256) in x and z with three
+	 * layers and solid ground down to y = -64, plus point edits.
+	 */
+	class OctreeReference
+	{
+	public:
+		static const int W = 256;
+
+		static int height(int x, int z)
+		{
+			return (int)(24.0f + 14.0f * sinf(x * 0.031f) * cosf(z * 0.027f) + 6.0f * sinf((x + z) * 0.11f));
+		}
+
+		static uint32_t terrain(int x, int y, int z)
+		{
+			if (x < -W || x >= W || z < -W || z >= W || y < -64)
+				return 0;
+			int h = height(x, z);
+			if (y >= h)
+				return 0;
+			return y > h - 2 ? 1 : (y > h - 5 ? 2 : 3);
+		}
+
+		uint32_t get(int x, int y, int z) const
+		{
+			auto it = m_edits.find({ x, y, z });
+			return it != m_edits.end() ? it->second : terrain(x, y, z);
+		}
+
+		void set(int x, int y, int z, uint32_t _value) { m_edits[{ x, y, z }] = _value; }
+
+		// voxel-by-voxel DDA
+		bool raycast(glm::vec3 _origin, glm::vec3 _direction, float _max_distance, glm::ivec3& _voxel, float& _distance) const
+		{
+			glm::vec3 d = glm::normalize(_direction);
+			glm::ivec3 v = glm::ivec3(glm::floor(_origin));
+			glm::vec3 tMax, tDelta;
+			glm::ivec3 step;
+			for (int a = 0; a < 3; a++)
+			{
+				step[a] = d[a] > 0.0f ? 1 : -1;
+				tDelta[a] = d[a] != 0.0f ? fabsf(1.0f / d[a]) : 1e30f;
+				tMax[a] = d[a] != 0.0f ? ((v[a] + (d[a] > 0.0f)) - _origin[a]) / d[a] : 1e30f;
+			}
+			float t = 0.0f;
+			while (t <= _max_distance)
+			{
+				if (VX_DATA_GET_TYPE(get(v.x, v.y, v.z)))
+				{
+					_voxel = v;
+					_distance = t;
+					return true;
+				}
+				int a = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+				t = tMax[a];
+				tMax[a] += tDelta[a];
+				v[a] += step[a];
+			}
+			return false;
+		}
+
+	private:
+		std::map<std::tuple<int, int, int>, uint32_t> m_edits;
+
+	};
+
+}
+
+
+//
+SYN_BENCH(vx_octree, "VxOctree: 512x512 terrain vs. a dense reference, memory and ray throughput")
+{
+	using namespace Syn;
+
+	const int W = OctreeReference::W;
+	const int S = VX_CHUNK_SIZE_XZ;
+	OctreeReference reference;
+	VxOctree octree(6);
+	bool passed = true;
+
+	Timer timer;
+	octree.fill({ -W, -64, -W }, { W, -16, W }, Voxel(3));
+	VxChunkStorage chunk;
+	for (int cx = -W / S; cx < W / S; cx++)
+	{
+		for (int cy = -1; cy < 4; cy++)
+		{
+			for (int cz = -W / S; cz < W / S; cz++)
+			{
+				for (int x = 0; x < S; x++)
+					for (int y = 0; y < S; y++)
+						for (int z = 0; z < S; z++)
+							chunk.at(x, y, z) = Voxel(OctreeReference::terrain(cx * S + x, cy * S + y, cz * S + z));
+				octree.setChunk({ cx, cy, cz }, chunk);
+			}
+		}
+	}
+	float msBuild = timer.getDeltaTimeMs();
+
+	size_t solid = 0;
+	for (int x = -W; x < W; x++)
+		for (int z = -W; z < W; z++)
+			solid += OctreeReference::height(x, z) + 64;
+	float denseMB = (2 * W / S) * (2 * W / S) * (128 / S) * sizeof(VxChunkStorage) / 1048576.0f;
+	benchPrint("build %.0f ms, %.1fM solid voxels, %u nodes, %u bricks", msBuild, solid / 1e6f, octree.getNodeCount(), octree.getBrickCount());
+	benchPrint("memory %.2f MB (%.0f KB per M solid voxels), dense chunks %.0f MB",
+			   octree.memoryUsage() / 1048576.0f, octree.memoryUsage() / 1024.0f / (solid / 1e6f), denseMB);
+
+	// reads, inside and outside the world
+	std::mt19937 rng(3);
+	uint32_t errors = 0;
+	for (int i = 0; i < 200000; i++)
+	{
+		int x = (int)(rng() % 1100) - 550, y = (int)(rng() % 200) - 100, z = (int)(rng() % 1100) - 550;
+		errors += (octree.get({ x, y, z }).data != OctreeReference::terrain(x, y, z));
+	}
+	passed &= benchCheck(errors == 0, "get() matches the reference");
+
+	// edits, before and after collapse()
+	errors = 0;
+	for (int i = 0; i < 20000; i++)
+	{
+		int x = (int)(rng() % 600) - 300, y = (int)(rng() % 120) - 70, z = (int)(rng() % 600) - 300;
+		uint32_t value = rng() % 4;
+		octree.set({ x, y, z }, Voxel(value));
+		reference.set(x, y, z, value);
+	}
+	auto checkEdits = [&]() -> uint32_t
+	{
+		uint32_t e = 0;
+		for (int i = 0; i < 200000; i++)
+		{
+			int x = (int)(rng() % 600) - 300, y = (int)(rng() % 120) - 70, z = (int)(rng() % 600) - 300;
+			e += (octree.get({ x, y, z }).data != reference.get(x, y, z));
+		}
+		return e;
+	};
+	errors = checkEdits();
+	uint32_t nodesBefore = octree.getNodeCount();
+	octree.collapse();
+	errors += checkEdits();
+	benchPrint("20k edits: %u -> %u nodes after collapse()", nodesBefore, octree.getNodeCount());
+	passed &= benchCheck(errors == 0, "set() and collapse() match the reference");
+
+	// chunk extraction
+	errors = 0;
+	for (int cx = -20; cx < 20; cx++)
+	{
+		for (int cy = -6; cy < 6; cy++)
+		{
+			for (int cz = -20; cz < 20; cz += 3)
+			{
+				bool extracted = octree.extractChunk({ cx, cy, cz }, chunk);
+				bool any = false;
+				for (int x = 0; x < S; x++)
+				{
+					for (int y = 0; y < S; y++)
+					{
+						for (int z = 0; z < S; z++)
+						{
+							uint32_t value = reference.get(cx * S + x, cy * S + y, cz * S + z);
+							any |= (value != 0);
+							errors += (chunk.at(x, y, z).data != value);
+						}
+					}
+				}
+				errors += (!extracted && any);
+			}
+		}
+	}
+	passed &= benchCheck(errors == 0, "extractChunk() matches the reference");
+
+	// rays against the brute-force DDA, including axis aligned ones
+	errors = 0;
+	uint32_t hits = 0;
+	std::uniform_real_distribution<float> U(-1.0f, 1.0f);
+	for (int i = 0; i < 20000; i++)
+	{
+		glm::vec3 origin(U(rng) * 300.0f, 30.0f + U(rng) * 40.0f, U(rng) * 300.0f);
+		glm::vec3 direction(U(rng), U(rng) - 0.3f, U(rng));
+		if (i % 50 == 0) direction = glm::vec3(0.0f, -1.0f, 0.0f);
+		if (i % 51 == 0) direction = glm::vec3(1.0f, 0.0f, 0.0f);
+
+		VxRayHit hit;
+		glm::ivec3 voxel;
+		float distance;
+		bool r = octree.raycast(origin, direction, 400.0f, hit);
+		bool rr = reference.raycast(origin, direction, 400.0f, voxel, distance);
+		errors += (r != rr || (r && (hit.voxel != voxel || fabsf(hit.distance - distance) > 1e-2f)));
+		if (r)
+		{
+			// the entry face is on the empty side
+			hits++;
+			glm::ivec3 front = hit.voxel + hit.normal;
+			errors += (hit.normal != glm::ivec3(0) && reference.get(front.x, front.y, front.z) != 0);
+		}
+	}
+	passed &= benchCheck(errors == 0, "raycast() matches the brute-force DDA (%u of 20000 rays hit)", hits);
+
+	// throughput
+	std::vector<std::pair<glm::vec3, glm::vec3>> rays(1 << 19);
+	for (auto& r : rays)
+	{
+		r.first = glm::vec3(U(rng) * 250.0f, 60.0f + U(rng) * 20.0f, U(rng) * 250.0f);
+		r.second = glm::vec3(U(rng), -0.5f + 0.4f * U(rng), U(rng));
+	}
+	uint32_t count = 0;
+	float msPicking = benchTimeMs([&]() {
+		for (auto& r : rays)
+		{
+			VxRayHit hit;
+			count += octree.raycast(r.first, r.second, 1000.0f, hit);
+		}
+	}, 1);
+	for (auto& r : rays)
+	{
+		r.first = glm::vec3(U(rng) * 250.0f, 50.0f + U(rng) * 10.0f, U(rng) * 250.0f);
+		r.second = glm::vec3(r.first.x + U(rng) * 100.0f, 50.0f + U(rng) * 10.0f, r.first.z + U(rng) * 100.0f);
+	}
+	float msSight = benchTimeMs([&]() {
+		for (auto& r : rays)
+			count += octree.lineOfSight(r.first, r.second);
+	}, 1);
+	benchPrint("picking rays %.2f M/s, line of sight (100 voxels) %.2f M/s",
+			   rays.size() / msPicking / 1e3f, rays.size() / msSight / 1e3f);
+
+	return passed;
+}
+
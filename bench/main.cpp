@@ -0,0 +1,69 @@
+
+#include <cstring>
+
+#include "Bench.hpp"
+
+#include "SynapseCore/Debug/Log.hpp"
+#include "SynapseCore/Event/EventHandler.hpp"
+#include "SynapseCore/Utils/Random/Random.hpp"
+#include "SynapseCore/Utils/Thread/ThreadPool.hpp"
+
+
+//
+int main(int _argc, char* _argv[])
+{
+	using namespace Syn;
+
+	// engine log goes to file, stdout is reserved for the results
+	Log::open("./bench_log.txt");
+	Log::use_stdout(false);
+	Random::init();
+	EventHandler::init();
+	ThreadPool::get().init();
+
+	std::vector<BenchCase>& cases = BenchRegistry::cases();
+	std::sort(cases.begin(), cases.end(), [](const BenchCase& _a, const BenchCase& _b) { return _a.name < _b.name; });
+
+	if (_argc > 1 && strcmp(_argv[1], "--list") == 0)
+	{
+		for (auto& c : cases)
+			printf("%-24s %s\n", c.name.c_str(), c.description.c_str());
+		return 0;
+	}
+
+	// select cases by name, all if none given
+	std::vector<const BenchCase*> run;
+	for (auto& c : cases)
+	{
+		bool selected = (_argc == 1);
+		for (int i = 1; i < _argc && !selected; i++)
+			selected = (c.name == _argv[i]);
+		if (selected)
+			run.push_back(&c);
+	}
+	if (run.empty())
+	{
+		printf("no matching bench cases (see --list).\n");
+		return 1;
+	}
+
+	printf("worker threads: %zu\n", ThreadPool::get().threadCount());
+	uint32_t failed = 0;
+	for (auto* c : run)
+	{
+		printf("\n%s -- %s\n", c->name.c_str(), c->description.c_str());
+		if (!c->fnc())
+		{
+			printf("  %s FAILED\n", c->name.c_str());
+			failed++;
+		}
+	}
+	printf("\n%zu cases run, %u failed.\n", run.size(), failed);
+
+	EventHandler::shutdown();
+	ThreadPool::get().shutdown();
+	Log::close();
+
+	return failed > 0 ? 1 : 0;
+}
+
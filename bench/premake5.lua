@@ -0,0 +1,63 @@
+project "bench"
+
+    -- headless benchmarks and checks of synapse-core, run from the command line:
+    --   ./bench                  runs all cases
+    --   ./bench <name> [...]     runs the named cases
+    --   ./bench --list           lists the cases
+    kind "ConsoleApp"
+
+    targetdir ("%{wks.location}/bin/" .. outputdir .. "/%{prj.name}")
+    objdir ("%{wks.location}/obj/" .. outputdir .. "/%{prj.name}")
+
+    -- the workspace pch lives in synapse-core
+    flags { "NoPCH" }
+
+    files
+    {
+        "**.hpp",
+        "**.cpp",
+    }
+
+    defines
+    {
+        "_CRT_SECURE_NO_WARNINGS",
+        "GLFW_INCLUDE_NONE",
+    }
+
+    includedirs
+    {
+        ".",
+        "%{IncludeDirs.synapse}",
+        "%{IncludeDirs.headers}",
+        "%{IncludeDirs.freetype2}",
+        "%{IncludeDirs.libpng}",
+    }
+
+    libdirs
+    {
+        "%{LibDirs.freetype2}",
+        "%{LibDirs.libpng}",
+    }
+
+    links
+    {
+        "synapse-core",
+        "glfw3",
+        "glad",
+        "assimp",
+        "freetype",
+        "bz2",
+        "png",
+        "z",
+        "pthread",
+        "dl",
+        "X11",
+    }
+
+
+    filter "configurations.Debug"
+        runtime "Debug"
+
+    filter "configurations.Release"
+        runtime "Release"
+
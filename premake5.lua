@@ -85,6 +85,7 @@ LibDirs["synapse"] = "%{wks.location}/build/bin/Release-linux-x86_64/synapse-cor
 
 -- projects included in this workspace -- inheriting globals from this file
 include "synapse-core"
+include "bench"
 --include "projects/imgui-1.88-test"
 --include "projects/mpl_test_v0.2"
 --include "projects/imgui-1.88-tabs"
@@ -0,0 +1,499 @@
+
+#include "../../pch.hpp"
+
+#include <cmath>
+
+#include "FluidSolverCPU.hpp"
+#include "../../SynapseCore/Utils/CPUFeatures.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+#include "../../SynapseCore/Utils/Timer/Timer.hpp"
+
+
+
+namespace Syn {
+
+
+	// Row kernels over the interior of a row, from j = 1 up to the returned index; the
+	// remainder is done by the scalar path. Rows b(ottom) and t(op) are y - 1 and y + 1.
+
+	// out = (pL + pR + pB + pT + alpha * b) * rbeta
+	typedef uint32_t (*jacobi_row_t)(const float*, const float*, const float*, const float*, uint32_t, float, float, float*);
+	// out = halfrdx * (uR - uL + vT - vB)
+	typedef uint32_t (*divergence_row_t)(const float*, const float*, const float*, uint32_t, float, float*);
+	// u -= halfrdx * (pR - pL), v -= halfrdx * (pT - pB)
+	typedef uint32_t (*gradient_row_t)(const float*, const float*, const float*, uint32_t, float, float*, float*);
+	// out = halfrdx * (vR - vL - (uT - uB))
+	typedef uint32_t (*curl_row_t)(const float*, const float*, const float*, uint32_t, float, float*);
+
+
+	//-----------------------------------------------------------------------------------
+	static void jacobi_row_scalar(const float* _pb, const float* _p, const float* _pt, const float* _b, uint32_t _j_begin, uint32_t _j_end, float _alpha, float _rbeta, float* _out)
+	{
+		for (uint32_t j = _j_begin; j < _j_end; j++)
+			_out[j] = (((_p[j - 1] + _p[j + 1]) + (_pb[j] + _pt[j])) + _alpha * _b[j]) * _rbeta;
+	}
+	//-----------------------------------------------------------------------------------
+	static void divergence_row_scalar(const float* _u, const float* _vb, const float* _vt, uint32_t _j_begin, uint32_t _j_end, float _halfrdx, float* _out)
+	{
+		for (uint32_t j = _j_begin; j < _j_end; j++)
+			_out[j] = _halfrdx * ((_u[j + 1] - _u[j - 1]) + (_vt[j] - _vb[j]));
+	}
+	//-----------------------------------------------------------------------------------
+	static void gradient_row_scalar(const float* _pb, const float* _p, const float* _pt, uint32_t _j_begin, uint32_t _j_end, float _halfrdx, float* _u, float* _v)
+	{
+		for (uint32_t j = _j_begin; j < _j_end; j++)
+		{
+			_u[j] = _u[j] - _halfrdx * (_p[j + 1] - _p[j - 1]);
+			_v[j] = _v[j] - _halfrdx * (_pt[j] - _pb[j]);
+		}
+	}
+	//-----------------------------------------------------------------------------------
+	static void curl_row_scalar(const float* _ub, const float* _ut, const float* _v, uint32_t _j_begin, uint32_t _j_end, float _halfrdx, float* _out)
+	{
+		for (uint32_t j = _j_begin; j < _j_end; j++)
+			_out[j] = _halfrdx * ((_v[j + 1] - _v[j - 1]) - (_ut[j] - _ub[j]));
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static uint32_t jacobi_row_none(const float*, const float*, const float*, const float*, uint32_t, float, float, float*) { return 1; }
+	static uint32_t divergence_row_none(const float*, const float*, const float*, uint32_t, float, float*) { return 1; }
+	static uint32_t gradient_row_none(const float*, const float*, const float*, uint32_t, float, float*, float*) { return 1; }
+	static uint32_t curl_row_none(const float*, const float*, const float*, uint32_t, float, float*) { return 1; }
+
+
+#ifdef SYN_SIMD_X86
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static uint32_t jacobi_row_avx2(const float* _pb, const float* _p, const float* _pt, const float* _b, uint32_t _w, float _alpha, float _rbeta, float* _out)
+	{
+		const __m256 alpha = _mm256_set1_ps(_alpha);
+		const __m256 rbeta = _mm256_set1_ps(_rbeta);
+
+		uint32_t j = 1;
+		for (; j + 8 <= _w - 1; j += 8)
+		{
+			__m256 lr = _mm256_add_ps(_mm256_loadu_ps(_p + j - 1), _mm256_loadu_ps(_p + j + 1));
+			__m256 bt = _mm256_add_ps(_mm256_loadu_ps(_pb + j), _mm256_loadu_ps(_pt + j));
+			__m256 s = _mm256_add_ps(_mm256_add_ps(lr, bt), _mm256_mul_ps(alpha, _mm256_loadu_ps(_b + j)));
+			_mm256_storeu_ps(_out + j, _mm256_mul_ps(s, rbeta));
+		}
+		return j;
+	}
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static uint32_t divergence_row_avx2(const float* _u, const float* _vb, const float* _vt, uint32_t _w, float _halfrdx, float* _out)
+	{
+		const __m256 halfrdx = _mm256_set1_ps(_halfrdx);
+
+		uint32_t j = 1;
+		for (; j + 8 <= _w - 1; j += 8)
+		{
+			__m256 du = _mm256_sub_ps(_mm256_loadu_ps(_u + j + 1), _mm256_loadu_ps(_u + j - 1));
+			__m256 dv = _mm256_sub_ps(_mm256_loadu_ps(_vt + j), _mm256_loadu_ps(_vb + j));
+			_mm256_storeu_ps(_out + j, _mm256_mul_ps(halfrdx, _mm256_add_ps(du, dv)));
+		}
+		return j;
+	}
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static uint32_t gradient_row_avx2(const float* _pb, const float* _p, const float* _pt, uint32_t _w, float _halfrdx, float* _u, float* _v)
+	{
+		const __m256 halfrdx = _mm256_set1_ps(_halfrdx);
+
+		uint32_t j = 1;
+		for (; j + 8 <= _w - 1; j += 8)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(_p + j + 1), _mm256_loadu_ps(_p + j - 1));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(_pt + j), _mm256_loadu_ps(_pb + j));
+			_mm256_storeu_ps(_u + j, _mm256_sub_ps(_mm256_loadu_ps(_u + j), _mm256_mul_ps(halfrdx, dx)));
+			_mm256_storeu_ps(_v + j, _mm256_sub_ps(_mm256_loadu_ps(_v + j), _mm256_mul_ps(halfrdx, dy)));
+		}
+		return j;
+	}
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static uint32_t curl_row_avx2(const float* _ub, const float* _ut, const float* _v, uint32_t _w, float _halfrdx, float* _out)
+	{
+		const __m256 halfrdx = _mm256_set1_ps(_halfrdx);
+
+		uint32_t j = 1;
+		for (; j + 8 <= _w - 1; j += 8)
+		{
+			__m256 dv = _mm256_sub_ps(_mm256_loadu_ps(_v + j + 1), _mm256_loadu_ps(_v + j - 1));
+			__m256 du = _mm256_sub_ps(_mm256_loadu_ps(_ut + j), _mm256_loadu_ps(_ub + j));
+			_mm256_storeu_ps(_out + j, _mm256_mul_ps(halfrdx, _mm256_sub_ps(dv, du)));
+		}
+		return j;
+	}
+#endif
+
+
+	//-----------------------------------------------------------------------------------
+	struct fluid_kernels_t
+	{
+		jacobi_row_t jacobi = jacobi_row_none;
+		divergence_row_t divergence = divergence_row_none;
+		gradient_row_t gradient = gradient_row_none;
+		curl_row_t curl = curl_row_none;
+		const char* name = "scalar";
+	};
+	//-----------------------------------------------------------------------------------
+	static const fluid_kernels_t& get_kernels(bool _simd)
+	{
+		static const fluid_kernels_t s_scalar;
+		if (!_simd)
+			return s_scalar;
+
+		static fluid_kernels_t s_kernels = []()
+		{
+			fluid_kernels_t kernels;
+			#if defined(SYN_SIMD_X86)
+				if (cpu_features().avx2)
+					kernels = { jacobi_row_avx2, divergence_row_avx2, gradient_row_avx2, curl_row_avx2, "AVX2" };
+			#endif
+			return kernels;
+		}();
+		return s_kernels;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	FluidSolverCPU::FluidSolverCPU(uint32_t _width, uint32_t _height, const FluidParameters& _params) :
+		m_width(max(_width, 3u)), m_height(max(_height, 3u)), m_params(_params), m_multigrid(_params.multigrid)
+	{
+		m_velocity = createSlab(m_width, m_height, 2, "velocity");
+		m_density = createSlab(m_width, m_height, 1, "density");
+		m_pressure = createSlab(m_width, m_height, 1, "pressure");
+		m_divergence = createSurface(m_width, m_height, 1, "divergence");
+		m_vorticity = createSurface(m_width, m_height, 1, "vorticity");
+		m_stats.kernels = get_kernels(m_params.simd).name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	CPUSlab FluidSolverCPU::createSlab(uint32_t _width, uint32_t _height, uint32_t _channels, const std::string& _name)
+	{
+		std::string frontName = "";
+		std::string backName = "";
+
+		if (_name.compare("") != 0)
+		{
+			frontName = "front_" + _name;
+			backName = "back_" + _name;
+		}
+
+		CPUSlab slab;
+		slab.frontSurface = createSurface(_width, _height, _channels, frontName);
+		slab.backSurface = createSurface(_width, _height, _channels, backName);
+		return slab;
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<CPUSurface> FluidSolverCPU::createSurface(uint32_t _width, uint32_t _height, uint32_t _channels, const std::string& _name)
+	{
+		Ref<CPUSurface> surface = std::make_shared<CPUSurface>();
+		surface->width = _width;
+		surface->height = _height;
+		surface->channels = _channels;
+		surface->name = _name;
+		surface->data.assign((size_t)_width * _height * _channels, 0.0f);
+		return surface;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::clearSurface(const Ref<CPUSurface>& _surface, float _value)
+	{
+		std::fill(_surface->data.begin(), _surface->data.end(), _value);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::swapSurfaces(CPUSlab* _slab)
+	{
+		Ref<CPUSurface> tmp = _slab->backSurface;
+		_slab->backSurface = _slab->frontSurface;
+		_slab->frontSurface = tmp;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::reset()
+	{
+		clearSurface(m_velocity.frontSurface);
+		clearSurface(m_velocity.backSurface);
+		clearSurface(m_density.frontSurface);
+		clearSurface(m_density.backSurface);
+		clearSurface(m_pressure.frontSurface);
+		clearSurface(m_pressure.backSurface);
+		clearSurface(m_divergence);
+		clearSurface(m_vorticity);
+		m_stats = FluidStats();
+		m_stats.kernels = get_kernels(m_params.simd).name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::setParameters(const FluidParameters& _params)
+	{
+		m_params = _params;
+		m_multigrid.setParameters(_params.multigrid);
+		m_stats.kernels = get_kernels(m_params.simd).name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::update(float _dt)
+	{
+		Timer timer("", false);
+
+		advect(_dt, *m_velocity.frontSurface, &m_velocity, m_params.velocityDissipation);
+		advect(_dt, *m_velocity.frontSurface, &m_density, m_params.densityDissipation);
+
+		if (m_params.vorticity > 0.0f)
+			vorticityConfinement(_dt);
+
+		divergence();
+		pressureSolve();
+		subtractGradient();
+
+		m_stats.lastStepMs = timer.getDeltaTimeMs();
+		m_stats.stepsPerSecond = m_stats.lastStepMs > 0.0f ? 1000.0f / m_stats.lastStepMs : 0.0f;
+		m_stats.steps++;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::addSplat(const glm::vec2& _position, const glm::vec2& _velocity, float _density, float _radius)
+	{
+		CPUSurface& velocity = *m_velocity.frontSurface;
+		CPUSurface& density = *m_density.frontSurface;
+
+		float r = max(_radius, 0.5f);
+		float inv_r2 = 1.0f / (r * r);
+		int extent = (int)std::ceil(3.0f * r);
+		int x0 = max((int)_position.x - extent, 1);
+		int x1 = min((int)_position.x + extent, (int)m_width - 2);
+		int y0 = max((int)_position.y - extent, 1);
+		int y1 = min((int)_position.y + extent, (int)m_height - 2);
+
+		for (int y = y0; y <= y1; y++)
+		{
+			float* u = velocity.row(0, y);
+			float* v = velocity.row(1, y);
+			float* d = density.row(0, y);
+			for (int x = x0; x <= x1; x++)
+			{
+				float dx = (float)x + 0.5f - _position.x;
+				float dy = (float)y + 0.5f - _position.y;
+				float w = std::exp(-(dx * dx + dy * dy) * inv_r2);
+				u[x] += _velocity.x * w;
+				v[x] += _velocity.y * w;
+				d[x] += _density * w;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::advect(float _dt, const CPUSurface& _velocity, CPUSlab* _quantity, float _dissipation)
+	{
+		const CPUSurface& src = *_quantity->frontSurface;
+		CPUSurface& dst = *_quantity->backSurface;
+		float scale = _dt / m_params.cellSize;
+		float xmax = (float)m_width - 1.5f;
+		float ymax = (float)m_height - 1.5f;
+
+		ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+		{
+			uint32_t y = (uint32_t)_y;
+			const float* u = _velocity.row(0, y);
+			const float* v = _velocity.row(1, y);
+			for (uint32_t x = 1; x < m_width - 1; x++)
+			{
+				// trace back, then bilinear interpolation of the quantity
+				float px = min(max((float)x - scale * u[x], 0.5f), xmax);
+				float py = min(max((float)y - scale * v[x], 0.5f), ymax);
+				uint32_t ix = (uint32_t)px;
+				uint32_t iy = (uint32_t)py;
+				float fx = px - (float)ix;
+				float fy = py - (float)iy;
+
+				for (uint32_t c = 0; c < src.channels; c++)
+				{
+					const float* r0 = src.row(c, iy);
+					const float* r1 = src.row(c, iy + 1);
+					float a = r0[ix] + fx * (r0[ix + 1] - r0[ix]);
+					float b = r1[ix] + fx * (r1[ix + 1] - r1[ix]);
+					dst.row(c, y)[x] = _dissipation * (a + fy * (b - a));
+				}
+			}
+		}, 8);
+
+		// velocities are no-slip at the walls
+		setBoundary(dst, src.channels == 2 ? -1.0f : 1.0f);
+		swapSurfaces(_quantity);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::vorticityConfinement(float _dt)
+	{
+		CPUSurface& velocity = *m_velocity.frontSurface;
+		CPUSurface& vorticity = *m_vorticity;
+		const fluid_kernels_t& kernels = get_kernels(m_params.simd);
+		float halfrdx = 0.5f / m_params.cellSize;
+		uint32_t w = m_width;
+
+		ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+		{
+			uint32_t y = (uint32_t)_y;
+			const float* ub = velocity.row(0, y - 1);
+			const float* ut = velocity.row(0, y + 1);
+			const float* v = velocity.row(1, y);
+			float* out = vorticity.row(0, y);
+			uint32_t j = kernels.curl(ub, ut, v, w, halfrdx, out);
+			curl_row_scalar(ub, ut, v, j, w - 1, halfrdx, out);
+		}, 8);
+
+		// force along N x w, N the normalized gradient of |w|; the vorticity boundary is 0
+		float scale = _dt * m_params.vorticity * m_params.cellSize;
+		ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+		{
+			uint32_t y = (uint32_t)_y;
+			const float* wb = vorticity.row(0, y - 1);
+			const float* wc = vorticity.row(0, y);
+			const float* wt = vorticity.row(0, y + 1);
+			float* u = velocity.row(0, y);
+			float* v = velocity.row(1, y);
+			for (uint32_t x = 1; x < w - 1; x++)
+			{
+				float nx = halfrdx * (std::fabs(wc[x + 1]) - std::fabs(wc[x - 1]));
+				float ny = halfrdx * (std::fabs(wt[x]) - std::fabs(wb[x]));
+				float len_i = 1.0f / (std::sqrt(nx * nx + ny * ny) + 1e-5f);
+				u[x] += scale * ny * len_i * wc[x];
+				v[x] -= scale * nx * len_i * wc[x];
+			}
+		}, 8);
+
+		setBoundary(velocity, -1.0f);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::divergence()
+	{
+		const CPUSurface& velocity = *m_velocity.frontSurface;
+		CPUSurface& divergence = *m_divergence;
+		const fluid_kernels_t& kernels = get_kernels(m_params.simd);
+		float halfrdx = 0.5f / m_params.cellSize;
+		uint32_t w = m_width;
+
+		ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+		{
+			uint32_t y = (uint32_t)_y;
+			const float* u = velocity.row(0, y);
+			const float* vb = velocity.row(1, y - 1);
+			const float* vt = velocity.row(1, y + 1);
+			float* out = divergence.row(0, y);
+			uint32_t j = kernels.divergence(u, vb, vt, w, halfrdx, out);
+			divergence_row_scalar(u, vb, vt, j, w - 1, halfrdx, out);
+		}, 8);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::pressureSolve()
+	{
+		if (m_params.pressureSolver == FluidPressureSolver::Multigrid)
+		{
+			m_multigrid.solve(*m_pressure.frontSurface, *m_divergence, m_params.cellSize);
+			const MultigridStats& stats = m_multigrid.getStats();
+			m_stats.pressureMs = stats.solveMs;
+			m_stats.pressureCycles = stats.cycles;
+			m_stats.pressureResidual = stats.relativeResidual;
+			return;
+		}
+
+		Timer timer("", false);
+		const fluid_kernels_t& kernels = get_kernels(m_params.simd);
+		const CPUSurface& divergence = *m_divergence;
+		float alpha = -m_params.cellSize * m_params.cellSize;
+		float rbeta = 0.25f;
+		uint32_t w = m_width;
+
+		for (uint32_t it = 0; it < m_params.pressureIterations; it++)
+		{
+			const CPUSurface& src = *m_pressure.frontSurface;
+			CPUSurface& dst = *m_pressure.backSurface;
+
+			ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+			{
+				uint32_t y = (uint32_t)_y;
+				const float* pb = src.row(0, y - 1);
+				const float* p = src.row(0, y);
+				const float* pt = src.row(0, y + 1);
+				const float* b = divergence.row(0, y);
+				float* out = dst.row(0, y);
+				uint32_t j = kernels.jacobi(pb, p, pt, b, w, alpha, rbeta, out);
+				jacobi_row_scalar(pb, p, pt, b, j, w - 1, alpha, rbeta, out);
+				// zero gradient at the side walls
+				out[0] = out[1];
+				out[w - 1] = out[w - 2];
+			}, 8);
+
+			memcpy(dst.row(0, 0), dst.row(0, 1), sizeof(float) * w);
+			memcpy(dst.row(0, m_height - 1), dst.row(0, m_height - 2), sizeof(float) * w);
+			swapSurfaces(&m_pressure);
+		}
+
+		m_stats.pressureMs = timer.getDeltaTimeMs();
+		m_stats.pressureCycles = m_params.pressureIterations;
+		m_stats.pressureResidual = 0.0f;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::subtractGradient()
+	{
+		const fluid_kernels_t& kernels = get_kernels(m_params.simd);
+		const CPUSurface& pressure = *m_pressure.frontSurface;
+		CPUSurface& velocity = *m_velocity.frontSurface;
+		float halfrdx = 0.5f / m_params.cellSize;
+		uint32_t w = m_width;
+
+		ThreadPool::get().parallelFor(1, m_height - 1, [&](size_t _y)
+		{
+			uint32_t y = (uint32_t)_y;
+			const float* pb = pressure.row(0, y - 1);
+			const float* p = pressure.row(0, y);
+			const float* pt = pressure.row(0, y + 1);
+			float* u = velocity.row(0, y);
+			float* v = velocity.row(1, y);
+			uint32_t j = kernels.gradient(pb, p, pt, w, halfrdx, u, v);
+			gradient_row_scalar(pb, p, pt, j, w - 1, halfrdx, u, v);
+		}, 8);
+
+		setBoundary(velocity, -1.0f);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void FluidSolverCPU::setBoundary(CPUSurface& _surface, float _scale)
+	{
+		uint32_t w = _surface.width;
+		uint32_t h = _surface.height;
+
+		for (uint32_t c = 0; c < _surface.channels; c++)
+		{
+			for (uint32_t y = 1; y < h - 1; y++)
+			{
+				float* r = _surface.row(c, y);
+				r[0] = _scale * r[1];
+				r[w - 1] = _scale * r[w - 2];
+			}
+
+			float* bottom = _surface.row(c, 0);
+			float* top = _surface.row(c, h - 1);
+			const float* bottomInner = _surface.row(c, 1);
+			const float* topInner = _surface.row(c, h - 2);
+			for (uint32_t x = 0; x < w; x++)
+			{
+				bottom[x] = _scale * bottomInner[x];
+				top[x] = _scale * topInner[x];
+			}
+		}
+	}
+
+
+}
+
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <glm/glm.hpp>
+
+#include "../../SynapseCore/Core.hpp"
+#include "../../SynapseCore/Memory/MemoryTypes.hpp"
+
+#include "Multigrid.hpp"
+
+
+namespace Syn {
+
+	/* CPU counterpart of a Grid2D surface : a width x height grid of float channels, stored
+	 * as structure of arrays (channel c at data[c * width * height], rows contiguous).
+	 */
+	struct CPUSurface
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t channels = 0;
+		std::string name = "";
+		std::vector<float> data;
+
+		inline float* channel(uint32_t _c) { return data.data() + (size_t)_c * width * height; }
+		inline const float* channel(uint32_t _c) const { return data.data() + (size_t)_c * width * height; }
+		inline float* row(uint32_t _c, uint32_t _y) { return channel(_c) + (size_t)_y * width; }
+		inline const float* row(uint32_t _c, uint32_t _y) const { return channel(_c) + (size_t)_y * width; }
+	};
+
+	// As Slab; kernels read the front surface and write the back, then the two are swapped.
+	typedef struct cpu_slab_
+	{
+		Ref<CPUSurface> frontSurface;
+		Ref<CPUSurface> backSurface;
+	} CPUSlab;
+
+
+	//
+	enum class FluidPressureSolver
+	{
+		Jacobi		= 0,
+		Multigrid	= 1,
+	};
+
+	//
+	struct FluidParameters
+	{
+		float cellSize = 1.0f;
+		FluidPressureSolver pressureSolver = FluidPressureSolver::Multigrid;
+		uint32_t pressureIterations = 40;	// Jacobi iterations, warm started from the last step
+		MultigridParameters multigrid;
+		float velocityDissipation = 0.999f;
+		float densityDissipation = 0.995f;
+		float vorticity = 0.3f;				// vorticity confinement strength, 0 to disable
+		bool simd = true;					// AVX2 row kernels where supported, false forces the scalar path
+	};
+
+	//
+	struct FluidStats
+	{
+		float lastStepMs = 0.0f;
+		float stepsPerSecond = 0.0f;		// of the last step
+		uint64_t steps = 0;
+		const char* kernels = "scalar";
+		float pressureMs = 0.0f;
+		uint32_t pressureCycles = 0;		// V-cycles, or Jacobi iterations
+		float pressureResidual = 0.0f;		// relative, multigrid only
+	};
+
+
+	/* Stable fluids (Stam 1999, as in GPU Gems ch. 38) on the CPU : semi-Lagrangian advection
+	 * of velocity and density, vorticity confinement, divergence, pressure projection
+	 * (multigrid V-cycles, or Jacobi iterations) and gradient subtraction, on cell centered
+	 * grids with no-slip walls. The outermost cells are boundary cells.
+	 *
+	 * Stencil kernels process rows with AVX2 where supported (selected at runtime), in the
+	 * same operation order as the scalar path, so results don't depend on the CPU. Rows are
+	 * distributed over the ThreadPool. Slabs follow Grid2D : every pass writes the back
+	 * surface and swaps. Units are cells and seconds, velocities in cells per second.
+	 */
+	class FluidSolverCPU
+	{
+	public:
+		FluidSolverCPU(uint32_t _width, uint32_t _height, const FluidParameters& _params=FluidParameters());
+		~FluidSolverCPU() = default;
+
+		// Surface handling, as Grid2D
+		CPUSlab createSlab(uint32_t _width, uint32_t _height, uint32_t _channels, const std::string& _name="");
+		Ref<CPUSurface> createSurface(uint32_t _width, uint32_t _height, uint32_t _channels, const std::string& _name);
+		void clearSurface(const Ref<CPUSurface>& _surface, float _value=0.0f);
+		void swapSurfaces(CPUSlab* _slab);
+
+		/* Advances the simulation by _dt. */
+		void update(float _dt);
+
+		/* Adds velocity and density around _position (in cells), with a Gaussian falloff of
+		 * _radius cells. Takes effect in the next update(). */
+		void addSplat(const glm::vec2& _position, const glm::vec2& _velocity, float _density, float _radius);
+
+		/* Clears velocity, density and pressure. */
+		void reset();
+		/* Takes effect from the next update(). */
+		void setParameters(const FluidParameters& _params);
+
+		// Accessors
+		inline const FluidParameters& getParameters() const { return m_params; }
+		inline const FluidStats& getStats() const { return m_stats; }
+		inline uint32_t getWidth() const { return m_width; }
+		inline uint32_t getHeight() const { return m_height; }
+		// current fields : velocity (u, v), density, pressure; divergence and vorticity of the last step
+		inline const Ref<CPUSurface>& getVelocity() const { return m_velocity.frontSurface; }
+		inline const Ref<CPUSurface>& getDensity() const { return m_density.frontSurface; }
+		inline const Ref<CPUSurface>& getPressure() const { return m_pressure.frontSurface; }
+		inline const Ref<CPUSurface>& getDivergence() const { return m_divergence; }
+		inline const Ref<CPUSurface>& getVorticity() const { return m_vorticity; }
+
+
+	private:
+		void advect(float _dt, const CPUSurface& _velocity, CPUSlab* _quantity, float _dissipation);
+		void vorticityConfinement(float _dt);
+		void divergence();
+		void pressureSolve();
+		void subtractGradient();
+		// walls : no-slip (negated neighbour) for velocity, zero gradient for scalars
+		void setBoundary(CPUSurface& _surface, float _scale);
+
+
+	private:
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		FluidParameters m_params;
+
+		CPUSlab m_velocity;
+		CPUSlab m_density;
+		CPUSlab m_pressure;
+		MultigridCPU m_multigrid;
+		Ref<CPUSurface> m_divergence = nullptr;
+		Ref<CPUSurface> m_vorticity = nullptr;
+
+		FluidStats m_stats;
+
+	};
+
+}
+
@@ -0,0 +1,273 @@
+
+#include "../../pch.hpp"
+
+#include <cmath>
+
+#include "Multigrid.hpp"
+#include "FluidSolverCPU.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+#include "../../SynapseCore/Utils/Timer/Timer.hpp"
+
+
+namespace Syn {
+
+
+	//-----------------------------------------------------------------------------------
+	// rows per ThreadPool task : small levels run inline
+	static inline size_t row_grain(const MultigridLevel& _level)
+	{
+		return max((size_t)16384 / _level.stride, (size_t)4);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::solve(CPUSurface& _pressure, const CPUSurface& _divergence, float _cell_size)
+	{
+		Timer timer("", false);
+
+		if (_pressure.width < 3 || _pressure.height < 3)
+			return;
+
+		uint32_t nx = _pressure.width - 2;
+		uint32_t ny = _pressure.height - 2;
+		if (m_levels.empty() || m_levels[0].nx != nx || m_levels[0].ny != ny || m_levels[0].h != _cell_size)
+			setupLevels(nx, ny, _cell_size);
+
+		MultigridLevel& fine = m_levels[0];
+		fine.u = _pressure.channel(0);
+
+		// rhs without its mean, so that the Neumann problem has a solution
+		double sum = 0.0;
+		for (uint32_t y = 1; y <= ny; y++)
+		{
+			const float* d = _divergence.row(0, y);
+			for (uint32_t x = 1; x <= nx; x++)
+				sum += d[x];
+		}
+		float mean = (float)(sum / ((double)nx * ny));
+		double sumSq = 0.0;
+		for (uint32_t y = 1; y <= ny; y++)
+		{
+			const float* d = _divergence.row(0, y);
+			float* f = fine.f.data() + (size_t)y * fine.stride;
+			for (uint32_t x = 1; x <= nx; x++)
+			{
+				f[x] = d[x] - mean;
+				sumSq += (double)f[x] * f[x];
+			}
+		}
+		float rhsNorm = (float)std::sqrt(sumSq / ((double)nx * ny));
+
+		m_stats.levels = (uint32_t)m_levels.size();
+		m_stats.cycles = 0;
+		m_stats.initialResidual = residual(0);
+		m_stats.residual = m_stats.initialResidual;
+
+		while (m_stats.cycles < m_params.maxCycles && m_stats.residual > m_params.tolerance * rhsNorm)
+		{
+			vcycle(0);
+			m_stats.residual = residual(0);
+			m_stats.cycles++;
+		}
+
+		setBoundary(0);
+		m_stats.relativeResidual = rhsNorm > 0.0f ? m_stats.residual / rhsNorm : 0.0f;
+		m_stats.solveMs = timer.getDeltaTimeMs();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::setupLevels(uint32_t _nx, uint32_t _ny, float _cell_size)
+	{
+		m_levels.clear();
+
+		uint32_t nx = _nx;
+		uint32_t ny = _ny;
+		float h = _cell_size;
+		uint32_t coarsest = max(m_params.coarsestSize, 1u);
+		while (true)
+		{
+			MultigridLevel level;
+			level.nx = nx;
+			level.ny = ny;
+			level.stride = nx + 2;
+			level.h = h;
+			size_t count = (size_t)(nx + 2) * (ny + 2);
+			if (!m_levels.empty())
+				level.uData.assign(count, 0.0f);
+			level.f.assign(count, 0.0f);
+			level.r.assign(count, 0.0f);
+			m_levels.push_back(std::move(level));
+
+			if (min(nx, ny) < 2 * coarsest)
+				break;
+			nx = (nx + 1) / 2;
+			ny = (ny + 1) / 2;
+			h *= 2.0f;
+		}
+
+		// level 0 solves in place, in the pressure surface
+		for (size_t i = 1; i < m_levels.size(); i++)
+			m_levels[i].u = m_levels[i].uData.data();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::vcycle(uint32_t _level)
+	{
+		if (_level == m_levels.size() - 1)
+		{
+			smooth(_level, m_params.coarseSmooth);
+			return;
+		}
+
+		smooth(_level, m_params.preSmooth);
+		residual(_level);
+		restrictResidual(_level);
+
+		MultigridLevel& coarse = m_levels[_level + 1];
+		std::fill(coarse.uData.begin(), coarse.uData.end(), 0.0f);
+		vcycle(_level + 1);
+
+		prolongate(_level);
+		smooth(_level, m_params.postSmooth);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::smooth(uint32_t _level, uint32_t _sweeps)
+	{
+		MultigridLevel& level = m_levels[_level];
+		float* u = level.u;
+		const float* f = level.f.data();
+		uint32_t stride = level.stride;
+		uint32_t nx = level.nx;
+		float h2 = level.h * level.h;
+
+		for (uint32_t s = 0; s < _sweeps; s++)
+		{
+			for (uint32_t color = 0; color < 2; color++)
+			{
+				setBoundary(_level);
+				ThreadPool::get().parallelFor(1, level.ny + 1, [&](size_t _y)
+				{
+					size_t row = _y * stride;
+					uint32_t x0 = ((1 + _y) & 1) == color ? 1 : 2;
+					for (uint32_t x = x0; x <= nx; x += 2)
+					{
+						size_t i = row + x;
+						u[i] = ((u[i - 1] + u[i + 1]) + (u[i - stride] + u[i + stride]) - h2 * f[i]) * 0.25f;
+					}
+				}, row_grain(level));
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	float MultigridCPU::residual(uint32_t _level)
+	{
+		MultigridLevel& level = m_levels[_level];
+		const float* u = level.u;
+		const float* f = level.f.data();
+		float* r = level.r.data();
+		uint32_t stride = level.stride;
+		uint32_t nx = level.nx;
+		float rh2 = 1.0f / (level.h * level.h);
+
+		setBoundary(_level);
+		ThreadPool::get().parallelFor(1, level.ny + 1, [&](size_t _y)
+		{
+			size_t row = _y * stride;
+			for (uint32_t x = 1; x <= nx; x++)
+			{
+				size_t i = row + x;
+				r[i] = f[i] - ((u[i - 1] + u[i + 1]) + (u[i - stride] + u[i + stride]) - 4.0f * u[i]) * rh2;
+			}
+		}, row_grain(level));
+
+		// summed in row order, independent of the threads
+		double sumSq = 0.0;
+		for (uint32_t y = 1; y <= level.ny; y++)
+		{
+			const float* rr = r + (size_t)y * stride;
+			for (uint32_t x = 1; x <= nx; x++)
+				sumSq += (double)rr[x] * rr[x];
+		}
+		return (float)std::sqrt(sumSq / ((double)nx * level.ny));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::restrictResidual(uint32_t _level)
+	{
+		const MultigridLevel& fine = m_levels[_level];
+		MultigridLevel& coarse = m_levels[_level + 1];
+		const float* r = fine.r.data();
+		float* f = coarse.f.data();
+
+		ThreadPool::get().parallelFor(1, coarse.ny + 1, [&](size_t _y)
+		{
+			// children 2y - 1 and 2y; with odd fine sizes the last ones fall in the boundary
+			// ring, where r is 0 : the coarse cell sums the residual of the fine cells it
+			// covers, which keeps the coarse rhs compatible
+			uint32_t fy0 = 2 * (uint32_t)_y - 1;
+			uint32_t fy1 = fy0 + 1;
+			for (uint32_t x = 1; x <= coarse.nx; x++)
+			{
+				uint32_t fx0 = 2 * x - 1;
+				uint32_t fx1 = fx0 + 1;
+				float sum = r[fy0 * fine.stride + fx0] + r[fy0 * fine.stride + fx1] +
+							r[fy1 * fine.stride + fx0] + r[fy1 * fine.stride + fx1];
+				f[_y * coarse.stride + x] = 0.25f * sum;
+			}
+		}, row_grain(coarse));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::prolongate(uint32_t _level)
+	{
+		MultigridLevel& fine = m_levels[_level];
+		const MultigridLevel& coarse = m_levels[_level + 1];
+		float* u = fine.u;
+		const float* e = coarse.u;
+
+		setBoundary(_level + 1);
+		ThreadPool::get().parallelFor(1, fine.ny + 1, [&](size_t _y)
+		{
+			// fine cell i (from 0) is at coarse coordinate i / 2 - 1/4 : weights 3/4 on the
+			// parent, 1/4 on the coarse neighbour towards the fine cell
+			uint32_t i = (uint32_t)_y - 1;
+			uint32_t cy = i / 2 + 1;
+			uint32_t ny = (i & 1) ? cy + 1 : cy - 1;
+			const float* e0 = e + (size_t)cy * coarse.stride;
+			const float* e1 = e + (size_t)ny * coarse.stride;
+			float* row = u + _y * fine.stride;
+			for (uint32_t x = 1; x <= fine.nx; x++)
+			{
+				uint32_t j = x - 1;
+				uint32_t cx = j / 2 + 1;
+				uint32_t nx = (j & 1) ? cx + 1 : cx - 1;
+				row[x] += 0.5625f * e0[cx] + 0.1875f * (e0[nx] + e1[cx]) + 0.0625f * e1[nx];
+			}
+		}, row_grain(fine));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridCPU::setBoundary(uint32_t _level)
+	{
+		MultigridLevel& level = m_levels[_level];
+		float* u = level.u;
+		uint32_t stride = level.stride;
+		uint32_t nx = level.nx;
+		uint32_t ny = level.ny;
+
+		for (uint32_t y = 1; y <= ny; y++)
+		{
+			float* row = u + (size_t)y * stride;
+			row[0] = row[1];
+			row[nx + 1] = row[nx];
+		}
+		memcpy(u, u + stride, sizeof(float) * stride);
+		memcpy(u + (size_t)(ny + 1) * stride, u + (size_t)ny * stride, sizeof(float) * stride);
+	}
+
+
+}
+
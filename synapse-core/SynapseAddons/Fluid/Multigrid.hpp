@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include <stdint.h>
+
+
+namespace Syn {
+
+	struct CPUSurface;
+
+
+	/* Geometric multigrid V-cycle parameters, shared by the CPU and GPU pressure solvers. */
+	struct MultigridParameters
+	{
+		uint32_t maxCycles = 4;				// V-cycles per solve (the GPU always runs all of them)
+		float tolerance = 1e-3f;			// target of RMS(residual) / RMS(rhs), CPU only
+		uint32_t preSmooth = 2;				// red-black Gauss-Seidel sweeps before restriction
+		uint32_t postSmooth = 2;			// and after prolongation
+		uint32_t coarseSmooth = 16;			// sweeps on the coarsest level
+		uint32_t coarsestSize = 4;			// coarsening stops below this many interior cells
+	};
+
+	// Statistics of the last solve.
+	struct MultigridStats
+	{
+		uint32_t levels = 0;
+		uint32_t cycles = 0;
+		float initialResidual = 0.0f;		// RMS, before the first cycle
+		float residual = 0.0f;				// RMS, after the last cycle
+		float relativeResidual = 0.0f;		// residual / RMS(rhs)
+		float solveMs = 0.0f;
+	};
+
+	// One grid of the CPU hierarchy : nx x ny interior cells inside a one cell ring.
+	struct MultigridLevel
+	{
+		uint32_t nx = 0;
+		uint32_t ny = 0;
+		uint32_t stride = 0;				// nx + 2
+		float h = 1.0f;						// cell size
+		float* u = nullptr;					// solution (the pressure surface on level 0)
+		std::vector<float> uData;
+		std::vector<float> f;				// right hand side
+		std::vector<float> r;				// residual
+	};
+
+
+	/* Multigrid solver for the pressure Poisson equation lap(p) = div, on a CPUSurface laid
+	 * out as in FluidSolverCPU : the outermost cells are a boundary ring, set to the
+	 * neighbouring interior value (zero normal gradient) after the solve.
+	 *
+	 * Levels halve the interior (rounding up) down to MultigridParameters::coarsestSize.
+	 * Restriction averages the 2x2 children, prolongation is bilinear between cell centers
+	 * and smoothing is red-black Gauss-Seidel. Rows of a color are independent, so every pass
+	 * is split over the ThreadPool and the result doesn't depend on the number of threads.
+	 * Since the problem is pure Neumann, the mean of the rhs is removed first.
+	 *
+	 * Interior sizes that halve evenly down to the coarsest level (e.g. 2^n + 2 wide surfaces)
+	 * reduce the residual about 10x per cycle; odd levels lose some of that.
+	 */
+	class MultigridCPU
+	{
+	public:
+		MultigridCPU(const MultigridParameters& _params=MultigridParameters()) : m_params(_params) {}
+		~MultigridCPU() = default;
+
+		/* Solves for _pressure (channel 0), with its current values as the initial guess. */
+		void solve(CPUSurface& _pressure, const CPUSurface& _divergence, float _cell_size);
+
+		// Accessors
+		inline void setParameters(const MultigridParameters& _params) { m_params = _params; m_levels.clear(); }
+		inline const MultigridParameters& getParameters() const { return m_params; }
+		inline const MultigridStats& getStats() const { return m_stats; }
+
+
+	private:
+		void setupLevels(uint32_t _nx, uint32_t _ny, float _cell_size);
+		void vcycle(uint32_t _level);
+		void smooth(uint32_t _level, uint32_t _sweeps);
+		// residual of _level into its r, returns the RMS
+		float residual(uint32_t _level);
+		// residual of _level to the rhs of _level + 1
+		void restrictResidual(uint32_t _level);
+		// adds the bilinear interpolation of the correction on _level + 1 to _level
+		void prolongate(uint32_t _level);
+		void setBoundary(uint32_t _level);
+
+
+	private:
+		MultigridParameters m_params;
+		std::vector<MultigridLevel> m_levels;
+		MultigridStats m_stats;
+
+	};
+
+
+}
+
@@ -0,0 +1,390 @@
+
+#include "../../pch.hpp"
+
+#include <cmath>
+
+#include "MultigridGPU.hpp"
+#include "../../SynapseCore/Renderer/Renderer.hpp"
+#include "../../SynapseCore/Renderer/Shader/ShaderLibrary.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+
+
+namespace Syn {
+
+
+	// shader passes
+	static const int s_pass_smooth = 0;
+	static const int s_pass_residual = 1;
+	static const int s_pass_restrict = 2;
+	static const int s_pass_prolongate = 3;
+	static const int s_pass_mean = 4;
+	static const int s_pass_remove_mean = 5;
+
+
+	//-----------------------------------------------------------------------------------
+	MultigridGPU::MultigridGPU(Grid2D* _grid, const MultigridParameters& _params) :
+		m_grid(_grid), m_params(_params)
+	{
+		m_quadVAO = m_grid->createQuad();
+		m_shader = getShader();
+
+		SYN_RENDER_S0({
+			glGenQueries(1, &self->m_timerQuery);
+		});
+
+		// resolves the uniforms before use
+		Renderer::executeRenderCommands();
+	}
+
+	//-----------------------------------------------------------------------------------
+	MultigridGPU::~MultigridGPU()
+	{
+		GLuint query = m_timerQuery;
+		SYN_RENDER_1(query, {
+			glDeleteQueries(1, &query);
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::solve(Slab* _pressure, const Ref<Framebuffer>& _divergence, float _cell_size)
+	{
+		glm::ivec2 size = _divergence->getSize();
+		if (m_levels.empty() || m_levels[0].size != size || m_levels[0].h != _cell_size)
+			setupLevels(size, _cell_size);
+
+		MultigridGPULevel& fine = m_levels[0];
+		fine.u = *_pressure;
+
+		m_stats.levels = (uint32_t)m_levels.size();
+		m_stats.cycles = m_params.maxCycles;
+
+		beginTimer();
+
+		m_shader->enable();
+		m_shader->setUniform1i("u_tex0", 0);
+		m_shader->setUniform1i("u_tex1", 1);
+		m_shader->setUniform1i("u_tex2", 2);
+
+		removeMean(_divergence);
+
+		if (m_readbackResidual)
+		{
+			residual(0);
+			readbackRMS(fine.r, &m_stats.initialResidual);
+			readbackRMS(fine.f, &m_rhsNorm);
+		}
+
+		for (uint32_t i = 0; i < m_params.maxCycles; i++)
+			vcycle(0);
+
+		if (m_readbackResidual)
+		{
+			residual(0);
+			readbackRMS(fine.r, &m_stats.residual);
+		}
+
+		m_shader->disable();
+		fine.u.frontSurface->unbind();
+
+		endTimer();
+
+		// the passes swap surfaces
+		*_pressure = fine.u;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::setupLevels(const glm::ivec2& _size, float _cell_size)
+	{
+		m_levels.clear();
+
+		glm::ivec2 size = _size;
+		float h = _cell_size;
+		int coarsest = (int)max(m_params.coarsestSize, 1u);
+		while (true)
+		{
+			MultigridGPULevel level;
+			level.size = size;
+			level.h = h;
+			std::string name = "mg_" + std::to_string(m_levels.size());
+			if (!m_levels.empty())
+				level.u = m_grid->createSlab(size.x, size.y, ColorFormat::R32F, name + "_u");
+			level.f = m_grid->createSurface(size.x, size.y, ColorFormat::R32F, name + "_f");
+			level.r = m_grid->createSurface(size.x, size.y, ColorFormat::R32F, name + "_r");
+			m_levels.push_back(level);
+
+			if (min(size.x, size.y) < 2 * coarsest)
+				break;
+			size = (size + 1) / 2;
+			h *= 2.0f;
+		}
+
+		m_mean = m_grid->createSurface(1, 1, ColorFormat::R32F, "mg_mean");
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::removeMean(const Ref<Framebuffer>& _divergence)
+	{
+		// the restriction averages the 2x2 children (zero outside odd sizes), so every
+		// level keeps a quarter of the sum of the one above; the coarse rhs surfaces are
+		// free until the first cycle
+		uint32_t coarsest = (uint32_t)m_levels.size() - 1;
+		for (uint32_t i = 0; i < coarsest; i++)
+		{
+			(i == 0 ? _divergence : m_levels[i].f)->bindTexture(0);
+			draw(m_levels[i + 1].f, s_pass_restrict);
+		}
+
+		glm::ivec2 size = m_levels[0].size;
+		m_shader->setUniform1f("u_scale", std::ldexp(1.0f, 2 * (int)coarsest) / ((float)size.x * size.y));
+		(coarsest == 0 ? _divergence : m_levels[coarsest].f)->bindTexture(0);
+		draw(m_mean, s_pass_mean);
+
+		_divergence->bindTexture(0);
+		m_mean->bindTexture(2);
+		draw(m_levels[0].f, s_pass_remove_mean);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::vcycle(uint32_t _level)
+	{
+		if (_level == m_levels.size() - 1)
+		{
+			smooth(_level, m_params.coarseSmooth);
+			return;
+		}
+
+		smooth(_level, m_params.preSmooth);
+		residual(_level);
+		restrictResidual(_level);
+
+		m_grid->clearSurface(m_levels[_level + 1].u.frontSurface, 0.0f);
+		vcycle(_level + 1);
+
+		prolongate(_level);
+		smooth(_level, m_params.postSmooth);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::smooth(uint32_t _level, uint32_t _sweeps)
+	{
+		MultigridGPULevel& level = m_levels[_level];
+
+		// the restricted rhs has the (zero) mean of the fine one up to rounding, which is
+		// removed on the coarsest level, small enough to average in the shader
+		m_shader->setUniform1i("u_remove_mean", _level == m_levels.size() - 1 ? 1 : 0);
+		m_shader->setUniform1f("u_h2", level.h * level.h);
+		level.f->bindTexture(1);
+
+		for (uint32_t s = 0; s < _sweeps; s++)
+		{
+			for (int color = 0; color < 2; color++)
+			{
+				m_shader->setUniform1i("u_color", color);
+				level.u.frontSurface->bindTexture(0);
+				draw(level.u.backSurface, s_pass_smooth);
+				m_grid->swapSurfaces(&level.u);
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::residual(uint32_t _level)
+	{
+		MultigridGPULevel& level = m_levels[_level];
+
+		m_shader->setUniform1f("u_h2", level.h * level.h);
+		level.u.frontSurface->bindTexture(0);
+		level.f->bindTexture(1);
+		draw(level.r, s_pass_residual);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::restrictResidual(uint32_t _level)
+	{
+		m_levels[_level].r->bindTexture(0);
+		draw(m_levels[_level + 1].f, s_pass_restrict);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::prolongate(uint32_t _level)
+	{
+		MultigridGPULevel& level = m_levels[_level];
+
+		level.u.frontSurface->bindTexture(0);
+		m_levels[_level + 1].u.frontSurface->bindTexture(2);
+		draw(level.u.backSurface, s_pass_prolongate);
+		m_grid->swapSurfaces(&level.u);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::beginTimer()
+	{
+		// GPU time of the previous solve, if available
+		SYN_RENDER_S0({
+			if (self->m_timerPending)
+			{
+				GLint available = 0;
+				glGetQueryObjectiv(self->m_timerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available)
+				{
+					GLuint64 ns = 0;
+					glGetQueryObjectui64v(self->m_timerQuery, GL_QUERY_RESULT, &ns);
+					self->m_stats.solveMs = (float)((double)ns * 1e-6);
+				}
+			}
+			glBeginQuery(GL_TIME_ELAPSED, self->m_timerQuery);
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::endTimer()
+	{
+		SYN_RENDER_S0({
+			glEndQuery(GL_TIME_ELAPSED);
+			self->m_timerPending = true;
+			self->m_stats.relativeResidual = self->m_rhsNorm > 0.0f ? self->m_stats.residual / self->m_rhsNorm : 0.0f;
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::draw(const Ref<Framebuffer>& _target, int _pass)
+	{
+		_target->bind();
+		m_shader->setUniform1i("u_pass", _pass);
+		Renderer::drawIndexedNoDepth(m_quadVAO);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void MultigridGPU::readbackRMS(const Ref<Framebuffer>& _surface, float* _rms)
+	{
+		Framebuffer* surface = _surface.get();
+
+		SYN_RENDER_S2(surface, _rms, {
+			glm::ivec2 size = surface->getSize();
+			self->m_readback.resize((size_t)size.x * size.y);
+
+			glBindFramebuffer(GL_FRAMEBUFFER, surface->getFramebufferID());
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, self->m_readback.data());
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+			double sumSq = 0.0;
+			for (float v : self->m_readback)
+				sumSq += (double)v * v;
+			*_rms = (float)std::sqrt(sumSq / (double)self->m_readback.size());
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<Shader> MultigridGPU::getShader()
+	{
+		static const std::string name = "fluid_multigrid_shader";
+		Ref<Shader> shader = ShaderLibrary::getShader(name);
+		if (shader != nullptr)
+			return shader;
+
+		std::string src = R"(
+			#type VERTEX_SHADER
+			#version 330 core
+
+			layout(location = 0) in vec4 a_position;
+
+			void main() {
+				gl_Position = a_position;
+			}
+
+			#type FRAGMENT_SHADER
+			#version 330 core
+
+			layout(location = 0) out vec4 out_value;
+
+			// u (the fine residual when restricting, the divergence when removing its mean), the
+			// rhs and the coarse correction; comments stay off the uniform lines, which
+			// Shader::parseUniforms() reads up to the end of the line
+			uniform sampler2D u_tex0;
+			uniform sampler2D u_tex1;
+			uniform sampler2D u_tex2;
+			uniform int u_pass;
+			uniform int u_color;
+			uniform int u_remove_mean;
+			uniform float u_h2;
+			uniform float u_scale;
+
+			// zero normal gradient at the border
+			float fetch(sampler2D _tex, ivec2 _p) {
+				return texelFetch(_tex, clamp(_p, ivec2(0), textureSize(_tex, 0) - 1), 0).r;
+			}
+			// zero outside, for the children of the last coarse cells of odd sizes
+			float fetchZero(sampler2D _tex, ivec2 _p) {
+				if (any(greaterThanEqual(_p, textureSize(_tex, 0))))
+					return 0.0f;
+				return texelFetch(_tex, _p, 0).r;
+			}
+			float neighbours(ivec2 _p) {
+				return (fetch(u_tex0, _p + ivec2(-1, 0)) + fetch(u_tex0, _p + ivec2(1, 0))) +
+					   (fetch(u_tex0, _p + ivec2(0, -1)) + fetch(u_tex0, _p + ivec2(0, 1)));
+			}
+			float sum(sampler2D _tex) {
+				ivec2 size = textureSize(_tex, 0);
+				float s = 0.0f;
+				for (int y = 0; y < size.y; y++)
+					for (int x = 0; x < size.x; x++)
+						s += texelFetch(_tex, ivec2(x, y), 0).r;
+				return s;
+			}
+			float rhsMean() {
+				ivec2 size = textureSize(u_tex1, 0);
+				return sum(u_tex1) / float(size.x * size.y);
+			}
+
+			void main() {
+				ivec2 p = ivec2(gl_FragCoord.xy);
+				float u = texelFetch(u_tex0, p, 0).r;
+				float v = u;
+
+				if (u_pass == 0) {
+					// red-black Gauss-Seidel, one color per pass
+					if (((p.x + p.y) & 1) == u_color) {
+						float f = texelFetch(u_tex1, p, 0).r;
+						if (u_remove_mean != 0)
+							f -= rhsMean();
+						v = (neighbours(p) - u_h2 * f) * 0.25f;
+					}
+				}
+				else if (u_pass == 1) {
+					// residual
+					v = texelFetch(u_tex1, p, 0).r - (neighbours(p) - 4.0f * u) / u_h2;
+				}
+				else if (u_pass == 2) {
+					// restriction, average of the 2x2 children
+					ivec2 c = 2 * p;
+					v = 0.25f * (fetchZero(u_tex0, c) + fetchZero(u_tex0, c + ivec2(1, 0)) +
+								 fetchZero(u_tex0, c + ivec2(0, 1)) + fetchZero(u_tex0, c + ivec2(1, 1)));
+				}
+				else if (u_pass == 4) {
+					// mean of the divergence, from the sum of its restriction
+					v = sum(u_tex0) * u_scale;
+				}
+				else if (u_pass == 5) {
+					// divergence without its mean
+					v = u - texelFetch(u_tex2, ivec2(0), 0).r;
+				}
+				else {
+					// bilinear prolongation of the correction, added to u
+					ivec2 c = p / 2;
+					ivec2 n = c + ivec2((p.x & 1) != 0 ? 1 : -1, (p.y & 1) != 0 ? 1 : -1);
+					v = u + 0.5625f * fetch(u_tex2, c) +
+							0.1875f * (fetch(u_tex2, ivec2(n.x, c.y)) + fetch(u_tex2, ivec2(c.x, n.y))) +
+							0.0625f * fetch(u_tex2, n);
+				}
+
+				out_value = vec4(v, 0.0f, 0.0f, 1.0f);
+			}
+		)";
+
+		return ShaderLibrary::loadFromSrc(name, src);
+	}
+
+
+}
+
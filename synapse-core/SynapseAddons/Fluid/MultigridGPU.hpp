@@ -0,0 +1,92 @@
+#pragma once
+
+#include <vector>
+
+#include "Grid2D.hpp"
+#include "Multigrid.hpp"
+
+
+namespace Syn {
+
+	// One grid of the GPU hierarchy; level 0 uses the caller's pressure.
+	typedef struct mg_gpu_level_
+	{
+		glm::ivec2 size = glm::ivec2(0);
+		float h = 1.0f;
+		Slab u;
+		Ref<Framebuffer> f = nullptr;
+		Ref<Framebuffer> r = nullptr;
+	} MultigridGPULevel;
+
+
+	/* Multigrid V-cycle pressure solver for the Slab (framebuffer) path of Grid2D fluids,
+	 * solving lap(p) = div with the same scheme as MultigridCPU : 2x2 average restriction,
+	 * bilinear prolongation and red-black Gauss-Seidel, one fragment pass per color. The
+	 * whole surface is the domain; the boundary is zero normal gradient (clamped fetches).
+	 * As on the CPU, the mean of the divergence is removed first : the restriction passes
+	 * reduce it to the coarsest level, which is summed into a 1x1 surface.
+	 *
+	 * Every solve runs MultigridParameters::maxCycles cycles, since checking the tolerance
+	 * would stall on a readback. GPU time is measured with a timer query and reported one
+	 * solve late; residuals are only read back when enabled (setReadbackResidual()).
+	 */
+	class MultigridGPU
+	{
+	public:
+		/* Surfaces are created through _grid (see Grid2D::createSlab()). */
+		MultigridGPU(Grid2D* _grid, const MultigridParameters& _params=MultigridParameters());
+		~MultigridGPU();
+
+		/* Solves for the first channel of _pressure, with the front surface as the initial
+		 * guess; the result ends up in the front surface. */
+		void solve(Slab* _pressure, const Ref<Framebuffer>& _divergence, float _cell_size);
+
+		// Accessors
+		inline void setParameters(const MultigridParameters& _params) { m_params = _params; m_levels.clear(); }
+		inline const MultigridParameters& getParameters() const { return m_params; }
+		inline const MultigridStats& getStats() const { return m_stats; }
+		/* Reads back the residual (three full size float reads per solve), for debugging. */
+		inline void setReadbackResidual(bool _readback) { m_readbackResidual = _readback; }
+
+
+	private:
+		void setupLevels(const glm::ivec2& _size, float _cell_size);
+		void vcycle(uint32_t _level);
+		void smooth(uint32_t _level, uint32_t _sweeps);
+		void residual(uint32_t _level);
+		void restrictResidual(uint32_t _level);
+		void prolongate(uint32_t _level);
+		// level 0 rhs : _divergence without its mean
+		void removeMean(const Ref<Framebuffer>& _divergence);
+		// GPU timer query around the solve
+		void beginTimer();
+		void endTimer();
+		// draws the full screen quad into _target, with pass _pass of the shader
+		void draw(const Ref<Framebuffer>& _target, int _pass);
+		// RMS of the first channel of _surface into *_rms, when the render commands execute
+		void readbackRMS(const Ref<Framebuffer>& _surface, float* _rms);
+		static Ref<Shader> getShader();
+
+
+	private:
+		Grid2D* m_grid = nullptr;
+		MultigridParameters m_params;
+		std::vector<MultigridGPULevel> m_levels;
+		Ref<Framebuffer> m_mean = nullptr;		// 1x1, mean of the divergence
+		MultigridStats m_stats;
+
+		Ref<VertexArray> m_quadVAO = nullptr;
+		Ref<Shader> m_shader = nullptr;
+
+		bool m_readbackResidual = false;
+		float m_rhsNorm = 0.0f;
+		std::vector<float> m_readback;
+
+		GLuint m_timerQuery = 0;
+		bool m_timerPending = false;
+
+	};
+
+
+}
+
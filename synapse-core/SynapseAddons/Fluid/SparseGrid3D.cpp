@@ -0,0 +1,521 @@
+
+#include "../../pch.hpp"
+
+#include <cmath>
+
+#include "SparseGrid3D.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+#include "../../SynapseCore/Utils/Timer/Timer.hpp"
+
+
+namespace Syn {
+
+
+	//-----------------------------------------------------------------------------------
+	static inline uint32_t brick_cell(int _x, int _y, int _z)
+	{
+		return (uint32_t)(_x + SPARSE_BRICK_SIZE * (_y + SPARSE_BRICK_SIZE * _z));
+	}
+
+	//-----------------------------------------------------------------------------------
+	// a brick and its face neighbours (null when inactive), for the 7 point stencils
+	struct brick_stencil_t
+	{
+		const SparseBrick* brick;
+		const SparseBrick* neighbour[6];	// -x, +x, -y, +y, -z, +z
+
+		// value at local (_x, _y, _z), at most one coordinate outside [0..7]
+		inline float at(uint32_t _channel, int _x, int _y, int _z) const
+		{
+			const int n = SPARSE_BRICK_SIZE;
+			const SparseBrick* b = brick;
+			if (_x < 0)			{ b = neighbour[0]; _x += n; }
+			else if (_x >= n)	{ b = neighbour[1]; _x -= n; }
+			else if (_y < 0)	{ b = neighbour[2]; _y += n; }
+			else if (_y >= n)	{ b = neighbour[3]; _y -= n; }
+			else if (_z < 0)	{ b = neighbour[4]; _z += n; }
+			else if (_z >= n)	{ b = neighbour[5]; _z -= n; }
+			return b != nullptr ? b->channel[_channel][brick_cell(_x, _y, _z)] : 0.0f;
+		}
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	SparseBrick::SparseBrick(const glm::ivec3& _coord) :
+		coord(_coord)
+	{
+		for (uint32_t c = 0; c < SPARSE_CHANNEL_COUNT; c++)
+			channel[c] = data + c * SPARSE_BRICK_CELLS;
+		memset(data, 0, sizeof(data));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseBrick::swapAdvected()
+	{
+		std::swap(channel[SPARSE_DENSITY], channel[SPARSE_DENSITY_NEXT]);
+		std::swap(channel[SPARSE_U], channel[SPARSE_U_NEXT]);
+		std::swap(channel[SPARSE_V], channel[SPARSE_V_NEXT]);
+		std::swap(channel[SPARSE_W], channel[SPARSE_W_NEXT]);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	SparseGrid3D::SparseGrid3D(const glm::ivec3& _size, const SparseGridParameters& _params) :
+		m_params(_params)
+	{
+		m_brickCount = (glm::max(_size, glm::ivec3(1)) + SPARSE_BRICK_SIZE - 1) / SPARSE_BRICK_SIZE;
+		m_size = m_brickCount * SPARSE_BRICK_SIZE;
+		m_brickTable.assign((size_t)m_brickCount.x * m_brickCount.y * m_brickCount.z, -1);
+		m_stats.denseBytes = (size_t)m_size.x * m_size.y * m_size.z * SPARSE_CHANNEL_COUNT * sizeof(float);
+		m_stats.residentBytes = m_brickTable.size() * sizeof(int32_t);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::update(float _dt)
+	{
+		Timer timer("", false);
+
+		updateActivation();
+		m_stats.activationMs = timer.getDeltaTimeMs();
+
+		advect(_dt);
+		addBuoyancy(_dt);
+		m_stats.advectMs = timer.getDeltaTimeMs() - m_stats.activationMs;
+
+		divergence();
+		pressureSolve();
+		subtractGradient();
+
+		m_stats.stepMs = timer.getDeltaTimeMs();
+		m_stats.projectMs = m_stats.stepMs - m_stats.advectMs - m_stats.activationMs;
+		m_stats.steps++;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::addSource(const glm::vec3& _position, float _radius, float _density, const glm::vec3& _velocity)
+	{
+		float r = max(_radius, 0.5f);
+		glm::ivec3 c0 = glm::max(glm::ivec3(glm::floor(_position - r)), glm::ivec3(0));
+		glm::ivec3 c1 = glm::min(glm::ivec3(glm::floor(_position + r)) + 1, m_size - 1);
+		if (c0.x > c1.x || c0.y > c1.y || c0.z > c1.z)
+			return;
+
+		glm::ivec3 b0 = c0 / SPARSE_BRICK_SIZE;
+		glm::ivec3 b1 = c1 / SPARSE_BRICK_SIZE;
+		for (int bz = b0.z; bz <= b1.z; bz++)
+			for (int by = b0.y; by <= b1.y; by++)
+				for (int bx = b0.x; bx <= b1.x; bx++)
+					activate(glm::ivec3(bx, by, bz));
+		rebuildActiveList();
+
+		float inv_r2 = 1.0f / (r * r);
+		for (int z = c0.z; z <= c1.z; z++)
+			for (int y = c0.y; y <= c1.y; y++)
+				for (int x = c0.x; x <= c1.x; x++)
+				{
+					glm::vec3 d = glm::vec3(x, y, z) - _position;
+					float w = 1.0f - glm::dot(d, d) * inv_r2;
+					if (w <= 0.0f)
+						continue;
+
+					glm::ivec3 p(x, y, z);
+					SparseBrick* brick = getBrick(p / SPARSE_BRICK_SIZE);
+					glm::ivec3 l = p - brick->coord * SPARSE_BRICK_SIZE;
+					uint32_t i = brick_cell(l.x, l.y, l.z);
+					brick->channel[SPARSE_DENSITY][i] += w * _density;
+					brick->channel[SPARSE_U][i] += w * _velocity.x;
+					brick->channel[SPARSE_V][i] += w * _velocity.y;
+					brick->channel[SPARSE_W][i] += w * _velocity.z;
+				}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::reset()
+	{
+		m_bricks.clear();
+		m_freeSlots.clear();
+		m_active.clear();
+		std::fill(m_brickTable.begin(), m_brickTable.end(), -1);
+
+		size_t denseBytes = m_stats.denseBytes;
+		m_stats = SparseGridStats();
+		m_stats.denseBytes = denseBytes;
+		m_stats.residentBytes = m_brickTable.size() * sizeof(int32_t);
+	}
+
+	//-----------------------------------------------------------------------------------
+	float SparseGrid3D::getDensity(const glm::ivec3& _cell) const
+	{
+		return cell(SPARSE_DENSITY, _cell);
+	}
+
+	//-----------------------------------------------------------------------------------
+	glm::vec3 SparseGrid3D::getVelocity(const glm::ivec3& _cell) const
+	{
+		return glm::vec3(cell(SPARSE_U, _cell), cell(SPARSE_V, _cell), cell(SPARSE_W, _cell));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::copyDensity(float* _dst) const
+	{
+		memset(_dst, 0, sizeof(float) * m_size.x * m_size.y * m_size.z);
+
+		const int n = SPARSE_BRICK_SIZE;
+		for (const SparseBrick* brick : m_active)
+		{
+			glm::ivec3 o = brick->coord * n;
+			const float* src = brick->channel[SPARSE_DENSITY];
+			for (int z = 0; z < n; z++)
+				for (int y = 0; y < n; y++)
+				{
+					float* row = _dst + (size_t)o.x + (size_t)m_size.x * ((size_t)(o.y + y) + (size_t)m_size.y * (o.z + z));
+					memcpy(row, src + brick_cell(0, y, z), sizeof(float) * n);
+				}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	float SparseGrid3D::totalDensity() const
+	{
+		double sum = 0.0;
+		for (const SparseBrick* brick : m_active)
+			for (uint32_t i = 0; i < SPARSE_BRICK_CELLS; i++)
+				sum += brick->channel[SPARSE_DENSITY][i];
+		return (float)sum;
+	}
+
+	//-----------------------------------------------------------------------------------
+	SparseBrick* SparseGrid3D::activate(const glm::ivec3& _brick)
+	{
+		int32_t& slot = m_brickTable[tableIndex(_brick)];
+		if (slot >= 0)
+			return m_bricks[slot].get();
+
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else
+		{
+			slot = (int32_t)m_bricks.size();
+			m_bricks.emplace_back();
+		}
+		m_bricks[slot] = std::make_unique<SparseBrick>(_brick);
+		m_stats.activated++;
+		m_stats.residentBytes += sizeof(SparseBrick);
+		return m_bricks[slot].get();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::deactivate(const glm::ivec3& _brick)
+	{
+		int32_t& slot = m_brickTable[tableIndex(_brick)];
+		if (slot < 0)
+			return;
+
+		m_bricks[slot].reset();
+		m_freeSlots.push_back(slot);
+		slot = -1;
+		m_stats.deactivated++;
+		m_stats.residentBytes -= sizeof(SparseBrick);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::rebuildActiveList()
+	{
+		m_active.clear();
+		for (int32_t slot : m_brickTable)
+			if (slot >= 0)
+				m_active.push_back(m_bricks[slot].get());
+		m_stats.activeBricks = (uint32_t)m_active.size();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::getNeighbours(const SparseBrick* _brick, const SparseBrick* _neighbours[6]) const
+	{
+		_neighbours[0] = getBrick(_brick->coord - glm::ivec3(1, 0, 0));
+		_neighbours[1] = getBrick(_brick->coord + glm::ivec3(1, 0, 0));
+		_neighbours[2] = getBrick(_brick->coord - glm::ivec3(0, 1, 0));
+		_neighbours[3] = getBrick(_brick->coord + glm::ivec3(0, 1, 0));
+		_neighbours[4] = getBrick(_brick->coord - glm::ivec3(0, 0, 1));
+		_neighbours[5] = getBrick(_brick->coord + glm::ivec3(0, 0, 1));
+	}
+
+	//-----------------------------------------------------------------------------------
+	float SparseGrid3D::cell(uint32_t _channel, const glm::ivec3& _cell) const
+	{
+		if (_cell.x < 0 || _cell.y < 0 || _cell.z < 0)
+			return 0.0f;
+
+		const SparseBrick* brick = getBrick(_cell / SPARSE_BRICK_SIZE);
+		if (brick == nullptr)
+			return 0.0f;
+
+		glm::ivec3 l = _cell - brick->coord * SPARSE_BRICK_SIZE;
+		return brick->channel[_channel][brick_cell(l.x, l.y, l.z)];
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::sample(const glm::vec3& _position, float* _out) const
+	{
+		glm::vec3 p = glm::clamp(_position, glm::vec3(0.0f), glm::vec3(m_size - 1));
+		glm::ivec3 i0 = glm::ivec3(p);
+		glm::vec3 f = p - glm::vec3(i0);
+
+		// the corners, as brick and cell, shared by the channels
+		const SparseBrick* bricks[8];
+		uint32_t cells[8];
+		glm::ivec3 b0 = i0 / SPARSE_BRICK_SIZE;
+		glm::ivec3 b1 = (i0 + 1) / SPARSE_BRICK_SIZE;
+		if (b0 == b1)
+		{
+			const SparseBrick* brick = getBrick(b0);
+			if (brick == nullptr)
+			{
+				_out[0] = _out[1] = _out[2] = _out[3] = 0.0f;
+				return;
+			}
+			glm::ivec3 l = i0 - b0 * SPARSE_BRICK_SIZE;
+			for (int k = 0; k < 8; k++)
+			{
+				bricks[k] = brick;
+				cells[k] = brick_cell(l.x + (k & 1), l.y + ((k >> 1) & 1), l.z + (k >> 2));
+			}
+		}
+		else
+		{
+			for (int k = 0; k < 8; k++)
+			{
+				glm::ivec3 c = i0 + glm::ivec3(k & 1, (k >> 1) & 1, k >> 2);
+				bricks[k] = getBrick(c / SPARSE_BRICK_SIZE);
+				glm::ivec3 l = c - (c / SPARSE_BRICK_SIZE) * SPARSE_BRICK_SIZE;
+				cells[k] = brick_cell(l.x, l.y, l.z);
+			}
+		}
+
+		for (uint32_t ch = 0; ch < 4; ch++)
+		{
+			float c[8];
+			for (int k = 0; k < 8; k++)
+				c[k] = bricks[k] != nullptr ? bricks[k]->channel[SPARSE_DENSITY + ch][cells[k]] : 0.0f;
+
+			float x00 = c[0] + f.x * (c[1] - c[0]);
+			float x10 = c[2] + f.x * (c[3] - c[2]);
+			float x01 = c[4] + f.x * (c[5] - c[4]);
+			float x11 = c[6] + f.x * (c[7] - c[6]);
+			float y0 = x00 + f.y * (x10 - x00);
+			float y1 = x01 + f.y * (x11 - x01);
+			_out[ch] = y0 + f.z * (y1 - y0);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::updateActivation()
+	{
+		m_stats.activated = 0;
+		m_stats.deactivated = 0;
+
+		// occupancy of the active bricks
+		std::vector<uint8_t> occupied(m_active.size(), 0);
+		float densityThreshold = m_params.densityThreshold;
+		float speedThreshold2 = m_params.velocityThreshold * m_params.velocityThreshold;
+		ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+		{
+			const SparseBrick* brick = m_active[_i];
+			const float* density = brick->channel[SPARSE_DENSITY];
+			const float* u = brick->channel[SPARSE_U];
+			const float* v = brick->channel[SPARSE_V];
+			const float* w = brick->channel[SPARSE_W];
+			for (uint32_t i = 0; i < SPARSE_BRICK_CELLS; i++)
+				if (std::fabs(density[i]) > densityThreshold || u[i] * u[i] + v[i] * v[i] + w[i] * w[i] > speedThreshold2)
+				{
+					occupied[_i] = 1;
+					return;
+				}
+		}, 16);
+
+		// wanted : occupied bricks and their 26 neighbours
+		std::vector<uint8_t> wanted(m_brickTable.size(), 0);
+		for (size_t i = 0; i < m_active.size(); i++)
+		{
+			if (!occupied[i])
+				continue;
+			glm::ivec3 b = m_active[i]->coord;
+			for (int dz = -1; dz <= 1; dz++)
+				for (int dy = -1; dy <= 1; dy++)
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						glm::ivec3 n = b + glm::ivec3(dx, dy, dz);
+						if (inside(n))
+							wanted[tableIndex(n)] = 1;
+					}
+		}
+
+		for (int z = 0; z < m_brickCount.z; z++)
+			for (int y = 0; y < m_brickCount.y; y++)
+				for (int x = 0; x < m_brickCount.x; x++)
+				{
+					glm::ivec3 b(x, y, z);
+					size_t i = tableIndex(b);
+					if (wanted[i] && m_brickTable[i] < 0)
+						activate(b);
+					else if (!wanted[i] && m_brickTable[i] >= 0)
+						deactivate(b);
+				}
+
+		rebuildActiveList();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::advect(float _dt)
+	{
+		float scale = _dt / m_params.cellSize;
+		float velocityDissipation = m_params.velocityDissipation;
+		float densityDissipation = m_params.densityDissipation;
+		const int n = SPARSE_BRICK_SIZE;
+
+		ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+		{
+			SparseBrick* brick = m_active[_i];
+			glm::ivec3 o = brick->coord * n;
+			for (int z = 0; z < n; z++)
+				for (int y = 0; y < n; y++)
+					for (int x = 0; x < n; x++)
+					{
+						uint32_t i = brick_cell(x, y, z);
+						glm::vec3 velocity(brick->channel[SPARSE_U][i], brick->channel[SPARSE_V][i], brick->channel[SPARSE_W][i]);
+						glm::vec3 p = glm::vec3(o + glm::ivec3(x, y, z)) - scale * velocity;
+
+						float values[4];
+						sample(p, values);
+						brick->channel[SPARSE_DENSITY_NEXT][i] = densityDissipation * values[0];
+						brick->channel[SPARSE_U_NEXT][i] = velocityDissipation * values[1];
+						brick->channel[SPARSE_V_NEXT][i] = velocityDissipation * values[2];
+						brick->channel[SPARSE_W_NEXT][i] = velocityDissipation * values[3];
+					}
+		}, 4);
+
+		for (SparseBrick* brick : m_active)
+			brick->swapAdvected();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::addBuoyancy(float _dt)
+	{
+		float lift = _dt * m_params.buoyancy;
+		if (lift == 0.0f)
+			return;
+
+		ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+		{
+			SparseBrick* brick = m_active[_i];
+			const float* density = brick->channel[SPARSE_DENSITY];
+			float* v = brick->channel[SPARSE_V];
+			for (uint32_t i = 0; i < SPARSE_BRICK_CELLS; i++)
+				v[i] += lift * density[i];
+		}, 16);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::divergence()
+	{
+		float halfrdx = 0.5f / m_params.cellSize;
+		const int n = SPARSE_BRICK_SIZE;
+
+		ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+		{
+			SparseBrick* brick = m_active[_i];
+			brick_stencil_t s;
+			s.brick = brick;
+			getNeighbours(brick, s.neighbour);
+
+			float* div = brick->channel[SPARSE_DIVERGENCE];
+			for (int z = 0; z < n; z++)
+				for (int y = 0; y < n; y++)
+					for (int x = 0; x < n; x++)
+					{
+						float du = s.at(SPARSE_U, x + 1, y, z) - s.at(SPARSE_U, x - 1, y, z);
+						float dv = s.at(SPARSE_V, x, y + 1, z) - s.at(SPARSE_V, x, y - 1, z);
+						float dw = s.at(SPARSE_W, x, y, z + 1) - s.at(SPARSE_W, x, y, z - 1);
+						div[brick_cell(x, y, z)] = halfrdx * ((du + dv) + dw);
+					}
+		}, 4);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::pressureSolve()
+	{
+		float h2 = m_params.cellSize * m_params.cellSize;
+		const float rbeta = 1.0f / 6.0f;
+		const int n = SPARSE_BRICK_SIZE;
+
+		// cells of one color only have neighbours of the other, so a color is updated in
+		// place and in parallel; bricks are 8 wide, so local parity is global parity
+		for (uint32_t it = 0; it < m_params.pressureIterations; it++)
+		{
+			for (int color = 0; color < 2; color++)
+			{
+				ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+				{
+					SparseBrick* brick = m_active[_i];
+					brick_stencil_t s;
+					s.brick = brick;
+					getNeighbours(brick, s.neighbour);
+
+					float* p = brick->channel[SPARSE_PRESSURE];
+					const float* div = brick->channel[SPARSE_DIVERGENCE];
+					for (int z = 0; z < n; z++)
+						for (int y = 0; y < n; y++)
+						{
+							bool innerRow = y > 0 && y < n - 1 && z > 0 && z < n - 1;
+							for (int x = (y + z + color) & 1; x < n; x += 2)
+							{
+								uint32_t i = brick_cell(x, y, z);
+								float sum;
+								if (innerRow && x > 0 && x < n - 1)
+									sum = (p[i - 1] + p[i + 1]) + (p[i - n] + p[i + n]) + (p[i - n * n] + p[i + n * n]);
+								else
+									sum = (s.at(SPARSE_PRESSURE, x - 1, y, z) + s.at(SPARSE_PRESSURE, x + 1, y, z)) +
+										  (s.at(SPARSE_PRESSURE, x, y - 1, z) + s.at(SPARSE_PRESSURE, x, y + 1, z)) +
+										  (s.at(SPARSE_PRESSURE, x, y, z - 1) + s.at(SPARSE_PRESSURE, x, y, z + 1));
+								p[i] = (sum - h2 * div[i]) * rbeta;
+							}
+						}
+				}, 4);
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void SparseGrid3D::subtractGradient()
+	{
+		float halfrdx = 0.5f / m_params.cellSize;
+		const int n = SPARSE_BRICK_SIZE;
+
+		ThreadPool::get().parallelFor(0, m_active.size(), [&](size_t _i)
+		{
+			SparseBrick* brick = m_active[_i];
+			brick_stencil_t s;
+			s.brick = brick;
+			getNeighbours(brick, s.neighbour);
+
+			float* u = brick->channel[SPARSE_U];
+			float* v = brick->channel[SPARSE_V];
+			float* w = brick->channel[SPARSE_W];
+			for (int z = 0; z < n; z++)
+				for (int y = 0; y < n; y++)
+					for (int x = 0; x < n; x++)
+					{
+						uint32_t i = brick_cell(x, y, z);
+						u[i] -= halfrdx * (s.at(SPARSE_PRESSURE, x + 1, y, z) - s.at(SPARSE_PRESSURE, x - 1, y, z));
+						v[i] -= halfrdx * (s.at(SPARSE_PRESSURE, x, y + 1, z) - s.at(SPARSE_PRESSURE, x, y - 1, z));
+						w[i] -= halfrdx * (s.at(SPARSE_PRESSURE, x, y, z + 1) - s.at(SPARSE_PRESSURE, x, y, z - 1));
+					}
+		}, 4);
+	}
+
+
+}
+
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <glm/glm.hpp>
+
+
+namespace Syn {
+
+	// Cells per brick side; bricks are 8^3 cells.
+	#define SPARSE_BRICK_SIZE	8
+	#define SPARSE_BRICK_CELLS	(SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE * SPARSE_BRICK_SIZE)
+
+	// Channels of a brick, the *_NEXT ones are advection targets (swapped in).
+	enum SparseChannel
+	{
+		SPARSE_DENSITY = 0,
+		SPARSE_U,
+		SPARSE_V,
+		SPARSE_W,
+		SPARSE_PRESSURE,
+		SPARSE_DIVERGENCE,
+		SPARSE_DENSITY_NEXT,
+		SPARSE_U_NEXT,
+		SPARSE_V_NEXT,
+		SPARSE_W_NEXT,
+		SPARSE_CHANNEL_COUNT
+	};
+
+	/* An allocated 8^3 block of cells, all channels stored as structure of arrays; cell
+	 * (x, y, z) of the brick is at x + 8 * (y + 8 * z).
+	 */
+	struct SparseBrick
+	{
+		glm::ivec3 coord = glm::ivec3(0);	// in bricks
+		float* channel[SPARSE_CHANNEL_COUNT];
+		float data[SPARSE_CHANNEL_COUNT * SPARSE_BRICK_CELLS];
+
+		SparseBrick(const glm::ivec3& _coord);
+		void swapAdvected();
+	};
+
+
+	//
+	struct SparseGridParameters
+	{
+		float cellSize = 1.0f;
+		uint32_t pressureIterations = 20;	// red-black Gauss-Seidel sweeps, warm started
+		float velocityDissipation = 0.999f;
+		float densityDissipation = 0.995f;
+		float buoyancy = 1.0f;				// upwards (+y) acceleration per unit density
+		float densityThreshold = 1e-4f;		// bricks with all density and speeds below the
+		float velocityThreshold = 0.05f;	// thresholds (cells per second) are deactivated
+	};
+
+	// Statistics of the last step.
+	struct SparseGridStats
+	{
+		uint32_t activeBricks = 0;
+		uint32_t activated = 0;				// bricks allocated in the last step
+		uint32_t deactivated = 0;			// and released
+		size_t residentBytes = 0;			// bricks and brick table
+		size_t denseBytes = 0;				// the same channels as a dense grid, for reference
+		float activationMs = 0.0f;
+		float advectMs = 0.0f;
+		float projectMs = 0.0f;
+		float stepMs = 0.0f;
+		uint64_t steps = 0;
+	};
+
+
+	/* 3D smoke on a sparse grid of 8^3 cell bricks, the volumetric counterpart of the Grid2D
+	 * / FluidSolverCPU surfaces. Only bricks holding density or velocity, and the ones next to
+	 * them (what one step of advection can reach, for velocities below 8 cells per step), are
+	 * allocated; the set is updated at the start of every step. A dense table of brick
+	 * indices over the bounding box (one int per 512 cells) resolves lookups.
+	 *
+	 * A step advects velocity and density (semi-Lagrangian, trilinear), adds buoyancy and
+	 * projects with red-black Gauss-Seidel on the pressure. Cells outside the active bricks,
+	 * and outside the box, are empty air : zero velocity, density and pressure. All passes
+	 * run over the active bricks on the ThreadPool, so time and memory follow the occupied
+	 * volume rather than the box. Results don't depend on the number of threads.
+	 */
+	class SparseGrid3D
+	{
+	public:
+		/* _size in cells, rounded up to whole bricks. */
+		SparseGrid3D(const glm::ivec3& _size, const SparseGridParameters& _params=SparseGridParameters());
+		~SparseGrid3D() = default;
+
+		/* Advances the simulation by _dt. */
+		void update(float _dt);
+
+		/* Adds density and velocity in a sphere around _position (in cells), activating the
+		 * bricks it covers. */
+		void addSource(const glm::vec3& _position, float _radius, float _density, const glm::vec3& _velocity);
+
+		/* Clears all bricks. */
+		void reset();
+
+		// Sampling : values of single cells, zero outside the active bricks
+		float getDensity(const glm::ivec3& _cell) const;
+		glm::vec3 getVelocity(const glm::ivec3& _cell) const;
+		/* Writes the density of the whole box to _dst (size.x * size.y * size.z floats, x
+		 * fastest), e.g. for uploading to a 3D texture. */
+		void copyDensity(float* _dst) const;
+		float totalDensity() const;
+
+		// Accessors
+		inline void setParameters(const SparseGridParameters& _params) { m_params = _params; }
+		inline const SparseGridParameters& getParameters() const { return m_params; }
+		inline const SparseGridStats& getStats() const { return m_stats; }
+		inline const glm::ivec3& getSize() const { return m_size; }
+		inline const glm::ivec3& getBrickCount() const { return m_brickCount; }
+		inline const std::vector<SparseBrick*>& getActiveBricks() const { return m_active; }
+
+
+	private:
+		// brick handling
+		inline bool inside(const glm::ivec3& _brick) const
+		{
+			return _brick.x >= 0 && _brick.y >= 0 && _brick.z >= 0 &&
+				   _brick.x < m_brickCount.x && _brick.y < m_brickCount.y && _brick.z < m_brickCount.z;
+		}
+		inline size_t tableIndex(const glm::ivec3& _brick) const
+		{
+			return (size_t)_brick.x + (size_t)m_brickCount.x * ((size_t)_brick.y + (size_t)m_brickCount.y * _brick.z);
+		}
+		inline SparseBrick* getBrick(const glm::ivec3& _brick) const
+		{
+			if (!inside(_brick))
+				return nullptr;
+			int32_t i = m_brickTable[tableIndex(_brick)];
+			return i < 0 ? nullptr : m_bricks[i].get();
+		}
+		SparseBrick* activate(const glm::ivec3& _brick);
+		void deactivate(const glm::ivec3& _brick);
+		void rebuildActiveList();
+		// face neighbours (-x, +x, -y, +y, -z, +z), null when inactive
+		void getNeighbours(const SparseBrick* _brick, const SparseBrick* _neighbours[6]) const;
+		// value of a channel at a cell, 0 outside the active bricks
+		float cell(uint32_t _channel, const glm::ivec3& _cell) const;
+		// trilinear samples of density, u, v and w at a cell space position (cell centers at
+		// integers), into _out[0..3]
+		void sample(const glm::vec3& _position, float* _out) const;
+
+		// step passes
+		void updateActivation();
+		void advect(float _dt);
+		void addBuoyancy(float _dt);
+		void divergence();
+		void pressureSolve();
+		void subtractGradient();
+
+
+	private:
+		glm::ivec3 m_size = glm::ivec3(0);
+		glm::ivec3 m_brickCount = glm::ivec3(0);
+		SparseGridParameters m_params;
+
+		std::vector<int32_t> m_brickTable;					// brick index, or -1
+		std::vector<std::unique_ptr<SparseBrick>> m_bricks;	// slots, null when free
+		std::vector<int32_t> m_freeSlots;
+		std::vector<SparseBrick*> m_active;					// in table order
+
+		SparseGridStats m_stats;
+
+	};
+
+
+}
+
@@ -0,0 +1,781 @@
+
+#include "../../pch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BarnesHut.hpp"
+#include "../../SynapseCore/Renderer/Renderer.hpp"
+#include "../../SynapseCore/Utils/CPUFeatures.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+#include "../../SynapseCore/Utils/Timer/Timer.hpp"
+
+
+
+namespace Syn {
+
+
+	// bodies per ThreadPool task for the per body passes
+	static const size_t s_chunkSize = 4096;
+	// leaves per task of the force evaluation, and bodies per task of direct summation
+	static const size_t s_leafChunkSize = 16;
+	static const size_t s_directChunkSize = 256;
+	// subtrees built in parallel, at least (fixed, so the node order doesn't depend on
+	// the number of threads)
+	static const size_t s_subtreeCount = 64;
+	// radix sort digits
+	static const uint32_t s_radixBits = 11;
+	static const uint32_t s_radixBuckets = 1u << s_radixBits;
+
+
+	//-----------------------------------------------------------------------------------
+	static inline size_t chunk_count(size_t _n, size_t _chunk)
+	{
+		return (_n + _chunk - 1) / _chunk;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// spreads the low 21 bits of _v to every third bit
+	static inline uint64_t expand_bits_21(uint64_t _v)
+	{
+		_v &= 0x1fffff;
+		_v = (_v | _v << 32) & 0x1f00000000ffffull;
+		_v = (_v | _v << 16) & 0x1f0000ff0000ffull;
+		_v = (_v | _v << 8)  & 0x100f00f00f00f00full;
+		_v = (_v | _v << 4)  & 0x10c30c30c30c30c3ull;
+		_v = (_v | _v << 2)  & 0x1249249249249249ull;
+		return _v;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// field of a source _s at offset _r (from the body to the source)
+	static inline glm::vec3 pair_field(const glm::vec3& _r, float _s, float _eps2)
+	{
+		float inv = 1.0f / std::sqrt(glm::dot(_r, _r) + _eps2);
+		return _r * (_s * inv * inv * inv);
+	}
+
+	// Field at _p of the _count sources of an interaction list (padded to a multiple of 8
+	// with zero sources), into _field.
+	typedef void (*list_kernel_t)(const float*, const float*, const float*, const float*, uint32_t, const glm::vec3&, float, glm::vec3&);
+
+	//-----------------------------------------------------------------------------------
+	// the sum of the lanes, in the same order on both paths
+	static inline float sum_lanes(const float* _l)
+	{
+		return ((_l[0] + _l[1]) + (_l[2] + _l[3])) + ((_l[4] + _l[5]) + (_l[6] + _l[7]));
+	}
+
+	//-----------------------------------------------------------------------------------
+	// The terms go to 8 lanes, as in the AVX2 path, so both give identical results. Terms
+	// at zero distance (the body itself, without softening) are dropped.
+	static void list_field_scalar(const float* _x, const float* _y, const float* _z, const float* _s, uint32_t _count, const glm::vec3& _p, float _eps2, glm::vec3& _field)
+	{
+		float fx[8] = { 0.0f }, fy[8] = { 0.0f }, fz[8] = { 0.0f };
+		for (uint32_t j = 0; j < _count; j++)
+		{
+			float dx = _x[j] - _p.x;
+			float dy = _y[j] - _p.y;
+			float dz = _z[j] - _p.z;
+			float r2 = ((dx * dx + dy * dy) + dz * dz) + _eps2;
+			float inv = r2 > 0.0f ? 1.0f / std::sqrt(r2) : 0.0f;
+			float f = ((_s[j] * inv) * inv) * inv;
+			fx[j & 7] += dx * f;
+			fy[j & 7] += dy * f;
+			fz[j & 7] += dz * f;
+		}
+		_field = glm::vec3(sum_lanes(fx), sum_lanes(fy), sum_lanes(fz));
+	}
+
+
+#ifdef SYN_SIMD_X86
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static void list_field_avx2(const float* _x, const float* _y, const float* _z, const float* _s, uint32_t _count, const glm::vec3& _p, float _eps2, glm::vec3& _field)
+	{
+		const __m256 px = _mm256_set1_ps(_p.x);
+		const __m256 py = _mm256_set1_ps(_p.y);
+		const __m256 pz = _mm256_set1_ps(_p.z);
+		const __m256 eps2 = _mm256_set1_ps(_eps2);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 zero = _mm256_setzero_ps();
+
+		__m256 fx = zero, fy = zero, fz = zero;
+		for (uint32_t j = 0; j < _count; j += 8)
+		{
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(_x + j), px);
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(_y + j), py);
+			__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(_z + j), pz);
+			__m256 r2 = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)), eps2);
+			__m256 inv = _mm256_and_ps(_mm256_div_ps(one, _mm256_sqrt_ps(r2)), _mm256_cmp_ps(r2, zero, _CMP_GT_OQ));
+			__m256 f = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(_s + j), inv), inv), inv);
+			fx = _mm256_add_ps(fx, _mm256_mul_ps(dx, f));
+			fy = _mm256_add_ps(fy, _mm256_mul_ps(dy, f));
+			fz = _mm256_add_ps(fz, _mm256_mul_ps(dz, f));
+		}
+
+		alignas(32) float lx[8], ly[8], lz[8];
+		_mm256_store_ps(lx, fx);
+		_mm256_store_ps(ly, fy);
+		_mm256_store_ps(lz, fz);
+		_field = glm::vec3(sum_lanes(lx), sum_lanes(ly), sum_lanes(lz));
+	}
+#endif
+
+
+	//-----------------------------------------------------------------------------------
+	struct nbody_kernels_t
+	{
+		list_kernel_t listField = list_field_scalar;
+		const char* name = "scalar";
+	};
+	//-----------------------------------------------------------------------------------
+	static const nbody_kernels_t& get_kernels()
+	{
+		static nbody_kernels_t s_kernels = []()
+		{
+			nbody_kernels_t kernels;
+			#if defined(SYN_SIMD_X86)
+				if (cpu_features().avx2)
+					kernels = { list_field_avx2, "AVX2" };
+			#endif
+			return kernels;
+		}();
+		return s_kernels;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// An interaction list, sources as structure of arrays.
+	struct interaction_list_t
+	{
+		std::vector<float> x, y, z, s;
+
+		inline void clear() { x.clear(); y.clear(); z.clear(); s.clear(); }
+		inline void add(const glm::vec3& _p, float _s) { x.push_back(_p.x); y.push_back(_p.y); z.push_back(_p.z); s.push_back(_s); }
+		inline uint32_t size() const { return (uint32_t)x.size(); }
+		// zero sources up to a multiple of 8
+		inline void pad() { while (x.size() & 7) add(glm::vec3(0.0f), 0.0f); }
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	// Stable LSD radix sort of _keys, carrying _values; passes where all keys share the
+	// digit are skipped. Chunks count and scatter in parallel.
+	static void radix_sort(std::vector<uint64_t>& _keys, std::vector<uint32_t>& _values, uint32_t _key_bits)
+	{
+		size_t n = _keys.size();
+		size_t chunk = max(s_chunkSize * 4, chunk_count(n, 64));
+		size_t chunks = chunk_count(n, chunk);
+
+		std::vector<uint64_t> keys(n);
+		std::vector<uint32_t> values(n);
+		std::vector<uint32_t> histogram(chunks * s_radixBuckets);
+		std::vector<uint32_t> totals(s_radixBuckets);
+
+		ThreadPool& pool = ThreadPool::get();
+		for (uint32_t shift = 0; shift < _key_bits; shift += s_radixBits)
+		{
+			pool.parallelFor(0, chunks, [&](size_t c)
+			{
+				uint32_t* h = &histogram[c * s_radixBuckets];
+				std::fill(h, h + s_radixBuckets, 0);
+				for (size_t i = c * chunk; i < min((c + 1) * chunk, n); i++)
+					h[(_keys[i] >> shift) & (s_radixBuckets - 1)]++;
+			});
+
+			std::fill(totals.begin(), totals.end(), 0);
+			for (size_t c = 0; c < chunks; c++)
+				for (uint32_t d = 0; d < s_radixBuckets; d++)
+					totals[d] += histogram[c * s_radixBuckets + d];
+			if (std::find(totals.begin(), totals.end(), (uint32_t)n) != totals.end())
+				continue;
+
+			// offsets in (digit, chunk) order, so the scatter is stable
+			uint32_t offset = 0;
+			for (uint32_t d = 0; d < s_radixBuckets; d++)
+			{
+				for (size_t c = 0; c < chunks; c++)
+				{
+					uint32_t count = histogram[c * s_radixBuckets + d];
+					histogram[c * s_radixBuckets + d] = offset;
+					offset += count;
+				}
+			}
+
+			pool.parallelFor(0, chunks, [&](size_t c)
+			{
+				uint32_t* h = &histogram[c * s_radixBuckets];
+				for (size_t i = c * chunk; i < min((c + 1) * chunk, n); i++)
+				{
+					uint32_t dst = h[(_keys[i] >> shift) & (s_radixBuckets - 1)]++;
+					keys[dst] = _keys[i];
+					values[dst] = _values[i];
+				}
+			});
+
+			_keys.swap(keys);
+			_values.swap(values);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	template<typename T>
+	static void permute(std::vector<T>& _v, const std::vector<uint32_t>& _order, std::vector<T>& _tmp)
+	{
+		_tmp.resize(_v.size());
+		ThreadPool::get().parallelFor(0, chunk_count(_v.size(), s_chunkSize), [&](size_t c)
+		{
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, _v.size()); i++)
+				_tmp[i] = _v[_order[i]];
+		});
+		_v.swap(_tmp);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// Splits _nodes[_node], on _level, into its non-empty octants, appended to _nodes.
+	// Returns false for leaves.
+	static bool split_node(std::vector<BarnesHutNode>& _nodes, uint32_t _node, uint32_t _level, const uint64_t* _codes, uint32_t _leaf_size)
+	{
+		BarnesHutNode node = _nodes[_node];
+		if (node.end - node.begin <= _leaf_size || _level >= NBODY_MORTON_BITS)
+			return false;
+
+		// the codes are sorted, so the bodies of an octant are contiguous
+		uint32_t shift = 3 * (NBODY_MORTON_BITS - 1 - _level);
+		float h = 0.5f * node.halfSize;
+		uint32_t first = (uint32_t)_nodes.size();
+		uint32_t begin = node.begin;
+		for (uint32_t octant = 0; octant < 8 && begin < node.end; octant++)
+		{
+			const uint64_t* it = std::partition_point(_codes + begin, _codes + node.end,
+													  [&](uint64_t _c) { return ((_c >> shift) & 7) <= octant; });
+			uint32_t end = (uint32_t)(it - _codes);
+			if (end == begin)
+				continue;
+
+			BarnesHutNode child;
+			child.center = node.center + glm::vec3((octant & 1) ? h : -h, (octant & 2) ? h : -h, (octant & 4) ? h : -h);
+			child.halfSize = h;
+			child.begin = begin;
+			child.end = end;
+			_nodes.push_back(child);
+			begin = end;
+		}
+
+		_nodes[_node].firstChild = first;
+		_nodes[_node].childCount = (uint32_t)_nodes.size() - first;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------------
+	static void build_subtree(std::vector<BarnesHutNode>& _nodes, uint32_t _node, uint32_t _level, const uint64_t* _codes, uint32_t _leaf_size, uint32_t& _depth)
+	{
+		if (!split_node(_nodes, _node, _level, _codes, _leaf_size))
+		{
+			_depth = max(_depth, _level);
+			return;
+		}
+
+		uint32_t first = _nodes[_node].firstChild;
+		uint32_t count = _nodes[_node].childCount;
+		for (uint32_t k = 0; k < count; k++)
+			build_subtree(_nodes, first + k, _level + 1, _codes, _leaf_size, _depth);
+	}
+
+	//-----------------------------------------------------------------------------------
+	// monopoles of a node, from its children (which have to be done) or its bodies
+	static void set_monopoles(BarnesHutNode* _nodes,
+							  uint32_t _node,
+							  const float* _px,
+							  const float* _py,
+							  const float* _pz,
+							  const float* _source)
+	{
+		BarnesHutNode& node = _nodes[_node];
+		glm::vec3 positiveSum(0.0f), negativeSum(0.0f);
+		float positive = 0.0f, negative = 0.0f;
+
+		if (node.childCount == 0)
+		{
+			for (uint32_t i = node.begin; i < node.end; i++)
+			{
+				glm::vec3 p(_px[i], _py[i], _pz[i]);
+				float s = _source[i];
+				if (s >= 0.0f)	{ positiveSum += p * s; positive += s; }
+				else			{ negativeSum -= p * s; negative -= s; }
+			}
+		}
+		else
+		{
+			for (uint32_t k = node.firstChild; k < node.firstChild + node.childCount; k++)
+			{
+				const BarnesHutNode& child = _nodes[k];
+				positiveSum += child.positiveCenter * child.positive;
+				positive += child.positive;
+				negativeSum += child.negativeCenter * child.negative;
+				negative += child.negative;
+			}
+		}
+
+		node.positive = positive;
+		node.positiveCenter = positive > 0.0f ? positiveSum / positive : node.center;
+		node.negative = negative;
+		node.negativeCenter = negative > 0.0f ? negativeSum / negative : node.center;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	BarnesHut::BarnesHut(const NBodyParameters& _params) :
+		m_params(_params)
+	{
+		// the render resources are created by the first render(), so that simulations
+		// run without a GL context
+	}
+
+	//-----------------------------------------------------------------------------------
+	uint32_t BarnesHut::addBody(const glm::vec3& _position, const glm::vec3& _velocity, float _mass, float _charge, uint32_t _color)
+	{
+		uint32_t id = (uint32_t)m_px.size();
+		m_px.push_back(_position.x);	m_py.push_back(_position.y);	m_pz.push_back(_position.z);
+		m_vx.push_back(_velocity.x);	m_vy.push_back(_velocity.y);	m_vz.push_back(_velocity.z);
+		m_ax.push_back(0.0f);			m_ay.push_back(0.0f);			m_az.push_back(0.0f);
+		m_mass.push_back(_mass);
+		m_charge.push_back(_charge);
+		m_color.push_back(_color);
+		m_id.push_back(id);
+		m_forcesValid = false;
+		return id;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::reserve(uint32_t _count)
+	{
+		for (auto* v : { &m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz, &m_ax, &m_ay, &m_az, &m_mass, &m_charge })
+			v->reserve(_count);
+		m_color.reserve(_count);
+		m_id.reserve(_count);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::clear()
+	{
+		for (auto* v : { &m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz, &m_ax, &m_ay, &m_az, &m_mass, &m_charge })
+			v->clear();
+		m_color.clear();
+		m_id.clear();
+		m_nodes.clear();
+		m_forcesValid = false;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::step(float _dt)
+	{
+		Timer timer("", false);
+
+		if (!m_forcesValid)
+			computeForces();
+
+		// kick, drift
+		size_t n = getCount();
+		float halfDt = 0.5f * _dt;
+		ThreadPool& pool = ThreadPool::get();
+		pool.parallelFor(0, chunk_count(n, s_chunkSize), [&](size_t c)
+		{
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, n); i++)
+			{
+				m_vx[i] += m_ax[i] * halfDt;	m_vy[i] += m_ay[i] * halfDt;	m_vz[i] += m_az[i] * halfDt;
+				m_px[i] += m_vx[i] * _dt;		m_py[i] += m_vy[i] * _dt;		m_pz[i] += m_vz[i] * _dt;
+			}
+		});
+
+		computeForces();
+
+		// kick
+		pool.parallelFor(0, chunk_count(n, s_chunkSize), [&](size_t c)
+		{
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, n); i++)
+			{
+				m_vx[i] += m_ax[i] * halfDt;	m_vy[i] += m_ay[i] * halfDt;	m_vz[i] += m_az[i] * halfDt;
+			}
+		});
+
+		m_stats.steps++;
+		m_stats.stepMs = timer.getDeltaTimeMs();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::computeForces()
+	{
+		m_stats.bodies = getCount();
+		m_forcesValid = true;
+		if (getCount() == 0)
+		{
+			m_nodes.clear();
+			return;
+		}
+
+		Timer timer("", false);
+		sortBodies();
+		m_stats.sortMs = timer.getDeltaTimeMs();
+		buildTree();
+		m_stats.treeMs = timer.getDeltaTimeMs() - m_stats.sortMs;
+		evaluateForces();
+		m_stats.forceMs = timer.getDeltaTimeMs() - m_stats.sortMs - m_stats.treeMs;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::sortBodies()
+	{
+		size_t n = getCount();
+		size_t chunks = chunk_count(n, s_chunkSize);
+		ThreadPool& pool = ThreadPool::get();
+
+		// bounds
+		std::vector<glm::vec3> chunkMin(chunks), chunkMax(chunks);
+		pool.parallelFor(0, chunks, [&](size_t c)
+		{
+			glm::vec3 lo(m_px[c * s_chunkSize], m_py[c * s_chunkSize], m_pz[c * s_chunkSize]);
+			glm::vec3 hi = lo;
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, n); i++)
+			{
+				lo.x = min(lo.x, m_px[i]);	lo.y = min(lo.y, m_py[i]);	lo.z = min(lo.z, m_pz[i]);
+				hi.x = max(hi.x, m_px[i]);	hi.y = max(hi.y, m_py[i]);	hi.z = max(hi.z, m_pz[i]);
+			}
+			chunkMin[c] = lo;
+			chunkMax[c] = hi;
+		});
+		glm::vec3 lo = chunkMin[0], hi = chunkMax[0];
+		for (size_t c = 1; c < chunks; c++)
+		{
+			lo.x = min(lo.x, chunkMin[c].x);	lo.y = min(lo.y, chunkMin[c].y);	lo.z = min(lo.z, chunkMin[c].z);
+			hi.x = max(hi.x, chunkMax[c].x);	hi.y = max(hi.y, chunkMax[c].y);	hi.z = max(hi.z, chunkMax[c].z);
+		}
+
+		// a slightly larger cube, so the far faces quantize inside
+		float size = max(max(hi.x - lo.x, hi.y - lo.y), max(hi.z - lo.z, 1e-6f));
+		m_cubeSize = size * (1.0f + 1e-5f);
+		m_cubeMin = 0.5f * (lo + hi) - glm::vec3(0.5f * m_cubeSize);
+
+		// Morton codes
+		const float cells = (float)(1u << NBODY_MORTON_BITS);
+		const float scale = cells / m_cubeSize;
+		m_codes.resize(n);
+		std::vector<uint32_t> order(n);
+		pool.parallelFor(0, chunks, [&](size_t c)
+		{
+			auto quantize = [&](float _x, float _min) -> uint64_t
+			{
+				return (uint64_t)min(max((_x - _min) * scale, 0.0f), cells - 1.0f);
+			};
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, n); i++)
+			{
+				m_codes[i] = expand_bits_21(quantize(m_px[i], m_cubeMin.x)) |
+							 expand_bits_21(quantize(m_py[i], m_cubeMin.y)) << 1 |
+							 expand_bits_21(quantize(m_pz[i], m_cubeMin.z)) << 2;
+				order[i] = (uint32_t)i;
+			}
+		});
+
+		radix_sort(m_codes, order, 3 * NBODY_MORTON_BITS);
+
+		// bodies to Morton order; the accelerations are recomputed
+		std::vector<float> tmp;
+		for (auto* v : { &m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz, &m_mass, &m_charge })
+			permute(*v, order, tmp);
+		std::vector<uint32_t> tmpu;
+		permute(m_color, order, tmpu);
+		permute(m_id, order, tmpu);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::buildTree()
+	{
+		uint32_t n = getCount();
+		uint32_t leafSize = max(m_params.leafSize, 1u);
+		const uint64_t* codes = m_codes.data();
+		ThreadPool& pool = ThreadPool::get();
+
+		m_source = m_params.interaction == NBodyInteraction::Gravity ? m_mass : m_charge;
+
+		m_nodes.clear();
+		BarnesHutNode root;
+		root.center = m_cubeMin + glm::vec3(0.5f * m_cubeSize);
+		root.halfSize = 0.5f * m_cubeSize;
+		root.begin = 0;
+		root.end = n;
+		m_nodes.push_back(root);
+
+		// top levels, until there are enough subtrees to go around; leaves stay in the
+		// frontier, with the level they were found on
+		struct subtree_t { uint32_t node; uint32_t level; };
+		std::vector<subtree_t> frontier = { { 0, 0 } };
+		bool split = true;
+		while (split && frontier.size() < s_subtreeCount)
+		{
+			split = false;
+			std::vector<subtree_t> next;
+			for (const subtree_t& s : frontier)
+			{
+				if (split_node(m_nodes, s.node, s.level, codes, leafSize))
+				{
+					const BarnesHutNode& node = m_nodes[s.node];
+					for (uint32_t k = 0; k < node.childCount; k++)
+						next.push_back({ node.firstChild + k, s.level + 1 });
+					split = true;
+				}
+				else
+					next.push_back(s);
+			}
+			frontier.swap(next);
+		}
+		uint32_t topCount = (uint32_t)m_nodes.size();
+
+		// subtrees, with their monopoles (children come after their parents)
+		std::vector<std::vector<BarnesHutNode>> subtrees(frontier.size());
+		std::vector<uint32_t> depths(frontier.size());
+		pool.parallelFor(0, frontier.size(), [&](size_t k)
+		{
+			std::vector<BarnesHutNode>& local = subtrees[k];
+			local.push_back(m_nodes[frontier[k].node]);
+			depths[k] = frontier[k].level;
+			build_subtree(local, 0, frontier[k].level, codes, leafSize, depths[k]);
+			for (uint32_t i = (uint32_t)local.size(); i-- > 0; )
+				set_monopoles(local.data(), i, m_px.data(), m_py.data(), m_pz.data(), m_source.data());
+		});
+
+		// appended in frontier order, the local indices (but the root) shifted
+		std::vector<uint8_t> isSubtree(topCount, 0);
+		m_stats.depth = 0;
+		for (size_t k = 0; k < frontier.size(); k++)
+		{
+			std::vector<BarnesHutNode>& local = subtrees[k];
+			uint32_t shift = (uint32_t)m_nodes.size() - 1;
+			for (BarnesHutNode& node : local)
+				if (node.childCount > 0)
+					node.firstChild += shift;
+			m_nodes[frontier[k].node] = local[0];
+			m_nodes.insert(m_nodes.end(), local.begin() + 1, local.end());
+
+			isSubtree[frontier[k].node] = 1;
+			m_stats.depth = max(m_stats.depth, depths[k]);
+		}
+
+		// the rest of the top levels
+		for (uint32_t i = topCount; i-- > 0; )
+			if (!isSubtree[i])
+				set_monopoles(m_nodes.data(), i, m_px.data(), m_py.data(), m_pz.data(), m_source.data());
+
+		m_stats.nodes = (uint32_t)m_nodes.size();
+		m_stats.leaves = (uint32_t)std::count_if(m_nodes.begin(), m_nodes.end(), [](const BarnesHutNode& _node) { return _node.childCount == 0; });
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::evaluateForces()
+	{
+		const nbody_kernels_t& kernels = get_kernels();
+		const float theta2 = m_params.theta * m_params.theta;
+		const float eps2 = m_params.softening * m_params.softening;
+		const BarnesHutNode* nodes = m_nodes.data();
+		const float* px = m_px.data();
+		const float* py = m_py.data();
+		const float* pz = m_pz.data();
+		const float* source = m_source.data();
+
+		std::vector<uint32_t> leaves;
+		leaves.reserve(m_stats.leaves);
+		for (uint32_t i = 0; i < (uint32_t)m_nodes.size(); i++)
+			if (m_nodes[i].childCount == 0)
+				leaves.push_back(i);
+
+		// one interaction list per leaf, from the traversal with the bounding box of its
+		// bodies (which makes the opening criterion stricter than per body)
+		size_t chunks = chunk_count(leaves.size(), s_leafChunkSize);
+		std::vector<uint64_t> interactions(chunks, 0);
+		ThreadPool::get().parallelFor(0, chunks, [&](size_t c)
+		{
+			interaction_list_t list;
+			// at most 7 pending siblings per level, and the children of the last
+			uint32_t stack[8 * (NBODY_MORTON_BITS + 1)];
+			uint64_t count = 0;
+
+			for (size_t l = c * s_leafChunkSize; l < min((c + 1) * s_leafChunkSize, leaves.size()); l++)
+			{
+				const BarnesHutNode& leaf = nodes[leaves[l]];
+				glm::vec3 lo(px[leaf.begin], py[leaf.begin], pz[leaf.begin]);
+				glm::vec3 hi = lo;
+				for (uint32_t i = leaf.begin + 1; i < leaf.end; i++)
+				{
+					lo.x = min(lo.x, px[i]);	lo.y = min(lo.y, py[i]);	lo.z = min(lo.z, pz[i]);
+					hi.x = max(hi.x, px[i]);	hi.y = max(hi.y, py[i]);	hi.z = max(hi.z, pz[i]);
+				}
+
+				list.clear();
+				uint32_t top = 0;
+				stack[top++] = 0;
+				while (top > 0)
+				{
+					const BarnesHutNode& node = nodes[stack[--top]];
+					// distance from the cell center to the box
+					glm::vec3 d(max(max(lo.x - node.center.x, node.center.x - hi.x), 0.0f),
+								max(max(lo.y - node.center.y, node.center.y - hi.y), 0.0f),
+								max(max(lo.z - node.center.z, node.center.z - hi.z), 0.0f));
+					float size = 2.0f * node.halfSize;
+					// a cell overlapping the box may hold bodies of the leaf, which must not be
+					// merged into its monopoles; for theta > 2/sqrt(3) the distance test alone
+					// would accept such cells
+					float h = node.halfSize;
+					bool overlaps = lo.x <= node.center.x + h && hi.x >= node.center.x - h &&
+									lo.y <= node.center.y + h && hi.y >= node.center.y - h &&
+									lo.z <= node.center.z + h && hi.z >= node.center.z - h;
+
+					if (!overlaps && size * size < theta2 * glm::dot(d, d))
+					{
+						// far enough, the cell as a whole
+						if (node.positive > 0.0f)
+							list.add(node.positiveCenter, node.positive);
+						if (node.negative > 0.0f)
+							list.add(node.negativeCenter, -node.negative);
+					}
+					else if (node.childCount == 0)
+					{
+						// the leaf itself included, the terms of the bodies on themselves vanish
+						for (uint32_t j = node.begin; j < node.end; j++)
+							list.add(glm::vec3(px[j], py[j], pz[j]), source[j]);
+					}
+					else
+					{
+						for (uint32_t k = 0; k < node.childCount; k++)
+							stack[top++] = node.firstChild + k;
+					}
+				}
+				count += (uint64_t)list.size() * (leaf.end - leaf.begin);
+				list.pad();
+
+				for (uint32_t i = leaf.begin; i < leaf.end; i++)
+				{
+					glm::vec3 field;
+					kernels.listField(list.x.data(), list.y.data(), list.z.data(), list.s.data(), list.size(),
+									  glm::vec3(px[i], py[i], pz[i]), eps2, field);
+					glm::vec3 a = field * fieldScale(i);
+					m_ax[i] = a.x;
+					m_ay[i] = a.y;
+					m_az[i] = a.z;
+				}
+			}
+			interactions[c] = count;
+		});
+
+		uint64_t total = 0;
+		for (uint64_t count : interactions)
+			total += count;
+		m_stats.interactionsPerBody = (float)((double)total / (double)getCount());
+		m_stats.kernels = kernels.name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::computeDirect(std::vector<glm::vec3>& _accelerations) const
+	{
+		size_t n = getCount();
+		const float eps2 = m_params.softening * m_params.softening;
+		const std::vector<float>& source = m_params.interaction == NBodyInteraction::Gravity ? m_mass : m_charge;
+
+		_accelerations.resize(n);
+		ThreadPool::get().parallelFor(0, chunk_count(n, s_directChunkSize), [&](size_t c)
+		{
+			for (size_t i = c * s_directChunkSize; i < min((c + 1) * s_directChunkSize, n); i++)
+			{
+				glm::vec3 p(m_px[i], m_py[i], m_pz[i]);
+				glm::vec3 field(0.0f);
+				for (size_t j = 0; j < n; j++)
+					if (j != i)
+						field += pair_field(glm::vec3(m_px[j], m_py[j], m_pz[j]) - p, source[j], eps2);
+				_accelerations[i] = field * fieldScale((uint32_t)i);
+			}
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	float BarnesHut::accuracy(uint32_t _samples, float* _max) const
+	{
+		size_t n = getCount();
+		size_t samples = (_samples == 0 || _samples > n) ? n : _samples;
+		if (samples == 0)
+			return 0.0f;
+
+		const float eps2 = m_params.softening * m_params.softening;
+		const std::vector<float>& source = m_params.interaction == NBodyInteraction::Gravity ? m_mass : m_charge;
+
+		std::vector<float> errors(samples);
+		ThreadPool::get().parallelFor(0, samples, [&](size_t k)
+		{
+			size_t i = k * n / samples;
+			glm::vec3 p(m_px[i], m_py[i], m_pz[i]);
+			glm::vec3 field(0.0f);
+			for (size_t j = 0; j < n; j++)
+				if (j != i)
+					field += pair_field(glm::vec3(m_px[j], m_py[j], m_pz[j]) - p, source[j], eps2);
+			glm::vec3 direct = field * fieldScale((uint32_t)i);
+
+			float norm = glm::length(direct);
+			errors[k] = norm > 0.0f ? glm::length(getAcceleration((uint32_t)i) - direct) / norm : 0.0f;
+		}, 16);
+
+		double sumSq = 0.0;
+		float maxError = 0.0f;
+		for (float e : errors)
+		{
+			sumSq += (double)e * e;
+			maxError = max(maxError, e);
+		}
+		if (_max != nullptr)
+			*_max = maxError;
+		return (float)std::sqrt(sumSq / (double)samples);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void BarnesHut::render(const Ref<Camera>& _camera)
+	{
+		size_t n = getCount();
+		m_uploadCount = (uint32_t)n;
+		if (n == 0)
+			return;
+
+		if (m_vertexArray == nullptr)
+		{
+			Ref<VertexBuffer> vertexBuffer = MakeRef<VertexBuffer>(GL_STREAM_DRAW);
+			vertexBuffer->setBufferLayout({
+				{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
+				{ VERTEX_ATTRIB_LOCATION_COLOR, ShaderDataType::UByte4, "a_color", true },
+			});
+			m_vertexArray = MakeRef<VertexArray>(vertexBuffer);
+			m_shader = ParticleSystem::getDefaultShader();
+
+			// resolves the uniforms before use
+			Renderer::executeRenderCommands();
+		}
+
+		m_vertices.resize(n);
+		ThreadPool::get().parallelFor(0, chunk_count(n, s_chunkSize), [&](size_t c)
+		{
+			for (size_t i = c * s_chunkSize; i < min((c + 1) * s_chunkSize, n); i++)
+				m_vertices[i] = { glm::vec3(m_px[i], m_py[i], m_pz[i]), m_color[i] };
+		});
+
+		// orphaned, as in ParticleSystem; the staging vertices have to stay until the
+		// render commands execute
+		const Ref<VertexBuffer>& vertexBuffer = m_vertexArray->getVertexBuffer();
+		vertexBuffer->startDataBlock(sizeof(ParticleVertex) * m_uploadCount);
+		vertexBuffer->addSubData(m_vertices.data(), sizeof(ParticleVertex) * m_uploadCount, 0);
+		vertexBuffer->endDataBlock();
+
+		m_shader->enable();
+		m_shader->setMatrix4fv("u_view_projection_matrix", _camera->getViewProjectionMatrix());
+		m_shader->setUniform1f("u_point_size", m_params.pointSize);
+		Renderer::drawArrays(m_vertexArray, m_uploadCount, 0, true, GL_POINTS);
+		m_shader->disable();
+	}
+
+
+}
+
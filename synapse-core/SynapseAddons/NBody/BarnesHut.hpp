@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../../SynapseCore/Renderer/Particles/ParticleSystem.hpp"
+
+
+namespace Syn {
+
+	// Morton code bits per axis, and hence the maximum depth of the octree.
+	#define NBODY_MORTON_BITS	21
+
+
+	//
+	enum class NBodyInteraction
+	{
+		Gravity			= 0,	// a_i =  G * sum_j m_j * r_ij / |r_ij|^3
+		Electrostatic	= 1,	// a_i = -k * q_i / m_i * sum_j q_j * r_ij / |r_ij|^3
+	};
+
+	//
+	struct NBodyParameters
+	{
+		NBodyInteraction interaction = NBodyInteraction::Gravity;
+		float coupling = 1.0f;				// G or k
+		float softening = 0.01f;			// |r|^2 + softening^2 in the pair terms
+		float theta = 0.5f;					// opening angle, cells of size s at distance d
+											// are used as a whole when s < theta * d (and
+											// they don't overlap the leaf being evaluated)
+		uint32_t leafSize = 16;				// bodies per leaf (leaves at the maximum depth
+											// may hold more)
+		float pointSize = 2.0f;				// see render()
+	};
+
+	// Statistics of the last force evaluation.
+	struct NBodyStats
+	{
+		uint32_t bodies = 0;
+		uint32_t nodes = 0;
+		uint32_t leaves = 0;
+		uint32_t depth = 0;
+		float interactionsPerBody = 0.0f;	// body and cell terms
+		float sortMs = 0.0f;				// bounds, Morton codes, sort and reordering
+		float treeMs = 0.0f;				// octree and monopoles
+		float forceMs = 0.0f;
+		float stepMs = 0.0f;				// the whole last step()
+		uint64_t steps = 0;
+		const char* kernels = "scalar";
+	};
+
+	/* An octree cell. Children are contiguous in the node array and the bodies of a cell
+	 * are contiguous in Morton order, [begin, end). Sources of both signs are kept as
+	 * separate monopoles (masses are all positive), so opposite charges don't cancel into
+	 * a badly placed center.
+	 */
+	typedef struct bh_node_
+	{
+		glm::vec3 center = glm::vec3(0.0f);	// of the cube
+		float halfSize = 0.0f;
+		uint32_t begin = 0;
+		uint32_t end = 0;
+		uint32_t firstChild = 0;			// the root is never a child, 0 for leaves
+		uint32_t childCount = 0;
+		glm::vec3 positiveCenter = glm::vec3(0.0f);
+		float positive = 0.0f;				// sum of positive sources
+		glm::vec3 negativeCenter = glm::vec3(0.0f);
+		float negative = 0.0f;				// sum of |negative sources|
+	} BarnesHutNode;
+
+
+	/* Barnes-Hut N-body simulation for gravity or electrostatics, O(n log n) per step.
+	 *
+	 * Every force evaluation sorts the bodies by the Morton codes of their positions
+	 * (parallel radix sort) and keeps them in that order, so the bodies of every octree
+	 * cell are contiguous. The top levels of the octree are split serially until there
+	 * are enough subtrees, which are then built and summarized (monopoles) in parallel.
+	 * Forces are evaluated per leaf on the ThreadPool : one traversal with the bounding
+	 * box of the leaf's bodies collects an interaction list of cells and bodies, which is
+	 * then summed for every body of the leaf with AVX2 (selected at runtime) or scalar
+	 * code. Both paths, and any number of threads, give identical results.
+	 *
+	 * Steps are kick-drift-kick leapfrog. Since bodies are reordered, they are found
+	 * through their ids (the index at addBody()), see getIds().
+	 */
+	class BarnesHut
+	{
+	public:
+		BarnesHut(const NBodyParameters& _params=NBodyParameters());
+		~BarnesHut() = default;
+
+		/* Adds a body and returns its id; _charge is only used by electrostatics. */
+		uint32_t addBody(const glm::vec3& _position,
+						 const glm::vec3& _velocity,
+						 float _mass,
+						 float _charge=0.0f,
+						 uint32_t _color=0xffffffff);
+		void reserve(uint32_t _count);
+		/* Removes all bodies. */
+		void clear();
+
+		/* Advances the simulation by _dt. */
+		void step(float _dt);
+		/* Builds the tree and evaluates the accelerations of the current positions. */
+		void computeForces();
+
+		/* Accelerations by direct summation, O(n^2), in body order; for reference. */
+		void computeDirect(std::vector<glm::vec3>& _accelerations) const;
+		/* Compares the accelerations of the last computeForces() to direct summation for
+		 * _samples bodies spread over the body order (all when 0), each O(n). Returns the
+		 * RMS of the relative errors |a - a_direct| / |a_direct|, the maximum in *_max.
+		 */
+		float accuracy(uint32_t _samples=1024, float* _max=nullptr) const;
+
+		/* Streams the body positions and colors and draws them as points, with the
+		 * ParticleSystem point shader. The first call creates the vertex array, nothing
+		 * else needs a GL context. */
+		void render(const Ref<Camera>& _camera);
+
+		// Accessors
+		inline uint32_t getCount() const { return (uint32_t)m_px.size(); }
+		inline glm::vec3 getPosition(uint32_t _i) const { return glm::vec3(m_px[_i], m_py[_i], m_pz[_i]); }
+		inline glm::vec3 getVelocity(uint32_t _i) const { return glm::vec3(m_vx[_i], m_vy[_i], m_vz[_i]); }
+		inline glm::vec3 getAcceleration(uint32_t _i) const { return glm::vec3(m_ax[_i], m_ay[_i], m_az[_i]); }
+		inline const std::vector<uint32_t>& getIds() const { return m_id; }
+		inline const std::vector<BarnesHutNode>& getNodes() const { return m_nodes; }
+		inline void setParameters(const NBodyParameters& _params) { m_params = _params; m_forcesValid = false; }
+		inline const NBodyParameters& getParameters() const { return m_params; }
+		inline const NBodyStats& getStats() const { return m_stats; }
+
+
+	private:
+		// Morton codes in the bounding cube, sorted, and the bodies reordered to match
+		void sortBodies();
+		// octree over the sorted bodies, with monopoles
+		void buildTree();
+		void evaluateForces();
+		// the factor from field to acceleration of body _i
+		inline float fieldScale(uint32_t _i) const
+		{
+			return m_params.interaction == NBodyInteraction::Gravity ?
+				m_params.coupling : -m_params.coupling * m_charge[_i] / m_mass[_i];
+		}
+
+
+	private:
+		NBodyParameters m_params;
+		NBodyStats m_stats;
+
+		// bodies, in Morton order after a force evaluation
+		std::vector<float> m_px, m_py, m_pz;
+		std::vector<float> m_vx, m_vy, m_vz;
+		std::vector<float> m_ax, m_ay, m_az;
+		std::vector<float> m_mass;
+		std::vector<float> m_charge;
+		std::vector<uint32_t> m_color;
+		std::vector<uint32_t> m_id;
+		std::vector<float> m_source;				// mass or charge, by the interaction
+		bool m_forcesValid = false;
+
+		std::vector<uint64_t> m_codes;
+		std::vector<BarnesHutNode> m_nodes;
+		glm::vec3 m_cubeMin = glm::vec3(0.0f);
+		float m_cubeSize = 0.0f;
+
+		// rendering
+		std::vector<ParticleVertex> m_vertices;		// staging
+		uint32_t m_uploadCount = 0;
+		Ref<VertexArray> m_vertexArray = nullptr;
+		Ref<Shader> m_shader = nullptr;
+
+	};
+
+
+}
+
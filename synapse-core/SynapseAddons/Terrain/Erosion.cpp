@@ -0,0 +1,391 @@
+
+#include "../../pch.hpp"
+
+#include <random>
+
+#include "Erosion.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+#include "../../SynapseCore/Utils/Timer/Timer.hpp"
+
+
+namespace Syn {
+
+
+	//-----------------------------------------------------------------------------------
+	// seed of the droplet generator of one tile in one batch
+	static uint32_t tile_seed(uint32_t _seed, uint64_t _batch, uint32_t _tile)
+	{
+		uint64_t h = ((uint64_t)_seed << 32) ^ (_batch * 0x9e3779b97f4a7c15ULL) ^ ((uint64_t)_tile * 0xc2b2ae3d27d4eb4fULL);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return (uint32_t)h;
+	}
+
+	//-----------------------------------------------------------------------------------
+	// [0..1), 24 bits from the generator, identical on all standard libraries
+	static inline float unit_float(std::mt19937& _rng)
+	{
+		return (float)(_rng() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	//-----------------------------------------------------------------------------------
+	Erosion::Erosion(uint32_t _nx, uint32_t _nz, const float* _heights) :
+		m_nx(_nx), m_nz(_nz)
+	{
+		m_heights.assign((size_t)m_nx * m_nz, 0.0f);
+		if (_heights != nullptr)
+			setHeights(_heights);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::setHeights(const float* _heights)
+	{
+		memcpy(m_heights.data(), _heights, sizeof(float) * m_heights.size());
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::hydraulic(uint64_t _droplet_count, uint32_t _seed)
+	{
+		m_stats.droplets = 0;
+		m_stats.hydraulicMs = 0.0f;
+		m_stats.dropletsPerSecond = 0.0f;
+		if (m_nx < 2 || m_nz < 2 || _droplet_count == 0)
+			return;
+
+		Timer timer("", false);
+		buildBrush();
+
+		// cells a droplet can touch outside its tile, and tiles twice that, so that tiles of
+		// the same checkerboard class are independent
+		uint32_t reach = m_hydraulicParams.maxLifetime + m_brushRadius + 2;
+		uint32_t tileSize = max(2 * reach, 32u);
+		uint32_t tilesX = (m_nx + tileSize - 1) / tileSize;
+		uint32_t tilesZ = (m_nz + tileSize - 1) / tileSize;
+		uint32_t tileCount = tilesX * tilesZ;
+
+		// droplets start within [0, n - 1) (the last row and column have no cell)
+		auto tileArea = [&](uint32_t _tile) -> uint64_t
+		{
+			uint32_t x0 = (_tile % tilesX) * tileSize;
+			uint32_t z0 = (_tile / tilesX) * tileSize;
+			return (uint64_t)(min(x0 + tileSize, m_nx - 1) - min(x0, m_nx - 1)) *
+				   (uint64_t)(min(z0 + tileSize, m_nz - 1) - min(z0, m_nz - 1));
+		};
+		std::vector<uint64_t> cumulativeArea(tileCount + 1, 0);
+		for (uint32_t t = 0; t < tileCount; t++)
+			cumulativeArea[t + 1] = cumulativeArea[t] + tileArea(t);
+		uint64_t totalArea = cumulativeArea[tileCount];
+
+		// tiles of the 4 classes
+		std::vector<uint32_t> classTiles[4];
+		for (uint32_t t = 0; t < tileCount; t++)
+			classTiles[((t / tilesX) % 2) * 2 + (t % tilesX) % 2].push_back(t);
+
+		// batches of a few droplets per tile, so that the field erodes evenly
+		uint64_t batchSize = (uint64_t)tileCount * 32;
+		uint64_t remaining = _droplet_count;
+		for (uint64_t batch = 0; remaining > 0; batch++)
+		{
+			uint64_t n = min(remaining, batchSize);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				const std::vector<uint32_t>& tiles = classTiles[c];
+				ThreadPool::get().parallelFor(0, tiles.size(), [&](size_t _i)
+				{
+					uint32_t tile = tiles[_i];
+					// share of the batch by area, exact in total
+					uint64_t count = n * cumulativeArea[tile + 1] / totalArea - n * cumulativeArea[tile] / totalArea;
+					if (count == 0)
+						return;
+
+					float x0 = (float)((tile % tilesX) * tileSize);
+					float z0 = (float)((tile / tilesX) * tileSize);
+					float w = (float)min((uint32_t)x0 + tileSize, m_nx - 1) - x0;
+					float h = (float)min((uint32_t)z0 + tileSize, m_nz - 1) - z0;
+
+					std::mt19937 rng(tile_seed(_seed, batch, tile));
+					for (uint64_t k = 0; k < count; k++)
+					{
+						float x = x0 + unit_float(rng) * w;
+						float z = z0 + unit_float(rng) * h;
+						runDroplet(x, z);
+					}
+				});
+			}
+			remaining -= n;
+		}
+
+		m_stats.droplets = _droplet_count;
+		m_stats.tiles = tileCount;
+		m_stats.hydraulicMs = timer.getDeltaTimeMs();
+		m_stats.dropletsPerSecond = m_stats.hydraulicMs > 0.0f ? (float)_droplet_count / (m_stats.hydraulicMs * 0.001f) : 0.0f;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::runDroplet(float _x, float _z)
+	{
+		const HydraulicErosionParameters& p = m_hydraulicParams;
+		float* heights = m_heights.data();
+		int nx = (int)m_nx;
+		int nz = (int)m_nz;
+
+		float x = _x;
+		float z = _z;
+		float dirX = 0.0f;
+		float dirZ = 0.0f;
+		float speed = p.initialSpeed;
+		float water = p.initialWater;
+		float sediment = 0.0f;
+
+		for (uint32_t lifetime = 0; lifetime < p.maxLifetime; lifetime++)
+		{
+			int nodeX = (int)x;
+			int nodeZ = (int)z;
+			int index = nodeZ * nx + nodeX;
+			// offset within the cell
+			float u = x - (float)nodeX;
+			float v = z - (float)nodeZ;
+
+			float gx, gz;
+			float height = heightAndGradient(x, z, gx, gz);
+
+			// new direction, downhill blended with the previous one
+			dirX = dirX * p.inertia - gx * (1.0f - p.inertia);
+			dirZ = dirZ * p.inertia - gz * (1.0f - p.inertia);
+			float len = sqrtf(dirX * dirX + dirZ * dirZ);
+			if (len == 0.0f)
+				break;
+			dirX /= len;
+			dirZ /= len;
+			x += dirX;
+			z += dirZ;
+
+			// stop at the border, and where the droplet has flowed over the edge
+			if (x < 0.0f || z < 0.0f || x >= (float)(nx - 1) || z >= (float)(nz - 1))
+				break;
+
+			float newHeight = heightAndGradient(x, z, gx, gz);
+			float dh = newHeight - height;
+
+			float capacity = max(-dh * speed * water * p.sedimentCapacityFactor, p.minSedimentCapacity);
+
+			if (sediment > capacity || dh > 0.0f)
+			{
+				// deposit : fill the pit going uphill, else a fraction of the surplus,
+				// bilinearly over the corners of the cell left
+				float amount = dh > 0.0f ? min(dh, sediment) : (sediment - capacity) * p.depositSpeed;
+				sediment -= amount;
+				heights[index]			+= amount * (1.0f - u) * (1.0f - v);
+				heights[index + 1]		+= amount * u * (1.0f - v);
+				heights[index + nx]		+= amount * (1.0f - u) * v;
+				heights[index + nx + 1] += amount * u * v;
+			}
+			else
+			{
+				// erode over the brush, never more than the height difference
+				float amount = min((capacity - sediment) * p.erodeSpeed, -dh);
+				for (size_t i = 0; i < m_brushOffsets.size(); i++)
+				{
+					int bx = nodeX + m_brushOffsets[i].x;
+					int bz = nodeZ + m_brushOffsets[i].y;
+					if (bx < 0 || bz < 0 || bx >= nx || bz >= nz)
+						continue;
+					float delta = amount * m_brushWeights[i];
+					heights[bz * nx + bx] -= delta;
+					sediment += delta;
+				}
+			}
+
+			speed = sqrtf(max(speed * speed - dh * p.gravity, 0.0f));
+			water *= (1.0f - p.evaporateSpeed);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	float Erosion::heightAndGradient(float _x, float _z, float& _gx, float& _gz) const
+	{
+		int cx = (int)_x;
+		int cz = (int)_z;
+		float u = _x - (float)cx;
+		float v = _z - (float)cz;
+
+		const float* h = m_heights.data() + (size_t)cz * m_nx + cx;
+		float h00 = h[0];
+		float h10 = h[1];
+		float h01 = h[m_nx];
+		float h11 = h[m_nx + 1];
+
+		_gx = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+		_gz = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+
+		return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::buildBrush()
+	{
+		uint32_t radius = max(m_hydraulicParams.erosionRadius, 1u);
+		if (radius == m_brushRadius && !m_brushOffsets.empty())
+			return;
+
+		m_brushRadius = radius;
+		m_brushOffsets.clear();
+		m_brushWeights.clear();
+
+		// weights fall off linearly with distance, normalized to 1
+		int r = (int)radius;
+		float sum = 0.0f;
+		for (int z = -r; z <= r; z++)
+		{
+			for (int x = -r; x <= r; x++)
+			{
+				float d = sqrtf((float)(x * x + z * z));
+				if (d >= (float)r)
+					continue;
+				float w = (float)r - d;
+				m_brushOffsets.push_back(glm::ivec2(x, z));
+				m_brushWeights.push_back(w);
+				sum += w;
+			}
+		}
+		for (auto& w : m_brushWeights)
+			w /= sum;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::thermal(uint32_t _iterations)
+	{
+		m_stats.thermalIterations = 0;
+		m_stats.thermalMs = 0.0f;
+		if (m_nx < 2 || m_nz < 2 || _iterations == 0)
+			return;
+
+		Timer timer("", false);
+
+		size_t n = m_heights.size();
+		m_outflow.resize(n);
+		m_excessSum.resize(n);
+		m_next.resize(n);
+
+		static const int s_dx[8] = { -1,  0,  1, -1, 1, -1, 0, 1 };
+		static const int s_dz[8] = { -1, -1, -1,  0, 0,  1, 1, 1 };
+		float talus[8];
+		for (int k = 0; k < 8; k++)
+			talus[k] = m_thermalParams.talus * ((s_dx[k] != 0 && s_dz[k] != 0) ? 1.41421356f : 1.0f);
+		float rate = min(max(m_thermalParams.rate, 0.0f), 1.0f);
+
+		int nx = (int)m_nx;
+		int nz = (int)m_nz;
+
+		for (uint32_t it = 0; it < _iterations; it++)
+		{
+			const float* h = m_heights.data();
+
+			// outflow of every cell : half the largest excess (so that a pair of cells at most
+			// levels out), times the rate, split over the lower neighbours by excess
+			ThreadPool::get().parallelFor(0, m_nz, [&](size_t _z)
+			{
+				int z = (int)_z;
+				for (int x = 0; x < nx; x++)
+				{
+					size_t i = (size_t)z * nx + x;
+					float maxExcess = 0.0f;
+					float sum = 0.0f;
+					for (int k = 0; k < 8; k++)
+					{
+						int xn = x + s_dx[k];
+						int zn = z + s_dz[k];
+						if (xn < 0 || zn < 0 || xn >= nx || zn >= nz)
+							continue;
+						float excess = h[i] - h[(size_t)zn * nx + xn] - talus[k];
+						if (excess > 0.0f)
+						{
+							sum += excess;
+							maxExcess = max(maxExcess, excess);
+						}
+					}
+					m_outflow[i] = rate * 0.5f * maxExcess;
+					m_excessSum[i] = sum;
+				}
+			}, 16);
+
+			// gather the inflow from higher neighbours; written to a separate buffer, so that
+			// rows are independent
+			ThreadPool::get().parallelFor(0, m_nz, [&](size_t _z)
+			{
+				int z = (int)_z;
+				for (int x = 0; x < nx; x++)
+				{
+					size_t i = (size_t)z * nx + x;
+					float value = h[i] - m_outflow[i];
+					for (int k = 0; k < 8; k++)
+					{
+						int xn = x + s_dx[k];
+						int zn = z + s_dz[k];
+						if (xn < 0 || zn < 0 || xn >= nx || zn >= nz)
+							continue;
+						size_t j = (size_t)zn * nx + xn;
+						// same talus from the neighbour's side (the offsets are symmetric)
+						float excess = h[j] - h[i] - talus[k];
+						if (excess > 0.0f && m_outflow[j] > 0.0f)
+							value += m_outflow[j] * excess / m_excessSum[j];
+					}
+					m_next[i] = value;
+				}
+			}, 16);
+
+			m_heights.swap(m_next);
+		}
+
+		m_stats.thermalIterations = _iterations;
+		m_stats.thermalMs = timer.getDeltaTimeMs();
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<MeshShape> Erosion::createMeshgrid(const Linspace<float>& _x, const Linspace<float>& _z, uint32_t _mesh_attrib_flags)
+	{
+		if (_x.size() != m_nx || _z.size() != m_nz)
+		{
+			SYN_CORE_WARNING("meshgrid size (", _x.size(), "x", _z.size(), ") doesn't match the height field (", m_nx, "x", m_nz, ").");
+			return nullptr;
+		}
+
+		return MeshCreator::createShapeMeshgrid(m_heights.data(), (uint32_t)m_heights.size(), _x, _z, _mesh_attrib_flags);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::updateMeshgrid(const Ref<MeshShapeGrid>& _grid)
+	{
+		if (_grid == nullptr || _grid->getNX() != m_nx || _grid->getNZ() != m_nz)
+		{
+			SYN_CORE_WARNING("meshgrid doesn't match the height field (", m_nx, "x", m_nz, ").");
+			return;
+		}
+
+		_grid->updateHeights(m_heights.data());
+	}
+
+	//-----------------------------------------------------------------------------------
+	void Erosion::updateTexture(const Ref<Texture2DNoise>& _texture)
+	{
+		if (_texture == nullptr || _texture->getWidth() != m_nx || _texture->getHeight() != m_nz)
+		{
+			SYN_CORE_WARNING("texture doesn't match the height field (", m_nx, "x", m_nz, ").");
+			return;
+		}
+
+		auto range = std::minmax_element(m_heights.begin(), m_heights.end());
+		float lo = *range.first;
+		float div = *range.second > lo ? 1.0f / (*range.second - lo) : 0.0f;
+
+		std::vector<float> normalized(m_heights.size());
+		for (size_t i = 0; i < m_heights.size(); i++)
+			normalized[i] = (m_heights[i] - lo) * div;
+
+		_texture->setFromNoiseData(normalized.data());
+	}
+
+
+}
+
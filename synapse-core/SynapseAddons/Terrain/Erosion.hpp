@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../../SynapseCore/Renderer/MeshCreator.hpp"
+#include "../../SynapseCore/Renderer/Material/Texture2DNoise.hpp"
+
+
+namespace Syn {
+
+	/* Droplet based hydraulic erosion parameters (after H. Beyer, "Implementation of a method
+	 * for hydraulic erosion"). Distances are in grid cells, heights in height field units;
+	 * the defaults suit heights in about [0..1], e.g. normalized fBm.
+	 */
+	struct HydraulicErosionParameters
+	{
+		uint32_t maxLifetime = 30;			// steps per droplet, a step is one cell
+		uint32_t erosionRadius = 3;			// radius of the erosion brush
+		float inertia = 0.05f;				// [0..1], how much of the previous direction is kept
+		float sedimentCapacityFactor = 4.0f;
+		float minSedimentCapacity = 0.01f;
+		float erodeSpeed = 0.3f;
+		float depositSpeed = 0.3f;
+		float evaporateSpeed = 0.01f;
+		float gravity = 4.0f;
+		float initialWater = 1.0f;
+		float initialSpeed = 1.0f;
+	};
+
+	/* Thermal (talus) erosion parameters : material slides to lower neighbours where the
+	 * height difference exceeds the talus (per cell; diagonals use talus * sqrt(2)).
+	 */
+	struct ThermalErosionParameters
+	{
+		float talus = 0.01f;
+		float rate = 0.5f;					// [0..1], fraction of the excess moved per iteration
+	};
+
+	// Statistics of the last hydraulic() / thermal() call.
+	struct ErosionStats
+	{
+		uint64_t droplets = 0;
+		uint32_t tiles = 0;					// droplet tiles (per phase, see hydraulic())
+		float hydraulicMs = 0.0f;
+		float dropletsPerSecond = 0.0f;
+		uint32_t thermalIterations = 0;
+		float thermalMs = 0.0f;
+	};
+
+
+	/* Hydraulic and thermal erosion of a height field, e.g. Noise heights for a terrain
+	 * meshgrid. Heights are row-major over z, as for MeshCreator::createShapeMeshgrid() :
+	 * heights[i * nx + j] is the height at (x[j], z[i]).
+	 *
+	 * Hydraulic erosion simulates droplets in tiles on the ThreadPool. Droplets move at most
+	 * one cell per step, so a droplet started in a tile only touches cells within its
+	 * lifetime (plus brush radius) of the tile. With tiles at least twice that size, tiles
+	 * in a 2x2 checkerboard class never touch the same cells and run in parallel, one class
+	 * after the other. Every tile draws its droplets from its own generator, seeded from
+	 * (seed, batch, tile), so results depend only on the seed -- not on the number of
+	 * threads or the scheduling.
+	 *
+	 * Thermal erosion is a Jacobi iteration over rows, also deterministic.
+	 */
+	class Erosion
+	{
+	public:
+		Erosion(uint32_t _nx, uint32_t _nz, const float* _heights=nullptr);
+		~Erosion() = default;
+
+		/* Runs _droplet_count droplets, in batches so that erosion spreads evenly over the
+		 * field instead of tile by tile. */
+		void hydraulic(uint64_t _droplet_count, uint32_t _seed=0);
+		/* Runs _iterations of talus erosion. */
+		void thermal(uint32_t _iterations);
+
+		// Results
+		/* Meshgrid of the heights over _x and _z (see MeshCreator::createShapeMeshgrid()). */
+		Ref<MeshShape> createMeshgrid(const Linspace<float>& _x,
+									  const Linspace<float>& _z,
+									  uint32_t _mesh_attrib_flags=MESH_ATTRIB_POSITION|MESH_ATTRIB_NORMAL);
+		/* Updates a persistent meshgrid of matching size. */
+		void updateMeshgrid(const Ref<MeshShapeGrid>& _grid);
+		/* Writes the heights, normalized to [0..1], to a noise texture of matching size. */
+		void updateTexture(const Ref<Texture2DNoise>& _texture);
+
+		// Accessors
+		void setHeights(const float* _heights);
+		inline const float* getHeights() const { return m_heights.data(); }
+		inline float* getHeights() { return m_heights.data(); }
+		inline uint32_t getNX() const { return m_nx; }
+		inline uint32_t getNZ() const { return m_nz; }
+		inline void setHydraulicParameters(const HydraulicErosionParameters& _params) { m_hydraulicParams = _params; }
+		inline void setThermalParameters(const ThermalErosionParameters& _params) { m_thermalParams = _params; }
+		inline const HydraulicErosionParameters& getHydraulicParameters() const { return m_hydraulicParams; }
+		inline const ThermalErosionParameters& getThermalParameters() const { return m_thermalParams; }
+		inline const ErosionStats& getStats() const { return m_stats; }
+
+
+	private:
+		// offsets and weights of the erosion brush, for the current radius
+		void buildBrush();
+		// height and gradient at (_x, _z), bilinear over the cell
+		float heightAndGradient(float _x, float _z, float& _gx, float& _gz) const;
+		void runDroplet(float _x, float _z);
+
+
+	private:
+		uint32_t m_nx = 0;
+		uint32_t m_nz = 0;
+		std::vector<float> m_heights;
+
+		HydraulicErosionParameters m_hydraulicParams;
+		ThermalErosionParameters m_thermalParams;
+
+		std::vector<glm::ivec2> m_brushOffsets;
+		std::vector<float> m_brushWeights;
+		uint32_t m_brushRadius = 0;
+
+		// thermal erosion work buffers
+		std::vector<float> m_outflow;
+		std::vector<float> m_excessSum;
+		std::vector<float> m_next;
+
+		ErosionStats m_stats;
+
+	};
+
+
+}
+
@@ -21,6 +21,11 @@
  * N.B.: if frequent chunk multiple updates are needed this may be a performance hit... */
 #define VX_CHUNK_STITCHING
 
+/* Morton (z-order) voxel order in flat chunk storage, instead of linear x-y-z order.
+ * Better locality for random and neighbour access in all directions, but neighbours
+ * are no longer at constant index offsets. */
+//#define VX_CHUNK_MORTON_ORDER
+
 // extract bits from the Voxel.data bitfield
 #define VX_DATA_MASK_LOW8			0x000000ff
 #define VX_DATA_MASK_TYPE			0x000000ff
@@ -60,13 +65,14 @@
 #define VX_CHUNK_MESH_DIR_NEG_Y		4
 #define VX_CHUNK_MESH_DIR_NEG_Z		5
 
-// remeshing instructions packed into a uint32_t
+// remeshing instructions packed into a uint32_t, (1 << VX_CHUNK_MESH_DIR_*)
 #define VX_CHUNK_REMESH_POS_X		0x01
 #define VX_CHUNK_REMESH_POS_Y		0x02
 #define VX_CHUNK_REMESH_POS_Z		0x04
 #define VX_CHUNK_REMESH_NEG_X		0x08
-#define VX_CHUNK_REMESH_NEG_Y		0x0f
-#define VX_CHUNK_REMESH_NEG_Z		0x10
+#define VX_CHUNK_REMESH_NEG_Y		0x10
+#define VX_CHUNK_REMESH_NEG_Z		0x20
+#define VX_CHUNK_REMESH_ALL			0x3f
 
 // xz size squared
 #define VX_CHUNK_SIZE_XZ_2			VX_CHUNK_SIZE_XZ * VX_CHUNK_SIZE_XZ
@@ -0,0 +1,178 @@
+#include "../../pch.hpp"
+
+#include <unordered_map>
+
+#include "VxChunkStorage.hpp"
+
+
+namespace Syn
+{
+    //-----------------------------------------------------------------------------------
+    void VxChunkStorage::fill(const Voxel& _voxel)
+    {
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            m_voxels[i] = _voxel;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::set(uint32_t i, const Voxel& _voxel)
+    {
+        // palettes are small, a linear search beats hashing
+        uint32_t index = 0;
+        while (index < m_palette.size() && m_palette[index] != _voxel.data)
+            index++;
+
+        if (index == m_palette.size())
+        {
+            // stale entries would eventually need indices wider than 16 bits; a chunk
+            // references at most VX_CHUNK_SIZE_ALLOC of them, so compacting makes room
+            if (m_palette.size() == ((size_t)1 << s_maxBits))
+            {
+                compact();
+                index = (uint32_t)m_palette.size();
+            }
+            m_palette.push_back(_voxel.data);
+            uint32_t bits = bits_for_palette_size(m_palette.size());
+            if (bits != m_bits)
+                setBitsPerIndex(bits);
+        }
+
+        if (m_bits)
+            setPaletteIndex(i, index);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::fill(const Voxel& _voxel)
+    {
+        m_palette.assign(1, _voxel.data);
+        m_indices.clear();
+        m_indices.shrink_to_fit();
+        m_bits = 0;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::compress(const VxChunkStorage& _chunk)
+    {
+        // palette first, then the indices at their final width
+        std::vector<uint32_t> indices(VX_CHUNK_SIZE_ALLOC);
+        std::unordered_map<uint32_t, uint32_t> lookup;
+        m_palette.clear();
+        uint32_t last = _chunk[0].data + 1;
+        uint32_t lastIndex = 0;
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+        {
+            uint32_t data = _chunk[i].data;
+            if (data != last)
+            {
+                auto it = lookup.find(data);
+                if (it == lookup.end())
+                {
+                    it = lookup.insert({ data, (uint32_t)m_palette.size() }).first;
+                    m_palette.push_back(data);
+                }
+                last = data;
+                lastIndex = it->second;
+            }
+            indices[i] = lastIndex;
+        }
+
+        m_bits = bits_for_palette_size(m_palette.size());
+        m_indices.assign((VX_CHUNK_SIZE_ALLOC * m_bits + 63) / 64, 0);
+        m_indices.shrink_to_fit();
+        if (m_bits)
+            for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+                setPaletteIndex(i, indices[i]);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::decompress(VxChunkStorage& _chunk) const
+    {
+        if (m_bits == 0)
+        {
+            _chunk.fill(Voxel(m_palette[0]));
+            return;
+        }
+
+        // whole words at a time
+        Voxel* voxels = _chunk.data();
+        uint32_t perWord = 64 / m_bits;
+        uint64_t mask = (1ull << m_bits) - 1;
+        uint32_t i = 0;
+        for (uint64_t word : m_indices)
+        {
+            for (uint32_t k = 0; k < perWord && i < VX_CHUNK_SIZE_ALLOC; k++, i++)
+            {
+                voxels[i].data = m_palette[word & mask];
+                word >>= m_bits;
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::compact()
+    {
+        if (m_bits == 0)
+            return;
+
+        // count references, remap the live entries in their current order
+        std::vector<uint32_t> count(m_palette.size(), 0);
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            count[getPaletteIndex(i)]++;
+
+        std::vector<uint32_t> remap(m_palette.size());
+        std::vector<uint32_t> palette;
+        for (uint32_t p = 0; p < m_palette.size(); p++)
+        {
+            if (count[p])
+            {
+                remap[p] = (uint32_t)palette.size();
+                palette.push_back(m_palette[p]);
+            }
+        }
+        if (palette.size() == m_palette.size())
+            return;
+
+        if (palette.size() == 1)
+        {
+            fill(Voxel(palette[0]));
+            return;
+        }
+
+        std::vector<uint32_t> indices(VX_CHUNK_SIZE_ALLOC);
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            indices[i] = remap[getPaletteIndex(i)];
+
+        m_palette = std::move(palette);
+        m_palette.shrink_to_fit();
+        m_bits = bits_for_palette_size(m_palette.size());
+        m_indices.assign((VX_CHUNK_SIZE_ALLOC * m_bits + 63) / 64, 0);
+        m_indices.shrink_to_fit();
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            setPaletteIndex(i, indices[i]);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxPaletteChunk::setBitsPerIndex(uint32_t _bits)
+    {
+        std::vector<uint32_t> indices(VX_CHUNK_SIZE_ALLOC);
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            indices[i] = getPaletteIndex(i);
+
+        m_bits = _bits;
+        m_indices.assign((VX_CHUNK_SIZE_ALLOC * m_bits + 63) / 64, 0);
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+            setPaletteIndex(i, indices[i]);
+    }
+
+    //-----------------------------------------------------------------------------------
+    uint32_t VxPaletteChunk::bits_for_palette_size(size_t _palette_size)
+    {
+        uint32_t bits = 0;
+        while (((size_t)1 << bits) < _palette_size)
+            bits = bits ? bits * 2 : 1;
+        return bits;
+    }
+
+
+}
+
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+
+#include "Types.hpp"
+
+
+namespace Syn
+{
+#ifdef VX_CHUNK_MORTON_ORDER
+    /* Morton code bits of the coordinates 0..VX_CHUNK_SIZE_XZ-1, i.e. every bit moved to
+     * every third bit. A table lookup is cheaper than the bit twiddling. */
+    struct vx_morton_table_t
+    {
+        uint32_t bits[VX_CHUNK_SIZE_XZ];
+        constexpr vx_morton_table_t() : bits()
+        {
+            for (uint32_t i = 0; i < VX_CHUNK_SIZE_XZ; i++)
+                for (uint32_t b = 0; (1u << b) <= i; b++)
+                    bits[i] |= ((i >> b) & 1) << (3 * b);
+        }
+    };
+    static constexpr vx_morton_table_t s_vx_morton_table;
+#endif
+
+    /* Flat, contiguous voxel storage of one chunk, replacing the pointer-to-pointer
+     * arrays of ALLOCATE_3D_ARRAY (one allocation per x-y column and two dependent
+     * loads per access). Voxels are in linear x-y-z order (z fastest, as m_voxels[x][y][z]
+     * of the 3D arrays), or in Morton order if VX_CHUNK_MORTON_ORDER is defined.
+     */
+    class VxChunkStorage
+    {
+    public:
+    #ifndef VX_CHUNK_MORTON_ORDER
+        // index offsets of the neighbours in linear order
+        static constexpr int32_t STRIDE_X = VX_CHUNK_SIZE_Y * VX_CHUNK_SIZE_XZ;
+        static constexpr int32_t STRIDE_Y = VX_CHUNK_SIZE_XZ;
+        static constexpr int32_t STRIDE_Z = 1;
+    #endif
+
+    public:
+        VxChunkStorage() { fill(Voxel()); }
+        ~VxChunkStorage() {}
+
+        /* Index of voxel (x, y, z) in data(). */
+        static inline uint32_t index(uint32_t x, uint32_t y, uint32_t z)
+        {
+        #ifdef VX_CHUNK_MORTON_ORDER
+            static_assert(VX_CHUNK_SIZE_XZ == VX_CHUNK_SIZE_Y && (VX_CHUNK_SIZE_XZ & (VX_CHUNK_SIZE_XZ - 1)) == 0,
+                          "Morton order requires cubic, power of 2 chunks.");
+            return (s_vx_morton_table.bits[x] << 2) | (s_vx_morton_table.bits[y] << 1) | s_vx_morton_table.bits[z];
+        #else
+            return (x * VX_CHUNK_SIZE_Y + y) * VX_CHUNK_SIZE_XZ + z;
+        #endif
+        }
+
+        inline Voxel& at(uint32_t x, uint32_t y, uint32_t z) { return m_voxels[index(x, y, z)]; }
+        inline const Voxel& at(uint32_t x, uint32_t y, uint32_t z) const { return m_voxels[index(x, y, z)]; }
+        inline Voxel& operator[](uint32_t i) { return m_voxels[i]; }
+        inline const Voxel& operator[](uint32_t i) const { return m_voxels[i]; }
+
+        /* Sets all voxels in the chunk to _voxel. */
+        void fill(const Voxel& _voxel);
+
+        // Accessors
+        inline Voxel* data() { return m_voxels; }
+        inline const Voxel* data() const { return m_voxels; }
+        static constexpr uint32_t size() { return VX_CHUNK_SIZE_ALLOC; }
+
+
+    private:
+        alignas(64) Voxel m_voxels[VX_CHUNK_SIZE_ALLOC];
+
+    };
+
+
+    /* Palette compressed voxel storage of one chunk: the distinct Voxel::data values of
+     * the chunk are kept in a palette, and every voxel is a bit-packed index into it.
+     * Index widths are powers of 2 (0, 1, 2, 4, 8 or 16 bits), so that no index straddles
+     * two words; a chunk of a single value stores no indices at all. Chunks with 2-4
+     * distinct values take 1/16 of the flat storage, 5-16 values 1/8.
+     *
+     * The palette grows on set(), but entries are only removed by compact(), or by set()
+     * when a new entry would need indices wider than 16 bits. Voxel order is that of
+     * VxChunkStorage.
+     */
+    class VxPaletteChunk
+    {
+    public:
+        VxPaletteChunk() { fill(Voxel()); }
+        VxPaletteChunk(const VxChunkStorage& _chunk) { compress(_chunk); }
+        ~VxPaletteChunk() {}
+
+        inline Voxel get(uint32_t x, uint32_t y, uint32_t z) const { return Voxel(m_palette[getPaletteIndex(VxChunkStorage::index(x, y, z))]); }
+        inline Voxel get(uint32_t i) const { return Voxel(m_palette[getPaletteIndex(i)]); }
+        void set(uint32_t x, uint32_t y, uint32_t z, const Voxel& _voxel) { set(VxChunkStorage::index(x, y, z), _voxel); }
+        void set(uint32_t i, const Voxel& _voxel);
+
+        /* Sets all voxels in the chunk to _voxel, releasing the indices. */
+        void fill(const Voxel& _voxel);
+
+        /* Conversion from and to flat storage. */
+        void compress(const VxChunkStorage& _chunk);
+        void decompress(VxChunkStorage& _chunk) const;
+
+        /* Removes palette entries no longer referenced and shrinks the index width. */
+        void compact();
+
+        // Accessors
+        inline uint32_t getPaletteSize() const { return (uint32_t)m_palette.size(); }
+        inline uint32_t getBitsPerIndex() const { return m_bits; }
+        /* Heap and object memory, in bytes. */
+        inline size_t memoryUsage() const { return sizeof(VxPaletteChunk) + m_palette.capacity() * sizeof(uint32_t) + m_indices.capacity() * sizeof(uint64_t); }
+
+
+    private:
+        inline uint32_t getPaletteIndex(uint32_t i) const
+        {
+            if (m_bits == 0)
+                return 0;
+            uint32_t bit = i * m_bits;
+            return (uint32_t)(m_indices[bit >> 6] >> (bit & 63)) & ((1u << m_bits) - 1);
+        }
+        inline void setPaletteIndex(uint32_t i, uint32_t _index)
+        {
+            uint32_t bit = i * m_bits;
+            uint64_t mask = (uint64_t)((1u << m_bits) - 1) << (bit & 63);
+            m_indices[bit >> 6] = (m_indices[bit >> 6] & ~mask) | ((uint64_t)_index << (bit & 63));
+        }
+        /* Re-packs the indices with a new width. */
+        void setBitsPerIndex(uint32_t _bits);
+        /* Smallest valid index width for _palette_size entries. */
+        static uint32_t bits_for_palette_size(size_t _palette_size);
+
+        // widest index; enough for a palette of every voxel of a chunk, plus one
+        static const uint32_t s_maxBits = 16;
+        static_assert(VX_CHUNK_SIZE_ALLOC < (1u << s_maxBits), "chunk too large for 16-bit palette indices");
+
+    private:
+        std::vector<uint32_t> m_palette;
+        std::vector<uint64_t> m_indices;
+        uint32_t m_bits = 0;
+
+    };
+
+
+}
+
@@ -0,0 +1,449 @@
+#include "../../pch.hpp"
+
+#include "VxMesher.hpp"
+#include "../../SynapseCore/Utils/Thread/ThreadPool.hpp"
+
+
+namespace Syn
+{
+    // chunk dimensions along x, y and z
+    static const uint32_t s_size[3] = { VX_CHUNK_SIZE_XZ, VX_CHUNK_SIZE_Y, VX_CHUNK_SIZE_XZ };
+    static const uint32_t s_maxSize = VX_CHUNK_SIZE_XZ > VX_CHUNK_SIZE_Y ? VX_CHUNK_SIZE_XZ : VX_CHUNK_SIZE_Y;
+    // columns are padded by one voxel on each side
+    static_assert(s_maxSize + 2 <= 64, "voxel columns have to fit in 64 bits.");
+
+    // the two axes spanning the faces along an axis, rows (u) and bits within rows (v)
+    static const uint32_t s_axisU[3] = { 1, 0, 0 };
+    static const uint32_t s_axisV[3] = { 2, 2, 1 };
+
+
+    // padded z and y columns, including the layers of the face neighbours
+    static const uint32_t s_paddedY = VX_CHUNK_SIZE_Y + 2;
+    static const uint32_t s_paddedZ = VX_CHUNK_SIZE_XZ + 2;
+
+
+    // occupancy of the chunk, per axis one padded column per (u, v)
+    struct vx_columns_t
+    {
+        uint64_t cols[3][s_maxSize * s_maxSize];
+        // z columns over x and y, and y columns over x and z, in [-1, size], for ambient
+        // occlusion
+        uint64_t padded[(VX_CHUNK_SIZE_XZ + 2) * s_paddedY];
+        uint64_t paddedY[(VX_CHUNK_SIZE_XZ + 2) * s_paddedZ];
+        // all solid voxels have the same data, no need to compare when merging
+        bool uniform;
+    };
+
+
+    //-----------------------------------------------------------------------------------
+    static inline bool is_solid(const Voxel& _voxel)
+    {
+        return VX_DATA_GET_TYPE(_voxel.data) != 0;
+    }
+
+    //-----------------------------------------------------------------------------------
+    static inline glm::uvec3 axis_coord(uint32_t _axis, uint32_t _d, uint32_t _u, uint32_t _v)
+    {
+        glm::uvec3 p;
+        p[_axis] = _d;
+        p[s_axisU[_axis]] = _u;
+        p[s_axisV[_axis]] = _v;
+        return p;
+    }
+
+    /* Corner occlusion of a face from the 3x3 voxels in front of it, indexed by the
+     * three bits (v-1, v, v+1) of the rows u-1, u and u+1, i.e. a | b << 3 | c << 6. */
+    struct vx_ao_table_t
+    {
+        uint8_t ao[512];
+        constexpr vx_ao_table_t() : ao()
+        {
+            for (uint32_t i = 0; i < 512; i++)
+            {
+                uint32_t a[3] = { i & 1, (i >> 1) & 1, (i >> 2) & 1 };
+                uint32_t b[3] = { (i >> 3) & 1, (i >> 4) & 1, (i >> 5) & 1 };
+                uint32_t c[3] = { (i >> 6) & 1, (i >> 7) & 1, (i >> 8) & 1 };
+                // corners (u, v), (u+1, v), (u+1, v+1), (u, v+1): side along u, side along
+                // v and the diagonal voxel
+                uint32_t side1[4] = { a[1], c[1], c[1], a[1] };
+                uint32_t side2[4] = { b[0], b[0], b[2], b[2] };
+                uint32_t corner[4] = { a[0], c[0], c[2], a[2] };
+                for (uint32_t k = 0; k < 4; k++)
+                {
+                    uint32_t value = (side1[k] && side2[k]) ? 0 : 3 - (side1[k] + side2[k] + corner[k]);
+                    ao[i] |= (uint8_t)(value << (2 * k));
+                }
+            }
+        }
+    };
+    static constexpr vx_ao_table_t s_aoTable;
+
+    //-----------------------------------------------------------------------------------
+    static inline uint64_t layer_row(const vx_columns_t& _columns, uint32_t _axis, int _d, int _u)
+    {
+        // occupancy over v (bit v+1) at _d along the axis and _u, both in [-1, size]
+        switch (_axis)
+        {
+            case 0:  return _columns.padded[(_d + 1) * s_paddedY + (_u + 1)];
+            case 1:  return _columns.padded[(_u + 1) * s_paddedY + (_d + 1)];
+            default: return _columns.paddedY[(_u + 1) * s_paddedZ + (_d + 1)];
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    static void build_columns(const VxChunkStorage& _chunk,
+                              const VxChunkStorage* const* _neighbours,
+                              const bool* _axes,
+                              vx_columns_t& _columns)
+    {
+        memset(_columns.cols, 0, sizeof(_columns.cols));
+
+        // data of the first solid voxel, for the uniformity test
+        uint32_t first = 0;
+        for (uint32_t i = 0; i < VX_CHUNK_SIZE_ALLOC; i++)
+        {
+            if (is_solid(_chunk[i]))
+            {
+                first = _chunk[i].data;
+                break;
+            }
+        }
+
+        // branchless, the z column is accumulated in a register
+        bool uniform = true;
+        for (uint32_t x = 0; x < VX_CHUNK_SIZE_XZ; x++)
+        {
+            for (uint32_t y = 0; y < VX_CHUNK_SIZE_Y; y++)
+            {
+                uint64_t colZ = 0;
+                for (uint32_t z = 0; z < VX_CHUNK_SIZE_XZ; z++)
+                {
+                    const Voxel& voxel = _chunk.at(x, y, z);
+                    uint64_t solid = is_solid(voxel);
+                    uniform &= !solid || voxel.data == first;
+
+                    _columns.cols[0][y * VX_CHUNK_SIZE_XZ + z] |= solid << (x + 1);
+                    _columns.cols[1][x * VX_CHUNK_SIZE_XZ + z] |= solid << (y + 1);
+                    colZ |= solid << (z + 1);
+                }
+                _columns.cols[2][x * VX_CHUNK_SIZE_Y + y] = colZ;
+            }
+        }
+        _columns.uniform = uniform;
+
+        // padded occupancy for ambient occlusion, from the face neighbours
+        memset(_columns.padded, 0, sizeof(_columns.padded));
+        memset(_columns.paddedY, 0, sizeof(_columns.paddedY));
+        for (uint32_t x = 0; x < VX_CHUNK_SIZE_XZ; x++)
+        {
+            for (uint32_t y = 0; y < VX_CHUNK_SIZE_Y; y++)
+                _columns.padded[(x + 1) * s_paddedY + (y + 1)] = _columns.cols[2][x * VX_CHUNK_SIZE_Y + y];
+            for (uint32_t z = 0; z < VX_CHUNK_SIZE_XZ; z++)
+                _columns.paddedY[(x + 1) * s_paddedZ + (z + 1)] = _columns.cols[1][x * VX_CHUNK_SIZE_XZ + z];
+        }
+
+        if (_neighbours != nullptr)
+        {
+            const uint32_t SX = VX_CHUNK_SIZE_XZ, SY = VX_CHUNK_SIZE_Y, SZ = VX_CHUNK_SIZE_XZ;
+            const VxChunkStorage* const* nb = _neighbours;
+            for (uint32_t a = 0; a < SX; a++)
+            {
+                for (uint32_t b = 0; b < SZ; b++)
+                {
+                    // y = -1 and y = SY layers (a = x, b = z)
+                    if (nb[VX_CHUNK_MESH_DIR_NEG_Y] && is_solid(nb[VX_CHUNK_MESH_DIR_NEG_Y]->at(a, SY - 1, b)))
+                    {
+                        _columns.padded[(a + 1) * s_paddedY] |= 1ull << (b + 1);
+                        _columns.paddedY[(a + 1) * s_paddedZ + (b + 1)] |= 1ull;
+                    }
+                    if (nb[VX_CHUNK_MESH_DIR_POS_Y] && is_solid(nb[VX_CHUNK_MESH_DIR_POS_Y]->at(a, 0, b)))
+                    {
+                        _columns.padded[(a + 1) * s_paddedY + SY + 1] |= 1ull << (b + 1);
+                        _columns.paddedY[(a + 1) * s_paddedZ + (b + 1)] |= 1ull << (SY + 1);
+                    }
+                }
+                for (uint32_t b = 0; b < SY; b++)
+                {
+                    // z = -1 and z = SZ ends of the columns (a = x, b = y)
+                    uint64_t& col = _columns.padded[(a + 1) * s_paddedY + (b + 1)];
+                    if (nb[VX_CHUNK_MESH_DIR_NEG_Z] && is_solid(nb[VX_CHUNK_MESH_DIR_NEG_Z]->at(a, b, SZ - 1)))
+                    {
+                        col |= 1ull;
+                        _columns.paddedY[(a + 1) * s_paddedZ] |= 1ull << (b + 1);
+                    }
+                    if (nb[VX_CHUNK_MESH_DIR_POS_Z] && is_solid(nb[VX_CHUNK_MESH_DIR_POS_Z]->at(a, b, 0)))
+                    {
+                        col |= 1ull << (SZ + 1);
+                        _columns.paddedY[(a + 1) * s_paddedZ + SZ + 1] |= 1ull << (b + 1);
+                    }
+                }
+            }
+            for (uint32_t y = 0; y < SY; y++)
+            {
+                for (uint32_t z = 0; z < SZ; z++)
+                {
+                    // x = -1 and x = SX layers
+                    if (nb[VX_CHUNK_MESH_DIR_NEG_X] && is_solid(nb[VX_CHUNK_MESH_DIR_NEG_X]->at(SX - 1, y, z)))
+                    {
+                        _columns.padded[y + 1] |= 1ull << (z + 1);
+                        _columns.paddedY[z + 1] |= 1ull << (y + 1);
+                    }
+                    if (nb[VX_CHUNK_MESH_DIR_POS_X] && is_solid(nb[VX_CHUNK_MESH_DIR_POS_X]->at(0, y, z)))
+                    {
+                        _columns.padded[(SX + 1) * s_paddedY + (y + 1)] |= 1ull << (z + 1);
+                        _columns.paddedY[(SX + 1) * s_paddedZ + (z + 1)] |= 1ull << (y + 1);
+                    }
+                }
+            }
+        }
+
+        #ifdef VX_CHUNK_STITCHING
+            if (_neighbours == nullptr)
+                return;
+
+            // border voxels of the neighbours in the padding bits
+            for (uint32_t axis = 0; axis < 3; axis++)
+            {
+                if (!_axes[axis])
+                    continue;
+
+                uint32_t u = s_axisU[axis];
+                uint32_t v = s_axisV[axis];
+                const VxChunkStorage* pos = _neighbours[axis];
+                const VxChunkStorage* neg = _neighbours[axis + 3];
+                for (uint32_t i = 0; i < s_size[u]; i++)
+                {
+                    for (uint32_t j = 0; j < s_size[v]; j++)
+                    {
+                        uint64_t& col = _columns.cols[axis][i * s_size[v] + j];
+                        if (neg)
+                        {
+                            glm::uvec3 p = axis_coord(axis, s_size[axis] - 1, i, j);
+                            if (is_solid(neg->at(p.x, p.y, p.z)))
+                                col |= 1ull;
+                        }
+                        if (pos)
+                        {
+                            glm::uvec3 p = axis_coord(axis, 0, i, j);
+                            if (is_solid(pos->at(p.x, p.y, p.z)))
+                                col |= 1ull << (s_size[axis] + 1);
+                        }
+                    }
+                }
+            }
+        #endif
+    }
+
+    //-----------------------------------------------------------------------------------
+    static void mesh_direction(const VxChunkStorage& _chunk,
+                               const vx_columns_t& _columns,
+                               uint32_t _dir,
+                               std::vector<VxQuad>& _quads)
+    {
+        uint32_t axis = _dir % 3;
+        bool positive = _dir < 3;
+        uint32_t nd = s_size[axis];
+        uint32_t nu = s_size[s_axisU[axis]];
+        uint32_t nv = s_size[s_axisV[axis]];
+        uint64_t interior = (1ull << nd) - 1;
+
+        // visible faces of every column, transposed into per slice planes of rows over v
+        uint64_t planes[s_maxSize * s_maxSize];
+        memset(planes, 0, sizeof(uint64_t) * nd * nu);
+        const uint64_t* cols = _columns.cols[axis];
+        for (uint32_t u = 0; u < nu; u++)
+        {
+            for (uint32_t v = 0; v < nv; v++)
+            {
+                uint64_t col = cols[u * nv + v];
+                uint64_t faces = positive ? col & ~(col >> 1) : col & ~(col << 1);
+                faces = (faces >> 1) & interior;
+                while (faces)
+                {
+                    uint32_t d = __builtin_ctzll(faces);
+                    faces &= faces - 1;
+                    planes[d * nu + u] |= 1ull << v;
+                }
+            }
+        }
+
+        auto voxel_data = [&](uint32_t _d, uint32_t _u, uint32_t _v)
+        {
+            glm::uvec3 p = axis_coord(axis, _d, _u, _v);
+            return _chunk.at(p.x, p.y, p.z).data;
+        };
+
+        // faces merge if both voxel data and corner occlusion are equal
+        uint8_t ao[s_maxSize * s_maxSize];
+        auto mergeable = [&](uint32_t _d, uint32_t _u, uint32_t _v, uint32_t _data, uint8_t _ao)
+        {
+            return ao[_u * nv + _v] == _ao && (_columns.uniform || voxel_data(_d, _u, _v) == _data);
+        };
+
+        _quads.clear();
+        for (uint32_t d = 0; d < nd; d++)
+        {
+            uint64_t* rows = &planes[d * nu];
+            // corner occlusion of the faces, from the rows in front of the slice
+            int front = positive ? (int)d + 1 : (int)d - 1;
+            for (uint32_t u = 0; u < nu; u++)
+            {
+                if (!rows[u])
+                    continue;
+                uint64_t a = layer_row(_columns, axis, front, (int)u - 1);
+                uint64_t b = layer_row(_columns, axis, front, (int)u);
+                uint64_t c = layer_row(_columns, axis, front, (int)u + 1);
+                for (uint64_t row = rows[u]; row; row &= row - 1)
+                {
+                    uint32_t v = __builtin_ctzll(row);
+                    ao[u * nv + v] = s_aoTable.ao[((a >> v) & 7) | (((b >> v) & 7) << 3) | (((c >> v) & 7) << 6)];
+                }
+            }
+
+            for (uint32_t u = 0; u < nu; u++)
+            {
+                while (rows[u])
+                {
+                    // run of faces along the row
+                    uint32_t v = __builtin_ctzll(rows[u]);
+                    uint32_t w = __builtin_ctzll(~(rows[u] >> v));
+                    uint32_t data = voxel_data(d, u, v);
+                    uint8_t faceAO = ao[u * nv + v];
+                    for (uint32_t k = 1; k < w; k++)
+                    {
+                        if (!mergeable(d, u, v + k, data, faceAO))
+                        {
+                            w = k;
+                            break;
+                        }
+                    }
+                    uint64_t run = ((w < 64 ? (1ull << w) : 0) - 1) << v;
+
+                    // extend over the following rows covering the run
+                    uint32_t h = 1;
+                    for (; u + h < nu && (rows[u + h] & run) == run; h++)
+                    {
+                        uint32_t k = 0;
+                        while (k < w && mergeable(d, u + h, v + k, data, faceAO))
+                            k++;
+                        if (k < w)
+                            break;
+                    }
+
+                    for (uint32_t k = 0; k < h; k++)
+                        rows[u + k] &= ~run;
+
+                    glm::uvec3 p = axis_coord(axis, d, u, v);
+                    VxQuad quad;
+                    quad.x = (uint8_t)p.x;
+                    quad.y = (uint8_t)p.y;
+                    quad.z = (uint8_t)p.z;
+                    quad.w = (uint8_t)w;
+                    quad.h = (uint8_t)h;
+                    quad.dir = (uint8_t)_dir;
+                    quad.ao = faceAO;
+                    quad.reserved = 0;
+                    quad.data = data;
+                    _quads.push_back(quad);
+                }
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxMesher::mesh(const VxChunkStorage& _chunk,
+                        VxChunkMesh& _mesh,
+                        uint32_t _remesh,
+                        const VxChunkStorage* const* _neighbours)
+    {
+        uint32_t dirs[6];
+        uint32_t dirCount = 0;
+        bool axes[3] = { false, false, false };
+        for (uint32_t dir = 0; dir < 6; dir++)
+        {
+            if (_remesh & (1u << dir))
+            {
+                dirs[dirCount++] = dir;
+                axes[dir % 3] = true;
+            }
+        }
+        if (dirCount == 0)
+            return;
+
+        vx_columns_t columns;
+        build_columns(_chunk, _neighbours, axes, columns);
+
+        #ifdef VX_THREADED_MESHING
+            ThreadPool::get().parallelFor(0, dirCount, [&](size_t i)
+            {
+                mesh_direction(_chunk, columns, dirs[i], _mesh.quads[dirs[i]]);
+            });
+        #else
+            for (uint32_t i = 0; i < dirCount; i++)
+                mesh_direction(_chunk, columns, dirs[i], _mesh.quads[dirs[i]]);
+        #endif
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxMesher::buildVertices(const std::vector<VxQuad>& _quads,
+                                 std::vector<VxVertex>& _vertices,
+                                 std::vector<uint32_t>& _indices)
+    {
+        _vertices.reserve(_vertices.size() + 4 * _quads.size());
+        _indices.reserve(_indices.size() + 6 * _quads.size());
+
+        for (const auto& quad : _quads)
+        {
+            uint32_t axis = quad.dir % 3;
+            bool positive = quad.dir < 3;
+            glm::vec3 eu(0.0f), ev(0.0f), normal(0.0f);
+            eu[s_axisU[axis]] = 1.0f;
+            ev[s_axisV[axis]] = 1.0f;
+            normal[axis] = positive ? 1.0f : -1.0f;
+
+            glm::vec3 p0 = glm::vec3(quad.x, quad.y, quad.z);
+            if (positive)
+                p0[axis] += 1.0f;
+            glm::vec3 U = eu * (float)quad.h;
+            glm::vec3 V = ev * (float)quad.w;
+
+            uint32_t type = VX_DATA_GET_TYPE(quad.data);
+            uint32_t ao[4];
+            for (uint32_t k = 0; k < 4; k++)
+                ao[k] = (quad.ao >> (2 * k)) & 0x3;
+
+            uint32_t base = (uint32_t)_vertices.size();
+            _vertices.push_back({ p0, VX_VERTEX_DATA(type, quad.dir, ao[0]) });
+            _vertices.push_back({ p0 + U, VX_VERTEX_DATA(type, quad.dir, ao[1]) });
+            _vertices.push_back({ p0 + U + V, VX_VERTEX_DATA(type, quad.dir, ao[2]) });
+            _vertices.push_back({ p0 + V, VX_VERTEX_DATA(type, quad.dir, ao[3]) });
+
+            // split along the brighter diagonal, otherwise the interpolation of a single
+            // occluded corner smears along the diagonal through it
+            uint32_t c0 = base, c1 = base + 1, c2 = base + 2, c3 = base + 3;
+            if (ao[1] + ao[3] > ao[0] + ao[2])
+            {
+                c0 = base + 1; c1 = base + 2; c2 = base + 3; c3 = base;
+            }
+
+            // U x V points along the normal for +x, -y and +z
+            if (glm::dot(glm::cross(eu, ev), normal) > 0.0f)
+                _indices.insert(_indices.end(), { c0, c1, c2, c0, c2, c3 });
+            else
+                _indices.insert(_indices.end(), { c0, c2, c1, c0, c3, c2 });
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    BufferLayout VxMesher::getVertexLayout()
+    {
+        // the face normal is encoded in the data
+        return BufferLayout({
+            { VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
+            { VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Int, "a_data" },
+        });
+    }
+
+
+}
+
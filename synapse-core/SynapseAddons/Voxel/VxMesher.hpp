@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Types.hpp"
+#include "VxChunkStorage.hpp"
+#include "../../SynapseCore/Renderer/Buffers/VertexBuffer.hpp"
+
+
+/* Vertex data of meshed voxel faces: voxel type in the low 8 bits, face direction
+ * (VX_CHUNK_MESH_DIR_*) in the next 3 and ambient occlusion (0-3, 3 unoccluded) in the
+ * next 2. Kept below 2^24, so that it survives the float conversion of
+ * glVertexAttribPointer(). */
+#define VX_VERTEX_DATA(type, dir, ao)	(((type) & VX_DATA_MASK_TYPE) | (((dir) & 0x7) << 8) | (((ao) & 0x3) << 11))
+#define VX_VERTEX_GET_TYPE(x)			((x) & VX_DATA_MASK_TYPE)
+#define VX_VERTEX_GET_DIR(x)			(((x) >> 8) & 0x7)
+#define VX_VERTEX_GET_AO(x)				(((x) >> 11) & 0x3)
+
+
+namespace Syn
+{
+    /* A merged rectangle of voxel faces, in chunk coordinates. For faces along the x axis
+     * the rectangle spans y (h) and z (w), along y x (h) and z (w), and along z x (h) and
+     * y (w).
+     */
+    struct VxQuad
+    {
+        uint8_t x, y, z;    // voxel at the minimum corner
+        uint8_t w, h;       // extent in voxels
+        uint8_t dir;        // VX_CHUNK_MESH_DIR_*
+        uint8_t ao;         // 2 bits per corner, see VxMesher
+        uint8_t reserved;
+        uint32_t data;      // Voxel::data of the merged faces
+    };
+
+    //
+    struct VxVertex
+    {
+        glm::vec3 position;
+        uint32_t data;      // VX_VERTEX_DATA()
+    };
+
+    /* Quads of a chunk, per face direction, so that single directions can be remeshed
+     * (and culled when facing away from the camera). */
+    struct VxChunkMesh
+    {
+        std::vector<VxQuad> quads[6];
+
+        uint32_t getQuadCount() const
+        {
+            uint32_t count = 0;
+            for (uint32_t dir = 0; dir < 6; dir++)
+                count += (uint32_t)quads[dir].size();
+            return count;
+        }
+    };
+
+
+    /* Binary greedy mesher. Per axis, the occupancy of every voxel column of the chunk
+     * is a 64-bit mask (padded with the neighbouring chunks' border voxels), from which
+     * the visible faces of a whole column in both directions are two shifts and an and.
+     * The face bits are transposed into one plane of row masks per slice, and faces are
+     * merged greedily with bit scans: runs along a row, then extended over the following
+     * rows while their masks cover the run. Only faces of identical Voxel::data merge.
+     *
+     * Voxels are solid if their type is non-zero. With VX_CHUNK_STITCHING, faces against
+     * solid voxels of the neighbouring chunks are skipped; without neighbours (or
+     * stitching), chunk borders are treated as empty. With VX_THREADED_MESHING, the face
+     * directions are meshed in parallel on the ThreadPool.
+     *
+     * Ambient occlusion is baked per face corner, 3 - (side1 + side2 + corner) of the
+     * voxels adjacent to the corner in front of the face, or 0 if both sides are solid.
+     * Faces only merge with equal corner values. The corners are ordered as the quad
+     * vertices: (u, v), (u+h, v), (u+h, v+w), (u, v+w). Occupancy across chunk borders
+     * is read from the face neighbours; the voxels of diagonal chunks, only touching
+     * faces along the chunk edges, count as empty.
+     */
+    class VxMesher
+    {
+    public:
+        /* Meshes the face directions flagged in _remesh (VX_CHUNK_REMESH_*); the quads of
+         * other directions in _mesh are left untouched. _neighbours, if not nullptr, holds
+         * six chunks (or nullptr) indexed by VX_CHUNK_MESH_DIR_*.
+         */
+        static void mesh(const VxChunkStorage& _chunk,
+                         VxChunkMesh& _mesh,
+                         uint32_t _remesh=VX_CHUNK_REMESH_ALL,
+                         const VxChunkStorage* const* _neighbours=nullptr);
+
+        /* Appends two triangles per quad, counter-clockwise seen from outside, in chunk
+         * coordinates (voxel (x, y, z) spans [x, x+1] etc). Quads are split along the
+         * diagonal with the larger occlusion sum, to avoid anisotropic occlusion. */
+        static void buildVertices(const std::vector<VxQuad>& _quads,
+                                  std::vector<VxVertex>& _vertices,
+                                  std::vector<uint32_t>& _indices);
+
+        // Layout of VxVertex; the data is read as a float and converted in the shader.
+        static BufferLayout getVertexLayout();
+
+    };
+
+
+}
+
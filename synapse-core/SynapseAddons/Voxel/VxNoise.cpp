@@ -2,14 +2,44 @@
 #include "../../pch.hpp"
 
 #include "VxNoise.hpp"
+#include "../../SynapseCore/Utils/CPUFeatures.hpp"
+
 
 
 namespace Syn
 {
+    //
+    struct vx_noise_params_t
+    {
+        const uint32_t* p;      // value noise permutation
+        const float* r;         // value noise lattice values
+        uint32_t r_mask;
+        const uint32_t* p_p;    // Perlin noise permutation
+        uint32_t octaves;
+        float frequency;
+        float d_frequency;
+        float d_amplitude;
+        float rot2[4];          // column-major, as glm
+        float rot3[9];
+    };
+
+    /* Matrix-vector products of the rotated fBm functions, written out so that the batch
+     * kernels can reproduce the exact order of operations. */
+    static inline glm::vec2 rotate2(const glm::mat2& m, const glm::vec2& p)
+    { return glm::vec2(m[0][0] * p.x + m[1][0] * p.y, m[0][1] * p.x + m[1][1] * p.y); }
+    static inline glm::vec3 rotate3(const glm::mat3& m, const glm::vec3& p)
+    {
+        return glm::vec3(m[0][0] * p.x + m[1][0] * p.y + m[2][0] * p.z,
+                         m[0][1] * p.x + m[1][1] * p.y + m[2][1] * p.z,
+                         m[0][2] * p.x + m[1][2] * p.y + m[2][2] * p.z);
+    }
+
     // Static variable declarations -----------------------------------------------------
+    const glm::mat2 VxNoiseContext::s_mrot2 = { 0.8, 0.6, -0.6, 0.8 };
+    const glm::mat3 VxNoiseContext::s_mrot3 = { 0.00f,  0.80f,  0.60f, -0.80f,  0.36f, -0.48f, -0.60f, -0.48f,  0.64f };
 
-    // Perlin noise
-    uint32_t    VxNoise::s_uint32_p[256] =
+    // Reference permutation of Perlin noise, shuffled for seeds other than the default
+    static const uint32_t s_uint32_p[256] =
     {
         151,160,137,91,90,15,131,13,201,95,96,53,194,233,7,225,140,36,103,30,69,142,8,99,37,240,
         21,10,23,190,6,148,247,120,234,75,0,26,197,62,94,252,219,203,117,35,11,32,57,177,33,88,
@@ -23,27 +53,11 @@ namespace Syn
         31,181,199,106,157,184,84,204,176,115,121,50,45,127,4,150,254,138,236,205,93,222,114,67,
         29,24,72,243,141,128,195,78,66,215,61,156,180
     };
-    uint32_t    VxNoise::s_p_p[512];
-
-    // Value noise
-    uint32_t    VxNoise::s_r_sz             = 256;
-    uint32_t    VxNoise::s_r_mask           = s_r_sz - 1;
-    float       VxNoise::s_r[256];
-    uint32_t    VxNoise::s_p[512];
-
-    // General
-    uint8_t     VxNoise::s_octave_count     = 5;
-    float       VxNoise::s_frequency_perlin = 1.0f;
-    float       VxNoise::s_frequency_value  = 5.0f;
-    float       VxNoise::s_d_frequency      = 2.0f;
-    float       VxNoise::s_d_amplitude      = 0.5f;
-    glm::mat2   VxNoise::s_mrot2            = { 0.8, 0.6, -0.6, 0.8 };
-    glm::mat3   VxNoise::s_mrot3            = { 0.00f,  0.80f,  0.60f, -0.80f,  0.36f, -0.48f, -0.60f, -0.48f,  0.64f };
 
     // Member functions -----------------------------------------------------------------
     //-----------------------------------------------------------------------------------
     /* 2D value noise, evaluated at (x, y). */
-    float VxNoise::value2(float x, float y)
+    float VxNoiseContext::value2(float x, float y) const
     {
         int xi = fast_floor(x);
         int yi = fast_floor(y);
@@ -56,10 +70,10 @@ namespace Syn
         int rx1 = (rx0 + 1) & s_r_mask;
         int ry1 = (ry0 + 1) & s_r_mask;
 
-        const float& c00 = s_r[s_p[s_p[rx0] + ry0]];
-        const float& c10 = s_r[s_p[s_p[rx1] + ry0]];
-        const float& c01 = s_r[s_p[s_p[rx0] + ry1]];
-        const float& c11 = s_r[s_p[s_p[rx1] + ry1]];
+        const float& c00 = m_r[m_p[m_p[rx0] + ry0]];
+        const float& c10 = m_r[m_p[m_p[rx1] + ry0]];
+        const float& c01 = m_r[m_p[m_p[rx0] + ry1]];
+        const float& c11 = m_r[m_p[m_p[rx1] + ry1]];
 
         float sx = cubic_step(xf);
         float sy = cubic_step(yf);
@@ -71,16 +85,16 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 2D fractional value noise, evaluated at (x, y) (5 octaves default). */
-    float VxNoise::value2_fbm(float x, float y)
+    float VxNoiseContext::value2_fbm(float x, float y) const
     {
         float  n = 0.0f;    // accumulated noise
-        float  f = s_frequency_value;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_value;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
         float  t = 0.0f;    // total amp, for normalizing to [0..1]
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * value2(x * f, y * f);
             t += a;
@@ -91,20 +105,20 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* Rotated 2D fractional value noise, evaluated at p (5 octaves default). */
-    float VxNoise::value2_fbm_r(const glm::vec2& p)
+    float VxNoiseContext::value2_fbm_r(const glm::vec2& p) const
     {
         glm::vec2 p_ = p;
         float  n = 0.0f;    // accumulated noise
-        float  f = s_frequency_value;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_value;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
         float  t = 0.0f;    // total amp, for normalizing to [0..1]
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * value2(p_.x * f, p_.y * f);
-            p_ = s_mrot2 * p_;
+            p_ = rotate2(s_mrot2, p_);
             t += a;
             a *= da;
             f *= df;
@@ -113,7 +127,7 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 3D value noise, evaluated at (x, y). */
-    float VxNoise::value3(float x, float y, float z)
+    float VxNoiseContext::value3(float x, float y, float z) const
     {
         int xi = fast_floor(x);
         int yi = fast_floor(y);
@@ -130,14 +144,14 @@ namespace Syn
         int ry1 = (ry0 + 1) & s_r_mask;
         int rz1 = (rz0 + 1) & s_r_mask;
 
-        const float& c000 = s_r[s_p[s_p[s_p[rx0] + ry0] + rz0]];
-        const float& c100 = s_r[s_p[s_p[s_p[rx1] + ry0] + rz0]];
-        const float& c010 = s_r[s_p[s_p[s_p[rx0] + ry1] + rz0]];
-        const float& c110 = s_r[s_p[s_p[s_p[rx1] + ry1] + rz0]];
-        const float& c001 = s_r[s_p[s_p[s_p[rx0] + ry0] + rz1]];
-        const float& c101 = s_r[s_p[s_p[s_p[rx1] + ry0] + rz1]];
-        const float& c011 = s_r[s_p[s_p[s_p[rx0] + ry1] + rz1]];
-        const float& c111 = s_r[s_p[s_p[s_p[rx1] + ry1] + rz1]];
+        const float& c000 = m_r[m_p[m_p[m_p[rx0] + ry0] + rz0]];
+        const float& c100 = m_r[m_p[m_p[m_p[rx1] + ry0] + rz0]];
+        const float& c010 = m_r[m_p[m_p[m_p[rx0] + ry1] + rz0]];
+        const float& c110 = m_r[m_p[m_p[m_p[rx1] + ry1] + rz0]];
+        const float& c001 = m_r[m_p[m_p[m_p[rx0] + ry0] + rz1]];
+        const float& c101 = m_r[m_p[m_p[m_p[rx1] + ry0] + rz1]];
+        const float& c011 = m_r[m_p[m_p[m_p[rx0] + ry1] + rz1]];
+        const float& c111 = m_r[m_p[m_p[m_p[rx1] + ry1] + rz1]];
 
         float u = cubic_step(xf);
         float v = cubic_step(yf);
@@ -155,16 +169,16 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 3D fractional value noise, evaluated at (x, y) (5 octaves default). */
-    float VxNoise::value3_fbm(float x, float y, float z)
+    float VxNoiseContext::value3_fbm(float x, float y, float z) const
     {
         float  n = 0.0f;    // accumulated noise
-        float  f = s_frequency_value;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_value;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
         float  t = 0.0f;    // total amp, for normalizing to [0..1]
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * value3(x * f, y * f, z * f);
             t += a;
@@ -175,20 +189,20 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* Rotated 3D fractional value noise, evaluated at p (5 octaves default). */
-    float VxNoise::value3_fbm_r(const glm::vec3& p)
+    float VxNoiseContext::value3_fbm_r(const glm::vec3& p) const
     {
         glm::vec3 p_ = p;
         float  n = 0.0f;    // accumulated noise
-        float  f = s_frequency_value;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_value;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
         float  t = 0.0f;    // total amp, for normalizing to [0..1]
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * value3(p_.x * f, p_.y * f, p_.z * f);
-            p_ = s_mrot3 * p_;
+            p_ = rotate3(s_mrot3, p_);
             t += a;
             a *= da;
             f *= df;
@@ -197,7 +211,7 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 2D Perlin noise, evaluated at (x, y). */
-    float VxNoise::perlin2(float x, float y)
+    float VxNoiseContext::perlin2(float x, float y) const
     {
         int xi = (int)x & 255;
         int yi = (int)y & 255;
@@ -209,10 +223,10 @@ namespace Syn
         float v = quintic_step(yf);
 
         int g00, g01, g10, g11;
-        g00 = s_p_p[s_p_p[  xi]+  yi];
-        g10 = s_p_p[s_p_p[1+xi]+  yi];
-        g01 = s_p_p[s_p_p[  xi]+1+yi];
-        g11 = s_p_p[s_p_p[1+xi]+1+yi];
+        g00 = m_p_p[m_p_p[  xi]+  yi];
+        g10 = m_p_p[m_p_p[1+xi]+  yi];
+        g01 = m_p_p[m_p_p[  xi]+1+yi];
+        g11 = m_p_p[m_p_p[1+xi]+1+yi];
 
         float x1, x2;
         x1 = lerp(grad2(g00, xf, yf  ), grad2(g10, xf-1, yf  ), u);
@@ -222,16 +236,16 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 2D fractional Perlin noise, evaluated at (x, y) (5 octaves default). */
-    float VxNoise::perlin2_fbm(float x, float y)
+    float VxNoiseContext::perlin2_fbm(float x, float y) const
     {
         float  n = 0.0f;    // accumulated noise
         float  t = 0.0f;    // total amp, for normalizing [0..1]
-        float  f = s_frequency_perlin;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_perlin;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * perlin2(x * f, y * f);
             t += a;
@@ -242,7 +256,7 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 3D Perlin noise, evaluated at (x, y, z). */
-    float VxNoise::perlin3(float x, float y, float z)
+    float VxNoiseContext::perlin3(float x, float y, float z) const
     {
         int xi = (int)x & 255;
         int yi = (int)y & 255;
@@ -257,14 +271,14 @@ namespace Syn
         float w = quintic_step(zf);
 
         int g000, g010, g001, g011, g100, g110, g101, g111;
-        g000 = s_p_p[s_p_p[s_p_p[  xi]+  yi]+  zi];
-        g010 = s_p_p[s_p_p[s_p_p[  xi]+1+yi]+  zi];
-        g001 = s_p_p[s_p_p[s_p_p[  xi]+  yi]+1+zi];
-        g011 = s_p_p[s_p_p[s_p_p[  xi]+1+yi]+1+zi];
-        g100 = s_p_p[s_p_p[s_p_p[1+xi]+  yi]+  zi];
-        g110 = s_p_p[s_p_p[s_p_p[1+xi]+1+yi]+  zi];
-        g101 = s_p_p[s_p_p[s_p_p[1+xi]+  yi]+1+zi];
-        g111 = s_p_p[s_p_p[s_p_p[1+xi]+1+yi]+1+zi];
+        g000 = m_p_p[m_p_p[m_p_p[  xi]+  yi]+  zi];
+        g010 = m_p_p[m_p_p[m_p_p[  xi]+1+yi]+  zi];
+        g001 = m_p_p[m_p_p[m_p_p[  xi]+  yi]+1+zi];
+        g011 = m_p_p[m_p_p[m_p_p[  xi]+1+yi]+1+zi];
+        g100 = m_p_p[m_p_p[m_p_p[1+xi]+  yi]+  zi];
+        g110 = m_p_p[m_p_p[m_p_p[1+xi]+1+yi]+  zi];
+        g101 = m_p_p[m_p_p[m_p_p[1+xi]+  yi]+1+zi];
+        g111 = m_p_p[m_p_p[m_p_p[1+xi]+1+yi]+1+zi];
 
         float x1, x2, y1, y2;
         x1 = lerp(grad3(g000, xf  , yf  , zf  ), grad3(g100, xf-1, yf  , zf  ), u);
@@ -278,16 +292,16 @@ namespace Syn
     }
     //-----------------------------------------------------------------------------------
     /* 3D fractional Perlin noise, evaluated at (x, y, z) (5 octaves default). */
-    float VxNoise::perlin3_fbm(float x, float y, float z)
+    float VxNoiseContext::perlin3_fbm(float x, float y, float z) const
     {
         float  n = 0.0f;    // accumulated noise
         float  t = 0.0f;    // total amp, for normalizing [0..1]
-        float  f = s_frequency_perlin;
-        float df = s_d_frequency;
+        float  f = m_params.frequency_perlin;
+        float df = m_params.d_frequency;
         float  a = 1.0f;
-        float da = s_d_amplitude;
+        float da = m_params.d_amplitude;
 
-        for (uint8_t i = 0; i < s_octave_count; i++)
+        for (uint8_t i = 0; i < m_params.octave_count; i++)
         {
             n += a * perlin3(x*f, y*f, z*f);
             t += a;
@@ -296,38 +310,381 @@ namespace Syn
         }
         return n / t;
     }
+
+    // Batch evaluation -----------------------------------------------------------------
+    // AVX-512F includes FMA; contraction of the separate multiplies and adds would break
+    // bit-exactness with the scalar path (clang doesn't contract across intrinsics).
+#ifdef SYN_SIMD_X86
+    #if defined(__clang__)
+        #pragma clang attribute push(__attribute__((target("avx2"))), apply_to=function)
+    #else
+        #pragma GCC push_options
+        #pragma GCC target("avx2")
+        #pragma GCC optimize("fp-contract=off")
+    #endif
+    namespace vx_noise_avx2
+    {
+        typedef __m256 vf;
+        typedef __m256i vi;
+        typedef __m256i vm;
+        static const uint32_t W = 8;
+
+        static inline vf set1(float x) { return _mm256_set1_ps(x); }
+        static inline vf loadu(const float* p) { return _mm256_loadu_ps(p); }
+        static inline void storeu(float* p, vf x) { _mm256_storeu_ps(p, x); }
+        static inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+        static inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+        static inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+        static inline vf div(vf a, vf b) { return _mm256_div_ps(a, b); }
+        static inline vi cvtt(vf x) { return _mm256_cvttps_epi32(x); }
+        static inline vf cvt(vi x) { return _mm256_cvtepi32_ps(x); }
+        static inline vi set1_i(int x) { return _mm256_set1_epi32(x); }
+        static inline vi and_i(vi a, vi b) { return _mm256_and_si256(a, b); }
+        static inline vi add_i(vi a, vi b) { return _mm256_add_epi32(a, b); }
+        static inline vi sub_i(vi a, vi b) { return _mm256_sub_epi32(a, b); }
+        static inline vi shl_i(vi a, int n) { return _mm256_slli_epi32(a, n); }
+        static inline vf xor_f(vf a, vi b) { return _mm256_xor_ps(a, _mm256_castsi256_ps(b)); }
+        static inline vi gather_i(const uint32_t* p, vi i) { return _mm256_i32gather_epi32(reinterpret_cast<const int*>(p), i, 4); }
+        static inline vf gather_f(const float* p, vi i) { return _mm256_i32gather_ps(p, i, 4); }
+        static inline vm gt_f(vf a, vf b) { return _mm256_castps_si256(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+        static inline vm lt_i(vi a, vi b) { return _mm256_cmpgt_epi32(b, a); }
+        static inline vm eq_i(vi a, vi b) { return _mm256_cmpeq_epi32(a, b); }
+        static inline vm or_m(vm a, vm b) { return _mm256_or_si256(a, b); }
+        static inline vf select_f(vm m, vf a, vf b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(m)); }
+        static inline vi select_i(vm m, vi a, vi b) { return _mm256_blendv_epi8(b, a, m); }
+
+        #include "VxNoiseSIMD.inl"
+    }
+    #if defined(__clang__)
+        #pragma clang attribute pop
+    #else
+        #pragma GCC pop_options
+    #endif
+
+    #if defined(__clang__)
+        #pragma clang attribute push(__attribute__((target("avx512f"))), apply_to=function)
+    #else
+        #pragma GCC push_options
+        #pragma GCC target("avx512f")
+        #pragma GCC optimize("fp-contract=off")
+    #endif
+    namespace vx_noise_avx512
+    {
+        typedef __m512 vf;
+        typedef __m512i vi;
+        typedef __mmask16 vm;
+        static const uint32_t W = 16;
+
+        static inline vf set1(float x) { return _mm512_set1_ps(x); }
+        static inline vf loadu(const float* p) { return _mm512_loadu_ps(p); }
+        static inline void storeu(float* p, vf x) { _mm512_storeu_ps(p, x); }
+        static inline vf add(vf a, vf b) { return _mm512_add_ps(a, b); }
+        static inline vf sub(vf a, vf b) { return _mm512_sub_ps(a, b); }
+        static inline vf mul(vf a, vf b) { return _mm512_mul_ps(a, b); }
+        static inline vf div(vf a, vf b) { return _mm512_div_ps(a, b); }
+        static inline vi cvtt(vf x) { return _mm512_cvttps_epi32(x); }
+        static inline vf cvt(vi x) { return _mm512_cvtepi32_ps(x); }
+        static inline vi set1_i(int x) { return _mm512_set1_epi32(x); }
+        static inline vi and_i(vi a, vi b) { return _mm512_and_si512(a, b); }
+        static inline vi add_i(vi a, vi b) { return _mm512_add_epi32(a, b); }
+        static inline vi sub_i(vi a, vi b) { return _mm512_sub_epi32(a, b); }
+        static inline vi shl_i(vi a, int n) { return _mm512_slli_epi32(a, n); }
+        static inline vf xor_f(vf a, vi b) { return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a), b)); }
+        static inline vi gather_i(const uint32_t* p, vi i) { return _mm512_i32gather_epi32(i, p, 4); }
+        static inline vf gather_f(const float* p, vi i) { return _mm512_i32gather_ps(i, p, 4); }
+        static inline vm gt_f(vf a, vf b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static inline vm lt_i(vi a, vi b) { return _mm512_cmplt_epi32_mask(a, b); }
+        static inline vm eq_i(vi a, vi b) { return _mm512_cmpeq_epi32_mask(a, b); }
+        static inline vm or_m(vm a, vm b) { return (vm)(a | b); }
+        static inline vf select_f(vm m, vf a, vf b) { return _mm512_mask_blend_ps(m, b, a); }
+        static inline vi select_i(vm m, vi a, vi b) { return _mm512_mask_blend_epi32(m, b, a); }
+
+        #include "VxNoiseSIMD.inl"
+    }
+    #if defined(__clang__)
+        #pragma clang attribute pop
+    #else
+        #pragma GCC pop_options
+    #endif
+#endif
+
     //-----------------------------------------------------------------------------------
-    /* Initializer : must be called before use. */
-    void VxNoise::init(uint32_t seed)
+    struct vx_noise_kernels_t
+    {
+        uint32_t (*value2_fbm)(const vx_noise_params_t&, const float*, const float*, float*, uint32_t, bool) = nullptr;
+        uint32_t (*value3_fbm)(const vx_noise_params_t&, const float*, const float*, const float*, float*, uint32_t, bool) = nullptr;
+        uint32_t (*perlin2_fbm)(const vx_noise_params_t&, const float*, const float*, float*, uint32_t) = nullptr;
+        uint32_t (*perlin3_fbm)(const vx_noise_params_t&, const float*, const float*, const float*, float*, uint32_t) = nullptr;
+        const char* name = "scalar";
+    };
+    //-----------------------------------------------------------------------------------
+    static const vx_noise_kernels_t& get_kernels()
+    {
+        static vx_noise_kernels_t s_kernels = []()
+        {
+            vx_noise_kernels_t kernels;
+            #ifdef SYN_SIMD_X86
+                if (cpu_features().avx512f)
+                    kernels = { vx_noise_avx512::value2_fbm, vx_noise_avx512::value3_fbm,
+                                vx_noise_avx512::perlin2_fbm, vx_noise_avx512::perlin3_fbm, "AVX-512" };
+                else if (cpu_features().avx2)
+                    kernels = { vx_noise_avx2::value2_fbm, vx_noise_avx2::value3_fbm,
+                                vx_noise_avx2::perlin2_fbm, vx_noise_avx2::perlin3_fbm, "AVX2" };
+            #endif
+            return kernels;
+        }();
+        return s_kernels;
+    }
+    //-----------------------------------------------------------------------------------
+    void VxNoiseContext::get_batch_params(vx_noise_params_t& params, float frequency) const
+    {
+        params.p = m_p;
+        params.r = m_r;
+        params.r_mask = s_r_mask;
+        params.p_p = m_p_p;
+        params.octaves = m_params.octave_count;
+        params.frequency = frequency;
+        params.d_frequency = m_params.d_frequency;
+        params.d_amplitude = m_params.d_amplitude;
+        for (int c = 0; c < 2; c++)
+            for (int r = 0; r < 2; r++)
+                params.rot2[c * 2 + r] = s_mrot2[c][r];
+        for (int c = 0; c < 3; c++)
+            for (int r = 0; r < 3; r++)
+                params.rot3[c * 3 + r] = s_mrot3[c][r];
+    }
+    //-----------------------------------------------------------------------------------
+    /* 2D fractional value noise, batch. */
+    void VxNoiseContext::value2_fbm(const float* x, const float* y, float* out, uint32_t count) const
+    {
+        uint32_t i = 0;
+        if (get_kernels().value2_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_value);
+            i = get_kernels().value2_fbm(params, x, y, out, count, false);
+        }
+        for (; i < count; i++)
+            out[i] = value2_fbm(x[i], y[i]);
+    }
+    //-----------------------------------------------------------------------------------
+    /* Rotated 2D fractional value noise, batch. */
+    void VxNoiseContext::value2_fbm_r(const float* x, const float* y, float* out, uint32_t count) const
+    {
+        uint32_t i = 0;
+        if (get_kernels().value2_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_value);
+            i = get_kernels().value2_fbm(params, x, y, out, count, true);
+        }
+        for (; i < count; i++)
+            out[i] = value2_fbm_r(glm::vec2(x[i], y[i]));
+    }
+    //-----------------------------------------------------------------------------------
+    /* 3D fractional value noise, batch. */
+    void VxNoiseContext::value3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count) const
+    {
+        uint32_t i = 0;
+        if (get_kernels().value3_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_value);
+            i = get_kernels().value3_fbm(params, x, y, z, out, count, false);
+        }
+        for (; i < count; i++)
+            out[i] = value3_fbm(x[i], y[i], z[i]);
+    }
+    //-----------------------------------------------------------------------------------
+    /* Rotated 3D fractional value noise, batch. */
+    void VxNoiseContext::value3_fbm_r(const float* x, const float* y, const float* z, float* out, uint32_t count) const
+    {
+        uint32_t i = 0;
+        if (get_kernels().value3_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_value);
+            i = get_kernels().value3_fbm(params, x, y, z, out, count, true);
+        }
+        for (; i < count; i++)
+            out[i] = value3_fbm_r(glm::vec3(x[i], y[i], z[i]));
+    }
+    //-----------------------------------------------------------------------------------
+    /* 2D fractional Perlin noise, batch. */
+    void VxNoiseContext::perlin2_fbm(const float* x, const float* y, float* out, uint32_t count) const
+    {
+        uint32_t i = 0;
+        if (get_kernels().perlin2_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_perlin);
+            i = get_kernels().perlin2_fbm(params, x, y, out, count);
+        }
+        for (; i < count; i++)
+            out[i] = perlin2_fbm(x[i], y[i]);
+    }
+    //-----------------------------------------------------------------------------------
+    /* 3D fractional Perlin noise, batch. */
+    void VxNoiseContext::perlin3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count) const
     {
-        // Initialize value noise permutation tables
-        //
+        uint32_t i = 0;
+        if (get_kernels().perlin3_fbm)
+        {
+            vx_noise_params_t params;
+            get_batch_params(params, m_params.frequency_perlin);
+            i = get_kernels().perlin3_fbm(params, x, y, z, out, count);
+        }
+        for (; i < count; i++)
+            out[i] = perlin3_fbm(x[i], y[i], z[i]);
+    }
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 2D grid; batch(x, y, out, n) evaluates a
+     * row. */
+    template<typename batch_fn_t>
+    static void eval_grid2_rows(const batch_fn_t& batch,
+                                float x0, float y0, float dx, float dy,
+                                uint32_t nx, uint32_t ny, float* out)
+    {
+        std::vector<float> xs(nx), ys(nx);
+        for (uint32_t i = 0; i < nx; i++)
+            xs[i] = x0 + (float)i * dx;
 
-        // Value noise random number generation (unifrom float dist)
-        std::mt19937 gen(seed);
+        for (uint32_t j = 0; j < ny; j++)
+        {
+            std::fill(ys.begin(), ys.end(), y0 + (float)j * dy);
+            batch(xs.data(), ys.data(), out + (size_t)j * nx, nx);
+        }
+    }
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 3D grid, row by row. */
+    template<typename batch_fn_t>
+    static void eval_grid3_rows(const batch_fn_t& batch,
+                                float x0, float y0, float z0, float dx, float dy, float dz,
+                                uint32_t nx, uint32_t ny, uint32_t nz, float* out)
+    {
+        std::vector<float> xs(nx), ys(nx), zs(nx);
+        for (uint32_t i = 0; i < nx; i++)
+            xs[i] = x0 + (float)i * dx;
+
+        for (uint32_t k = 0; k < nz; k++)
+        {
+            std::fill(zs.begin(), zs.end(), z0 + (float)k * dz);
+            for (uint32_t j = 0; j < ny; j++)
+            {
+                std::fill(ys.begin(), ys.end(), y0 + (float)j * dy);
+                batch(xs.data(), ys.data(), zs.data(), out + ((size_t)k * ny + j) * nx, nx);
+            }
+        }
+    }
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 2D grid. */
+    void VxNoiseContext::eval_grid2(void (VxNoiseContext::*batch)(const float*, const float*, float*, uint32_t) const,
+                                    float x0, float y0, float dx, float dy,
+                                    uint32_t nx, uint32_t ny, float* out) const
+    {
+        eval_grid2_rows([&](const float* x, const float* y, float* row, uint32_t n) { (this->*batch)(x, y, row, n); },
+                        x0, y0, dx, dy, nx, ny, out);
+    }
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 3D grid. */
+    void VxNoiseContext::eval_grid3(void (VxNoiseContext::*batch)(const float*, const float*, const float*, float*, uint32_t) const,
+                                    float x0, float y0, float z0, float dx, float dy, float dz,
+                                    uint32_t nx, uint32_t ny, uint32_t nz, float* out) const
+    {
+        eval_grid3_rows([&](const float* x, const float* y, const float* z, float* row, uint32_t n) { (this->*batch)(x, y, z, row, n); },
+                        x0, y0, z0, dx, dy, dz, nx, ny, nz, out);
+    }
+    //-----------------------------------------------------------------------------------
+    VxNoiseContext::VxNoiseContext(uint32_t _seed, const VxNoiseParams& _params) :
+        m_seed(_seed), m_params(_params)
+    {
+        // Value noise random number generation (unifrom float dist); the lattice values
+        // and the permutation draw from separate engines with the same seed
+        std::mt19937 gen_float(_seed);
+        std::mt19937 gen_uint(_seed);
         std::uniform_real_distribution<float> dist_float;
-        auto r_float = std::bind(dist_float, gen);
         for (uint32_t i = 0; i < s_r_sz; i++)
         {
-            s_r[i] = r_float();
-            s_p[i] = i;
+            m_r[i] = dist_float(gen_float);
+            m_p[i] = i;
         }
 
         // Permute random floats
         std::uniform_int_distribution<uint> dist_uint;
-        auto r_uint = std::bind(dist_uint, gen);
         for (uint32_t i = 0; i < s_r_sz; i++)
         {
-            uint32_t j = r_uint() & s_r_mask;
-            std::swap(s_p[i], s_p[j]);
-            s_p[i + s_r_sz] = s_p[i];
+            uint32_t j = dist_uint(gen_uint) & s_r_mask;
+            std::swap(m_p[i], m_p[j]);
+            m_p[i + s_r_sz] = m_p[i];
         }
 
-        // Initialize Perlin noise permutation table
-        for (int i = 0; i < 512; i++)
-            s_p_p[i] = s_uint32_p[i % 256];
+        // Perlin noise permutation table : the reference permutation, shuffled unless
+        // default seeded (keeping the original output of the default seed)
+        for (uint32_t i = 0; i < 256; i++)
+            m_p_p[i] = s_uint32_p[i];
+        if (_seed != s_default_seed)
+        {
+            for (uint32_t i = 255; i > 0; i--)
+                std::swap(m_p_p[i], m_p_p[dist_uint(gen_uint) % (i + 1)]);
+        }
+        for (uint32_t i = 0; i < 256; i++)
+            m_p_p[i + 256] = m_p_p[i];
+    }
+    //-----------------------------------------------------------------------------------
+    VxNoiseContext::VxNoiseContext(const VxNoiseContext& _other, const VxNoiseParams& _params) :
+        VxNoiseContext(_other)
+    {
+        m_params = _params;
+    }
+
+    // Static API -----------------------------------------------------------------------
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 2D grid. */
+    void VxNoise::eval_grid2(void (*batch)(const float*, const float*, float*, uint32_t),
+                             float x0, float y0, float dx, float dy,
+                             uint32_t nx, uint32_t ny, float* out)
+    {
+        eval_grid2_rows(batch, x0, y0, dx, dy, nx, ny, out);
+    }
+    //-----------------------------------------------------------------------------------
+    /* A batch function evaluated over a regular 3D grid. */
+    void VxNoise::eval_grid3(void (*batch)(const float*, const float*, const float*, float*, uint32_t),
+                             float x0, float y0, float z0, float dx, float dy, float dz,
+                             uint32_t nx, uint32_t ny, uint32_t nz, float* out)
+    {
+        eval_grid3_rows(batch, x0, y0, z0, dx, dy, dz, nx, ny, nz, out);
+    }
+    //-----------------------------------------------------------------------------------
+    /* Instruction set used by the batch functions. */
+    const char* VxNoise::simd_path()
+    {
+        return get_kernels().name;
+    }
+    //-----------------------------------------------------------------------------------
+    /* Initializer : seeds the default context (keeping its parameters). */
+    void VxNoise::init(uint32_t seed)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::shared_ptr<const VxNoiseContext> seeded = std::make_shared<const VxNoiseContext>(seed, context()->params());
+        std::atomic_store(&s_context, seeded);
 
-        SYN_CORE_TRACE("voxel noise engine initialized.");
+        SYN_CORE_TRACE("voxel noise engine initialized (seed ", seed, ").");
+    }
+    //-----------------------------------------------------------------------------------
+    const std::shared_ptr<const VxNoiseContext>& VxNoise::initial_context()
+    {
+        static const std::shared_ptr<const VxNoiseContext> s_initial = std::make_shared<const VxNoiseContext>();
+        return s_initial;
+    }
+    //-----------------------------------------------------------------------------------
+    void VxNoise::set_params(const std::function<void(VxNoiseParams&)>& _modify)
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        std::shared_ptr<const VxNoiseContext> current = context();
+        VxNoiseParams params = current->params();
+        _modify(params);
+        std::shared_ptr<const VxNoiseContext> modified = std::make_shared<const VxNoiseContext>(*current, params);
+        std::atomic_store(&s_context, modified);
     }
     //-----------------------------------------------------------------------------------
     /* Save noise as png image. */
@@ -1,7 +1,9 @@
-
 #pragma once
 
+#include <mutex>
+#include <memory>
 #include <random>
+#include <vector>
 #include <functional>
 
 #include <glm/glm.hpp>
@@ -13,30 +15,41 @@
 
 namespace Syn
 {
-    class VxNoise
+    // Tables and parameters of a batch evaluation, see VxNoise.cpp.
+    struct vx_noise_params_t;
+
+
+    /* fBm parameters of a noise context. */
+    struct VxNoiseParams
     {
-    // Member variables
-    private:
-        // Perlin noise
-        static uint32_t s_uint32_p[256];
-        static uint32_t s_p_p[512];
+        uint8_t octave_count    = 5;
+        float frequency_perlin  = 1.0f;
+        float frequency_value   = 5.0f;
+        float d_frequency       = 2.0f;     // frequency multiplier per octave
+        float d_amplitude       = 0.5f;     // amplitude multiplier per octave
+    };
 
-        // Value noise
-        static uint32_t s_r_sz;
-        static uint32_t s_r_mask;
-        static float s_r[256];
-        static uint32_t s_p[512];
 
+    /* Immutable noise context: the permutation and lattice tables of a seed, and the fBm
+     * parameters. All functions are const and lock free, so any number of threads (e.g.
+     * ThreadPool tasks) may evaluate the same or different contexts concurrently. Two
+     * contexts with the same seed and parameters return identical noise.
+     */
+    class VxNoiseContext
+    {
+    public:
+        /* The default seed uses the reference Perlin permutation, other seeds a shuffle of it. */
+        VxNoiseContext(uint32_t _seed=s_default_seed, const VxNoiseParams& _params=VxNoiseParams());
+        /* The tables of _other (same seed) with other parameters. */
+        VxNoiseContext(const VxNoiseContext& _other, const VxNoiseParams& _params);
+        VxNoiseContext(const VxNoiseContext&) = default;
+        ~VxNoiseContext() = default;
 
-        // General
-        static uint8_t s_octave_count;
-        static float s_frequency_perlin;
-        static float s_frequency_value;
-        static float s_d_frequency;
-        static float s_d_amplitude;
+        // Accessors
+        inline uint32_t seed() const { return m_seed; }
+        inline const VxNoiseParams& params() const { return m_params; }
 
-        static glm::mat2 s_mrot2;
-        static glm::mat3 s_mrot3;
+        static const uint32_t s_default_seed = 211117;
 
 
     // Private functions
@@ -89,99 +102,258 @@ namespace Syn
                 default: return 0;
             }
         }
-
-    // Accessors
-    public:
-        /* default = 5 */
-        static void set_octave_count(uint8_t o)     { s_octave_count     = o;  }
-        /* default = 5.0f */
-        static void set_frequency_value(float f)    { s_frequency_value  = f;  }
-        /* default = 5.0f */
-        static void set_frequency_perlin(float f)   { s_frequency_perlin = f;  }
-        /* default = 2.0f */
-        static void set_d_frequency(float df)       { s_d_frequency      = df; }
-        /* default = 0.5f */
-        static void set_d_amplitude(float da)       { s_d_amplitude      = da; }
+        /* Tables and parameters, for the batch kernels. */
+        void get_batch_params(vx_noise_params_t& params, float frequency) const;
 
 
     // Member functions (in vx_noise.cpp)
     public:
         // Value noise functions
         /* 2D value noise, evaluated at (x, y). */
-        static float value2(float x, float y);
+        float value2(float x, float y) const;
         /* 2D fractional value noise, evaluated at (x, y) (5 octaves default). */
-        static float value2_fbm(float x, float y);
+        float value2_fbm(float x, float y) const;
         /* Rotated 2D fractional value noise, evaluated at p (5 octaves default). */
-        static float value2_fbm_r(const glm::vec2& p);
+        float value2_fbm_r(const glm::vec2& p) const;
         /* 3D value noise, evaluated at (x, y). */
-        static float value3(float x, float y, float z);
+        float value3(float x, float y, float z) const;
         /* 3D fractional value noise, evaluated at (x, y) (5 octaves default). */
-        static float value3_fbm(float x, float y, float z);
+        float value3_fbm(float x, float y, float z) const;
         /* Rotated 3D fractional value noise, evaluated at p (5 octaves default). */
-        static float value3_fbm_r(const glm::vec3& p);
+        float value3_fbm_r(const glm::vec3& p) const;
 
         // Perlin noise functions
         /* 2D Perlin noise, evaluated at (x, y). */
-        static float perlin2(float x, float y);
+        float perlin2(float x, float y) const;
         /* 2D fractional Perlin noise, evaluated at (x, y) (5 octaves default). */
-        static float perlin2_fbm(float x, float y);
+        float perlin2_fbm(float x, float y) const;
         /* 3D Perlin noise, evaluated at (x, y, z). */
-        static float perlin3(float x, float y, float z);
+        float perlin3(float x, float y, float z) const;
         /* 3D fractional Perlin noise, evaluated at (x, y, z) (5 octaves default). */
-        static float perlin3_fbm(float x, float y, float z);
+        float perlin3_fbm(float x, float y, float z) const;
 
 
     // Argument type overloads
     public:
         // Value noise
         /* 2D value noise, evaluated at p. */
-        static float value2(const glm::vec2& p)
+        float value2(const glm::vec2& p) const
         { return value2(p.x, p.y); }
         /* 2D fractional value noise, evaluated at p (5 octaves default). */
-        static float value2_fbm(const glm::vec2& p)
+        float value2_fbm(const glm::vec2& p) const
         { return value2_fbm(p.x, p.y); }
         /* Rotated 2D fractional value noise, evaluated at (x, y) (5 octaves default). */
-        static float value2_fbm_r(float x, float y)
+        float value2_fbm_r(float x, float y) const
         { return value2_fbm_r(glm::vec2(x, y)); }
         /* 3D value noise, evaluated at p. */
-        static float value3(const glm::vec3& p)
+        float value3(const glm::vec3& p) const
         { return value3(p.x, p.y, p.z); }
         /* 3D fractional value noise, evaluated at p (5 octaves default). */
-        static float value3_fbm(const glm::vec3& p)
+        float value3_fbm(const glm::vec3& p) const
         { return value3_fbm(p.x, p.y, p.z); }
         /* Rotated 3D fractional value noise, evaluated at (x, y) (5 octaves default). */
-        static float value3_fbm_r(float x, float y, float z)
+        float value3_fbm_r(float x, float y, float z) const
         { return value3_fbm_r(glm::vec3(x, y, z)); }
 
         // Perlin noise
         /* 2D Perlin noise, evaluated at p. */
-        static float perlin2(const glm::vec2& p)
+        float perlin2(const glm::vec2& p) const
         { return perlin2(p.x, p.y); }
         /* 2D fractional Perlin noise, evaluated at p (5 octaves default). */
-        static float perlin2_fbm(const glm::vec2& p)
+        float perlin2_fbm(const glm::vec2& p) const
         { return perlin2_fbm(p.x, p.y); }
         /* 3D Perlin noise, evaluated at p. */
-        static float perlin3(const glm::vec3& p)
+        float perlin3(const glm::vec3& p) const
         { return perlin3(p.x, p.y, p.z); }
         /* 3D fractional Perlin noise, evaluated at p (5 octaves default). */
-        static float perlin3_fbm(const glm::vec3& p)
+        float perlin3_fbm(const glm::vec3& p) const
         { return perlin3_fbm(p.x, p.y, p.z); }
 
 
+    // Batch evaluation (in vx_noise.cpp)
+    public:
+        /* The fBm functions above, evaluated at count points given as coordinate arrays,
+         * 8 or 16 at a time with AVX2 or AVX-512 (selected at runtime), with a scalar
+         * fallback. Results are bit-exact with the scalar functions, as long as neither
+         * is compiled with floating-point contraction (e.g. -ffast-math).
+         */
+        void value2_fbm(const float* x, const float* y, float* out, uint32_t count) const;
+        void value2_fbm_r(const float* x, const float* y, float* out, uint32_t count) const;
+        void value3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count) const;
+        void value3_fbm_r(const float* x, const float* y, const float* z, float* out, uint32_t count) const;
+        void perlin2_fbm(const float* x, const float* y, float* out, uint32_t count) const;
+        void perlin3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count) const;
+
+        /* A batch function evaluated over a regular grid, at (x0 + i * dx, y0 + j * dy),
+         * written row-major (x fastest) to out. */
+        void eval_grid2(void (VxNoiseContext::*batch)(const float*, const float*, float*, uint32_t) const,
+                        float x0, float y0, float dx, float dy,
+                        uint32_t nx, uint32_t ny, float* out) const;
+        /* As above, at (x0 + i * dx, y0 + j * dy, z0 + k * dz), x fastest, then y. */
+        void eval_grid3(void (VxNoiseContext::*batch)(const float*, const float*, const float*, float*, uint32_t) const,
+                        float x0, float y0, float z0, float dx, float dy, float dz,
+                        uint32_t nx, uint32_t ny, uint32_t nz, float* out) const;
+
+
+    // Member variables
+    private:
+        static const uint32_t s_r_sz = 256;
+        static const uint32_t s_r_mask = s_r_sz - 1;
+        static const glm::mat2 s_mrot2;
+        static const glm::mat3 s_mrot3;
+
+        uint32_t m_seed;
+        VxNoiseParams m_params;
+
+        // Perlin noise permutation
+        uint32_t m_p_p[512];
+
+        // Value noise lattice values and permutation
+        float m_r[s_r_sz];
+        uint32_t m_p[2 * s_r_sz];
+
+    };
+
+
+    /* Static noise API, evaluating a process wide default context. Setting the seed
+     * (init()) or a parameter publishes a new default context; calls already running on
+     * other threads finish on the one they started with, which is freed once the last of
+     * them returns. Loops evaluating many points should hold on to context() (one atomic
+     * load instead of one per call); threads that need their own seed or parameters
+     * should own a VxNoiseContext instead.
+     */
+    class VxNoise
+    {
+    // Accessors
+    public:
+        /* default = 5 */
+        static void set_octave_count(uint8_t o)     { set_params([o](VxNoiseParams& p)   { p.octave_count     = o;  }); }
+        /* default = 1.0f */
+        static void set_frequency_perlin(float f)   { set_params([f](VxNoiseParams& p)   { p.frequency_perlin = f;  }); }
+        /* default = 5.0f */
+        static void set_frequency_value(float f)    { set_params([f](VxNoiseParams& p)   { p.frequency_value  = f;  }); }
+        /* default = 2.0f */
+        static void set_d_frequency(float df)       { set_params([df](VxNoiseParams& p)  { p.d_frequency      = df; }); }
+        /* default = 0.5f */
+        static void set_d_amplitude(float da)       { set_params([da](VxNoiseParams& p)  { p.d_amplitude      = da; }); }
+
+        /* The current default context. */
+        static std::shared_ptr<const VxNoiseContext> context()
+        {
+            std::shared_ptr<const VxNoiseContext> context = std::atomic_load(&s_context);
+            return context ? context : initial_context();
+        }
+
+
+    // Member functions
+    public:
+        // Value noise functions
+        /* 2D value noise, evaluated at (x, y). */
+        static float value2(float x, float y)                           { return context()->value2(x, y); }
+        /* 2D fractional value noise, evaluated at (x, y) (5 octaves default). */
+        static float value2_fbm(float x, float y)                       { return context()->value2_fbm(x, y); }
+        /* Rotated 2D fractional value noise, evaluated at p (5 octaves default). */
+        static float value2_fbm_r(const glm::vec2& p)                   { return context()->value2_fbm_r(p); }
+        /* 3D value noise, evaluated at (x, y). */
+        static float value3(float x, float y, float z)                  { return context()->value3(x, y, z); }
+        /* 3D fractional value noise, evaluated at (x, y) (5 octaves default). */
+        static float value3_fbm(float x, float y, float z)              { return context()->value3_fbm(x, y, z); }
+        /* Rotated 3D fractional value noise, evaluated at p (5 octaves default). */
+        static float value3_fbm_r(const glm::vec3& p)                   { return context()->value3_fbm_r(p); }
+
+        // Perlin noise functions
+        /* 2D Perlin noise, evaluated at (x, y). */
+        static float perlin2(float x, float y)                          { return context()->perlin2(x, y); }
+        /* 2D fractional Perlin noise, evaluated at (x, y) (5 octaves default). */
+        static float perlin2_fbm(float x, float y)                      { return context()->perlin2_fbm(x, y); }
+        /* 3D Perlin noise, evaluated at (x, y, z). */
+        static float perlin3(float x, float y, float z)                 { return context()->perlin3(x, y, z); }
+        /* 3D fractional Perlin noise, evaluated at (x, y, z) (5 octaves default). */
+        static float perlin3_fbm(float x, float y, float z)             { return context()->perlin3_fbm(x, y, z); }
+
+
+    // Argument type overloads
+    public:
+        // Value noise
+        /* 2D value noise, evaluated at p. */
+        static float value2(const glm::vec2& p)                         { return context()->value2(p); }
+        /* 2D fractional value noise, evaluated at p (5 octaves default). */
+        static float value2_fbm(const glm::vec2& p)                     { return context()->value2_fbm(p); }
+        /* Rotated 2D fractional value noise, evaluated at (x, y) (5 octaves default). */
+        static float value2_fbm_r(float x, float y)                     { return context()->value2_fbm_r(x, y); }
+        /* 3D value noise, evaluated at p. */
+        static float value3(const glm::vec3& p)                         { return context()->value3(p); }
+        /* 3D fractional value noise, evaluated at p (5 octaves default). */
+        static float value3_fbm(const glm::vec3& p)                     { return context()->value3_fbm(p); }
+        /* Rotated 3D fractional value noise, evaluated at (x, y) (5 octaves default). */
+        static float value3_fbm_r(float x, float y, float z)            { return context()->value3_fbm_r(x, y, z); }
+
+        // Perlin noise
+        /* 2D Perlin noise, evaluated at p. */
+        static float perlin2(const glm::vec2& p)                        { return context()->perlin2(p); }
+        /* 2D fractional Perlin noise, evaluated at p (5 octaves default). */
+        static float perlin2_fbm(const glm::vec2& p)                    { return context()->perlin2_fbm(p); }
+        /* 3D Perlin noise, evaluated at p. */
+        static float perlin3(const glm::vec3& p)                        { return context()->perlin3(p); }
+        /* 3D fractional Perlin noise, evaluated at p (5 octaves default). */
+        static float perlin3_fbm(const glm::vec3& p)                    { return context()->perlin3_fbm(p); }
+
+
+    // Batch evaluation, see VxNoiseContext
+    public:
+        static void value2_fbm(const float* x, const float* y, float* out, uint32_t count)
+        { context()->value2_fbm(x, y, out, count); }
+        static void value2_fbm_r(const float* x, const float* y, float* out, uint32_t count)
+        { context()->value2_fbm_r(x, y, out, count); }
+        static void value3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count)
+        { context()->value3_fbm(x, y, z, out, count); }
+        static void value3_fbm_r(const float* x, const float* y, const float* z, float* out, uint32_t count)
+        { context()->value3_fbm_r(x, y, z, out, count); }
+        static void perlin2_fbm(const float* x, const float* y, float* out, uint32_t count)
+        { context()->perlin2_fbm(x, y, out, count); }
+        static void perlin3_fbm(const float* x, const float* y, const float* z, float* out, uint32_t count)
+        { context()->perlin3_fbm(x, y, z, out, count); }
+
+        /* A batch function evaluated over a regular grid, at (x0 + i * dx, y0 + j * dy),
+         * written row-major (x fastest) to out. */
+        static void eval_grid2(void (*batch)(const float*, const float*, float*, uint32_t),
+                               float x0, float y0, float dx, float dy,
+                               uint32_t nx, uint32_t ny, float* out);
+        /* As above, at (x0 + i * dx, y0 + j * dy, z0 + k * dz), x fastest, then y. */
+        static void eval_grid3(void (*batch)(const float*, const float*, const float*, float*, uint32_t),
+                               float x0, float y0, float z0, float dx, float dy, float dz,
+                               uint32_t nx, uint32_t ny, uint32_t nz, float* out);
+
+        /* Instruction set used by the batch functions ("AVX-512", "AVX2" or "scalar"). */
+        static const char* simd_path();
+
+
     // Initializer
     public:
-        /* Initializer : must be called before use. */
-        static void init(uint32_t seed=211117);
+        /* Initializer : seeds the default context (keeping its parameters). */
+        static void init(uint32_t seed=VxNoiseContext::s_default_seed);
 
 
     // Utility function(s)
     public:
         /* Save noise as png image. */
-        static void save_noise_PNG(const std::string& _file_name, 
-                                   uint32_t _width, 
-                                   uint32_t _height, 
+        static void save_noise_PNG(const std::string& _file_name,
+                                   uint32_t _width,
+                                   uint32_t _height,
                                    float* _data);
 
+
+    // Private functions
+    private:
+        static const std::shared_ptr<const VxNoiseContext>& initial_context();
+        static void set_params(const std::function<void(VxNoiseParams&)>& _modify);
+
+    // Member variables
+    private:
+        // accessed through std::atomic_load/atomic_store only
+        inline static std::shared_ptr<const VxNoiseContext> s_context;
+        inline static std::mutex s_mutex;
+
     };
 
 
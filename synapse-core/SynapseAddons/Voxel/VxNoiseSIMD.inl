@@ -0,0 +1,313 @@
+// Batch kernels of VxNoise, included once per instruction set by VxNoise.cpp, inside a
+// namespace defining the lane types and operations (vf, vi, vm, W, set1(), gather_f()
+// etc). Every kernel mirrors the operation order of its scalar counterpart, so that the
+// results are bit-exact. Kernels process whole batches of W points and return the
+// number of points processed; the remainder is left to the scalar path.
+
+
+//---------------------------------------------------------------------------------------
+// fast_floor(), including its x <= 0 behaviour
+static inline vi fast_floor(vf x)
+{
+    vi i = cvtt(x);
+    return select_i(gt_f(x, set1(0.0f)), i, sub_i(i, set1_i(1)));
+}
+//---------------------------------------------------------------------------------------
+static inline vf cubic_step(vf t)
+{
+    return mul(mul(t, t), sub(set1(3.0f), mul(set1(2.0f), t)));
+}
+//---------------------------------------------------------------------------------------
+static inline vf quintic_step(vf t)
+{
+    return mul(mul(mul(t, t), t), add(mul(t, sub(mul(t, set1(6.0f)), set1(15.0f))), set1(10.0f)));
+}
+//---------------------------------------------------------------------------------------
+static inline vf lerp(vf a, vf b, vf t)
+{
+    return add(a, mul(t, sub(b, a)));
+}
+//---------------------------------------------------------------------------------------
+// Negates the lanes of x where (h & _bit) is set.
+static inline vf negate_if(vi h, int _bit, int _shift, vf x)
+{
+    return xor_f(x, shl_i(and_i(h, set1_i(_bit)), _shift));
+}
+//---------------------------------------------------------------------------------------
+static inline vf grad2(vi h, vf x, vf y)
+{
+    return add(negate_if(h, 1, 31, x), negate_if(h, 2, 30, y));
+}
+//---------------------------------------------------------------------------------------
+// The 16 cases of VxNoise::grad3() are (+-a) + (+-b), the signs given by bits 0 and 1.
+static inline vf grad3(vi hash, vf x, vf y, vf z)
+{
+    vi h = and_i(hash, set1_i(0xf));
+    vf a = select_f(lt_i(h, set1_i(8)), x, y);
+    vm bx = or_m(eq_i(h, set1_i(12)), eq_i(h, set1_i(14)));
+    vf b = select_f(lt_i(h, set1_i(4)), y, select_f(bx, x, z));
+    return add(negate_if(h, 1, 31, a), negate_if(h, 2, 30, b));
+}
+//---------------------------------------------------------------------------------------
+static inline vf value2(const vx_noise_params_t& _p, vf x, vf y)
+{
+    vi mask = set1_i((int)_p.r_mask);
+    vi xi = fast_floor(x);
+    vi yi = fast_floor(y);
+
+    vf xf = sub(x, cvt(xi));
+    vf yf = sub(y, cvt(yi));
+
+    vi rx0 = and_i(xi, mask);
+    vi ry0 = and_i(yi, mask);
+    vi rx1 = and_i(add_i(rx0, set1_i(1)), mask);
+    vi ry1 = and_i(add_i(ry0, set1_i(1)), mask);
+
+    vi px0 = gather_i(_p.p, rx0);
+    vi px1 = gather_i(_p.p, rx1);
+    vf c00 = gather_f(_p.r, gather_i(_p.p, add_i(px0, ry0)));
+    vf c10 = gather_f(_p.r, gather_i(_p.p, add_i(px1, ry0)));
+    vf c01 = gather_f(_p.r, gather_i(_p.p, add_i(px0, ry1)));
+    vf c11 = gather_f(_p.r, gather_i(_p.p, add_i(px1, ry1)));
+
+    vf sx = cubic_step(xf);
+    vf sy = cubic_step(yf);
+
+    return lerp(lerp(c00, c10, sx), lerp(c01, c11, sx), sy);
+}
+//---------------------------------------------------------------------------------------
+static inline vf value3(const vx_noise_params_t& _p, vf x, vf y, vf z)
+{
+    vi mask = set1_i((int)_p.r_mask);
+    vi xi = fast_floor(x);
+    vi yi = fast_floor(y);
+    vi zi = fast_floor(z);
+
+    vf xf = sub(x, cvt(xi));
+    vf yf = sub(y, cvt(yi));
+    vf zf = sub(z, cvt(zi));
+
+    vi rx0 = and_i(xi, mask);
+    vi ry0 = and_i(yi, mask);
+    vi rz0 = and_i(zi, mask);
+    vi rx1 = and_i(add_i(rx0, set1_i(1)), mask);
+    vi ry1 = and_i(add_i(ry0, set1_i(1)), mask);
+    vi rz1 = and_i(add_i(rz0, set1_i(1)), mask);
+
+    vi px0 = gather_i(_p.p, rx0);
+    vi px1 = gather_i(_p.p, rx1);
+    vi p00 = gather_i(_p.p, add_i(px0, ry0));
+    vi p10 = gather_i(_p.p, add_i(px1, ry0));
+    vi p01 = gather_i(_p.p, add_i(px0, ry1));
+    vi p11 = gather_i(_p.p, add_i(px1, ry1));
+    vf c000 = gather_f(_p.r, gather_i(_p.p, add_i(p00, rz0)));
+    vf c100 = gather_f(_p.r, gather_i(_p.p, add_i(p10, rz0)));
+    vf c010 = gather_f(_p.r, gather_i(_p.p, add_i(p01, rz0)));
+    vf c110 = gather_f(_p.r, gather_i(_p.p, add_i(p11, rz0)));
+    vf c001 = gather_f(_p.r, gather_i(_p.p, add_i(p00, rz1)));
+    vf c101 = gather_f(_p.r, gather_i(_p.p, add_i(p10, rz1)));
+    vf c011 = gather_f(_p.r, gather_i(_p.p, add_i(p01, rz1)));
+    vf c111 = gather_f(_p.r, gather_i(_p.p, add_i(p11, rz1)));
+
+    vf u = cubic_step(xf);
+    vf v = cubic_step(yf);
+    vf w = cubic_step(zf);
+
+    vf y1 = lerp(lerp(c000, c100, u), lerp(c010, c110, u), v);
+    vf y2 = lerp(lerp(c001, c101, u), lerp(c011, c111, u), v);
+    return lerp(y1, y2, w);
+}
+//---------------------------------------------------------------------------------------
+static inline vf perlin2(const vx_noise_params_t& _p, vf x, vf y)
+{
+    vi mask = set1_i(255);
+    vi one = set1_i(1);
+    vi xt = cvtt(x);
+    vi yt = cvtt(y);
+    vi xi = and_i(xt, mask);
+    vi yi = and_i(yt, mask);
+
+    vf xf = sub(x, cvt(xt));
+    vf yf = sub(y, cvt(yt));
+
+    vf u = quintic_step(xf);
+    vf v = quintic_step(yf);
+
+    vi px0 = gather_i(_p.p_p, xi);
+    vi px1 = gather_i(_p.p_p, add_i(one, xi));
+    vi g00 = gather_i(_p.p_p, add_i(px0, yi));
+    vi g10 = gather_i(_p.p_p, add_i(px1, yi));
+    vi g01 = gather_i(_p.p_p, add_i(add_i(px0, one), yi));
+    vi g11 = gather_i(_p.p_p, add_i(add_i(px1, one), yi));
+
+    vf xf1 = sub(xf, set1(1.0f));
+    vf yf1 = sub(yf, set1(1.0f));
+    vf x1 = lerp(grad2(g00, xf, yf ), grad2(g10, xf1, yf ), u);
+    vf x2 = lerp(grad2(g01, xf, yf1), grad2(g11, xf1, yf1), u);
+
+    return mul(add(lerp(x1, x2, v), set1(1.0f)), set1(0.5f));
+}
+//---------------------------------------------------------------------------------------
+static inline vf perlin3(const vx_noise_params_t& _p, vf x, vf y, vf z)
+{
+    vi mask = set1_i(255);
+    vi one = set1_i(1);
+    vi xt = cvtt(x);
+    vi yt = cvtt(y);
+    vi zt = cvtt(z);
+    vi xi = and_i(xt, mask);
+    vi yi = and_i(yt, mask);
+    vi zi = and_i(zt, mask);
+
+    vf xf = sub(x, cvt(xt));
+    vf yf = sub(y, cvt(yt));
+    vf zf = sub(z, cvt(zt));
+
+    vf u = quintic_step(xf);
+    vf v = quintic_step(yf);
+    vf w = quintic_step(zf);
+
+    // s_p_p[s_p_p[s_p_p[x] + y] + z], with 1 added to the offsets as in the scalar code
+    vi px0 = gather_i(_p.p_p, xi);
+    vi px1 = gather_i(_p.p_p, add_i(one, xi));
+    vi p00 = gather_i(_p.p_p, add_i(px0, yi));
+    vi p01 = gather_i(_p.p_p, add_i(add_i(px0, one), yi));
+    vi p10 = gather_i(_p.p_p, add_i(px1, yi));
+    vi p11 = gather_i(_p.p_p, add_i(add_i(px1, one), yi));
+    vi g000 = gather_i(_p.p_p, add_i(p00, zi));
+    vi g010 = gather_i(_p.p_p, add_i(p01, zi));
+    vi g001 = gather_i(_p.p_p, add_i(add_i(p00, one), zi));
+    vi g011 = gather_i(_p.p_p, add_i(add_i(p01, one), zi));
+    vi g100 = gather_i(_p.p_p, add_i(p10, zi));
+    vi g110 = gather_i(_p.p_p, add_i(p11, zi));
+    vi g101 = gather_i(_p.p_p, add_i(add_i(p10, one), zi));
+    vi g111 = gather_i(_p.p_p, add_i(add_i(p11, one), zi));
+
+    vf xf1 = sub(xf, set1(1.0f));
+    vf yf1 = sub(yf, set1(1.0f));
+    vf zf1 = sub(zf, set1(1.0f));
+    vf x1, x2, y1, y2;
+    x1 = lerp(grad3(g000, xf, yf , zf ), grad3(g100, xf1, yf , zf ), u);
+    x2 = lerp(grad3(g010, xf, yf1, zf ), grad3(g110, xf1, yf1, zf ), u);
+    y1 = lerp(x1, x2, v);
+    x1 = lerp(grad3(g001, xf, yf , zf1), grad3(g101, xf1, yf , zf1), u);
+    x2 = lerp(grad3(g011, xf, yf1, zf1), grad3(g111, xf1, yf1, zf1), u);
+    y2 = lerp(x1, x2, v);
+
+    return mul(add(lerp(y1, y2, w), set1(1.0f)), set1(0.5f));
+}
+
+
+//---------------------------------------------------------------------------------------
+static uint32_t value2_fbm(const vx_noise_params_t& _p, const float* _x, const float* _y, float* _out, uint32_t _count, bool _rotate)
+{
+    const float* m = _p.rot2;
+    uint32_t i = 0;
+    for (; i + W <= _count; i += W)
+    {
+        vf x = loadu(_x + i);
+        vf y = loadu(_y + i);
+        vf n = set1(0.0f);
+        float f = _p.frequency;
+        float a = 1.0f;
+        float t = 0.0f;
+        for (uint32_t o = 0; o < _p.octaves; o++)
+        {
+            n = add(n, mul(set1(a), value2(_p, mul(x, set1(f)), mul(y, set1(f)))));
+            if (_rotate)
+            {
+                vf rx = add(mul(set1(m[0]), x), mul(set1(m[2]), y));
+                vf ry = add(mul(set1(m[1]), x), mul(set1(m[3]), y));
+                x = rx;
+                y = ry;
+            }
+            t += a;
+            a *= _p.d_amplitude;
+            f *= _p.d_frequency;
+        }
+        storeu(_out + i, div(n, set1(t)));
+    }
+    return i;
+}
+//---------------------------------------------------------------------------------------
+static uint32_t value3_fbm(const vx_noise_params_t& _p, const float* _x, const float* _y, const float* _z, float* _out, uint32_t _count, bool _rotate)
+{
+    const float* m = _p.rot3;
+    uint32_t i = 0;
+    for (; i + W <= _count; i += W)
+    {
+        vf x = loadu(_x + i);
+        vf y = loadu(_y + i);
+        vf z = loadu(_z + i);
+        vf n = set1(0.0f);
+        float f = _p.frequency;
+        float a = 1.0f;
+        float t = 0.0f;
+        for (uint32_t o = 0; o < _p.octaves; o++)
+        {
+            n = add(n, mul(set1(a), value3(_p, mul(x, set1(f)), mul(y, set1(f)), mul(z, set1(f)))));
+            if (_rotate)
+            {
+                vf rx = add(add(mul(set1(m[0]), x), mul(set1(m[3]), y)), mul(set1(m[6]), z));
+                vf ry = add(add(mul(set1(m[1]), x), mul(set1(m[4]), y)), mul(set1(m[7]), z));
+                vf rz = add(add(mul(set1(m[2]), x), mul(set1(m[5]), y)), mul(set1(m[8]), z));
+                x = rx;
+                y = ry;
+                z = rz;
+            }
+            t += a;
+            a *= _p.d_amplitude;
+            f *= _p.d_frequency;
+        }
+        storeu(_out + i, div(n, set1(t)));
+    }
+    return i;
+}
+//---------------------------------------------------------------------------------------
+static uint32_t perlin2_fbm(const vx_noise_params_t& _p, const float* _x, const float* _y, float* _out, uint32_t _count)
+{
+    uint32_t i = 0;
+    for (; i + W <= _count; i += W)
+    {
+        vf x = loadu(_x + i);
+        vf y = loadu(_y + i);
+        vf n = set1(0.0f);
+        float f = _p.frequency;
+        float a = 1.0f;
+        float t = 0.0f;
+        for (uint32_t o = 0; o < _p.octaves; o++)
+        {
+            n = add(n, mul(set1(a), perlin2(_p, mul(x, set1(f)), mul(y, set1(f)))));
+            t += a;
+            a *= _p.d_amplitude;
+            f *= _p.d_frequency;
+        }
+        storeu(_out + i, div(n, set1(t)));
+    }
+    return i;
+}
+//---------------------------------------------------------------------------------------
+static uint32_t perlin3_fbm(const vx_noise_params_t& _p, const float* _x, const float* _y, const float* _z, float* _out, uint32_t _count)
+{
+    uint32_t i = 0;
+    for (; i + W <= _count; i += W)
+    {
+        vf x = loadu(_x + i);
+        vf y = loadu(_y + i);
+        vf z = loadu(_z + i);
+        vf n = set1(0.0f);
+        float f = _p.frequency;
+        float a = 1.0f;
+        float t = 0.0f;
+        for (uint32_t o = 0; o < _p.octaves; o++)
+        {
+            n = add(n, mul(set1(a), perlin3(_p, mul(x, set1(f)), mul(y, set1(f)), mul(z, set1(f)))));
+            t += a;
+            a *= _p.d_amplitude;
+            f *= _p.d_frequency;
+        }
+        storeu(_out + i, div(n, set1(t)));
+    }
+    return i;
+}
+
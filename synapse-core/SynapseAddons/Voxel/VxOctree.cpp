@@ -0,0 +1,504 @@
+#include "../../pch.hpp"
+
+#include "VxOctree.hpp"
+#include "../../SynapseCore/Utils/MathUtils.hpp"
+
+
+namespace Syn
+{
+    static_assert(VX_CHUNK_SIZE_XZ == VX_CHUNK_SIZE_Y, "VxOctree requires cubic chunks.");
+
+    //-----------------------------------------------------------------------------------
+    VxOctree::VxOctree(uint32_t _depth)
+    {
+        // 2^(depth-1) chunks either side of the origin, keeping the extent within an int
+        m_depth = max(1u, min(_depth, 20u));
+        m_extent = VX_CHUNK_SIZE_XZ << (m_depth - 1);
+
+        m_nodes.push_back({ NO_CHILDREN, NO_BRICK, 0 });
+    }
+
+    //-----------------------------------------------------------------------------------
+    Voxel VxOctree::get(const glm::ivec3& _p) const
+    {
+        if (!contains(_p))
+            return Voxel();
+
+        region_t region = lookup(_p);
+        const node_t& node = m_nodes[region.node];
+        if (node.brick == NO_BRICK)
+            return Voxel(node.value);
+
+        glm::ivec3 local = _p - region.min;
+        return m_bricks[node.brick].get(local.x, local.y, local.z);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::set(const glm::ivec3& _p, const Voxel& _voxel)
+    {
+        if (!contains(_p))
+            return;
+
+        // descend to the chunk, splitting uniform nodes of another value
+        uint32_t node = 0;
+        glm::ivec3 min = glm::ivec3(-m_extent);
+        int size = 2 * m_extent;
+        for (uint32_t level = 0; level < m_depth; level++)
+        {
+            if (m_nodes[node].children == NO_CHILDREN)
+            {
+                if (m_nodes[node].value == _voxel.data)
+                    return;
+                split(node);
+            }
+
+            size >>= 1;
+            uint32_t child = 0;
+            if (_p.x >= min.x + size) { child |= 1; min.x += size; }
+            if (_p.y >= min.y + size) { child |= 2; min.y += size; }
+            if (_p.z >= min.z + size) { child |= 4; min.z += size; }
+            node = m_nodes[node].children + child;
+        }
+
+        if (m_nodes[node].brick == NO_BRICK)
+        {
+            if (m_nodes[node].value == _voxel.data)
+                return;
+            uint32_t brick = allocateBrick();
+            m_bricks[brick].fill(Voxel(m_nodes[node].value));
+            m_nodes[node].brick = brick;
+        }
+
+        glm::ivec3 local = _p - min;
+        m_bricks[m_nodes[node].brick].set(local.x, local.y, local.z, _voxel);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::fill(const glm::ivec3& _min, const glm::ivec3& _max, const Voxel& _voxel)
+    {
+        glm::ivec3 min = glm::max(_min, glm::ivec3(-m_extent));
+        glm::ivec3 max = glm::min(_max, glm::ivec3(m_extent));
+        if (min.x >= max.x || min.y >= max.y || min.z >= max.z)
+            return;
+
+        fillRecursive(0, glm::ivec3(-m_extent), 2 * m_extent, min, max, _voxel.data);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::setChunk(const glm::ivec3& _chunk, const VxChunkStorage& _storage)
+    {
+        if (!contains(_chunk * VX_CHUNK_SIZE_XZ))
+            return;
+
+        uint32_t path[32];
+        uint32_t node = acquireChunkNode(_chunk, path);
+
+        uint32_t brick = m_nodes[node].brick;
+        if (brick == NO_BRICK)
+            brick = allocateBrick();
+        m_bricks[brick].compress(_storage);
+
+        if (m_bricks[brick].getPaletteSize() == 1)
+        {
+            m_nodes[node].value = m_bricks[brick].get(0).data;
+            m_nodes[node].brick = NO_BRICK;
+            m_bricks[brick].fill(Voxel());
+            m_freeBricks.push_back(brick);
+            collapseUp(path, m_depth - 1);
+        }
+        else
+            m_nodes[node].brick = brick;
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxOctree::extractChunk(const glm::ivec3& _chunk, VxChunkStorage& _storage) const
+    {
+        glm::ivec3 p = _chunk * VX_CHUNK_SIZE_XZ;
+        if (!contains(p))
+        {
+            _storage.fill(Voxel());
+            return false;
+        }
+
+        const node_t& node = m_nodes[lookup(p).node];
+        if (node.brick != NO_BRICK)
+        {
+            m_bricks[node.brick].decompress(_storage);
+            return true;
+        }
+
+        _storage.fill(Voxel(node.value));
+        return VX_DATA_GET_TYPE(node.value) != 0;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::collapse()
+    {
+        collapseRecursive(0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxOctree::raycast(const glm::vec3& _origin, const glm::vec3& _direction, float _max_distance, VxRayHit& _hit) const
+    {
+        float length = glm::length(_direction);
+        if (length == 0.0f)
+            return false;
+        glm::vec3 d = _direction / length;
+
+        // 1/d, with axes parallel to the ray never crossed
+        static const float INF = std::numeric_limits<float>::max();
+        glm::vec3 inv;
+        glm::ivec3 step;
+        for (int a = 0; a < 3; a++)
+        {
+            inv[a] = d[a] != 0.0f ? 1.0f / d[a] : INF;
+            step[a] = d[a] > 0.0f ? 1 : -1;
+        }
+
+        // clip the ray to the world
+        float t = 0.0f;
+        float tEnd = _max_distance;
+        int entryAxis = -1;
+        float extent = (float)m_extent;
+        for (int a = 0; a < 3; a++)
+        {
+            if (d[a] == 0.0f)
+            {
+                if (_origin[a] < -extent || _origin[a] >= extent)
+                    return false;
+                continue;
+            }
+            float t0 = (-extent - _origin[a]) * inv[a];
+            float t1 = (extent - _origin[a]) * inv[a];
+            if (t0 > t1)
+                std::swap(t0, t1);
+            if (t0 > t)
+            {
+                t = t0;
+                entryAxis = a;
+            }
+            tEnd = min(tEnd, t1);
+        }
+        if (t > tEnd)
+            return false;
+
+        glm::ivec3 normal = glm::ivec3(0);
+        glm::ivec3 voxel = glm::clamp(glm::ivec3(glm::floor(_origin + d * t)), glm::ivec3(-m_extent), glm::ivec3(m_extent - 1));
+        if (entryAxis >= 0)
+        {
+            normal[entryAxis] = -step[entryAxis];
+            voxel[entryAxis] = step[entryAxis] > 0 ? -m_extent : m_extent - 1;
+        }
+
+        while (true)
+        {
+            region_t region = lookup(voxel);
+            const node_t& node = m_nodes[region.node];
+
+            if (node.brick == NO_BRICK)
+            {
+                if (VX_DATA_GET_TYPE(node.value) != 0)
+                {
+                    _hit = { voxel, normal, t, Voxel(node.value) };
+                    return true;
+                }
+
+                // skip the whole uniform region, leaving it through the nearest face
+                int axis = 0;
+                float tExit = INF;
+                for (int a = 0; a < 3; a++)
+                {
+                    if (d[a] == 0.0f)
+                        continue;
+                    int bound = region.min[a] + (step[a] > 0 ? region.size : 0);
+                    float ta = ((float)bound - _origin[a]) * inv[a];
+                    if (ta < tExit)
+                    {
+                        tExit = ta;
+                        axis = a;
+                    }
+                }
+                if (tExit > tEnd)
+                    return false;
+
+                t = max(t, tExit);
+                glm::vec3 p = _origin + d * t;
+                for (int a = 0; a < 3; a++)
+                    voxel[a] = clamp((int)floorf(p[a]), region.min[a], region.min[a] + region.size - 1);
+                voxel[axis] = step[axis] > 0 ? region.min[axis] + region.size : region.min[axis] - 1;
+                normal = glm::ivec3(0);
+                normal[axis] = -step[axis];
+            }
+            else
+            {
+                // voxel by voxel through the brick
+                const VxPaletteChunk& brick = m_bricks[node.brick];
+                glm::ivec3 local = voxel - region.min;
+                glm::vec3 tMax, tDelta;
+                for (int a = 0; a < 3; a++)
+                {
+                    tMax[a] = d[a] != 0.0f ? ((float)(voxel[a] + (step[a] > 0)) - _origin[a]) * inv[a] : INF;
+                    tDelta[a] = d[a] != 0.0f ? fabsf(inv[a]) : INF;
+                }
+
+                while (true)
+                {
+                    Voxel v = brick.get(local.x, local.y, local.z);
+                    if (VX_DATA_GET_TYPE(v.data) != 0)
+                    {
+                        _hit = { region.min + local, normal, t, v };
+                        return true;
+                    }
+
+                    int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+                    if (tMax[axis] > tEnd)
+                        return false;
+                    t = max(t, tMax[axis]);
+                    tMax[axis] += tDelta[axis];
+                    local[axis] += step[axis];
+                    normal = glm::ivec3(0);
+                    normal[axis] = -step[axis];
+
+                    if (local[axis] < 0 || local[axis] >= VX_CHUNK_SIZE_XZ)
+                        break;
+                }
+                voxel = region.min + local;
+            }
+
+            if (!contains(voxel))
+                return false;
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxOctree::lineOfSight(const glm::vec3& _from, const glm::vec3& _to) const
+    {
+        VxRayHit hit;
+        return !raycast(_from, _to - _from, glm::length(_to - _from), hit);
+    }
+
+    //-----------------------------------------------------------------------------------
+    size_t VxOctree::memoryUsage() const
+    {
+        size_t bytes = sizeof(VxOctree) +
+                       m_nodes.capacity() * sizeof(node_t) +
+                       m_freeNodeBlocks.capacity() * sizeof(uint32_t) +
+                       m_freeBricks.capacity() * sizeof(uint32_t) +
+                       (m_bricks.capacity() - m_bricks.size()) * sizeof(VxPaletteChunk);
+        for (const auto& brick : m_bricks)
+            bytes += brick.memoryUsage();
+        return bytes;
+    }
+
+    //-----------------------------------------------------------------------------------
+    VxOctree::region_t VxOctree::lookup(const glm::ivec3& _p) const
+    {
+        region_t region = { 0, glm::ivec3(-m_extent), 2 * m_extent };
+        while (m_nodes[region.node].children != NO_CHILDREN)
+        {
+            region.size >>= 1;
+            uint32_t child = 0;
+            if (_p.x >= region.min.x + region.size) { child |= 1; region.min.x += region.size; }
+            if (_p.y >= region.min.y + region.size) { child |= 2; region.min.y += region.size; }
+            if (_p.z >= region.min.z + region.size) { child |= 4; region.min.z += region.size; }
+            region.node = m_nodes[region.node].children + child;
+        }
+        return region;
+    }
+
+    //-----------------------------------------------------------------------------------
+    uint32_t VxOctree::acquireChunkNode(const glm::ivec3& _chunk, uint32_t* _path)
+    {
+        glm::ivec3 p = _chunk * VX_CHUNK_SIZE_XZ;
+        uint32_t node = 0;
+        glm::ivec3 min = glm::ivec3(-m_extent);
+        int size = 2 * m_extent;
+        for (uint32_t level = 0; level < m_depth; level++)
+        {
+            _path[level] = node;
+            if (m_nodes[node].children == NO_CHILDREN)
+                split(node);
+
+            size >>= 1;
+            uint32_t child = 0;
+            if (p.x >= min.x + size) { child |= 1; min.x += size; }
+            if (p.y >= min.y + size) { child |= 2; min.y += size; }
+            if (p.z >= min.z + size) { child |= 4; min.z += size; }
+            node = m_nodes[node].children + child;
+        }
+        _path[m_depth] = node;
+        return node;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::split(uint32_t _node)
+    {
+        uint32_t children;
+        if (!m_freeNodeBlocks.empty())
+        {
+            children = m_freeNodeBlocks.back();
+            m_freeNodeBlocks.pop_back();
+        }
+        else
+        {
+            children = (uint32_t)m_nodes.size();
+            m_nodes.resize(m_nodes.size() + 8);
+        }
+
+        // children inherit the uniform value
+        uint32_t value = m_nodes[_node].value;
+        for (uint32_t i = 0; i < 8; i++)
+            m_nodes[children + i] = { NO_CHILDREN, NO_BRICK, value };
+        m_nodes[_node].children = children;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::release(uint32_t _node)
+    {
+        uint32_t children = m_nodes[_node].children;
+        if (children != NO_CHILDREN)
+        {
+            for (uint32_t i = 0; i < 8; i++)
+                release(children + i);
+            m_freeNodeBlocks.push_back(children);
+            m_nodes[_node].children = NO_CHILDREN;
+        }
+
+        uint32_t brick = m_nodes[_node].brick;
+        if (brick != NO_BRICK)
+        {
+            m_bricks[brick].fill(Voxel());
+            m_freeBricks.push_back(brick);
+            m_nodes[_node].brick = NO_BRICK;
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxOctree::tryCollapse(uint32_t _node)
+    {
+        uint32_t children = m_nodes[_node].children;
+        if (children == NO_CHILDREN)
+            return m_nodes[_node].brick == NO_BRICK;
+
+        uint32_t value = m_nodes[children].value;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            const node_t& child = m_nodes[children + i];
+            if (child.children != NO_CHILDREN || child.brick != NO_BRICK || child.value != value)
+                return false;
+        }
+
+        m_freeNodeBlocks.push_back(children);
+        m_nodes[_node].children = NO_CHILDREN;
+        m_nodes[_node].value = value;
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::collapseUp(const uint32_t* _path, uint32_t _level)
+    {
+        for (int level = (int)_level; level >= 0; level--)
+            if (!tryCollapse(_path[level]))
+                return;
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxOctree::collapseRecursive(uint32_t _node)
+    {
+        uint32_t children = m_nodes[_node].children;
+        if (children == NO_CHILDREN)
+        {
+            uint32_t brick = m_nodes[_node].brick;
+            if (brick == NO_BRICK)
+                return true;
+
+            m_bricks[brick].compact();
+            if (m_bricks[brick].getPaletteSize() > 1)
+                return false;
+
+            m_nodes[_node].value = m_bricks[brick].get(0).data;
+            m_nodes[_node].brick = NO_BRICK;
+            m_bricks[brick].fill(Voxel());
+            m_freeBricks.push_back(brick);
+            return true;
+        }
+
+        bool uniform = true;
+        for (uint32_t i = 0; i < 8; i++)
+            uniform &= collapseRecursive(children + i);
+
+        return uniform && tryCollapse(_node);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxOctree::fillRecursive(uint32_t _node, const glm::ivec3& _node_min, int _size, const glm::ivec3& _min, const glm::ivec3& _max, uint32_t _value)
+    {
+        glm::ivec3 nodeMax = _node_min + _size;
+        for (int a = 0; a < 3; a++)
+            if (_node_min[a] >= _max[a] || nodeMax[a] <= _min[a])
+                return;
+
+        // covered nodes become uniform
+        if (_node_min.x >= _min.x && _node_min.y >= _min.y && _node_min.z >= _min.z &&
+            nodeMax.x <= _max.x && nodeMax.y <= _max.y && nodeMax.z <= _max.z)
+        {
+            release(_node);
+            m_nodes[_node].value = _value;
+            return;
+        }
+
+        const node_t& node = m_nodes[_node];
+        if (node.children == NO_CHILDREN && node.brick == NO_BRICK && node.value == _value)
+            return;
+
+        // partially covered chunk
+        if (_size == VX_CHUNK_SIZE_XZ)
+        {
+            uint32_t brick = node.brick;
+            if (brick == NO_BRICK)
+            {
+                brick = allocateBrick();
+                m_bricks[brick].fill(Voxel(m_nodes[_node].value));
+                m_nodes[_node].brick = brick;
+            }
+
+            glm::ivec3 a = glm::max(_min, _node_min) - _node_min;
+            glm::ivec3 b = glm::min(_max, nodeMax) - _node_min;
+            for (int x = a.x; x < b.x; x++)
+                for (int y = a.y; y < b.y; y++)
+                    for (int z = a.z; z < b.z; z++)
+                        m_bricks[brick].set(x, y, z, Voxel(_value));
+            return;
+        }
+
+        if (node.children == NO_CHILDREN)
+            split(_node);
+
+        int half = _size >> 1;
+        uint32_t children = m_nodes[_node].children;
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            glm::ivec3 childMin = _node_min + glm::ivec3(i & 1, (i >> 1) & 1, (i >> 2) & 1) * half;
+            fillRecursive(children + i, childMin, half, _min, _max, _value);
+        }
+
+        tryCollapse(_node);
+    }
+
+    //-----------------------------------------------------------------------------------
+    uint32_t VxOctree::allocateBrick()
+    {
+        if (!m_freeBricks.empty())
+        {
+            uint32_t brick = m_freeBricks.back();
+            m_freeBricks.pop_back();
+            return brick;
+        }
+
+        m_bricks.emplace_back();
+        return (uint32_t)(m_bricks.size() - 1);
+    }
+
+
+}
+
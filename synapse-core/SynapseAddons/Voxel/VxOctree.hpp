@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Types.hpp"
+#include "VxChunkStorage.hpp"
+
+
+namespace Syn
+{
+    //
+    struct VxRayHit
+    {
+        glm::ivec3 voxel = glm::ivec3(0);
+        glm::ivec3 normal = glm::ivec3(0);     // face entered, zero if the ray starts inside
+        float distance = 0.0f;
+        Voxel data;
+    };
+
+
+    /* Sparse voxel world: an octree over chunk sized bricks (a brick map). Nodes of
+     * uniform content, including empty space, are single leaves at any level; only chunks
+     * with mixed content store a brick, palette compressed (VxPaletteChunk).
+     *
+     * The world spans [-extent, extent) voxels along every axis, extent being
+     * VX_CHUNK_SIZE_XZ * 2^(depth-1). Chunk coordinates are voxel coordinates divided by
+     * the chunk size (rounded down), as for the dense chunks, which can be written with
+     * setChunk() and extracted for meshing with extractChunk().
+     *
+     * fill() and setChunk() merge the nodes they make uniform. set() only splits nodes
+     * (and creates bricks) as needed; what becomes uniform through single voxel edits is
+     * merged by collapse().
+     */
+    class VxOctree
+    {
+    public:
+        VxOctree(uint32_t _depth=10);
+        ~VxOctree() {}
+
+        /* Single voxels; outside the world get() returns empty voxels and set() is
+         * ignored. */
+        Voxel get(const glm::ivec3& _p) const;
+        void set(const glm::ivec3& _p, const Voxel& _voxel);
+
+        /* Sets all voxels in [_min, _max), collapsing covered nodes. */
+        void fill(const glm::ivec3& _min, const glm::ivec3& _max, const Voxel& _voxel);
+
+        /* Dense chunk access. extractChunk() returns false if the chunk is empty. */
+        void setChunk(const glm::ivec3& _chunk, const VxChunkStorage& _storage);
+        bool extractChunk(const glm::ivec3& _chunk, VxChunkStorage& _storage) const;
+
+        /* Compacts all bricks and merges uniform nodes bottom-up. */
+        void collapse();
+
+        /* First solid voxel along the ray, within _max_distance. Empty nodes are skipped
+         * as a whole, bricks are traversed voxel by voxel (3D DDA). */
+        bool raycast(const glm::vec3& _origin, const glm::vec3& _direction, float _max_distance, VxRayHit& _hit) const;
+        bool lineOfSight(const glm::vec3& _from, const glm::vec3& _to) const;
+
+        // Accessors
+        inline int getExtent() const { return m_extent; }
+        inline uint32_t getNodeCount() const { return (uint32_t)(m_nodes.size() - 8 * m_freeNodeBlocks.size()); }
+        inline uint32_t getBrickCount() const { return (uint32_t)(m_bricks.size() - m_freeBricks.size()); }
+        /* Nodes and bricks, in bytes. */
+        size_t memoryUsage() const;
+
+
+    private:
+        struct node_t
+        {
+            uint32_t children;      // first of 8 consecutive children, NO_CHILDREN for leaves
+            uint32_t brick;         // leaves at chunk level, NO_BRICK if uniform
+            uint32_t value;         // Voxel::data of uniform leaves
+        };
+        static const uint32_t NO_CHILDREN = 0;  // the root is never a child
+        static const uint32_t NO_BRICK = UINT32_MAX;
+
+        /* Uniform region (or brick) containing a voxel. */
+        struct region_t
+        {
+            uint32_t node;
+            glm::ivec3 min;
+            int size;
+        };
+
+        inline bool contains(const glm::ivec3& _p) const
+        {
+            return _p.x >= -m_extent && _p.y >= -m_extent && _p.z >= -m_extent &&
+                   _p.x < m_extent && _p.y < m_extent && _p.z < m_extent;
+        }
+        region_t lookup(const glm::ivec3& _p) const;
+        /* Node of a chunk, splitting uniform nodes on the way; the path from the root is
+         * written to _path (depth + 1 entries). */
+        uint32_t acquireChunkNode(const glm::ivec3& _chunk, uint32_t* _path);
+        void split(uint32_t _node);
+        void release(uint32_t _node);
+        bool tryCollapse(uint32_t _node);
+        void collapseUp(const uint32_t* _path, uint32_t _level);
+        bool collapseRecursive(uint32_t _node);
+        void fillRecursive(uint32_t _node, const glm::ivec3& _node_min, int _size, const glm::ivec3& _min, const glm::ivec3& _max, uint32_t _value);
+        uint32_t allocateBrick();
+
+    private:
+        std::vector<node_t> m_nodes;
+        std::vector<uint32_t> m_freeNodeBlocks;
+        std::vector<VxPaletteChunk> m_bricks;
+        std::vector<uint32_t> m_freeBricks;
+
+        uint32_t m_depth = 10;
+        int m_extent = 0;
+
+    };
+
+
+}
+
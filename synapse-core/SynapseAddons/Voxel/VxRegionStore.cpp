@@ -0,0 +1,422 @@
+#include "../../pch.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+
+#include "VxRegionStore.hpp"
+#include "VxMesher.hpp"
+
+
+namespace Syn
+{
+    static const char s_regionMagic[4] = { 'S', 'Y', 'N', 'V' };
+    static const uint32_t s_regionVersion = 1;
+    static const uint32_t s_regionEntryCount = VX_REGION_SIZE * VX_REGION_SIZE;
+    // mapped region files kept open
+    static const size_t s_maxOpenRegions = 64;
+    // delay before chunks that failed to write are retried
+    static const std::chrono::milliseconds s_retryDelay(1000);
+
+    //-----------------------------------------------------------------------------------
+    struct vx_region_header_t
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t chunkSizeXZ;
+        uint32_t chunkSizeY;
+        uint32_t regionSize;
+        uint32_t reserved;
+    };
+
+    //-----------------------------------------------------------------------------------
+    struct vx_region_entry_t
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    //-----------------------------------------------------------------------------------
+    static int floor_div(int _x, int _d)
+    {
+        return (_x >= 0 ? _x : _x - _d + 1) / _d;
+    }
+
+    //-----------------------------------------------------------------------------------
+    static uint32_t region_slot(const glm::ivec3& _chunk)
+    {
+        int x = _chunk.x - floor_div(_chunk.x, VX_REGION_SIZE) * VX_REGION_SIZE;
+        int z = _chunk.z - floor_div(_chunk.z, VX_REGION_SIZE) * VX_REGION_SIZE;
+        return (uint32_t)(x * VX_REGION_SIZE + z);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /* Entry table of a mapped region, nullptr if the file is missing or doesn't match
+     * the current format and chunk size. */
+    static const vx_region_entry_t* region_table(const MappedFile& _file)
+    {
+        size_t tableEnd = sizeof(vx_region_header_t) + sizeof(vx_region_entry_t) * s_regionEntryCount;
+        if (!_file.data() || _file.size() < tableEnd)
+            return nullptr;
+
+        vx_region_header_t header;
+        std::memcpy(&header, _file.data(), sizeof(vx_region_header_t));
+        if (std::memcmp(header.magic, s_regionMagic, sizeof(s_regionMagic)) != 0 ||
+            header.version != s_regionVersion ||
+            header.chunkSizeXZ != VX_CHUNK_SIZE_XZ ||
+            header.chunkSizeY != VX_CHUNK_SIZE_Y ||
+            header.regionSize != VX_REGION_SIZE)
+            return nullptr;
+
+        return reinterpret_cast<const vx_region_entry_t*>(_file.data() + sizeof(vx_region_header_t));
+    }
+
+    //-----------------------------------------------------------------------------------
+    static bool region_entry_valid(const MappedFile& _file, const vx_region_entry_t& _entry)
+    {
+        return _entry.size && (size_t)_entry.offset + _entry.size <= _file.size();
+    }
+
+
+    //-----------------------------------------------------------------------------------
+    VxRegionStore::VxRegionStore(const std::string& _directory) :
+        m_directory(_directory)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(m_directory, error);
+        if (error)
+        {
+            SYN_CORE_WARNING("could not create region directory '", m_directory, "'.");
+        }
+
+        m_thread = std::thread(&VxRegionStore::ioThread, this);
+    }
+
+    //-----------------------------------------------------------------------------------
+    VxRegionStore::~VxRegionStore()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_workAvailable.notify_one();
+        m_thread.join();
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxRegionStore::load(const glm::ivec3& _chunk, VxChunkStorage& _storage)
+    {
+        std::shared_ptr<MappedFile> file;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            // chunks not yet written are newer than the file
+            for (const chunk_map_t* map : { &m_queued, &m_writing })
+            {
+                auto it = map->find(_chunk);
+                if (it != map->end())
+                    return decode(it->second.data(), it->second.size(), _storage);
+            }
+
+            file = getRegionFile(getRegion(_chunk));
+        }
+
+        // the mapping stays valid even if the region is replaced meanwhile
+        const vx_region_entry_t* table = region_table(*file);
+        if (!table)
+            return false;
+
+        const vx_region_entry_t& entry = table[region_slot(_chunk)];
+        if (!region_entry_valid(*file, entry))
+            return false;
+
+        return decode(file->data() + entry.offset, entry.size, _storage);
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxRegionStore::save(const glm::ivec3& _chunk, const VxChunkStorage& _storage)
+    {
+        std::vector<uint8_t> payload;
+        encode(_storage, payload);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queued[_chunk] = std::move(payload);
+        }
+        m_workAvailable.notify_one();
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxRegionStore::loadOrGenerate(const glm::ivec3& _chunk, VxChunkStorage& _storage, const VoxelGeneratorFunc& _generator)
+    {
+        if (load(_chunk, _storage))
+            return true;
+
+        _generator(_chunk, _storage);
+        save(_chunk, _storage);
+        return false;
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxRegionStore::flush()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        uint64_t failures = m_writeFailures;
+        m_idle.wait(lock, [&]() { return (m_queued.empty() && m_writing.empty()) || m_writeFailures != failures; });
+        return m_queued.empty() && m_writing.empty();
+    }
+
+    //-----------------------------------------------------------------------------------
+    StreamingChunkManager::GeneratorFunc VxRegionStore::makeChunkGenerator(const VoxelGeneratorFunc& _generator)
+    {
+        return [this, _generator](const glm::ivec3& _chunk_coord, ChunkData& _data)
+        {
+            VxChunkStorage voxels;
+            loadOrGenerate(_chunk_coord, voxels, _generator);
+
+            VxChunkMesh mesh;
+            VxMesher::mesh(voxels, mesh);
+
+            std::vector<VxVertex> vertices;
+            for (uint32_t dir = 0; dir < 6; dir++)
+                VxMesher::buildVertices(mesh.quads[dir], vertices, _data.indices);
+
+            glm::vec3 offset = glm::vec3(_chunk_coord * glm::ivec3(VX_CHUNK_SIZE_XZ, VX_CHUNK_SIZE_Y, VX_CHUNK_SIZE_XZ));
+            for (auto& vertex : vertices)
+                vertex.position += offset;
+
+            _data.vertices.resize(vertices.size() * sizeof(VxVertex));
+            if (!vertices.empty())
+                std::memcpy(_data.vertices.data(), vertices.data(), _data.vertices.size());
+            _data.aabb = AABB(offset, offset + glm::vec3(VX_CHUNK_SIZE_XZ_F, VX_CHUNK_SIZE_Y_F, VX_CHUNK_SIZE_XZ_F));
+        };
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxRegionStore::encode(const VxChunkStorage& _storage, std::vector<uint8_t>& _payload)
+    {
+        _payload.clear();
+        const Voxel* voxels = _storage.data();
+        uint32_t i = 0;
+        while (i < VX_CHUNK_SIZE_ALLOC)
+        {
+            uint32_t value = voxels[i].data;
+            uint32_t run = 1;
+            while (i + run < VX_CHUNK_SIZE_ALLOC && voxels[i + run].data == value)
+                run++;
+            i += run;
+
+            while (run >= 0x80)
+            {
+                _payload.push_back((uint8_t)(run | 0x80));
+                run >>= 7;
+            }
+            _payload.push_back((uint8_t)run);
+
+            uint8_t bytes[sizeof(uint32_t)];
+            std::memcpy(bytes, &value, sizeof(uint32_t));
+            _payload.insert(_payload.end(), bytes, bytes + sizeof(uint32_t));
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxRegionStore::decode(const uint8_t* _payload, size_t _size, VxChunkStorage& _storage)
+    {
+        const uint8_t* ptr = _payload;
+        const uint8_t* end = _payload + _size;
+        Voxel* voxels = _storage.data();
+        uint32_t i = 0;
+        while (i < VX_CHUNK_SIZE_ALLOC)
+        {
+            uint32_t run = 0;
+            for (uint32_t shift = 0; ; shift += 7)
+            {
+                if (ptr == end || shift > 28)
+                    return false;
+                uint8_t byte = *ptr++;
+                run |= (uint32_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80))
+                    break;
+            }
+
+            uint32_t value;
+            if ((size_t)(end - ptr) < sizeof(uint32_t) || run == 0 || run > VX_CHUNK_SIZE_ALLOC - i)
+                return false;
+            std::memcpy(&value, ptr, sizeof(uint32_t));
+            ptr += sizeof(uint32_t);
+
+            std::fill(voxels + i, voxels + i + run, Voxel(value));
+            i += run;
+        }
+
+        return ptr == end;
+    }
+
+    //-----------------------------------------------------------------------------------
+    glm::ivec3 VxRegionStore::getRegion(const glm::ivec3& _chunk)
+    {
+        return glm::ivec3(floor_div(_chunk.x, VX_REGION_SIZE), _chunk.y, floor_div(_chunk.z, VX_REGION_SIZE));
+    }
+
+    //-----------------------------------------------------------------------------------
+    std::string VxRegionStore::getRegionPath(const glm::ivec3& _region) const
+    {
+        return m_directory + "/r." + std::to_string(_region.x) + "." + std::to_string(_region.y) + "." + std::to_string(_region.z) + ".vxr";
+    }
+
+    //-----------------------------------------------------------------------------------
+    void VxRegionStore::ioThread()
+    {
+        bool retry = false;         // the last batch had failed writes
+        bool lastBatch = false;     // the one attempt made after stopping
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (retry)
+                    m_workAvailable.wait_for(lock, s_retryDelay, [&]() { return m_stop; });
+                m_workAvailable.wait(lock, [&]() { return m_stop || !m_queued.empty(); });
+                if (m_queued.empty())
+                    return;
+                if (lastBatch)
+                {
+                    SYN_CORE_ERROR(m_queued.size(), " chunks could not be written to '", m_directory, "' and are lost.");
+                    m_queued.clear();
+                    m_idle.notify_all();
+                    return;
+                }
+                lastBatch = m_stop;
+                m_writing.swap(m_queued);
+            }
+
+            // m_writing is only modified here, so it can be read without the lock
+            std::unordered_map<glm::ivec3, std::vector<const chunk_map_t::value_type*>, ivec3Hash, ivec3Hash> regions;
+            for (const auto& chunk : m_writing)
+                regions[getRegion(chunk.first)].push_back(&chunk);
+
+            retry = false;
+            for (const auto& region : regions)
+            {
+                bool written = writeRegion(region.first, region.second);
+
+                // the new file is in place: drop the old mapping and the written chunks.
+                // Otherwise the chunks go back to the queue, unless saved again meanwhile.
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (written)
+                    m_regionFiles.erase(region.first);
+                else
+                {
+                    SYN_CORE_WARNING(region.second.size(), " chunks of region '", getRegionPath(region.first), "' kept queued, retrying.");
+                    m_writeFailures++;
+                    retry = true;
+                }
+                for (const auto* chunk : region.second)
+                {
+                    // a copy, the pointer is into the node erased below
+                    glm::ivec3 coord = chunk->first;
+                    auto it = m_writing.find(coord);
+                    if (!written)
+                        m_queued.try_emplace(coord, std::move(it->second));
+                    m_writing.erase(it);
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_queued.empty() || retry)
+                    m_idle.notify_all();
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    bool VxRegionStore::writeRegion(const glm::ivec3& _region, const std::vector<const chunk_map_t::value_type*>& _chunks)
+    {
+        std::string path = getRegionPath(_region);
+
+        // payloads per slot, new chunks replacing the existing ones
+        std::vector<std::pair<const uint8_t*, uint32_t>> payloads(s_regionEntryCount, { nullptr, 0 });
+        std::vector<uint8_t> buffer;
+        {
+            MappedFile old(path);
+            const vx_region_entry_t* table = region_table(old);
+            if (table)
+                for (uint32_t slot = 0; slot < s_regionEntryCount; slot++)
+                    if (region_entry_valid(old, table[slot]))
+                        payloads[slot] = { old.data() + table[slot].offset, table[slot].size };
+
+            for (const auto* chunk : _chunks)
+                payloads[region_slot(chunk->first)] = { chunk->second.data(), (uint32_t)chunk->second.size() };
+
+            // assembled in memory while the old file is mapped
+            size_t tableEnd = sizeof(vx_region_header_t) + sizeof(vx_region_entry_t) * s_regionEntryCount;
+            size_t size = tableEnd;
+            for (const auto& payload : payloads)
+                size += payload.second;
+            buffer.resize(size);
+
+            vx_region_header_t header;
+            std::memset(&header, 0, sizeof(vx_region_header_t));
+            std::memcpy(header.magic, s_regionMagic, sizeof(s_regionMagic));
+            header.version = s_regionVersion;
+            header.chunkSizeXZ = VX_CHUNK_SIZE_XZ;
+            header.chunkSizeY = VX_CHUNK_SIZE_Y;
+            header.regionSize = VX_REGION_SIZE;
+            std::memcpy(buffer.data(), &header, sizeof(vx_region_header_t));
+
+            uint32_t offset = (uint32_t)tableEnd;
+            for (uint32_t slot = 0; slot < s_regionEntryCount; slot++)
+            {
+                vx_region_entry_t entry = { payloads[slot].second ? offset : 0, payloads[slot].second };
+                std::memcpy(buffer.data() + sizeof(vx_region_header_t) + slot * sizeof(vx_region_entry_t), &entry, sizeof(vx_region_entry_t));
+                if (entry.size)
+                    std::memcpy(buffer.data() + offset, payloads[slot].first, entry.size);
+                offset += entry.size;
+            }
+        }
+
+        std::string tmpPath = path + ".tmp";
+        FILE* file = std::fopen(tmpPath.c_str(), "wb");
+        if (!file)
+        {
+            SYN_CORE_WARNING("could not write region '", path, "'.");
+            return false;
+        }
+
+        bool written = std::fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size() && std::fflush(file) == 0;
+        #ifdef __linux__
+            // on disk before the rename, or a crash could leave an empty region behind
+            written = written && fsync(fileno(file)) == 0;
+        #endif
+        written = std::fclose(file) == 0 && written;
+
+        if (!written || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            SYN_CORE_WARNING("could not write region '", path, "'.");
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+
+        return true;
+    }
+
+    //-----------------------------------------------------------------------------------
+    std::shared_ptr<MappedFile> VxRegionStore::getRegionFile(const glm::ivec3& _region)
+    {
+        auto it = m_regionFiles.find(_region);
+        if (it != m_regionFiles.end())
+            return it->second;
+
+        // mappings in use are kept alive by their readers
+        if (m_regionFiles.size() >= s_maxOpenRegions)
+            m_regionFiles.clear();
+
+        auto file = std::make_shared<MappedFile>(getRegionPath(_region));
+        m_regionFiles[_region] = file;
+        return file;
+    }
+
+
+}
+
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+#include "Types.hpp"
+#include "VxChunkStorage.hpp"
+#include "../../SynapseCore/Types.hpp"
+#include "../../SynapseCore/Utils/MappedFile.hpp"
+#include "../../SynapseCore/Renderer/Chunk/StreamingChunkManager.hpp"
+
+
+// Chunks per region file, along x and z.
+#define VX_REGION_SIZE              32
+
+
+namespace Syn
+{
+    /* Persistent voxel chunk storage in region files. A region file holds the chunks of
+     * a VX_REGION_SIZE x VX_REGION_SIZE area of one chunk layer (y), named
+     * r.<x>.<y>.<z>.vxr after the region coordinate.
+     *
+     * File layout (native endianness):
+     *   header | entry[VX_REGION_SIZE^2] (offset, size; size 0 if absent) | payloads
+     * Payloads are run-length encoded Voxel::data, in VxChunkStorage order: runs of a
+     * LEB128 length and a 32-bit value. Terrain layers compress to a few runs per row.
+     *
+     * Region files are read through a memory mapping. save() returns immediately; the
+     * chunks are written on a dedicated I/O thread, batched per region, each region
+     * rewritten to a temporary file and renamed over the old one, so that a crash never
+     * leaves a partially written region. Chunks waiting to be written are served by
+     * load() from memory. Chunks of a region that fails to write (disk full, rename
+     * failure) stay queued and are retried. The destructor writes all pending chunks,
+     * with one last attempt for failed ones.
+     *
+     * load(), save() and loadOrGenerate() are thread safe.
+     */
+    class VxRegionStore
+    {
+    public:
+        using VoxelGeneratorFunc = std::function<void(const glm::ivec3& _chunk_coord, VxChunkStorage& _storage)>;
+
+    public:
+        VxRegionStore(const std::string& _directory);
+        ~VxRegionStore();
+
+        /* Reads a chunk; false if it has never been saved (or its region is corrupt). */
+        bool load(const glm::ivec3& _chunk, VxChunkStorage& _storage);
+        /* Queues a chunk for writing. */
+        void save(const glm::ivec3& _chunk, const VxChunkStorage& _storage);
+        /* Loads a chunk, or generates and saves it if it isn't stored; true if loaded. */
+        bool loadOrGenerate(const glm::ivec3& _chunk, VxChunkStorage& _storage, const VoxelGeneratorFunc& _generator);
+        /* Blocks until all queued chunks are written, or a write fails; false in the latter
+         * case (the chunks stay queued). */
+        bool flush();
+
+        /* Generator for a StreamingChunkManager (with VxMesher::getVertexLayout() and a
+         * chunk size of VX_CHUNK_SIZE_XZ): voxels are loaded from the store, or generated
+         * and saved, then meshed into world space triangles. Chunks are meshed without
+         * neighbours. The store must outlive the manager.
+         */
+        StreamingChunkManager::GeneratorFunc makeChunkGenerator(const VoxelGeneratorFunc& _generator);
+
+        /* Payload encoding, exposed for tools. decode() fails on truncated or malformed
+         * payloads. */
+        static void encode(const VxChunkStorage& _storage, std::vector<uint8_t>& _payload);
+        static bool decode(const uint8_t* _payload, size_t _size, VxChunkStorage& _storage);
+
+        // Accessors
+        static glm::ivec3 getRegion(const glm::ivec3& _chunk);
+        std::string getRegionPath(const glm::ivec3& _region) const;
+        inline const std::string& getDirectory() const { return m_directory; }
+
+
+    private:
+        using chunk_map_t = std::unordered_map<glm::ivec3, std::vector<uint8_t>, ivec3Hash, ivec3Hash>;
+
+        void ioThread();
+        bool writeRegion(const glm::ivec3& _region, const std::vector<const chunk_map_t::value_type*>& _chunks);
+        // Mapping of a region file, opened on first use; data() is nullptr if missing.
+        std::shared_ptr<MappedFile> getRegionFile(const glm::ivec3& _region);
+
+    private:
+        std::string m_directory;
+
+        std::mutex m_mutex;
+        std::condition_variable m_workAvailable;
+        std::condition_variable m_idle;
+        bool m_stop = false;
+        uint64_t m_writeFailures = 0;   // regions that failed to write
+
+        // chunks waiting for the I/O thread, and the batch being written
+        chunk_map_t m_queued;
+        chunk_map_t m_writing;
+
+        std::unordered_map<glm::ivec3, std::shared_ptr<MappedFile>, ivec3Hash, ivec3Hash> m_regionFiles;
+
+        std::thread m_thread;
+
+    };
+
+
+}
+
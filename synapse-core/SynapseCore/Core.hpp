@@ -105,6 +105,7 @@ static constexpr int RETURN_FAILURE = -1;
 #define DEBUG_MESH_BITANGENT_SHADER
 //#define DEBUG_MESH
 //#define DEBUG_MESH_TERRAIN
+//#define DEBUG_CHUNK_MANAGER
 #define DEBUG_FRAMEBUFFER
 #define DEBUG_VERTEX_ARRAY
 #define DEBUG_VERTEX_BUFFER
@@ -135,6 +136,7 @@ static constexpr int RETURN_FAILURE = -1;
 	#define DEBUG_MESH_BITANGENT_SHADER
 	#define DEBUG_MESH
 	#define DEBUG_MESH_TERRAIN
+	#define DEBUG_CHUNK_MANAGER
 	#define DEBUG_FRAMEBUFFER
 	#define DEBUG_VERTEX_ARRAY
 	#define DEBUG_VERTEX_BUFFER
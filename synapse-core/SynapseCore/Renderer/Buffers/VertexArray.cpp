@@ -33,6 +33,11 @@ namespace Syn {
 			case ShaderDataType::Int2:
 			case ShaderDataType::Int3:
 			case ShaderDataType::Int4:		return GL_INT;
+			case ShaderDataType::Half2:
+			case ShaderDataType::Half4:		return GL_HALF_FLOAT;
+			case ShaderDataType::Int_2_10_10_10:	return GL_INT_2_10_10_10_REV;
+			case ShaderDataType::UByte4:	return GL_UNSIGNED_BYTE;
+			case ShaderDataType::UShort4:	return GL_UNSIGNED_SHORT;
 			case ShaderDataType::None:		break;
 		}
 		SYN_CORE_WARNING("Unknown data type: ", (int)_type, ".");
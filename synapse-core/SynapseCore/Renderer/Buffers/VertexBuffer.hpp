@@ -11,7 +11,11 @@ namespace Syn {
 	enum class ShaderDataType 
 	{ 
 		None = 0,
-		Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4
+		Float, Float2, Float3, Float4, Mat3, Mat4, Int, Int2, Int3, Int4,
+		Half2, Half4,		// 16-bit floats
+		Int_2_10_10_10,		// packed signed 10:10:10:2, 4 components (use normalized)
+		UByte4,				// 4 unsigned bytes, e.g. RGBA8 colors (use normalized)
+		UShort4				// 4 unsigned shorts, e.g. quantized positions (use normalized)
 	};
 
 
@@ -30,6 +34,11 @@ namespace Syn {
 			case ShaderDataType::Int2:		return 4 * 2;
 			case ShaderDataType::Int3:		return 4 * 3;
 			case ShaderDataType::Int4:		return 4 * 4;
+			case ShaderDataType::Half2:		return 2 * 2;
+			case ShaderDataType::Half4:		return 2 * 4;
+			case ShaderDataType::Int_2_10_10_10:	return 4;
+			case ShaderDataType::UByte4:	return 4;
+			case ShaderDataType::UShort4:	return 2 * 4;
 		}
 		SYN_CORE_WARNING("unknown ShaderDataType (", (int)_type, ").");
 		return 0;
@@ -51,6 +60,11 @@ namespace Syn {
 			case ShaderDataType::Int2:		return 2;
 			case ShaderDataType::Int3:		return 3;
 			case ShaderDataType::Int4:		return 4;
+			case ShaderDataType::Half2:		return 2;
+			case ShaderDataType::Half4:		return 4;
+			case ShaderDataType::Int_2_10_10_10:	return 4;
+			case ShaderDataType::UByte4:	return 4;
+			case ShaderDataType::UShort4:	return 4;
 		}
 
 		SYN_CORE_WARNING("unknown ShaderDataType (", (int)_type, ").");
@@ -0,0 +1,367 @@
+#include "../../../pch.hpp"
+
+#include <algorithm>
+
+#include "StreamingChunkManager.hpp"
+#include "../Renderer.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/Timer/Timer.hpp"
+#include "../../Utils/Thread/ThreadPool.hpp"
+
+
+namespace Syn
+{
+
+	//-----------------------------------------------------------------------------------
+	StreamingChunkManager::StreamingChunkManager(const GeneratorFunc& _generator,
+												 const BufferLayout& _layout,
+												 uint32_t _chunk_size,
+												 int _render_distance,
+												 uint32_t _cache_capacity)
+	{
+		m_generator = _generator;
+		m_layout = _layout;
+		m_chunkSize = _chunk_size;
+		m_chunkRenderDistance = _render_distance;
+		m_cacheCapacity = _cache_capacity;
+		m_completed = std::make_shared<completion_queue_t>();
+	}
+
+	//-----------------------------------------------------------------------------------
+	StreamingChunkManager::~StreamingChunkManager()
+	{
+		// chunks still being generated finish into the (shared) completion queue, which is
+		// released by the last task
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::updateChunks(const glm::vec3& _camera_position)
+	{
+		// the view direction of the last update
+		updateChunks(_camera_position, glm::vec3(m_cameraDirection.x, 0.0f, m_cameraDirection.y));
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::updateChunks(const glm::vec3& _camera_position, const glm::vec3& _camera_direction)
+	{
+		// the uploads of the last update have been executed, release the CPU copies
+		for (auto& chunk : m_uploadedChunks)
+			chunk->data = ChunkData();
+		m_uploadedChunks.clear();
+
+		// re-prioritize when the camera enters a new chunk or turns
+		glm::vec2 direction = glm::vec2(_camera_direction.x, _camera_direction.z);
+		float length = glm::length(direction);
+		direction = length > 0.0f ? direction / length : glm::vec2(0.0f);
+
+		glm::ivec3 cameraChunk = glm::ivec3(glm::floor(_camera_position / (float)m_chunkSize));
+		m_cameraPosition = _camera_position;
+		if (length == 0.0f)
+			direction = m_cameraDirection;
+		bool turned = length > 0.0f && glm::dot(direction, m_cameraDirection) < 0.9f;
+		if (m_forceRebuild || cameraChunk != m_currentCameraChunk || turned)
+		{
+			m_currentCameraChunk = cameraChunk;
+			m_cameraDirection = direction;
+			rebuildRequests();
+			m_forceRebuild = false;
+		}
+
+		dispatchGeneration();
+		uploadReadyChunks();
+
+		m_stats.queueDepth = (uint32_t)m_pendingChunks.size();
+		m_stats.inFlight = m_inFlight;
+		m_stats.readyCount = (uint32_t)m_readyChunks.size();
+		m_stats.loadedCount = (uint32_t)m_loadedChunks.size();
+		m_stats.cachedCount = (uint32_t)m_cacheList.size();
+
+		#ifdef DEBUG_CHUNK_MANAGER
+			if (m_stats.uploadedLastUpdate)
+			{
+				SYN_CORE_TRACE("uploaded ", m_stats.uploadedLastUpdate, " chunks (", m_stats.bytesLastUpdate, " bytes), queue=", m_stats.queueDepth,
+							   ", in flight=", m_stats.inFlight, ", latency avg=", m_stats.avgLatencyMs, " ms, max=", m_stats.maxLatencyMs, " ms.");
+			}
+		#endif
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::render(const Ref<Shader>& _shader)
+	{
+		_shader->setMatrix4fv("u_model_matrix", glm::mat4(1.0f));
+		for (auto& it : m_loadedChunks)
+		{
+			const Ref<StreamedChunk>& chunk = it.second;
+			if (chunk->indexBuffer->getIndexCount() == 0)
+				continue;
+			chunk->vertexArray->bind();
+			Renderer::drawIndexed(chunk->indexBuffer->getIndexCount(), true, GL_TRIANGLES);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::collectWantedChunks(std::vector<glm::ivec3>& _coords) const
+	{
+		int d = m_chunkRenderDistance;
+		for (int y = m_minChunkY; y <= m_maxChunkY; y++)
+			for (int z = m_currentCameraChunk.z - d; z <= m_currentCameraChunk.z + d; z++)
+				for (int x = m_currentCameraChunk.x - d; x <= m_currentCameraChunk.x + d; x++)
+					_coords.push_back(glm::ivec3(x, y, z));
+	}
+
+	//-----------------------------------------------------------------------------------
+	bool StreamingChunkManager::isChunkWanted(const glm::ivec3& _coord) const
+	{
+		return abs(_coord.x - m_currentCameraChunk.x) <= m_chunkRenderDistance &&
+			   abs(_coord.z - m_currentCameraChunk.z) <= m_chunkRenderDistance &&
+			   _coord.y >= m_minChunkY && _coord.y <= m_maxChunkY;
+	}
+
+	//-----------------------------------------------------------------------------------
+	glm::vec3 StreamingChunkManager::chunkCenter(const glm::ivec3& _coord) const
+	{
+		return (glm::vec3(_coord) + 0.5f) * (float)m_chunkSize;
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<StreamedChunk> StreamingChunkManager::findChunk(const glm::ivec3& _coord) const
+	{
+		auto loaded = m_loadedChunks.find(_coord);
+		if (loaded != m_loadedChunks.end())
+			return loaded->second;
+		auto cached = m_cacheMap.find(_coord);
+		if (cached != m_cacheMap.end())
+			return *cached->second;
+		return nullptr;
+	}
+
+	//-----------------------------------------------------------------------------------
+	float StreamingChunkManager::chunkPriority(const glm::ivec3& _coord) const
+	{
+		// distance from the camera to the chunk center, up to twice that for chunks
+		// behind the camera
+		glm::vec3 d = chunkCenter(_coord) - m_cameraPosition;
+		float distance = glm::length(d);
+		glm::vec2 dxz = glm::vec2(d.x, d.z);
+		float lengthXZ = glm::length(dxz);
+		float facing = lengthXZ > 0.0f ? glm::dot(dxz / lengthXZ, m_cameraDirection) : 1.0f;
+		return distance * (1.5f - 0.5f * facing);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::rebuildRequests()
+	{
+		// drop pending requests out of range; the remaining are re-prioritized below
+		std::vector<pending_chunk_t> pending;
+		pending.reserve(m_pendingChunks.size());
+		for (auto& p : m_pendingChunks)
+		{
+			if (isChunkWanted(p.coord))
+				pending.push_back(p);
+			else
+			{
+				m_requested.erase(p.coord);
+				m_requestTimes.erase(p.coord);
+			}
+		}
+
+		// request missing chunks, restoring cached ones directly
+		std::vector<glm::ivec3> wanted;
+		collectWantedChunks(wanted);
+		for (auto& coord : wanted)
+		{
+			if (m_loadedChunks.find(coord) != m_loadedChunks.end() || m_requested.find(coord) != m_requested.end())
+				continue;
+
+			auto cached = m_cacheMap.find(coord);
+			if (cached != m_cacheMap.end())
+			{
+				m_loadedChunks[coord] = *cached->second;
+				m_cacheList.erase(cached->second);
+				m_cacheMap.erase(cached);
+				continue;
+			}
+
+			m_requested.insert(coord);
+			m_requestTimes[coord] = std::chrono::high_resolution_clock::now();
+			pending.push_back({ coord, 0.0f });
+		}
+
+		// evict chunks out of range, after restoring from the cache so that the evictions
+		// don't push out chunks returning into range
+		for (auto it = m_loadedChunks.begin(); it != m_loadedChunks.end(); )
+		{
+			if (!isChunkWanted(it->first))
+			{
+				evictToCache(it->second);
+				it = m_loadedChunks.erase(it);
+			}
+			else
+				++it;
+		}
+
+		for (auto& p : pending)
+			p.priority = chunkPriority(p.coord);
+		std::make_heap(pending.begin(), pending.end());
+		m_pendingChunks = std::move(pending);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::dispatchGeneration()
+	{
+		ThreadPool& pool = ThreadPool::get();
+
+		// no workers, generate on this thread within the time budget
+		if (!pool.isRunning())
+		{
+			Timer timer("", false);
+			while (!m_pendingChunks.empty() && timer.getDeltaTimeMs() < m_uploadBudgetMs)
+			{
+				std::pop_heap(m_pendingChunks.begin(), m_pendingChunks.end());
+				ready_chunk_t ready;
+				ready.coord = m_pendingChunks.back().coord;
+				m_pendingChunks.pop_back();
+				m_generator(ready.coord, ready.data);
+				m_readyChunks.push_back(std::move(ready));
+			}
+			return;
+		}
+
+		// collect finished chunks
+		{
+			std::lock_guard<std::mutex> lock(m_completed->mutex);
+			m_inFlight -= (uint32_t)m_completed->chunks.size();
+			for (auto& ready : m_completed->chunks)
+				m_readyChunks.push_back(std::move(ready));
+			m_completed->chunks.clear();
+		}
+
+		// keep a bounded number of chunks in flight, so that the generation order follows
+		// the priorities as the camera moves
+		uint32_t maxInFlight = m_maxInFlight ? m_maxInFlight : (uint32_t)pool.threadCount() * 2;
+		while (!m_pendingChunks.empty() && m_inFlight < maxInFlight)
+		{
+			std::pop_heap(m_pendingChunks.begin(), m_pendingChunks.end());
+			glm::ivec3 coord = m_pendingChunks.back().coord;
+			m_pendingChunks.pop_back();
+
+			std::shared_ptr<completion_queue_t> completed = m_completed;
+			GeneratorFunc generator = m_generator;
+			pool.submit([completed, generator, coord]()
+			{
+				ready_chunk_t ready;
+				ready.coord = coord;
+				generator(coord, ready.data);
+				std::lock_guard<std::mutex> lock(completed->mutex);
+				completed->chunks.push_back(std::move(ready));
+			});
+			m_inFlight++;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::uploadReadyChunks()
+	{
+		m_stats.uploadedLastUpdate = 0;
+		m_stats.bytesLastUpdate = 0;
+
+		// discard chunks that went out of range while generated, upload the rest nearest
+		// first
+		std::vector<std::pair<float, size_t>> order;
+		order.reserve(m_readyChunks.size());
+		for (size_t i = 0; i < m_readyChunks.size(); i++)
+		{
+			if (isChunkWanted(m_readyChunks[i].coord))
+				order.push_back({ chunkPriority(m_readyChunks[i].coord), i });
+			else
+			{
+				m_requested.erase(m_readyChunks[i].coord);
+				m_requestTimes.erase(m_readyChunks[i].coord);
+			}
+		}
+		std::sort(order.begin(), order.end());
+
+		Timer timer("", false);
+		std::vector<ready_chunk_t> remaining;
+		auto now = std::chrono::high_resolution_clock::now();
+		for (auto& o : order)
+		{
+			ready_chunk_t& ready = m_readyChunks[o.second];
+			uint64_t bytes = ready.data.vertices.size() + ready.data.indices.size() * sizeof(uint32_t);
+
+			// always upload at least one chunk per update
+			if (m_stats.uploadedLastUpdate > 0 &&
+				(timer.getDeltaTimeMs() > m_uploadBudgetMs || m_stats.bytesLastUpdate + bytes > m_uploadBudgetBytes))
+			{
+				remaining.push_back(std::move(ready));
+				continue;
+			}
+
+			Ref<StreamedChunk> chunk = acquireChunk();
+			chunk->coord = ready.coord;
+			chunk->aabb = ready.data.aabb;
+			chunk->data = std::move(ready.data);
+			// the index buffer binding is part of the vertex array state
+			chunk->vertexArray->bind();
+			chunk->vertexBuffer->setData(chunk->data.vertices.data(), (uint32_t)chunk->data.vertices.size());
+			chunk->indexBuffer->setData(chunk->data.indices.data(), (uint32_t)chunk->data.indices.size());
+			chunk->vertexArray->unbind();
+			m_loadedChunks[chunk->coord] = chunk;
+			m_uploadedChunks.push_back(chunk);
+
+			// latency, request to upload
+			auto requested = m_requestTimes.find(chunk->coord);
+			if (requested != m_requestTimes.end())
+			{
+				float latency = std::chrono::duration<float, std::milli>(now - requested->second).count();
+				m_stats.avgLatencyMs = m_stats.avgLatencyMs == 0.0f ? latency : 0.9f * m_stats.avgLatencyMs + 0.1f * latency;
+				m_stats.maxLatencyMs = max(m_stats.maxLatencyMs, latency);
+				m_requestTimes.erase(requested);
+			}
+			m_requested.erase(chunk->coord);
+
+			m_stats.uploadedLastUpdate++;
+			m_stats.bytesLastUpdate += bytes;
+		}
+
+		m_readyChunks = std::move(remaining);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void StreamingChunkManager::evictToCache(const Ref<StreamedChunk>& _chunk)
+	{
+		m_cacheList.push_front(_chunk);
+		m_cacheMap[_chunk->coord] = m_cacheList.begin();
+
+		// least recently evicted chunks leave the cache, their buffers are recycled
+		while (m_cacheList.size() > m_cacheCapacity)
+		{
+			Ref<StreamedChunk> lru = m_cacheList.back();
+			m_cacheMap.erase(lru->coord);
+			m_cacheList.pop_back();
+			lru->data = ChunkData();
+			m_freeChunks.push_back(lru);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<StreamedChunk> StreamingChunkManager::acquireChunk()
+	{
+		// reuse the buffers (and vertex array setup) of a chunk dropped from the cache
+		if (!m_freeChunks.empty())
+		{
+			Ref<StreamedChunk> chunk = m_freeChunks.back();
+			m_freeChunks.pop_back();
+			return chunk;
+		}
+
+		Ref<StreamedChunk> chunk = MakeRef<StreamedChunk>();
+		chunk->vertexBuffer = MakeRef<VertexBuffer>();
+		chunk->vertexBuffer->setBufferLayout(m_layout);
+		chunk->indexBuffer = MakeRef<IndexBuffer>();
+		chunk->vertexArray = MakeRef<VertexArray>(chunk->vertexBuffer, chunk->indexBuffer);
+		return chunk;
+	}
+
+
+}
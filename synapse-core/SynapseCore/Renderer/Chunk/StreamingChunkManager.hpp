@@ -0,0 +1,191 @@
+#pragma once
+
+#include <list>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "ChunkManager.hpp"
+#include "../Shader/Shader.hpp"
+#include "../Buffers/VertexArray.hpp"
+
+
+namespace Syn
+{
+
+	/* CPU side output of a chunk generator: vertex data in the layout supplied to the
+	 * StreamingChunkManager, triangle list indices and the bounding box of the chunk.
+	 */
+	struct ChunkData
+	{
+		std::vector<uint8_t> vertices;
+		std::vector<uint32_t> indices;
+		AABB aabb;
+	};
+
+
+	// A chunk resident on the GPU.
+	struct StreamedChunk
+	{
+		glm::ivec3 coord = glm::ivec3(0);
+		Ref<VertexArray> vertexArray = nullptr;
+		Ref<VertexBuffer> vertexBuffer = nullptr;
+		Ref<IndexBuffer> indexBuffer = nullptr;
+		AABB aabb;
+		// CPU copy, kept until the deferred upload has been executed
+		ChunkData data;
+	};
+
+
+	// Streaming statistics, updated by updateChunks().
+	struct ChunkStreamingStats
+	{
+		uint32_t queueDepth = 0;		// chunks waiting to be generated
+		uint32_t inFlight = 0;			// chunks being generated
+		uint32_t readyCount = 0;		// generated chunks waiting for upload
+		uint32_t loadedCount = 0;
+		uint32_t cachedCount = 0;
+		uint32_t uploadedLastUpdate = 0;
+		uint64_t bytesLastUpdate = 0;
+		float avgLatencyMs = 0.0f;		// request to upload, exponential moving average
+		float maxLatencyMs = 0.0f;
+	};
+
+
+	/* Concrete streaming chunk manager. Chunks within the render distance of the camera
+	 * (in x and z; y spans the fixed range set by setVerticalRange()) are requested
+	 * nearest first, with chunks in the view direction preferred, and generated by a
+	 * user supplied generator on the ThreadPool (inline if the pool isn't running).
+	 * Generated chunks are uploaded within a per-update time and byte budget.
+	 *
+	 * Chunks leaving the render distance are moved to an LRU cache; returning chunks
+	 * are restored from the cache without regeneration, and chunks dropping out of the
+	 * cache donate their GPU buffers to new uploads.
+	 *
+	 * The generator is called from worker threads and must be thread safe. Chunk
+	 * vertices are expected in world space.
+	 */
+	class StreamingChunkManager : public ChunkManager
+	{
+	public:
+		using GeneratorFunc = std::function<void(const glm::ivec3& _chunk_coord, ChunkData& _data)>;
+
+	public:
+		StreamingChunkManager(const GeneratorFunc& _generator,
+							  const BufferLayout& _layout,
+							  uint32_t _chunk_size=16,
+							  int _render_distance=3,
+							  uint32_t _cache_capacity=64);
+		virtual ~StreamingChunkManager();
+
+		/* Requests missing chunks around _camera_position, evicts chunks out of range,
+		 * dispatches generation and uploads completed chunks within budget. The view
+		 * direction of the last call to the overload below is used for prioritization.
+		 */
+		virtual void updateChunks(const glm::vec3& _camera_position) override;
+		void updateChunks(const glm::vec3& _camera_position, const glm::vec3& _camera_direction);
+
+		// Renders all loaded chunks; the shader is expected to be enabled by the caller.
+		virtual void render(const Ref<Shader>& _shader);
+
+		// Per-update upload budget, in milliseconds and bytes.
+		void setUploadBudget(float _ms, uint64_t _bytes) { m_uploadBudgetMs = _ms; m_uploadBudgetBytes = _bytes; }
+		// Range of chunk y coordinates streamed (inclusive).
+		void setVerticalRange(int _min_y, int _max_y) { m_minChunkY = _min_y; m_maxChunkY = _max_y; m_forceRebuild = true; }
+		void setRenderDistance(int _distance) { m_chunkRenderDistance = _distance; m_forceRebuild = true; }
+		// Maximum number of chunks generated simultaneously, 0 for twice the number of worker threads.
+		void setMaxInFlight(uint32_t _max) { m_maxInFlight = _max; }
+
+		// Accessors
+		inline const ChunkStreamingStats& getStats() const { return m_stats; }
+		inline const std::unordered_map<glm::ivec3, Ref<StreamedChunk>, ivec3Hash, ivec3Hash>& getLoadedChunks() const { return m_loadedChunks; }
+		inline uint32_t getChunkSize() const { return m_chunkSize; }
+
+
+	protected:
+		/* The set of chunks streamed around the camera chunk. collectWantedChunks() lists
+		 * them and isChunkWanted() tests a single chunk; the two have to agree. The
+		 * defaults are the chunks within the render distance in x and z, over the
+		 * vertical range.
+		 */
+		virtual void collectWantedChunks(std::vector<glm::ivec3>& _coords) const;
+		virtual bool isChunkWanted(const glm::ivec3& _coord) const;
+		// World space center of a chunk, used for prioritization.
+		virtual glm::vec3 chunkCenter(const glm::ivec3& _coord) const;
+		// A loaded or cached chunk, nullptr if neither.
+		Ref<StreamedChunk> findChunk(const glm::ivec3& _coord) const;
+
+		glm::vec3 m_cameraPosition = glm::vec3(0.0f);
+		glm::vec2 m_cameraDirection = glm::vec2(0.0f);
+
+
+	private:
+		void rebuildRequests();
+		void dispatchGeneration();
+		void uploadReadyChunks();
+		float chunkPriority(const glm::ivec3& _coord) const;
+		void evictToCache(const Ref<StreamedChunk>& _chunk);
+		Ref<StreamedChunk> acquireChunk();
+
+
+	private:
+		struct pending_chunk_t
+		{
+			glm::ivec3 coord;
+			float priority;
+			// larger priority values have lower priority
+			bool operator<(const pending_chunk_t& _other) const { return priority > _other.priority; }
+		};
+
+		struct ready_chunk_t
+		{
+			glm::ivec3 coord;
+			ChunkData data;
+		};
+
+		// shared with worker tasks, so that tasks finishing after destruction are safe
+		struct completion_queue_t
+		{
+			std::mutex mutex;
+			std::vector<ready_chunk_t> chunks;
+		};
+
+		GeneratorFunc m_generator;
+		BufferLayout m_layout;
+
+		int m_minChunkY = 0;
+		int m_maxChunkY = 0;
+		bool m_forceRebuild = true;
+
+		// loaded chunks and LRU cache of evicted chunks (front is most recent)
+		std::unordered_map<glm::ivec3, Ref<StreamedChunk>, ivec3Hash, ivec3Hash> m_loadedChunks;
+		std::list<Ref<StreamedChunk>> m_cacheList;
+		std::unordered_map<glm::ivec3, std::list<Ref<StreamedChunk>>::iterator, ivec3Hash, ivec3Hash> m_cacheMap;
+		uint32_t m_cacheCapacity = 64;
+		// GPU buffers of chunks dropped from the cache, for reuse
+		std::vector<Ref<StreamedChunk>> m_freeChunks;
+
+		// requested chunks: pending (max-heap on priority), generating, ready for upload
+		std::vector<pending_chunk_t> m_pendingChunks;
+		std::unordered_set<glm::ivec3, ivec3Hash, ivec3Hash> m_requested;
+		std::unordered_map<glm::ivec3, std::chrono::high_resolution_clock::time_point, ivec3Hash, ivec3Hash> m_requestTimes;
+		uint32_t m_inFlight = 0;
+		uint32_t m_maxInFlight = 0;
+		std::shared_ptr<completion_queue_t> m_completed;
+		std::vector<ready_chunk_t> m_readyChunks;
+
+		// chunks uploaded in the last update, CPU data released in the next
+		std::vector<Ref<StreamedChunk>> m_uploadedChunks;
+
+		float m_uploadBudgetMs = 2.0f;
+		uint64_t m_uploadBudgetBytes = 8 * 1024 * 1024;
+
+		ChunkStreamingStats m_stats;
+
+	};
+
+
+}
@@ -0,0 +1,359 @@
+#include "../../../pch.hpp"
+
+#include <cfloat>
+
+#include "TerrainChunkManager.hpp"
+#include "../Renderer.hpp"
+#include "../Mesh/MeshNormals.hpp"
+#include "../Shader/ShaderLibrary.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/MathUtils.hpp"
+
+
+namespace Syn
+{
+
+	// height samples outside the chunk on each side: one for the central differences of
+	// the fine normals, two for those of the coarse normals
+	static const int s_apron = 2;
+
+
+	struct terrain_vertex_t
+	{
+		glm::vec3 position;
+		float yCoarse;
+		uint32_t normal;
+		uint32_t normalCoarse;
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	static void generate_terrain_chunk(const TerrainChunkManager::HeightFunc& _height_func,
+									   const TerrainLODSettings& _settings,
+									   const glm::ivec3& _coord,
+									   ChunkData& _data)
+	{
+		int n = (int)(_settings.resolution >> _coord.y);
+		float step = (float)_settings.chunkSize / (float)n;
+		float skirtDepth = _settings.skirtDepth > 0.0f ? _settings.skirtDepth : step;
+
+		// heights, including the apron. Positions are computed from integer sample
+		// indices, so that shared vertices are bit identical between neighbouring chunks
+		// and between levels (the steps differ by powers of 2).
+		int na = n + 1 + 2 * s_apron;
+		int x0 = _coord.x * n - s_apron;
+		int z0 = _coord.z * n - s_apron;
+		std::vector<float> h(na * na);
+		for (int i = 0; i < na; i++)
+			for (int j = 0; j < na; j++)
+				h[i * na + j] = _height_func((float)(x0 + j) * step, (float)(z0 + i) * step);
+
+		// normals at this level, and at the next coarser level from every other sample
+		std::vector<glm::vec3> fineNormals(na * na);
+		MeshNormals::computeGridNormals(h.data(), na, na, step, step, fineNormals.data());
+
+		int nc = na / 2 + 1;
+		std::vector<float> hc(nc * nc);
+		for (int i = 0; i < nc; i++)
+			for (int j = 0; j < nc; j++)
+				hc[i * nc + j] = h[2 * i * na + 2 * j];
+		std::vector<glm::vec3> coarseNormals(nc * nc);
+		MeshNormals::computeGridNormals(hc.data(), nc, nc, 2.0f * step, 2.0f * step, coarseNormals.data());
+
+		auto H = [&](int _i, int _j) { return h[_i * na + _j]; };
+		auto CN = [&](int _i, int _j) { return coarseNormals[(_i / 2) * nc + _j / 2]; };
+
+		// grid vertices, followed by the skirt vertices
+		uint32_t gridVertexCount = (n + 1) * (n + 1);
+		uint32_t borderVertexCount = 4 * n;
+		_data.vertices.resize((gridVertexCount + borderVertexCount) * sizeof(terrain_vertex_t));
+		terrain_vertex_t* vertices = (terrain_vertex_t*)_data.vertices.data();
+
+		for (int i = 0; i <= n; i++)
+		{
+			for (int j = 0; j <= n; j++)
+			{
+				// the apron is even, the parity is that of the chunk indices
+				int ai = i + s_apron;
+				int aj = j + s_apron;
+
+				// height and normal of the point on the coarse triangle, with the coarse
+				// diagonal from (i+1, j-1) to (i-1, j+1) (see the index buffer below)
+				float yCoarse;
+				glm::vec3 normalCoarse;
+				if (!(i & 1) && !(j & 1))
+				{
+					yCoarse = H(ai, aj);
+					normalCoarse = CN(ai, aj);
+				}
+				else if (!(i & 1))
+				{
+					yCoarse = 0.5f * (H(ai, aj - 1) + H(ai, aj + 1));
+					normalCoarse = glm::normalize(CN(ai, aj - 1) + CN(ai, aj + 1));
+				}
+				else if (!(j & 1))
+				{
+					yCoarse = 0.5f * (H(ai - 1, aj) + H(ai + 1, aj));
+					normalCoarse = glm::normalize(CN(ai - 1, aj) + CN(ai + 1, aj));
+				}
+				else
+				{
+					yCoarse = 0.5f * (H(ai + 1, aj - 1) + H(ai - 1, aj + 1));
+					normalCoarse = glm::normalize(CN(ai + 1, aj - 1) + CN(ai - 1, aj + 1));
+				}
+
+				terrain_vertex_t& v = vertices[i * (n + 1) + j];
+				v.position = glm::vec3((float)(x0 + aj) * step, H(ai, aj), (float)(z0 + ai) * step);
+				v.yCoarse = yCoarse;
+				v.normal = pack_snorm_2_10_10_10(fineNormals[ai * na + aj]);
+				v.normalCoarse = pack_snorm_2_10_10_10(normalCoarse);
+			}
+		}
+
+		// border, counter-clockwise seen from above: z = 0 edge, x = max, z = max, x = 0
+		std::vector<uint32_t> border(borderVertexCount);
+		for (int k = 0; k < n; k++)
+		{
+			border[k] = k;
+			border[n + k] = k * (n + 1) + n;
+			border[2 * n + k] = n * (n + 1) + n - k;
+			border[3 * n + k] = (n - k) * (n + 1);
+		}
+		for (uint32_t k = 0; k < borderVertexCount; k++)
+		{
+			terrain_vertex_t& v = vertices[gridVertexCount + k];
+			v = vertices[border[k]];
+			v.position.y -= skirtDepth;
+			v.yCoarse -= skirtDepth;
+		}
+
+		_data.indices.resize(6 * n * n + 6 * borderVertexCount);
+		uint32_t* indices = _data.indices.data();
+		for (int i = 0; i < n; i++)
+		{
+			for (int j = 0; j < n; j++)
+			{
+				uint32_t index = 6 * (i * n + j);
+				// upper left triangle
+				indices[index + 0] = i * (n + 1) + j;
+				indices[index + 1] = (i + 1) * (n + 1) + j;
+				indices[index + 2] = i * (n + 1) + j + 1;
+				// lower right triangle
+				indices[index + 3] = i * (n + 1) + j + 1;
+				indices[index + 4] = (i + 1) * (n + 1) + j;
+				indices[index + 5] = (i + 1) * (n + 1) + j + 1;
+			}
+		}
+		// skirts, facing outwards
+		uint32_t index = 6 * n * n;
+		for (uint32_t k = 0; k < borderVertexCount; k++)
+		{
+			uint32_t k1 = (k + 1) % borderVertexCount;
+			uint32_t b0 = border[k], b1 = border[k1];
+			uint32_t s0 = gridVertexCount + k, s1 = gridVertexCount + k1;
+			indices[index++] = b0;
+			indices[index++] = b1;
+			indices[index++] = s0;
+			indices[index++] = b1;
+			indices[index++] = s1;
+			indices[index++] = s0;
+		}
+
+		AABB aabb;
+		for (uint32_t k = 0; k < gridVertexCount + borderVertexCount; k++)
+		{
+			aabb.min = glm::min(aabb.min, vertices[k].position);
+			aabb.max = glm::max(aabb.max, vertices[k].position);
+		}
+		_data.aabb = aabb;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static uint32_t default_cache_capacity(const TerrainLODSettings& _settings)
+	{
+		if (_settings.cacheCapacity)
+			return _settings.cacheCapacity;
+		return 4 * (2 * _settings.renderDistance + 1);
+	}
+
+	//-----------------------------------------------------------------------------------
+	TerrainChunkManager::TerrainChunkManager(const HeightFunc& _height_func, const TerrainLODSettings& _settings) :
+		StreamingChunkManager([_height_func, _settings](const glm::ivec3& _coord, ChunkData& _data)
+							  { generate_terrain_chunk(_height_func, _settings, _coord, _data); },
+							  getVertexLayout(),
+							  _settings.chunkSize,
+							  _settings.renderDistance,
+							  default_cache_capacity(_settings))
+	{
+		SYN_CORE_ASSERT(_settings.resolution >= 2 && (_settings.resolution & (_settings.resolution - 1)) == 0,
+						"terrain chunk resolution has to be a power of 2.");
+		SYN_CORE_ASSERT(_settings.fullResolutionRings > 0, "at least one ring of chunks at full resolution required.");
+
+		m_settings = _settings;
+		m_resolution = _settings.resolution;
+
+		// coarsest level has 2 quads per side
+		m_maxLevel = 0;
+		while ((m_resolution >> (m_maxLevel + 1)) >= 2)
+			m_maxLevel++;
+	}
+
+	//-----------------------------------------------------------------------------------
+	uint32_t TerrainChunkManager::getLevel(int _ring) const
+	{
+		// 1 + floor(log2(ring / R0)) outside the full resolution rings
+		uint32_t level = 0;
+		for (uint32_t q = (uint32_t)(_ring / m_settings.fullResolutionRings); q; q >>= 1)
+			level++;
+		return min(level, m_maxLevel);
+	}
+
+	//-----------------------------------------------------------------------------------
+	glm::vec2 TerrainChunkManager::getMorphRange(uint32_t _level) const
+	{
+		// nothing coarser to morph to
+		if (_level >= m_maxLevel)
+			return glm::vec2(FLT_MAX * 0.5f, FLT_MAX);
+
+		// level L covers the rings [a, b); in the shader's distance (from the camera
+		// chunk border, in chunks) the outer border of ring b-1 is at b-1. Morph over the
+		// outer half, fully coarse at the border to the next level.
+		int R0 = m_settings.fullResolutionRings;
+		float a = _level == 0 ? 0.0f : (float)(R0 << (_level - 1));
+		float b = (float)(R0 << _level);
+		float end = b - 1.0f;
+		return glm::vec2(end - 0.5f * (b - a), end);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void TerrainChunkManager::render(const Ref<Shader>& _shader)
+	{
+		float chunkSize = (float)m_chunkSize;
+		glm::vec2 center = (glm::vec2(m_currentCameraChunk.x, m_currentCameraChunk.z) + 0.5f) * chunkSize;
+		_shader->setMatrix4fv("u_model_matrix", glm::mat4(1.0f));
+		_shader->setUniform2fv("u_lod_center", center);
+		_shader->setUniform1f("u_chunk_size", chunkSize);
+		GLint morphRangeLocation = _shader->getUniformLocation("u_morph_range");
+
+		std::vector<glm::ivec3> wanted;
+		collectWantedChunks(wanted);
+
+		m_renderedTriangles = 0;
+		for (auto& coord : wanted)
+		{
+			// until uploaded, draw the chunk at the nearest level available
+			Ref<StreamedChunk> chunk = findChunk(coord);
+			for (uint32_t d = 1; chunk == nullptr && d <= m_maxLevel; d++)
+			{
+				if (coord.y + (int)d <= (int)m_maxLevel)
+					chunk = findChunk(glm::ivec3(coord.x, coord.y + d, coord.z));
+				if (chunk == nullptr && coord.y - (int)d >= 0)
+					chunk = findChunk(glm::ivec3(coord.x, coord.y - d, coord.z));
+			}
+			if (chunk == nullptr || chunk->indexBuffer->getIndexCount() == 0)
+				continue;
+
+			_shader->setUniform2fv(morphRangeLocation, getMorphRange((uint32_t)chunk->coord.y));
+			chunk->vertexArray->bind();
+			Renderer::drawIndexed(chunk->indexBuffer->getIndexCount(), true, GL_TRIANGLES);
+			m_renderedTriangles += chunk->indexBuffer->getIndexCount() / 3;
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	void TerrainChunkManager::collectWantedChunks(std::vector<glm::ivec3>& _coords) const
+	{
+		int d = m_chunkRenderDistance;
+		_coords.reserve(_coords.size() + (2 * d + 1) * (2 * d + 1));
+		for (int z = -d; z <= d; z++)
+			for (int x = -d; x <= d; x++)
+				_coords.push_back(glm::ivec3(m_currentCameraChunk.x + x,
+											 getLevel(max(abs(x), abs(z))),
+											 m_currentCameraChunk.z + z));
+	}
+
+	//-----------------------------------------------------------------------------------
+	bool TerrainChunkManager::isChunkWanted(const glm::ivec3& _coord) const
+	{
+		int ring = max(abs(_coord.x - m_currentCameraChunk.x), abs(_coord.z - m_currentCameraChunk.z));
+		return ring <= m_chunkRenderDistance && _coord.y == (int)getLevel(ring);
+	}
+
+	//-----------------------------------------------------------------------------------
+	glm::vec3 TerrainChunkManager::chunkCenter(const glm::ivec3& _coord) const
+	{
+		// the y component is the level, prioritize on the horizontal distance
+		float chunkSize = (float)m_chunkSize;
+		return glm::vec3(((float)_coord.x + 0.5f) * chunkSize, m_cameraPosition.y, ((float)_coord.z + 0.5f) * chunkSize);
+	}
+
+	//-----------------------------------------------------------------------------------
+	BufferLayout TerrainChunkManager::getVertexLayout()
+	{
+		// the coarse attributes use the (otherwise unused) tangent frame locations
+		return BufferLayout({
+			{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
+			{ VERTEX_ATTRIB_LOCATION_TANGENT, ShaderDataType::Float, "a_y_coarse" },
+			{ VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Int_2_10_10_10, "a_normal", true },
+			{ VERTEX_ATTRIB_LOCATION_BITANGENT, ShaderDataType::Int_2_10_10_10, "a_normal_coarse", true },
+		});
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<Shader> TerrainChunkManager::getDefaultShader()
+	{
+		static const std::string name = "static_terrain_cdlod_shader";
+		Ref<Shader> shader = ShaderLibrary::getShader(name);
+		if (shader != nullptr)
+			return shader;
+
+		std::string src = R"(
+			#type VERTEX_SHADER
+			#version 330 core
+
+			layout(location = 0) in vec3 a_position;
+			layout(location = 1) in vec4 a_normal;
+			layout(location = 2) in float a_y_coarse;
+			layout(location = 3) in vec4 a_normal_coarse;
+
+			uniform mat4 u_view_projection_matrix = mat4(1.0f);
+			uniform mat4 u_model_matrix = mat4(1.0f);
+			uniform vec2 u_lod_center;
+			uniform float u_chunk_size;
+			uniform vec2 u_morph_range;
+
+			out vec3 v_normal;
+
+			void main() {
+				// Chebyshev distance from the border of the camera chunk, in chunks
+				vec2 d = abs(a_position.xz - u_lod_center) / u_chunk_size;
+				float dist = max(d.x, d.y) - 0.5f;
+				float k = clamp((dist - u_morph_range.x) / (u_morph_range.y - u_morph_range.x), 0.0f, 1.0f);
+
+				vec3 position = vec3(a_position.x, mix(a_position.y, a_y_coarse, k), a_position.z);
+				v_normal = mat3(u_model_matrix) * normalize(mix(a_normal.xyz, a_normal_coarse.xyz, k));
+				gl_Position = u_view_projection_matrix * u_model_matrix * vec4(position, 1.0f);
+			}
+
+			#type FRAGMENT_SHADER
+			#version 330 core
+
+			layout(location = 0) out vec4 out_color;
+
+			in vec3 v_normal;
+
+			uniform vec3 u_light_direction = vec3(-0.4f, -1.0f, -0.3f);
+			uniform vec3 u_color = vec3(0.55f, 0.6f, 0.45f);
+
+			void main() {
+				float diffuse = max(dot(normalize(v_normal), normalize(-u_light_direction)), 0.0f);
+				out_color = vec4(u_color * (0.2f + 0.8f * diffuse), 1.0f);
+			}
+		)";
+
+		return ShaderLibrary::loadFromSrc(name, src);
+	}
+
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "StreamingChunkManager.hpp"
+
+
+namespace Syn
+{
+
+	struct TerrainLODSettings
+	{
+		// chunk side, in world units
+		uint32_t chunkSize = 64;
+		// quads per chunk side at full resolution (power of 2)
+		uint32_t resolution = 32;
+		// rings of chunks around the camera chunk at full resolution
+		int fullResolutionRings = 2;
+		int renderDistance = 16;
+		// depth of the skirts hiding cracks at level transitions, 0 for the vertex spacing
+		float skirtDepth = 0.0f;
+		// chunk cache, 0 for four times the number of chunks along a side of the view
+		uint32_t cacheCapacity = 0;
+	};
+
+
+	/* Continuous distance dependent LOD (CDLOD) for heightmap terrain, on top of the
+	 * StreamingChunkManager.
+	 *
+	 * All chunks have the same extent, but the resolution halves per distance ring:
+	 * chunks in the first fullResolutionRings (R0) Chebyshev rings around the camera
+	 * chunk are at level 0 (resolution quads per side), and level L > 0 covers the rings
+	 * [R0 * 2^(L-1), R0 * 2^L), down to 2 quads per side. The level is stored in the y
+	 * component of the chunk coordinate; the same xz chunk at another level is another
+	 * chunk, which is kept for rendering until the new one is uploaded.
+	 *
+	 * Every vertex also stores the height and normal it has in the next coarser level,
+	 * linearly interpolated along the coarse triangle, and the vertex shader morphs
+	 * towards them over the outer half of a level's rings, so that the outer border of
+	 * a level is identical to the inner border of the next. Skirts hide the remaining
+	 * T-junction cracks, as well as the cracks while a chunk is drawn at its previous
+	 * level.
+	 *
+	 * The height function is called from worker threads and must be thread safe.
+	 */
+	class TerrainChunkManager : public StreamingChunkManager
+	{
+	public:
+		using HeightFunc = std::function<float(float _x, float _z)>;
+
+	public:
+		TerrainChunkManager(const HeightFunc& _height_func, const TerrainLODSettings& _settings=TerrainLODSettings());
+		virtual ~TerrainChunkManager() = default;
+
+		/* Renders the wanted chunks, each at its level or, until uploaded, at any other
+		 * level loaded or cached. Sets u_model_matrix, u_lod_center, u_chunk_size and the
+		 * per chunk u_morph_range of the shader (see getDefaultShader()), which is
+		 * expected to be enabled by the caller.
+		 */
+		virtual void render(const Ref<Shader>& _shader) override;
+
+		// LOD level of the chunks in a Chebyshev ring (in chunks) around the camera chunk.
+		uint32_t getLevel(int _ring) const;
+		// Morph start and end, in chunks from the camera chunk (see the vertex shader).
+		glm::vec2 getMorphRange(uint32_t _level) const;
+
+		/* The vertex layout of terrain chunks: position, height in the next level,
+		 * normal and normal in the next level (24 bytes).
+		 */
+		static BufferLayout getVertexLayout();
+		// Lambert shaded terrain with vertex morphing, created on first use.
+		static Ref<Shader> getDefaultShader();
+
+		// Accessors
+		inline uint32_t getMaxLevel() const { return m_maxLevel; }
+		inline const TerrainLODSettings& getSettings() const { return m_settings; }
+		inline uint64_t getRenderedTriangleCount() const { return m_renderedTriangles; }
+
+
+	protected:
+		virtual void collectWantedChunks(std::vector<glm::ivec3>& _coords) const override;
+		virtual bool isChunkWanted(const glm::ivec3& _coord) const override;
+		virtual glm::vec3 chunkCenter(const glm::ivec3& _coord) const override;
+
+
+	private:
+		TerrainLODSettings m_settings;
+		uint32_t m_maxLevel = 0;
+		uint64_t m_renderedTriangles = 0;
+
+	};
+
+
+}
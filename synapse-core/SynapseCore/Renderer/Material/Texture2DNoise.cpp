@@ -7,33 +7,51 @@
 #include "Texture2DNoise.hpp"
 #include "../Renderer.hpp"
 #include "../../Utils/Timer/Timer.hpp"
+#include "../../Utils/Thread/ThreadPool.hpp"
 
 
 namespace Syn
 {
 
-	Texture2DNoise::Texture2DNoise(uint32_t _side)
+	static const GLint s_grey_swizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+
+	// noise to [0..255], truncating as before; out of range noise saturates
+	static inline unsigned char to_pixel(float _n)
+	{
+		return static_cast<unsigned char>(min(max(_n, 0.0f), 1.0f) * 255.0f);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	Texture2DNoise::Texture2DNoise(uint32_t _side, ColorFormat _format)
 	{
 		m_width = m_height = _side;
-		// allocate memory to store noise and pixel data
-		m_pixelData = new unsigned char[3 * _side * _side];
+		m_format = _format;
+		if (m_format != ColorFormat::R8 && m_format != ColorFormat::R32F)
+		{
+			SYN_CORE_WARNING("unsupported noise texture format ", (int)_format, ", using R8.");
+			m_format = ColorFormat::R8;
+		}
+
+		// allocate memory to store noise and pixel data, reused by all updates
+		m_pixelData = new unsigned char[_side * _side];
 		m_noiseData = new float[_side * _side];
-		memset(m_pixelData, 0, 3 * _side * _side);
+		memset(m_pixelData, 0, _side * _side);
 		memset(m_noiseData, 0, sizeof(float) * _side * _side);
 
 		SYN_RENDER_S0({
 			// create texture
 			glCreateTextures(GL_TEXTURE_2D, 1, &self->m_textureID);
 			// allocate storage
-			glTextureStorage2D(self->m_textureID, 1, GL_RGB8, self->m_width, self->m_height);
-			// upload to VRAM
-			//glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, data);
+			glTextureStorage2D(self->m_textureID, 1, getOpenGLPixelFormat(self->m_format).internalFormat, self->m_width, self->m_height);
 			// texture parameters
 			glGenerateMipmap(GL_TEXTURE_2D);
 			glTextureParameteri(self->m_textureID, GL_TEXTURE_WRAP_S, GL_REPEAT);
 			glTextureParameteri(self->m_textureID, GL_TEXTURE_WRAP_T, GL_REPEAT);
 			glTextureParameteri(self->m_textureID, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
 			glTextureParameteri(self->m_textureID, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			// single channel, sampled as grey
+			glTextureParameteriv(self->m_textureID, GL_TEXTURE_SWIZZLE_RGBA, s_grey_swizzle);
 		});
 
 	}
@@ -58,40 +76,25 @@ namespace Syn
 	void Texture2DNoise::setDataDebug1D(float* _data)
 	{
 		// incoming data in range [0..1] and with m_width elements.
-		m_noiseData = _data;
+		memcpy(m_noiseData, _data, sizeof(float) * m_width);
 	
-		uint32_t index = 0;
 		for (uint32_t x = 0; x < m_width; x++)
 		{
-			uint32_t h = (uint32_t)(m_noiseData[x] * m_height);
-			//uint32_t y = h;
+			uint32_t h = min((uint32_t)(m_noiseData[x] * m_height), m_height);
 			for (uint32_t y = 0; y < h; y++)
-			{
-				index = 3 * (y * m_width + x);
-				m_pixelData[index+0] = 255;
-				m_pixelData[index+1] = 255;
-				m_pixelData[index+2] = 255;
-			}
+				m_pixelData[y * m_width + x] = 255;
 		}
 
-		SYN_RENDER_S0({
-			// upload new data to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		uploadRows(0, m_height, false);
 	}
 
 
 	//-----------------------------------------------------------------------------------
 	void Texture2DNoise::setDataDebug2D(float* _data, const glm::vec2& _noise_limits)
 	{
-		// delete existing data if this is a reset
-		if (m_noiseData != nullptr)
-			delete[] m_noiseData;
-
 		// incoming data in range [_noise_limits.x.._noise_limits.y] and with m_size elements.
 		// please normalize to range [0..1] before rendering..
-
-		m_noiseData = _data;
+		memcpy(m_noiseData, _data, sizeof(float) * m_width * m_height);
 
 		uint32_t index = 0;
 		// offset normalization - push to [0..max]
@@ -106,115 +109,163 @@ namespace Syn
 				// 2d index into 1d array, as per usual
 				index = y * m_width + x;
 		
-				// map to range [0..1]
-				float normalizedNoise = (m_noiseData[index] + offset) * div;
-				
-				// convert to [0..255] for rendering
-				unsigned char c = static_cast<unsigned char>(normalizedNoise * 255.0f);
-				
-				// three (3) channels per pixel
-				m_pixelData[3 * index + 0] = c;
-				m_pixelData[3 * index + 1] = c;
-				m_pixelData[3 * index + 2] = c;
+				// map to range [0..1] and convert to [0..255] for rendering
+				m_pixelData[index] = to_pixel((m_noiseData[index] + offset) * div);
 			}
 		}
 		
 		SYN_CORE_TRACE("creating texture (", m_width, "x", m_height, " px).");
 
-		SYN_RENDER_S0({
-			// upload to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		// normalized view, also for R32F textures
+		uploadRows(0, m_height, false);
 	}
 
 	
 	//-----------------------------------------------------------------------------------
 	void Texture2DNoise::setFromNoiseFunc(bool _rotate_noise)
 	{
-		// if this is a reset, delete and reallocate memory
-		if (m_noiseData != nullptr)
-			delete[] m_noiseData;
+		// a single level, computed at once
+		beginNoiseFunc(_rotate_noise, 1);
+	}
 
-		m_noiseData = new float[m_width * m_height];
 
-		uint32_t index = 0;
-		glm::vec2 v(0);
-		float n = 0.0f;
+	//-----------------------------------------------------------------------------------
+	void Texture2DNoise::beginNoiseFunc(bool _rotate_noise, uint32_t _coarse_step)
+	{
+		m_rotateNoise = _rotate_noise;
+		m_coarseStep = 1;
+		while (m_coarseStep * 2 <= _coarse_step)
+			m_coarseStep *= 2;
 
-		for (uint32_t y = 0; y < m_height; y++)
+		m_refineStep = m_coarseStep;
+		m_refineRow = 0;
+
+		// the coarsest level replaces the previous contents at once
+		refine(0.0f);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	bool Texture2DNoise::refine(float _budget_ms)
+	{
+		if (m_refineStep == 0)
+			return true;
+
+		Timer timer("", false);
+		uint32_t step = m_refineStep;
+		uint32_t rowCount = (m_height + step - 1) / step;
+		// rows of the level per block : about 32k samples, at least a row per thread
+		uint32_t rowSamples = max(m_width / step, 1u);
+		uint32_t blockRows = max(32768 / rowSamples, (uint32_t)ThreadPool::get().threadCount() + 1);
+		uint32_t y0 = m_refineRow * step;
+
+		while (m_refineRow < rowCount)
 		{
-			for (uint32_t x = 0; x < m_width; x++)
-			{
-				index = y * m_width + x;
-				v = glm::vec2(x, y);
-				// TODO : replace by selected fractional function? -- don't know what this means, function pointer?! can't remember...
-				n = Syn::Noise::fbm_perlin2(v, _rotate_noise);
-				m_noiseData[index] = n;
-				unsigned char c = static_cast<unsigned char>(n * 255.0f);
+			uint32_t end = min(m_refineRow + blockRows, rowCount);
+			refineRows(m_refineRow, end);
+			m_refineRow = end;
 
-				m_pixelData[3 * index + 0] = c;
-				m_pixelData[3 * index + 1] = c;
-				m_pixelData[3 * index + 2] = c;
+			if (_budget_ms > 0.0f && timer.getDeltaTimeMs() >= _budget_ms)
+				break;
+		}
 
-			}
+		uploadRows(y0, min(m_refineRow * step, m_height));
+
+		// next level
+		if (m_refineRow == rowCount)
+		{
+			m_refineStep /= 2;
+			m_refineRow = 0;
 		}
 
-		SYN_RENDER_S0({
-			// upload to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		return m_refineStep == 0;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void Texture2DNoise::refineRows(uint32_t _row_begin, uint32_t _row_end)
+	{
+		uint32_t step = m_refineStep;
+		// samples on even rows and columns are known from the coarser level, so even rows
+		// only sample the odd columns
+		bool skipKnown = step < m_coarseStep;
+		uint32_t rowStride = skipKnown ? 2 : 1;
+		uint32_t fullFirst = skipKnown ? (_row_begin | 1) : _row_begin;
+		uint32_t knownFirst = (_row_begin + 1) & ~1u;
+		uint32_t fullRows = fullFirst < _row_end ? (_row_end - fullFirst + rowStride - 1) / rowStride : 0;
+		uint32_t knownRows = skipKnown && knownFirst < _row_end ? (_row_end - knownFirst + 1) / 2 : 0;
+		uint32_t fullColumns = (m_width + step - 1) / step;
+		uint32_t knownColumns = fullColumns / 2;
+
+		// noise of the block by Noise::evalGrid() : the fully sampled rows, then the rest
+		size_t knownOffset = (size_t)fullRows * fullColumns;
+		m_refineNoise.resize(knownOffset + (size_t)knownRows * knownColumns);
+		if (fullRows)
+		{
+			Linspace<float> x(0.0f, (float)((fullColumns - 1) * step), fullColumns);
+			Linspace<float> y((float)(fullFirst * step), (float)((fullFirst + (fullRows - 1) * rowStride) * step), fullRows);
+			Syn::Noise::evalGrid(x, y, m_refineNoise.data(), NoiseType::Perlin, m_rotateNoise);
+		}
+		if (knownRows && knownColumns)
+		{
+			Linspace<float> x((float)step, (float)((2 * knownColumns - 1) * step), knownColumns);
+			Linspace<float> y((float)(knownFirst * step), (float)((knownFirst + (knownRows - 1) * 2) * step), knownRows);
+			Syn::Noise::evalGrid(x, y, m_refineNoise.data() + knownOffset, NoiseType::Perlin, m_rotateNoise);
+		}
 
+		ThreadPool::get().parallelFor(_row_begin, _row_end, [&](size_t _row)
+		{
+			uint32_t y = (uint32_t)_row * step;
+			uint32_t y1 = min(y + step, m_height);
+			bool knownRow = skipKnown && (_row % 2) == 0;
+			uint32_t x0 = knownRow ? step : 0;
+			uint32_t dx = knownRow ? 2 * step : step;
+			const float* noise = knownRow ? m_refineNoise.data() + knownOffset + (_row - knownFirst) / 2 * knownColumns
+										  : m_refineNoise.data() + (_row - fullFirst) / rowStride * fullColumns;
+
+			for (uint32_t x = x0; x < m_width; x += dx)
+			{
+				float n = *noise++;
+				unsigned char c = to_pixel(n);
+
+				// replicate over the block of this level
+				uint32_t x1 = min(x + step, m_width);
+				for (uint32_t by = y; by < y1; by++)
+				{
+					size_t index = (size_t)by * m_width;
+					for (uint32_t bx = x; bx < x1; bx++)
+					{
+						m_noiseData[index + bx] = n;
+						m_pixelData[index + bx] = c;
+					}
+				}
+			}
+		});
 	}
-	
+
 
 	//-----------------------------------------------------------------------------------
 	void Texture2DNoise::setFromNoiseData(float* _noise_data)
 	{
-		// if reassignment, delete[]
-		if (m_noiseData != nullptr)
-			delete[] m_noiseData;
-
 		// copy and store data, don't store pointer
 		size_t sz = m_width * m_height;
-		m_noiseData = new float[sz];
 		memcpy(m_noiseData, _noise_data, sizeof(float) * sz);
 
-		uint32_t index;
-
-		for (uint32_t y = 0; y < m_height; y++)
-		{
-			for (uint32_t x = 0; x < m_width; x++)
-			{
-				index = y * m_width + x;
-				float n = _noise_data[index];
-				unsigned char c = static_cast<unsigned char>(n * 255.0f);
-				m_pixelData[3 * index + 0] = c;
-				m_pixelData[3 * index + 1] = c;
-				m_pixelData[3 * index + 2] = c;
-			}
-		}
-
-		SYN_RENDER_S0({
-			// upload to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		for (size_t i = 0; i < sz; i++)
+			m_pixelData[i] = to_pixel(_noise_data[i]);
 
+		uploadRows(0, m_height);
 	}
 
 
 	//-----------------------------------------------------------------------------------
 	void Texture2DNoise::setFromPixelData(unsigned char* _px_data)
 	{
-		if (m_pixelData != nullptr)
-			delete[] m_pixelData;
-
-		m_pixelData = new unsigned char[3 * m_width * m_height];
-		memcpy(m_pixelData, _px_data, 3 * m_width * m_height);
+		size_t sz = m_width * m_height;
+		for (size_t i = 0; i < sz; i++)
+			m_pixelData[i] = _px_data[3 * i];
 
-		SYN_RENDER_S0({
-			// upload to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		uploadRows(0, m_height, false);
 	}
 
 
@@ -229,20 +280,9 @@ namespace Syn
 		// cant scale using a negative value
 		float scale = max(_f, 0.0f);
 
-		uint32_t index;
-
-		for (uint32_t y = 0; y < m_height; y++)
-		{
-			for (uint32_t x = 0; x < m_width; x++)
-			{
-				index = y * m_width + x;
-				float old_c = static_cast<float>(m_pixelData[3 * index]);
-				unsigned char c = static_cast<unsigned char>(old_c * scale);
-				m_pixelData[3 * index + 0] = c;
-				m_pixelData[3 * index + 1] = c;
-				m_pixelData[3 * index + 2] = c;
-			}
-		}
+		size_t sz = m_width * m_height;
+		for (size_t i = 0; i < sz; i++)
+			m_pixelData[i] = static_cast<unsigned char>(static_cast<float>(m_pixelData[i]) * scale);
 	}
 
 
@@ -267,7 +307,6 @@ namespace Syn
 		float* incomingData = _texture_ptr->getNoiseData();
 		uint32_t index;
 		float a, b, n;
-		unsigned char c;
 
 		for (uint32_t y = 0; y < m_height; y++)
 		{
@@ -278,19 +317,33 @@ namespace Syn
 				b = incomingData[index];
 				n = a * thisWeight + b * thatWeight;
 				m_noiseData[index] = n;
-				
-				c = static_cast<unsigned char>(n * 255.0f);
-				m_pixelData[3 * index + 0] = c;
-				m_pixelData[3 * index + 1] = c;
-				m_pixelData[3 * index + 2] = c;
+				m_pixelData[index] = to_pixel(n);
 			}
 		}
 
-		SYN_RENDER_S0({
-			// upload to VRAM
-			glTextureSubImage2D(self->m_textureID, 0, 0, 0, self->m_width, self->m_height, GL_RGB, GL_UNSIGNED_BYTE, self->m_pixelData);
-		});
+		uploadRows(0, m_height);
+	}
 
+
+	//-----------------------------------------------------------------------------------
+	void Texture2DNoise::uploadRows(uint32_t _y0, uint32_t _y1, bool _from_noise)
+	{
+		if (_y1 <= _y0)
+			return;
+
+		uint32_t y0 = _y0;
+		uint32_t rows = _y1 - _y0;
+		bool fromNoise = _from_noise && m_format == ColorFormat::R32F;
+
+		SYN_RENDER_S3(y0, rows, fromNoise, {
+			// upload to VRAM; rows of single bytes aren't 4-byte aligned
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+			if (fromNoise)
+				glTextureSubImage2D(self->m_textureID, 0, 0, y0, self->m_width, rows, GL_RED, GL_FLOAT, self->m_noiseData + (size_t)y0 * self->m_width);
+			else
+				glTextureSubImage2D(self->m_textureID, 0, 0, y0, self->m_width, rows, GL_RED, GL_UNSIGNED_BYTE, self->m_pixelData + (size_t)y0 * self->m_width);
+			glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		});
 	}
 
 
@@ -298,7 +351,7 @@ namespace Syn
 	void Texture2DNoise::saveAsPNG(const std::string& _filename)
 	{
 		stbi_flip_vertically_on_write(1);
-		stbi_write_png(_filename.c_str(), m_width, m_height, 3, (void*)m_pixelData, 0);
+		stbi_write_png(_filename.c_str(), m_width, m_height, 1, (void*)m_pixelData, 0);
 	}
 
 
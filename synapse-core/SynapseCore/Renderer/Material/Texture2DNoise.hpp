@@ -12,17 +12,37 @@
 namespace Syn
 {
 
+	/* Single channel noise texture, stored as GL_R8 (default) or GL_R32F and swizzled to grey.
+	 * The noise values (m_noiseData) and their [0..255] conversion (m_pixelData) are kept on the
+	 * CPU; R32F textures are uploaded from the noise values where there are any, R8 textures
+	 * from the pixels.
+	 */
 	class Texture2DNoise : public Texture
 	{
 	public:
-		Texture2DNoise(uint32_t _side);
+		Texture2DNoise(uint32_t _side, ColorFormat _format=ColorFormat::R8);
 		~Texture2DNoise();
 
+		/* Debug views; _data is copied. */
 		void setDataDebug1D(float* _data);
 		void setDataDebug2D(float* _data, const glm::vec2& _noise_limits);
 		// TODO : which function in Syn::Noise to call? For now fBm of selected Syn::Noise::s_f_noise_2D_ptr
+		/* Regenerates the texture from Noise::fbm_perlin2(), with the current noise parameters, in
+		 * parallel row blocks on the ThreadPool. */
 		void setFromNoiseFunc(bool _rotate_noise=true);
+		/* Progressive regeneration, for interactive parameter changes : the coarsest level (every
+		 * _coarse_step:th sample, rounded to a power of 2, replicated over its block) is computed
+		 * immediately, finer levels by subsequent calls to refine(). Only samples not computed at
+		 * a coarser level are evaluated, so the total cost equals setFromNoiseFunc(). Calling this
+		 * again restarts the regeneration, e.g. when the parameters change. */
+		void beginNoiseFunc(bool _rotate_noise=true, uint32_t _coarse_step=8);
+		/* Continues a progressive regeneration for about _budget_ms (at least one block of rows),
+		 * or until the current level is done if _budget_ms is 0. Only the changed rows are uploaded.
+		 * Returns true when the texture is complete. */
+		bool refine(float _budget_ms=4.0f);
+		bool isRefining() const { return m_refineStep != 0; }
 		void setFromNoiseData(float* _noise_data);
+		/* _px_data is RGB, 3 bytes per pixel; the first channel is used. */
 		void setFromPixelData(unsigned char* _px_data);
 
 		/* Scales all pixel values with a factor _f. */
@@ -42,12 +62,27 @@ namespace Syn
 
 		// accessors
 		float* getNoiseData() { return m_noiseData; }
+		ColorFormat getFormat() const { return m_format; }
+
+
+	private:
+		/* Computes rows [_row_begin, _row_end) of the current refinement level. */
+		void refineRows(uint32_t _row_begin, uint32_t _row_end);
+		/* Uploads rows [_y0, _y1), from the noise values if _from_noise and R32F, else the pixels. */
+		void uploadRows(uint32_t _y0, uint32_t _y1, bool _from_noise=true);
 
 
 	private:
 		float* m_noiseData = nullptr;
 		unsigned char* m_pixelData = nullptr;
-
+		ColorFormat m_format = ColorFormat::R8;
+
+		// progressive regeneration : level step (0 if idle), next row (of the level)
+		bool m_rotateNoise = true;
+		uint32_t m_coarseStep = 1;
+		uint32_t m_refineStep = 0;
+		uint32_t m_refineRow = 0;
+		std::vector<float> m_refineNoise;	// noise of the rows being refined
 
 	};
 
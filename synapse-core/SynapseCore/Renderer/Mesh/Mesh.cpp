@@ -0,0 +1,142 @@
+#include "../../../pch.hpp"
+
+#include "Mesh.hpp"
+#include "MeshSimplifier.hpp"
+#include "MeshOptimizer.hpp"
+#include "../../Utils/Timer/Timer.hpp"
+
+
+namespace Syn {
+
+
+	//-----------------------------------------------------------------------------------
+	void Mesh::generateLODs(const float* _positions,
+							uint32_t _stride_bytes,
+							uint32_t _vertex_count,
+							const uint32_t* _indices,
+							const std::vector<Submesh>& _submeshes,
+							const std::vector<float>& _lod_ratios,
+							float _max_error)
+	{
+		SYN_CORE_ASSERT(m_vertexArray != nullptr, "vertex array has to be set before generating LODs.");
+
+		#ifdef DEBUG_MESH
+			Timer timer("", false);
+		#endif
+
+		// level 0 is the full resolution mesh
+		m_lods.clear();
+		m_lods.reserve(_lod_ratios.size() + 1);
+		m_currentLOD = 0;
+
+		MeshLOD lod0;
+		lod0.indexBuffer = m_vertexArray->getIndexBuffer();
+		lod0.submeshes = _submeshes;
+		lod0.triangleCount = lod0.indexBuffer->getIndexCount() / 3;
+		m_lods.push_back(lod0);
+
+		// error bound relative to the size of the mesh
+		AABB aabb = m_aabb;
+		if (aabb.min.x > aabb.max.x)
+		{
+			const uint8_t* base = reinterpret_cast<const uint8_t*>(_positions);
+			for (uint32_t v = 0; v < _vertex_count; v++)
+			{
+				const float* p = reinterpret_cast<const float*>(base + (size_t)v * _stride_bytes);
+				aabb.min = glm::min(aabb.min, glm::vec3(p[0], p[1], p[2]));
+				aabb.max = glm::max(aabb.max, glm::vec3(p[0], p[1], p[2]));
+			}
+		}
+		float maxError = _max_error * glm::length(aabb.max - aabb.min);
+
+		for (float ratio : _lod_ratios)
+		{
+			MeshLOD lod;
+			for (const Submesh& submesh : _submeshes)
+			{
+				const uint32_t* indices = _indices + submesh.baseIndex;
+				uint32_t vertexCount = 0;
+				for (uint32_t i = 0; i < submesh.indexCount; i++)
+					vertexCount = max(vertexCount, indices[i] + 1);
+
+				const float* positions = reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(_positions) + (size_t)submesh.baseVertex * _stride_bytes);
+				uint32_t target = static_cast<uint32_t>(submesh.indexCount * ratio) / 3 * 3;
+
+				float error = 0.0f;
+				std::vector<uint32_t> simplified = MeshSimplifier::simplify(positions, vertexCount, _stride_bytes, indices, submesh.indexCount, target, maxError, &error);
+				MeshOptimizer::optimizeVertexCache(simplified.data(), static_cast<uint32_t>(simplified.size()), vertexCount);
+
+				Submesh s = submesh;
+				s.baseIndex = static_cast<uint32_t>(lod.indices.size());
+				s.indexCount = static_cast<uint32_t>(simplified.size());
+				lod.submeshes.push_back(s);
+				lod.indices.insert(lod.indices.end(), simplified.begin(), simplified.end());
+				lod.error = max(lod.error, error);
+			}
+			lod.triangleCount = static_cast<uint32_t>(lod.indices.size() / 3);
+
+			#ifdef DEBUG_MESH
+				uint32_t budget = static_cast<uint32_t>(lod0.triangleCount * ratio);
+				SYN_CORE_TRACE("LOD ", m_lods.size(), ": ", lod.triangleCount, " triangles (budget ", budget, ", ",
+							   100.0f * lod.triangleCount / lod0.triangleCount, "%), error = ", lod.error, ".");
+				if (lod.triangleCount > budget + 3 * _submeshes.size())
+				{
+					SYN_CORE_WARNING("LOD ", m_lods.size(), " exceeds triangle budget (locked borders/seams or error bound reached).");
+				}
+				SYN_CORE_ASSERT(lod.error <= maxError, "LOD error exceeds error bound.");
+			#endif
+
+			// upload; the index data is kept with the level until the render queue is flushed
+			lod.indexBuffer = MakeRef<IndexBuffer>();
+			lod.indexBuffer->setData(lod.indices.data(), static_cast<uint32_t>(lod.indices.size()));
+			m_lods.push_back(std::move(lod));
+		}
+
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE(m_lods.size() - 1, " LODs generated in ", timer.getDeltaTimeMs(), " ms.");
+		#endif
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	uint32_t Mesh::selectLOD(const Ref<Camera>& _camera_ptr, float _viewport_height)
+	{
+		if (m_lods.size() < 2)
+			return m_currentLOD;
+
+		// bounding sphere, in world space
+		const glm::mat4& model = m_transform.getModelMatrix();
+		glm::vec4 center = model * glm::vec4(0.5f * (m_aabb.min + m_aabb.max), 1.0f);
+		float scale = max(glm::length(glm::vec3(model[0])), max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		float radius = 0.5f * glm::length(m_aabb.max - m_aabb.min) * scale;
+
+		float distance = glm::length(glm::vec3(center) - _camera_ptr->getPosition()) - radius;
+		distance = max(distance, _camera_ptr->getZNear());
+
+		// pixels per world unit at the closest point of the sphere
+		float pixelsPerUnit = _viewport_height / (2.0f * tanf(0.5f * glm::radians(_camera_ptr->getFOV())) * distance);
+		m_projectedSize = 2.0f * radius * pixelsPerUnit;
+
+		// coarsest level with a projected error below the threshold
+		uint32_t lod = 0;
+		for (uint32_t i = 1; i < m_lods.size(); i++)
+			if (m_lods[i].error * scale * pixelsPerUnit <= m_lodPixelError)
+				lod = i;
+
+		setLOD(lod);
+		return lod;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void Mesh::setLOD(uint32_t _lod)
+	{
+		if (_lod >= m_lods.size() || _lod == m_currentLOD)
+			return;
+
+		m_vertexArray->setIndexBuffer(m_lods[_lod].indexBuffer);
+		m_currentLOD = _lod;
+	}
+
+
+}
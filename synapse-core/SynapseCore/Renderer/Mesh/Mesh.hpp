@@ -22,6 +22,9 @@
 #define MESH_TRANSFORM_CENTER_Y			BIT_SHIFT(2)
 #define MESH_TRANSFORM_CENTER_Z			BIT_SHIFT(3)
 #define MESH_TRANSFORM_MATRIX			BIT_SHIFT(4)
+#define MESH_LOAD_OPTIMIZE				BIT_SHIFT(5)	// vertex cache and fetch reordering
+#define MESH_LOAD_PACKED_VERTICES		BIT_SHIFT(6)	// upload as VertexPacked, see MeshAssimp::render()
+#define MESH_LOAD_NO_CACHE				BIT_SHIFT(7)	// always import through Assimp
 
 #define MESH_ATTRIB_NONE				BIT_SHIFT(0)
 #define MESH_ATTRIB_POSITION			BIT_SHIFT(1)
@@ -47,6 +50,26 @@ namespace Syn {
 	};
 
 
+	struct MeshMaterial
+	{
+		std::string name = "";
+		std::string diffusePath = "";
+	};
+
+
+	/* A level of detail of a mesh; an index buffer into the (shared) vertex buffer of
+	 * the mesh, with the geometric error relative to the full resolution mesh.
+	 */
+	struct MeshLOD
+	{
+		Ref<IndexBuffer> indexBuffer = nullptr;
+		std::vector<uint32_t> indices;		// kept for the deferred upload
+		std::vector<Submesh> submeshes;		// per-level baseIndex and indexCount
+		uint32_t triangleCount = 0;
+		float error = 0.0f;					// object space units
+	};
+
+
 	// pure abstract
 	class Mesh
 	{
@@ -72,6 +95,35 @@ namespace Syn {
 		inline uint32_t getIndexCount() { return m_vertexArray->getIndexCount(); }
 		inline uint32_t getTriangleCount() { return m_vertexArray->getIndexCount() / 3; }
 
+		/* Builds a chain of simplified index buffers (using MeshSimplifier), one per 
+		 * ratio in _lod_ratios (e.g. { 0.5f, 0.25f, 0.1f } of the triangles). Level 0 is
+		 * the current index buffer. Submeshes are simplified separately; _positions are
+		 * read every _stride_bytes, and the indices of every submesh are relative to its
+		 * baseVertex. Each level stops early if its error would exceed _max_error, given
+		 * as a fraction of the AABB diagonal.
+		 */
+		void generateLODs(const float* _positions,
+						  uint32_t _stride_bytes,
+						  uint32_t _vertex_count,
+						  const uint32_t* _indices,
+						  const std::vector<Submesh>& _submeshes,
+						  const std::vector<float>& _lod_ratios,
+						  float _max_error=0.05f);
+		/* Selects the coarsest LOD whose error, projected to the screen, is below the
+		 * pixel threshold (see setLODPixelError()), from the projected screen-space size
+		 * of the bounding sphere of the mesh. Returns the selected level.
+		 */
+		uint32_t selectLOD(const Ref<Camera>& _camera_ptr, float _viewport_height);
+		// Explicitly sets the LOD, by swapping the index buffer of the vertex array.
+		void setLOD(uint32_t _lod);
+		inline uint32_t getLOD() const { return m_currentLOD; }
+		inline uint32_t getLODCount() const { return static_cast<uint32_t>(m_lods.size()); }
+		inline const MeshLOD& getLODData(uint32_t _lod) const { return m_lods[_lod]; }
+		inline void setLODPixelError(float _pixels) { m_lodPixelError = _pixels; }
+		inline float getLODPixelError() const { return m_lodPixelError; }
+		// Projected diameter (in pixels) of the bounding sphere, from the last selectLOD().
+		inline float getProjectedSize() const { return m_projectedSize; }
+
 
 	protected:
 		std::string m_assetPath = "";
@@ -79,6 +131,12 @@ namespace Syn {
 		Ref<VertexArray> m_vertexArray = nullptr;
 		Transform m_transform = Transform();
 
+		// LODs
+		std::vector<MeshLOD> m_lods;
+		uint32_t m_currentLOD = 0;
+		float m_lodPixelError = 1.0f;
+		float m_projectedSize = 0.0f;
+
 	};
 
 
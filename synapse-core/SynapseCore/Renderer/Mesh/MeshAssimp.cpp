@@ -9,8 +9,12 @@
 #include <assimp/LogStream.hpp>
 
 #include "MeshAssimp.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshCache.hpp"
 #include "../../Debug/Log.hpp"
 #include "../../Types.hpp"
+#include "../../Utils/Timer/Timer.hpp"
+#include "../../Utils/Thread/ThreadPool.hpp"
 
 
 namespace Syn {
@@ -55,6 +59,46 @@ namespace Syn {
 
 		SYN_CORE_TRACE("loading mesh '", m_assetPath, "'.");
 
+		#ifdef DEBUG_MESH
+			Timer timer("", false);
+		#endif
+
+		// processed data from the binary cache if valid, otherwise imported (and cached)
+		uint32_t processFlags = m_loadFlags & MESH_LOAD_OPTIMIZE;
+		std::string cachePath = MeshCache::getCachePath(m_assetPath);
+		uint64_t sourceHash = (m_loadFlags & MESH_LOAD_NO_CACHE) ? 0 : MeshCache::hashFile(m_assetPath);
+		bool cached = sourceHash != 0 && MeshCache::load(cachePath, sourceHash, s_meshImportFlags, processFlags,
+														 m_submeshes, m_materials, m_vertices, m_indices, m_aabb);
+		if (!cached)
+		{
+			import();
+
+			// reorder for the post-transform cache and for vertex fetch
+			if (m_loadFlags & MESH_LOAD_OPTIMIZE)
+				optimize();
+
+			if (sourceHash != 0)
+				MeshCache::save(cachePath, sourceHash, s_meshImportFlags, processFlags,
+								m_submeshes, m_materials, m_vertices, m_indices, m_aabb);
+		}
+
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE(cached ? "loaded from cache" : "imported", " in ", timer.getDeltaTimeMs(), " ms.");
+		#endif
+
+		// post-load flags
+		applyLoadTransform(_mesh_load_transform);
+
+		upload();
+
+		SYN_CORE_TRACE(m_vertices.size(), " vertices and ", m_indices.size(), " indices loaded.");
+
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshAssimp::import()
+	{
 		m_importer = std::make_unique<Assimp::Importer>();
 
 		const aiScene* scene = m_importer->ReadFile(m_assetPath, s_meshImportFlags);
@@ -68,6 +112,7 @@ namespace Syn {
 			SYN_CORE_TRACE("has animations = ", scene->HasAnimations() ? "TRUE" : "FALSE");
 		#endif
 
+		// submesh table; vertex and index offsets are a prefix sum over the submeshes
 		uint32_t vertexCount = 0;
 		uint32_t indexCount = 0;
 
@@ -88,71 +133,92 @@ namespace Syn {
 				SYN_CORE_TRACE("\tsubmesh.baseIndex = ", submesh.baseIndex);
 				SYN_CORE_TRACE("\tsubmesh.materialIndex = ", submesh.materialIndex);
 				SYN_CORE_TRACE("\tsubmesh.indexCount = ", submesh.indexCount);
-				//if (mesh->mMaterialIndex >= 0)
-				//{
-				//	aiMaterial* mat = scene->mMaterials[m];
-				//	aiString str;
-				//	uint32_t n = mat->GetTexture(aiTextureType_DIFFUSE, 0, &str);
-				//	SYN_CORE_TRACE("\tmaterial path = ", str.C_Str());
-				//}
+				SYN_CORE_TRACE("\ttangents/bitangents = ", mesh->HasTangentsAndBitangents() ? "TRUE" : "FALSE");
+				SYN_CORE_TRACE("\tUV coordinates = ", mesh->HasTextureCoords(0) ? "TRUE" : "FALSE");
 			#endif
 
 			vertexCount += mesh->mNumVertices;
 			indexCount += submesh.indexCount;
+		}
+
+		// convert submeshes in parallel, each writing to its own range of the buffers
+		m_vertices.resize(vertexCount);
+		m_indices.resize(indexCount / 3);
+		std::vector<AABB> submeshAABBs(scene->mNumMeshes);
+
+		#ifdef DEBUG_MESH
+			Timer timer("", false);
+		#endif
+
+		ThreadPool::get().parallelFor(0, scene->mNumMeshes, [&](size_t m)
+		{
+			const aiMesh* mesh = scene->mMeshes[m];
+			const Submesh& submesh = m_submeshes[m];
 
 			// vertices
+			VertexBase* vertices = &m_vertices[submesh.baseVertex];
+			glm::vec3 aabbMin = submeshAABBs[m].min;
+			glm::vec3 aabbMax = submeshAABBs[m].max;
 			for (size_t i = 0; i < mesh->mNumVertices; i++)
 			{
-				VertexBase vertex;
+				VertexBase& vertex = vertices[i];
 				vertex.position = { mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z };
-
-				// update AABB
-				m_aabb.min.x = min(m_aabb.min.x, vertex.position.x);
-				m_aabb.max.x = max(m_aabb.max.x, vertex.position.x);
-				m_aabb.min.y = min(m_aabb.min.y, vertex.position.y);
-				m_aabb.max.y = max(m_aabb.max.y, vertex.position.y);
-				m_aabb.min.z = min(m_aabb.min.z, vertex.position.z);
-				m_aabb.max.z = max(m_aabb.max.z, vertex.position.z);
+				aabbMin = glm::min(aabbMin, vertex.position);
+				aabbMax = glm::max(aabbMax, vertex.position);
 
 				vertex.normal = { mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z };
 
 				if (mesh->HasTangentsAndBitangents())
 				{
-					#ifdef DEBUG_MESH
-						if (m == 0 && i == 0)
-						{
-							SYN_CORE_TRACE("extracting tangents/bitangents.");
-						}
-					#endif
 					vertex.tangent = { mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z };
 					vertex.bitangent = { mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z };
 				}
 
 				if (mesh->HasTextureCoords(0))
-				{
-					#ifdef DEBUG_MESH
-						if (m == 0 && i == 0)
-						{
-							SYN_CORE_TRACE("extracting UV coordinates.");
-						}
-					#endif
 					vertex.uv = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
-				}
-
-				m_vertices.push_back(vertex);
-
 			}
+			submeshAABBs[m] = AABB(aabbMin, aabbMax);
 
 			// indices
+			Index* indices = &m_indices[submesh.baseIndex / 3];
 			for (size_t i = 0; i < mesh->mNumFaces; i++)
 			{
 				SYN_CORE_ASSERT(mesh->mFaces[i].mNumIndices == 3, "face must have 3 indices.");
-				m_indices.push_back({ mesh->mFaces[i].mIndices[0], mesh->mFaces[i].mIndices[1], mesh->mFaces[i].mIndices[2] });
+				indices[i] = { mesh->mFaces[i].mIndices[0], mesh->mFaces[i].mIndices[1], mesh->mFaces[i].mIndices[2] };
 			}
+		});
+
+		// reduce the submesh AABBs
+		for (const AABB& aabb : submeshAABBs)
+		{
+			m_aabb.min = glm::min(m_aabb.min, aabb.min);
+			m_aabb.max = glm::max(m_aabb.max, aabb.max);
 		}
 
-		// post-load flags
-		std::cout << "";
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE("converted ", scene->mNumMeshes, " submeshes on ", ThreadPool::get().isRunning() ? ThreadPool::get().threadCount() + 1 : 1, " threads in ", timer.getDeltaTimeMs(), " ms.");
+		#endif
+
+		// materials
+		m_materials.resize(scene->mNumMaterials);
+		for (size_t m = 0; m < scene->mNumMaterials; m++)
+		{
+			aiMaterial* material = scene->mMaterials[m];
+			aiString str;
+			if (material->Get(AI_MATKEY_NAME, str) == AI_SUCCESS)
+				m_materials[m].name = str.C_Str();
+			if (material->GetTexture(aiTextureType_DIFFUSE, 0, &str) == AI_SUCCESS)
+				m_materials[m].diffusePath = str.C_Str();
+		}
+
+		// store scene pointer
+		m_scene = scene;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshAssimp::applyLoadTransform(const Transform& _mesh_load_transform)
+	{
 		if (m_loadFlags != MESH_TRANSFORM_NONE)
 		{
 			// centering
@@ -203,19 +269,44 @@ namespace Syn {
 				m_aabb.max = glm::vec3(max.x, max.y, max.z);
 			}
 		}
+	}
+
 
+	//-----------------------------------------------------------------------------------
+	void MeshAssimp::upload()
+	{
 		// setup VAO, VBO, IBO
 		Ref<VertexBuffer> vertexBuffer = MakeRef<VertexBuffer>();
-		vertexBuffer->setBufferLayout({
-			{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_color" },
-			{ VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Float3, "a_normal" },
-			{ VERTEX_ATTRIB_LOCATION_TANGENT, ShaderDataType::Float3, "a_tangent" },
-			{ VERTEX_ATTRIB_LOCATION_BITANGENT, ShaderDataType::Float3, "a_bitangent" },
-			{ VERTEX_ATTRIB_LOCATION_UV, ShaderDataType::Float2, "a_uv" }
-		});
-		vertexBuffer->setData(m_vertices.data(), sizeof(VertexBase) * m_vertices.size());
+		if (m_loadFlags & MESH_LOAD_PACKED_VERTICES)
+		{
+			// quantized vertices; the normalized attributes read as before, but positions
+			// are relative to the bounds and need unpack_position() in the shader (see render())
+			m_packedVertices.resize(m_vertices.size());
+			MeshOptimizer::packVertices(m_vertices.data(), static_cast<uint32_t>(m_vertices.size()), m_packedVertices.data(),
+										m_positionScale, m_positionOffset);
+			vertexBuffer->setBufferLayout({
+				{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::UShort4, "a_position", true },
+				{ VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Int_2_10_10_10, "a_normal", true },
+				{ VERTEX_ATTRIB_LOCATION_TANGENT, ShaderDataType::Int_2_10_10_10, "a_tangent", true },
+				{ VERTEX_ATTRIB_LOCATION_BITANGENT, ShaderDataType::Int_2_10_10_10, "a_bitangent", true },
+				{ VERTEX_ATTRIB_LOCATION_UV, ShaderDataType::Half2, "a_uv" }
+			});
+			vertexBuffer->setData(m_packedVertices.data(), sizeof(VertexPacked) * m_packedVertices.size());
+		}
+		else
+		{
+			vertexBuffer->setBufferLayout({
+				{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_color" },
+				{ VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Float3, "a_normal" },
+				{ VERTEX_ATTRIB_LOCATION_TANGENT, ShaderDataType::Float3, "a_tangent" },
+				{ VERTEX_ATTRIB_LOCATION_BITANGENT, ShaderDataType::Float3, "a_bitangent" },
+				{ VERTEX_ATTRIB_LOCATION_UV, ShaderDataType::Float2, "a_uv" }
+			});
+			vertexBuffer->setData(m_vertices.data(), sizeof(VertexBase) * m_vertices.size());
+		}
 		#ifdef DEBUG_MESH
-			SYN_CORE_TRACE("vertex buffer size = ", sizeof(VertexBase) * m_vertices.size(), " bytes.");
+			uint32_t vertexSize = (m_loadFlags & MESH_LOAD_PACKED_VERTICES) ? sizeof(VertexPacked) : sizeof(VertexBase);
+			SYN_CORE_TRACE("vertex buffer size = ", vertexSize * m_vertices.size(), " bytes (", vertexSize, " bytes/vertex, ", sizeof(VertexBase), " unpacked).");
 		#endif
 
 		Ref<IndexBuffer> indexBuffer = MakeRef<IndexBuffer>();
@@ -225,12 +316,6 @@ namespace Syn {
 		#endif
 
 		m_vertexArray = MakeRef<VertexArray>(vertexBuffer, indexBuffer);
-
-		// store scene pointer
-		m_scene = scene;
-
-		SYN_CORE_TRACE(m_vertices.size(), " vertices and ", m_indices.size(), " indices loaded.");
-
 	}
 
 
@@ -238,10 +323,25 @@ namespace Syn {
 	void MeshAssimp::render(const Ref<Shader>& _shader_ptr)
 	{
 		_shader_ptr->setMatrix4fv("u_modelMatrix", m_transform.getModelMatrix());
+		if (m_loadFlags & MESH_LOAD_PACKED_VERTICES)
+		{
+			if (_shader_ptr->hasUniform("u_positionScale"))
+			{
+				_shader_ptr->setUniform3fv("u_positionScale", m_positionScale);
+				_shader_ptr->setUniform3fv("u_positionOffset", m_positionOffset);
+			}
+			else if (!m_reportedUnpackedShader)
+			{
+				SYN_CORE_WARNING(_shader_ptr->getName(), ": packed vertices drawn without unpack_position() (#include <packed_vertex>).");
+				m_reportedUnpackedShader = true;
+			}
+		}
 		m_vertexArray->bind();
 		//Renderer::drawIndexed(m_vertexArray->getNumIndices());
-		SYN_RENDER_S0({
-			for (Submesh& submesh : self->m_submeshes)
+		uint32_t lod = m_currentLOD;
+		SYN_RENDER_S1(lod, {
+			const std::vector<Submesh>& submeshes = self->m_lods.empty() ? self->m_submeshes : self->m_lods[lod].submeshes;
+			for (const Submesh& submesh : submeshes)
 			{
 				glDrawElementsBaseVertex(GL_TRIANGLES, submesh.indexCount, GL_UNSIGNED_INT, (void*)(sizeof(uint32_t) * submesh.baseIndex), submesh.baseVertex);
 			}
@@ -249,6 +349,56 @@ namespace Syn {
 	}
 
 
+	//-----------------------------------------------------------------------------------
+	void MeshAssimp::optimize()
+	{
+		#ifdef DEBUG_MESH
+			Timer timer("", false);
+			// triangle weighted ACMR over all submeshes
+			auto acmr = [&]() -> float
+			{
+				float sum = 0.0f;
+				for (size_t s = 0; s < m_submeshes.size(); s++)
+				{
+					uint32_t vertexCount = (s + 1 < m_submeshes.size() ? m_submeshes[s + 1].baseVertex : m_vertices.size()) - m_submeshes[s].baseVertex;
+					sum += MeshOptimizer::computeACMR(&m_indices[0].i0 + m_submeshes[s].baseIndex, m_submeshes[s].indexCount, vertexCount) * (m_submeshes[s].indexCount / 3);
+				}
+				return m_indices.size() > 0 ? sum / m_indices.size() : 0.0f;
+			};
+			float acmrBefore = acmr();
+		#endif
+
+		for (size_t s = 0; s < m_submeshes.size(); s++)
+		{
+			const Submesh& submesh = m_submeshes[s];
+			// submeshes are contiguous in m_vertices
+			uint32_t vertexCount = (s + 1 < m_submeshes.size() ? m_submeshes[s + 1].baseVertex : m_vertices.size()) - submesh.baseVertex;
+			uint32_t* indices = &m_indices[0].i0 + submesh.baseIndex;
+
+			MeshOptimizer::optimizeVertexCache(indices, submesh.indexCount, vertexCount);
+			MeshOptimizer::optimizeVertexFetch(&m_vertices[submesh.baseVertex], vertexCount, sizeof(VertexBase), indices, submesh.indexCount);
+		}
+
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE("vertex cache/fetch optimized in ", timer.getDeltaTimeMs(), " ms; ACMR ", acmrBefore, " -> ", acmr(), ".");
+		#endif
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshAssimp::generateLODs(const std::vector<float>& _lod_ratios, float _max_error)
+	{
+		// submesh indices are relative to baseVertex (cf. glDrawElementsBaseVertex)
+		Mesh::generateLODs(&m_vertices[0].position.x,
+						   sizeof(VertexBase),
+						   static_cast<uint32_t>(m_vertices.size()),
+						   &m_indices[0].i0,
+						   m_submeshes,
+						   _lod_ratios,
+						   _max_error);
+	}
+
+
 	//-----------------------------------------------------------------------------------
 	void MeshAssimp::printVertices(uint32_t _mesh_attrib_flags)
 	{
@@ -13,18 +13,51 @@ namespace Syn {
 	public:
 		MeshAssimp(const std::string& _file_path, uint32_t _mesh_load_flags=MESH_TRANSFORM_NONE, const Transform& _mesh_load_transform=Transform());
 
+		/* Draws the submeshes of the current LOD. With MESH_LOAD_PACKED_VERTICES, the
+		 * positions are quantized to the bounds of the mesh and the vertex shader has to
+		 * scale them back, with the uniforms set here :
+		 *   #include <packed_vertex>
+		 *   ...
+		 *   vec3 position = unpack_position(a_position.xyz);
+		 * The other attributes are normalized and read as before. A shader without the
+		 * uniforms is reported once.
+		 */
 		void render(const Ref<Shader>& _shader_ptr);
 		void printVertices(uint32_t _mesh_attrib_flags);
 
+		/* Generates a LOD chain from the loaded vertices, one level per ratio of the
+		 * original triangle count; see Mesh::generateLODs().
+		 */
+		using Mesh::generateLODs;
+		void generateLODs(const std::vector<float>& _lod_ratios={ 0.5f, 0.25f, 0.1f }, float _max_error=0.05f);
+
+
+		// accessors
+		inline const std::vector<Submesh>& getSubmeshes() const { return m_submeshes; }
+		inline const std::vector<MeshMaterial>& getMaterials() const { return m_materials; }
+
+
+	private:
+		// Load stages; Assimp import, optimization, load transforms and upload to the GPU.
+		void import();
+		// Vertex cache and fetch optimization, per submesh.
+		void optimize();
+		void applyLoadTransform(const Transform& _mesh_load_transform);
+		void upload();
 
 	private:
 		std::unique_ptr<Assimp::Importer> m_importer;
-		const aiScene* m_scene;
+		const aiScene* m_scene = nullptr;	// nullptr if loaded from the mesh cache
 
 		uint32_t m_loadFlags = 0;
 
 		std::vector<Submesh> m_submeshes;
+		std::vector<MeshMaterial> m_materials;
 		std::vector<VertexBase> m_vertices;
+		std::vector<VertexPacked> m_packedVertices;
+		glm::vec3 m_positionScale = glm::vec3(1.0f);	// dequantization of packed positions
+		glm::vec3 m_positionOffset = glm::vec3(0.0f);
+		bool m_reportedUnpackedShader = false;
 		std::vector<Index> m_indices;
 
 
@@ -0,0 +1,269 @@
+#include "../../../pch.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "MeshCache.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/MappedFile.hpp"
+
+
+namespace Syn {
+
+
+	static const char s_cacheMagic[4] = { 'S', 'Y', 'N', 'M' };
+	static const uint32_t s_cacheVersion = 1;
+
+
+	//-----------------------------------------------------------------------------------
+	struct mesh_cache_header_t
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t importFlags;
+		uint32_t processFlags;
+		uint32_t vertexSize;
+		uint32_t submeshCount;
+		uint32_t materialCount;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		float aabbMin[3];
+		float aabbMax[3];
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	// Bounds checked sequential reads from a mapped file.
+	struct cache_reader_t
+	{
+		const uint8_t* ptr;
+		const uint8_t* end;
+
+		inline size_t remaining() const { return (size_t)(end - ptr); }
+
+		// true if _count elements of _size bytes are left, checked before allocating
+		inline bool fits(uint64_t _count, size_t _size) const { return _count <= remaining() / _size; }
+
+		bool read(void* _dst, size_t _bytes)
+		{
+			if ((size_t)(end - ptr) < _bytes)
+				return false;
+			std::memcpy(_dst, ptr, _bytes);
+			ptr += _bytes;
+			return true;
+		}
+
+		bool readString(std::string& _s)
+		{
+			uint32_t length;
+			if (!read(&length, sizeof(uint32_t)))
+				return false;
+			uint32_t padded = (length + 3) & ~3u;
+			if ((size_t)(end - ptr) < padded)
+				return false;
+			_s.assign(reinterpret_cast<const char*>(ptr), length);
+			ptr += padded;
+			return true;
+		}
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	// Reads everything after the header. The counts of the header are checked against
+	// the size of the file before the containers are resized, and the submesh ranges
+	// and indices against the vertex and index counts, since draws and the optimizer
+	// index with them.
+	static bool read_mesh_data(cache_reader_t& _reader,
+							   const mesh_cache_header_t& _header,
+							   std::vector<Submesh>& _submeshes,
+							   std::vector<MeshMaterial>& _materials,
+							   std::vector<VertexBase>& _vertices,
+							   std::vector<Index>& _indices)
+	{
+		// submeshes and materials (two length prefixes each, at least)
+		if (!_reader.fits(_header.submeshCount, sizeof(Submesh)))
+			return false;
+		_submeshes.resize(_header.submeshCount);
+		if (!_reader.read(_submeshes.data(), sizeof(Submesh) * _header.submeshCount))
+			return false;
+
+		if (!_reader.fits(_header.materialCount, 2 * sizeof(uint32_t)))
+			return false;
+		_materials.resize(_header.materialCount);
+		for (MeshMaterial& material : _materials)
+			if (!_reader.readString(material.name) || !_reader.readString(material.diffusePath))
+				return false;
+
+		// vertex and index data, in GPU layout
+		uint64_t dataBytes = (uint64_t)_header.vertexCount * sizeof(VertexBase) + (uint64_t)_header.indexCount * sizeof(uint32_t);
+		if (dataBytes > _reader.remaining())
+			return false;
+		_vertices.resize(_header.vertexCount);
+		_indices.resize(_header.indexCount / 3);
+		_reader.read(_vertices.data(), sizeof(VertexBase) * _header.vertexCount);
+		_reader.read(_indices.data(), sizeof(uint32_t) * _header.indexCount);
+
+		// submesh ranges; a submesh owns the vertices up to the next one (cf.
+		// MeshAssimp::optimize()), and its indices are relative to baseVertex
+		const uint32_t* indices = reinterpret_cast<const uint32_t*>(_indices.data());
+		for (size_t s = 0; s < _submeshes.size(); s++)
+		{
+			const Submesh& submesh = _submeshes[s];
+			uint32_t vertexEnd = s + 1 < _submeshes.size() ? _submeshes[s + 1].baseVertex : _header.vertexCount;
+			if (submesh.baseVertex > vertexEnd || vertexEnd > _header.vertexCount ||
+				submesh.indexCount % 3 != 0 || submesh.baseIndex % 3 != 0 ||
+				(uint64_t)submesh.baseIndex + submesh.indexCount > _header.indexCount)
+				return false;
+
+			uint32_t vertexCount = vertexEnd - submesh.baseVertex;
+			for (uint32_t i = 0; i < submesh.indexCount; i++)
+				if (indices[submesh.baseIndex + i] >= vertexCount)
+					return false;
+		}
+
+		return true;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static void write_string(std::ofstream& _file, const std::string& _s)
+	{
+		static const char s_padding[4] = { 0 };
+		uint32_t length = static_cast<uint32_t>(_s.size());
+		_file.write(reinterpret_cast<const char*>(&length), sizeof(uint32_t));
+		_file.write(_s.data(), length);
+		_file.write(s_padding, ((length + 3) & ~3u) - length);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	uint64_t MeshCache::hashFile(const std::string& _file_path)
+	{
+		MappedFile file(_file_path, true);
+		if (!file.data())
+			return 0;
+
+		uint64_t hash = 14695981039346656037ull;
+		const uint8_t* data = file.data();
+		for (size_t i = 0; i < file.size(); i++)
+		{
+			hash ^= data[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	bool MeshCache::load(const std::string& _cache_path,
+						 uint64_t _source_hash,
+						 uint32_t _import_flags,
+						 uint32_t _process_flags,
+						 std::vector<Submesh>& _submeshes,
+						 std::vector<MeshMaterial>& _materials,
+						 std::vector<VertexBase>& _vertices,
+						 std::vector<Index>& _indices,
+						 AABB& _aabb)
+	{
+		MappedFile file(_cache_path, true);
+		if (!file.data())
+			return false;
+
+		cache_reader_t reader = { file.data(), file.data() + file.size() };
+
+		mesh_cache_header_t header;
+		if (!reader.read(&header, sizeof(mesh_cache_header_t)) ||
+			std::memcmp(header.magic, s_cacheMagic, sizeof(s_cacheMagic)) != 0)
+		{
+			SYN_CORE_WARNING("'", _cache_path, "' is not a mesh cache.");
+			return false;
+		}
+
+		if (header.version != s_cacheVersion || header.vertexSize != sizeof(VertexBase) ||
+			header.sourceHash != _source_hash || header.importFlags != _import_flags || header.processFlags != _process_flags ||
+			header.indexCount % 3 != 0)
+		{
+			SYN_CORE_TRACE("mesh cache '", _cache_path, "' is stale.");
+			return false;
+		}
+
+		// a corrupt cache is treated as stale; the containers are cleared, since the
+		// caller imports into them next
+		if (!read_mesh_data(reader, header, _submeshes, _materials, _vertices, _indices))
+		{
+			SYN_CORE_WARNING("mesh cache '", _cache_path, "' is truncated or corrupt.");
+			_submeshes.clear();
+			_materials.clear();
+			_vertices.clear();
+			_indices.clear();
+			return false;
+		}
+
+		_aabb.min = glm::vec3(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]);
+		_aabb.max = glm::vec3(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]);
+
+		return true;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	bool MeshCache::save(const std::string& _cache_path,
+						 uint64_t _source_hash,
+						 uint32_t _import_flags,
+						 uint32_t _process_flags,
+						 const std::vector<Submesh>& _submeshes,
+						 const std::vector<MeshMaterial>& _materials,
+						 const std::vector<VertexBase>& _vertices,
+						 const std::vector<Index>& _indices,
+						 const AABB& _aabb)
+	{
+		mesh_cache_header_t header;
+		std::memset(&header, 0, sizeof(mesh_cache_header_t));
+		std::memcpy(header.magic, s_cacheMagic, sizeof(s_cacheMagic));
+		header.version = s_cacheVersion;
+		header.sourceHash = _source_hash;
+		header.importFlags = _import_flags;
+		header.processFlags = _process_flags;
+		header.vertexSize = sizeof(VertexBase);
+		header.submeshCount = static_cast<uint32_t>(_submeshes.size());
+		header.materialCount = static_cast<uint32_t>(_materials.size());
+		header.vertexCount = static_cast<uint32_t>(_vertices.size());
+		header.indexCount = static_cast<uint32_t>(_indices.size() * 3);
+		for (uint32_t i = 0; i < 3; i++)
+		{
+			header.aabbMin[i] = _aabb.min[i];
+			header.aabbMax[i] = _aabb.max[i];
+		}
+
+		std::string tmpPath = _cache_path + ".tmp";
+		std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SYN_CORE_WARNING("could not write mesh cache '", _cache_path, "'.");
+			return false;
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(mesh_cache_header_t));
+		file.write(reinterpret_cast<const char*>(_submeshes.data()), sizeof(Submesh) * _submeshes.size());
+		for (const MeshMaterial& material : _materials)
+		{
+			write_string(file, material.name);
+			write_string(file, material.diffusePath);
+		}
+		file.write(reinterpret_cast<const char*>(_vertices.data()), sizeof(VertexBase) * _vertices.size());
+		file.write(reinterpret_cast<const char*>(_indices.data()), sizeof(Index) * _indices.size());
+		file.close();
+
+		if (!file.good() || std::rename(tmpPath.c_str(), _cache_path.c_str()) != 0)
+		{
+			SYN_CORE_WARNING("could not write mesh cache '", _cache_path, "'.");
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+
+		return true;
+	}
+
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+
+#include <string>
+#include <vector>
+
+#include "Mesh.hpp"
+#include "../../Types.hpp"
+
+
+namespace Syn {
+
+
+	/* Binary cache of imported meshes, holding the processed (triangulated, optimized)
+	 * vertex and index buffers, submesh table, AABB and materials, as written after
+	 * the first import. The layout matches the GPU vertex layout, so loading is a
+	 * mapping of the file followed by block copies; no per-vertex work.
+	 *
+	 * File layout (native endianness):
+	 *   header | Submesh[submeshCount] | materials | VertexBase[vertexCount] | uint32_t[indexCount]
+	 * where materials are length-prefixed (uint32_t) strings, name and diffuse path,
+	 * padded to 4 bytes. A cache is invalid if the hash of the source file, the Assimp
+	 * import flags, the processing flags (load flags affecting the data, e.g.
+	 * MESH_LOAD_OPTIMIZE), the version or the vertex size differ.
+	 */
+	class MeshCache
+	{
+	public:
+		// Cache file path of a source asset.
+		static std::string getCachePath(const std::string& _asset_path) { return _asset_path + ".syncache"; }
+
+		// 64-bit FNV-1a hash of the contents of a file, 0 if it could not be read.
+		static uint64_t hashFile(const std::string& _file_path);
+
+		/* Loads the cache at _cache_path into the supplied containers. Returns false
+		 * if the file doesn't exist, is corrupt or stale (see above).
+		 */
+		static bool load(const std::string& _cache_path,
+						 uint64_t _source_hash,
+						 uint32_t _import_flags,
+						 uint32_t _process_flags,
+						 std::vector<Submesh>& _submeshes,
+						 std::vector<MeshMaterial>& _materials,
+						 std::vector<VertexBase>& _vertices,
+						 std::vector<Index>& _indices,
+						 AABB& _aabb);
+
+		/* Writes a cache; written to a temporary file first and then renamed, so a
+		 * partially written cache is never read.
+		 */
+		static bool save(const std::string& _cache_path,
+						 uint64_t _source_hash,
+						 uint32_t _import_flags,
+						 uint32_t _process_flags,
+						 const std::vector<Submesh>& _submeshes,
+						 const std::vector<MeshMaterial>& _materials,
+						 const std::vector<VertexBase>& _vertices,
+						 const std::vector<Index>& _indices,
+						 const AABB& _aabb);
+
+	};
+
+
+}
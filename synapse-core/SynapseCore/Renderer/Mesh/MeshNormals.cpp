@@ -0,0 +1,235 @@
+#include "../../../pch.hpp"
+
+#include <cmath>
+
+#include "MeshNormals.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/MathUtils.hpp"
+#include "../../Utils/CPUFeatures.hpp"
+
+
+
+namespace Syn {
+
+
+	// Computes the normals of the interior vertices of a grid row, from j = 1 up to the
+	// returned index; the remainder is done by the scalar path.
+	typedef uint32_t (*grid_row_kernel_t)(const float*, const float*, const float*, uint32_t, float, float, glm::vec3*);
+
+	// Computes _count normals from _count gradients, up to the returned index.
+	typedef uint32_t (*gradient_kernel_t)(const glm::vec2*, uint32_t, const glm::vec2&, glm::vec3*);
+
+
+	//-----------------------------------------------------------------------------------
+	static inline glm::vec3 normal_from_gradient(float _gx, float _gz)
+	{
+		float length_i = 1.0f / std::sqrt(_gx * _gx + _gz * _gz + 1.0f);
+		return glm::vec3(-_gx * length_i, length_i, -_gz * length_i);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static void grid_row_scalar(const float* _h, const float* _hu, const float* _hd, uint32_t _j_begin, uint32_t _j_end, float _sx, float _sz, glm::vec3* _out)
+	{
+		for (uint32_t j = _j_begin; j < _j_end; j++)
+			_out[j] = normal_from_gradient((_h[j + 1] - _h[j - 1]) * _sx, (_hd[j] - _hu[j]) * _sz);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static uint32_t grid_row_none(const float*, const float*, const float*, uint32_t, float, float, glm::vec3*)
+	{
+		return 1;
+	}
+	//-----------------------------------------------------------------------------------
+	static uint32_t gradients_none(const glm::vec2*, uint32_t, const glm::vec2&, glm::vec3*)
+	{
+		return 0;
+	}
+
+
+#ifdef SYN_SIMD_X86
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2,fma")))
+	static inline void store_normals_avx2(__m256 _gx, __m256 _gz, glm::vec3* _out)
+	{
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+
+		__m256 length_i = _mm256_div_ps(one, _mm256_sqrt_ps(_mm256_fmadd_ps(_gx, _gx, _mm256_fmadd_ps(_gz, _gz, one))));
+		alignas(32) float x[8], y[8], z[8];
+		_mm256_store_ps(x, _mm256_xor_ps(_mm256_mul_ps(_gx, length_i), sign));
+		_mm256_store_ps(y, length_i);
+		_mm256_store_ps(z, _mm256_xor_ps(_mm256_mul_ps(_gz, length_i), sign));
+		for (uint32_t k = 0; k < 8; k++)
+			_out[k] = glm::vec3(x[k], y[k], z[k]);
+	}
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2,fma")))
+	static uint32_t grid_row_avx2(const float* _h, const float* _hu, const float* _hd, uint32_t _nx, float _sx, float _sz, glm::vec3* _out)
+	{
+		const __m256 sx = _mm256_set1_ps(_sx);
+		const __m256 sz = _mm256_set1_ps(_sz);
+
+		uint32_t j = 1;
+		for (; j + 8 <= _nx - 1; j += 8)
+		{
+			__m256 gx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(_h + j + 1), _mm256_loadu_ps(_h + j - 1)), sx);
+			__m256 gz = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(_hd + j), _mm256_loadu_ps(_hu + j)), sz);
+			store_normals_avx2(gx, gz, _out + j);
+		}
+		return j;
+	}
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2,fma")))
+	static uint32_t gradients_avx2(const glm::vec2* _gradients, uint32_t _count, const glm::vec2& _scale, glm::vec3* _out)
+	{
+		const __m256 sx = _mm256_set1_ps(_scale.x);
+		const __m256 sz = _mm256_set1_ps(_scale.y);
+		const float* g = &_gradients[0].x;
+
+		uint32_t i = 0;
+		for (; i + 8 <= _count; i += 8)
+		{
+			// de-interleave 8 (dx, dz) pairs
+			__m256 a = _mm256_loadu_ps(g + 2 * i);
+			__m256 b = _mm256_loadu_ps(g + 2 * i + 8);
+			__m256 gx = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))), _MM_SHUFFLE(3, 1, 2, 0)));
+			__m256 gz = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))), _MM_SHUFFLE(3, 1, 2, 0)));
+			store_normals_avx2(_mm256_mul_ps(gx, sx), _mm256_mul_ps(gz, sz), _out + i);
+		}
+		return i;
+	}
+#endif
+
+
+#ifdef SYN_SIMD_NEON
+	//-----------------------------------------------------------------------------------
+	static inline void store_normals_neon(float32x4_t _gx, float32x4_t _gz, glm::vec3* _out)
+	{
+		const float32x4_t one = vdupq_n_f32(1.0f);
+
+		float32x4_t length_i = vdivq_f32(one, vsqrtq_f32(vfmaq_f32(vfmaq_f32(one, _gz, _gz), _gx, _gx)));
+		float32x4x3_t n;
+		n.val[0] = vnegq_f32(vmulq_f32(_gx, length_i));
+		n.val[1] = length_i;
+		n.val[2] = vnegq_f32(vmulq_f32(_gz, length_i));
+		vst3q_f32(&_out[0].x, n);
+	}
+	//-----------------------------------------------------------------------------------
+	static uint32_t grid_row_neon(const float* _h, const float* _hu, const float* _hd, uint32_t _nx, float _sx, float _sz, glm::vec3* _out)
+	{
+		const float32x4_t sx = vdupq_n_f32(_sx);
+		const float32x4_t sz = vdupq_n_f32(_sz);
+
+		uint32_t j = 1;
+		for (; j + 4 <= _nx - 1; j += 4)
+		{
+			float32x4_t gx = vmulq_f32(vsubq_f32(vld1q_f32(_h + j + 1), vld1q_f32(_h + j - 1)), sx);
+			float32x4_t gz = vmulq_f32(vsubq_f32(vld1q_f32(_hd + j), vld1q_f32(_hu + j)), sz);
+			store_normals_neon(gx, gz, _out + j);
+		}
+		return j;
+	}
+	//-----------------------------------------------------------------------------------
+	static uint32_t gradients_neon(const glm::vec2* _gradients, uint32_t _count, const glm::vec2& _scale, glm::vec3* _out)
+	{
+		const float32x4_t sx = vdupq_n_f32(_scale.x);
+		const float32x4_t sz = vdupq_n_f32(_scale.y);
+
+		uint32_t i = 0;
+		for (; i + 4 <= _count; i += 4)
+		{
+			float32x4x2_t g = vld2q_f32(&_gradients[i].x);
+			store_normals_neon(vmulq_f32(g.val[0], sx), vmulq_f32(g.val[1], sz), _out + i);
+		}
+		return i;
+	}
+#endif
+
+
+	//-----------------------------------------------------------------------------------
+	struct normal_kernels_t
+	{
+		grid_row_kernel_t gridRow = grid_row_none;
+		gradient_kernel_t gradients = gradients_none;
+		const char* name = "scalar";
+	};
+	//-----------------------------------------------------------------------------------
+	static const normal_kernels_t& get_kernels()
+	{
+		static normal_kernels_t s_kernels = []()
+		{
+			normal_kernels_t kernels;
+			#if defined(SYN_SIMD_X86)
+				if (cpu_features().avx2 && cpu_features().fma)
+					kernels = { grid_row_avx2, gradients_avx2, "AVX2" };
+			#elif defined(SYN_SIMD_NEON)
+				if (cpu_features().neon)
+					kernels = { grid_row_neon, gradients_neon, "NEON" };
+			#endif
+			return kernels;
+		}();
+		return s_kernels;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshNormals::computeGridNormals(const float* _heights,
+										 uint32_t _nx,
+										 uint32_t _nz,
+										 float _dx,
+										 float _dz,
+										 glm::vec3* _normals,
+										 uint32_t _row_begin,
+										 uint32_t _row_end)
+	{
+		SYN_CORE_ASSERT(_nx > 1 && _nz > 1, "grid has to be at least 2x2.");
+
+		grid_row_kernel_t kernel = get_kernels().gridRow;
+		_row_end = min(_row_end, _nz);
+
+		float sx1 = 1.0f / _dx;			// one-sided
+		float sx2 = 0.5f / _dx;			// central
+		for (uint32_t i = _row_begin; i < _row_end; i++)
+		{
+			uint32_t iu = i > 0 ? i - 1 : i;
+			uint32_t id = i < _nz - 1 ? i + 1 : i;
+			float sz = 1.0f / ((float)(id - iu) * _dz);
+
+			const float* h = &_heights[i * _nx];
+			const float* hu = &_heights[iu * _nx];
+			const float* hd = &_heights[id * _nx];
+			glm::vec3* out = &_normals[(i - _row_begin) * _nx];
+
+			// x borders
+			out[0] = normal_from_gradient((h[1] - h[0]) * sx1, (hd[0] - hu[0]) * sz);
+			out[_nx - 1] = normal_from_gradient((h[_nx - 1] - h[_nx - 2]) * sx1, (hd[_nx - 1] - hu[_nx - 1]) * sz);
+
+			// interior
+			uint32_t j = kernel(h, hu, hd, _nx, sx2, sz, out);
+			grid_row_scalar(h, hu, hd, j, _nx - 1, sx2, sz, out);
+		}
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshNormals::computeNormalsFromGradients(const glm::vec2* _gradients,
+												  uint32_t _count,
+												  glm::vec3* _normals,
+												  const glm::vec2& _scale)
+	{
+		uint32_t i = get_kernels().gradients(_gradients, _count, _scale, _normals);
+		for (; i < _count; i++)
+			_normals[i] = normal_from_gradient(_gradients[i].x * _scale.x, _gradients[i].y * _scale.y);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	const char* MeshNormals::getSIMDPath()
+	{
+		return get_kernels().name;
+	}
+
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+
+#include <stdint.h>
+
+#include <glm/glm.hpp>
+
+
+namespace Syn {
+
+
+	/* Normal generation for regular height grids, vectorized with AVX2 (selected at
+	 * runtime) or NEON, with a scalar fallback.
+	 *
+	 * Heights are row-major over z, i.e. _heights[i * _nx + j] is the height at
+	 * (x_j, z_i). Normals are normalize(-dh/dx, 1, -dh/dz), which for finite
+	 * differences is identical to the cross product of the central difference vectors
+	 * (UD x LR) used by MESH_NORMALS_APPROX_FAST, and on a uniform grid also to the
+	 * sum of the four quadrant cross products of MESH_NORMALS_APPROX.
+	 */
+	class MeshNormals
+	{
+	public:
+		/* Finite differences (central, one-sided at the borders) over a grid with spacing
+		 * _dx and _dz. Only rows [_row_begin, _row_end) are computed, written to _normals
+		 * starting at the first normal of _row_begin; the heights are always the full
+		 * grid. The grid has to be at least 2x2.
+		 */
+		static void computeGridNormals(const float* _heights,
+									   uint32_t _nx,
+									   uint32_t _nz,
+									   float _dx,
+									   float _dz,
+									   glm::vec3* _normals,
+									   uint32_t _row_begin=0,
+									   uint32_t _row_end=UINT32_MAX);
+
+		/* Analytic normals from gradients (dh/dx, dh/dz) per vertex, e.g. from
+		 * NoiseGenerator::eval_d() or Noise::fbm_perlin2_d(). _scale converts the
+		 * gradients to mesh units, i.e. the height scale divided by the scale from mesh
+		 * to noise coordinates, per axis.
+		 */
+		static void computeNormalsFromGradients(const glm::vec2* _gradients,
+												uint32_t _count,
+												glm::vec3* _normals,
+												const glm::vec2& _scale=glm::vec2(1.0f));
+
+		// Instruction set used by the kernels ("AVX2", "NEON" or "scalar").
+		static const char* getSIMDPath();
+
+	};
+
+
+}
@@ -0,0 +1,268 @@
+#include "../../../pch.hpp"
+
+#include <cstring>
+#include <cmath>
+
+#include "MeshOptimizer.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/MathUtils.hpp"
+
+
+namespace Syn {
+
+
+	// Forsyth scoring parameters; the simulated cache is LRU.
+	static const uint32_t s_cacheSize = 32;
+	static const float s_cacheDecayPower = 1.5f;
+	static const float s_lastTriangleScore = 0.75f;
+	static const float s_valenceBoostScale = 2.0f;
+	static const float s_valenceBoostPower = 0.5f;
+	static const uint32_t s_valenceTableSize = 32;
+
+
+	//-----------------------------------------------------------------------------------
+	static float vertex_score(int32_t _cache_position, uint32_t _remaining_triangles)
+	{
+		static float s_cacheScores[s_cacheSize];
+		static float s_valenceScores[s_valenceTableSize];
+		static bool s_tablesInitialized = [&]()
+		{
+			for (uint32_t i = 0; i < s_cacheSize; i++)
+			{
+				if (i < 3)
+					s_cacheScores[i] = s_lastTriangleScore;
+				else
+					s_cacheScores[i] = powf(1.0f - (float)(i - 3) / (float)(s_cacheSize - 3), s_cacheDecayPower);
+			}
+			s_valenceScores[0] = 0.0f;
+			for (uint32_t i = 1; i < s_valenceTableSize; i++)
+				s_valenceScores[i] = s_valenceBoostScale * powf((float)i, -s_valenceBoostPower);
+			return true;
+		}();
+		(void)s_tablesInitialized;
+
+		// no triangles left using this vertex
+		if (_remaining_triangles == 0)
+			return -1.0f;
+
+		float score = _cache_position < 0 ? 0.0f : s_cacheScores[_cache_position];
+		if (_remaining_triangles < s_valenceTableSize)
+			score += s_valenceScores[_remaining_triangles];
+		else
+			score += s_valenceBoostScale * powf((float)_remaining_triangles, -s_valenceBoostPower);
+		return score;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshOptimizer::optimizeVertexCache(uint32_t* _indices, uint32_t _index_count, uint32_t _vertex_count)
+	{
+		uint32_t triangleCount = _index_count / 3;
+		if (triangleCount == 0)
+			return;
+
+		// vertex -> triangle adjacency; the live part of each list is remaining[v] long
+		std::vector<uint32_t> remaining(_vertex_count, 0);
+		for (uint32_t i = 0; i < _index_count; i++)
+			remaining[_indices[i]]++;
+
+		std::vector<uint32_t> offsets(_vertex_count + 1, 0);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+			offsets[v + 1] = offsets[v] + remaining[v];
+
+		std::vector<uint32_t> adjacency(_index_count);
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (uint32_t i = 0; i < _index_count; i++)
+			adjacency[fill[_indices[i]]++] = i / 3;
+
+		std::vector<int32_t> cachePosition(_vertex_count, -1);
+		std::vector<float> vertexScores(_vertex_count);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+			vertexScores[v] = vertex_score(-1, remaining[v]);
+
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> output;
+		output.reserve(_index_count);
+
+		uint32_t cache[s_cacheSize + 3];
+		uint32_t nextCache[s_cacheSize + 3];
+		uint32_t cacheCount = 0;
+
+		int64_t best = -1;
+		uint32_t cursor = 0;
+
+		while (output.size() < _index_count)
+		{
+			// no candidates in the cache, continue with the next triangle in input order
+			if (best < 0)
+			{
+				while (emitted[cursor])
+					cursor++;
+				best = cursor;
+			}
+
+			const uint32_t* triangle = &_indices[best * 3];
+			output.insert(output.end(), triangle, triangle + 3);
+			emitted[best] = 1;
+
+			// remove the triangle from the adjacency of its vertices
+			for (uint32_t k = 0; k < 3; k++)
+			{
+				uint32_t v = triangle[k];
+				uint32_t* list = &adjacency[offsets[v]];
+				for (uint32_t a = 0; a < remaining[v]; a++)
+				{
+					if (list[a] == (uint32_t)best)
+					{
+						list[a] = list[remaining[v] - 1];
+						break;
+					}
+				}
+				remaining[v]--;
+			}
+
+			// LRU update; the vertices of the emitted triangle move to the front
+			uint32_t nextCount = 0;
+			for (uint32_t k = 0; k < 3; k++)
+				nextCache[nextCount++] = triangle[k];
+			for (uint32_t i = 0; i < cacheCount; i++)
+			{
+				uint32_t v = cache[i];
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+					nextCache[nextCount++] = v;
+			}
+			for (uint32_t i = s_cacheSize; i < nextCount; i++)
+			{
+				cachePosition[nextCache[i]] = -1;
+				vertexScores[nextCache[i]] = vertex_score(-1, remaining[nextCache[i]]);
+			}
+			cacheCount = min(nextCount, s_cacheSize);
+			for (uint32_t i = 0; i < cacheCount; i++)
+			{
+				cache[i] = nextCache[i];
+				cachePosition[cache[i]] = i;
+				vertexScores[cache[i]] = vertex_score(i, remaining[cache[i]]);
+			}
+
+			// next triangle: the highest scoring one using a cached vertex
+			best = -1;
+			float bestScore = -1.0f;
+			for (uint32_t i = 0; i < cacheCount; i++)
+			{
+				uint32_t v = cache[i];
+				const uint32_t* list = &adjacency[offsets[v]];
+				for (uint32_t a = 0; a < remaining[v]; a++)
+				{
+					uint32_t t = list[a] * 3;
+					float score = vertexScores[_indices[t + 0]] + vertexScores[_indices[t + 1]] + vertexScores[_indices[t + 2]];
+					if (score > bestScore)
+					{
+						bestScore = score;
+						best = list[a];
+					}
+				}
+			}
+		}
+
+		std::memcpy(_indices, output.data(), sizeof(uint32_t) * _index_count);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	uint32_t MeshOptimizer::optimizeVertexFetch(void* _vertices, uint32_t _vertex_count, uint32_t _vertex_size, uint32_t* _indices, uint32_t _index_count)
+	{
+		std::vector<uint32_t> remap(_vertex_count, UINT32_MAX);
+		uint32_t next = 0;
+		for (uint32_t i = 0; i < _index_count; i++)
+		{
+			uint32_t& r = remap[_indices[i]];
+			if (r == UINT32_MAX)
+				r = next++;
+			_indices[i] = r;
+		}
+
+		uint32_t referencedCount = next;
+		for (uint32_t v = 0; v < _vertex_count; v++)
+			if (remap[v] == UINT32_MAX)
+				remap[v] = next++;
+
+		uint8_t* vertices = reinterpret_cast<uint8_t*>(_vertices);
+		std::vector<uint8_t> reordered((size_t)_vertex_count * _vertex_size);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+			std::memcpy(&reordered[(size_t)remap[v] * _vertex_size], vertices + (size_t)v * _vertex_size, _vertex_size);
+		std::memcpy(vertices, reordered.data(), reordered.size());
+
+		return referencedCount;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	float MeshOptimizer::computeACMR(const uint32_t* _indices, uint32_t _index_count, uint32_t _vertex_count, uint32_t _cache_size)
+	{
+		if (_index_count < 3)
+			return 0.0f;
+
+		// FIFO: a vertex is cached if less than _cache_size misses occured since its own
+		std::vector<uint32_t> timestamps(_vertex_count, 0);
+		uint32_t time = _cache_size + 1;
+		uint32_t misses = 0;
+		for (uint32_t i = 0; i < _index_count; i++)
+		{
+			uint32_t v = _indices[i];
+			if (time - timestamps[v] > _cache_size)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+
+		return (float)misses / (float)(_index_count / 3);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshOptimizer::packVertices(const VertexBase* _vertices,
+									 uint32_t _vertex_count,
+									 VertexPacked* _packed,
+									 glm::vec3& _position_scale,
+									 glm::vec3& _position_offset)
+	{
+		// bounds of the positions, computed here since the mesh AABB isn't kept exact
+		// through load transforms
+		glm::vec3 minPos = _vertex_count ? _vertices[0].position : glm::vec3(0.0f);
+		glm::vec3 maxPos = minPos;
+		for (uint32_t i = 1; i < _vertex_count; i++)
+		{
+			minPos = glm::min(minPos, _vertices[i].position);
+			maxPos = glm::max(maxPos, _vertices[i].position);
+		}
+		_position_offset = minPos;
+		_position_scale = maxPos - minPos;
+		glm::vec3 invScale;
+		for (uint32_t k = 0; k < 3; k++)
+			invScale[k] = _position_scale[k] > 0.0f ? 1.0f / _position_scale[k] : 0.0f;
+
+		for (uint32_t i = 0; i < _vertex_count; i++)
+		{
+			const VertexBase& v = _vertices[i];
+			VertexPacked& p = _packed[i];
+
+			glm::vec3 q = (v.position - _position_offset) * invScale;
+			p.position[0] = float_to_unorm16(q.x);
+			p.position[1] = float_to_unorm16(q.y);
+			p.position[2] = float_to_unorm16(q.z);
+			p.position[3] = float_to_unorm16(1.0f);
+
+			// handedness of the tangent frame in the 2-bit w of the tangent
+			float handedness = glm::dot(glm::cross(v.normal, v.tangent), v.bitangent) < 0.0f ? -1.0f : 1.0f;
+			p.normal = pack_snorm_2_10_10_10(v.normal);
+			p.tangent = pack_snorm_2_10_10_10(v.tangent, handedness);
+			p.bitangent = pack_snorm_2_10_10_10(v.bitangent);
+
+			p.uv[0] = float_to_half(v.uv.x);
+			p.uv[1] = float_to_half(v.uv.y);
+		}
+	}
+
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+
+#include <vector>
+#include <stdint.h>
+
+#include "../../Types.hpp"
+
+
+namespace Syn {
+
+
+	/* Post-import optimizations of indexed triangle lists: reordering of triangles for
+	 * the post-transform vertex cache (Forsyth, 'Linear-speed vertex cache optimisation',
+	 * 2006), reordering of vertices for fetch locality, and quantization of vertices.
+	 */
+	class MeshOptimizer
+	{
+	public:
+		/* Reorders the triangles of _indices in-place for post-transform vertex cache
+		 * efficiency. Vertex data is unaffected.
+		 */
+		static void optimizeVertexCache(uint32_t* _indices, uint32_t _index_count, uint32_t _vertex_count);
+
+		/* Reorders _vertices (_vertex_count vertices of _vertex_size bytes) in-place in the
+		 * order of first use by _indices, which are remapped accordingly. Unreferenced
+		 * vertices are moved to the end, hence the vertex count is unchanged. Returns
+		 * the number of referenced vertices.
+		 */
+		static uint32_t optimizeVertexFetch(void* _vertices, uint32_t _vertex_count, uint32_t _vertex_size, uint32_t* _indices, uint32_t _index_count);
+
+		/* Average cache miss ratio (transformed vertices per triangle) of _indices,
+		 * simulated with a FIFO cache of _cache_size entries. 0.5 is the optimum for
+		 * regular grids, 3.0 the worst case.
+		 */
+		static float computeACMR(const uint32_t* _indices, uint32_t _index_count, uint32_t _vertex_count, uint32_t _cache_size=16);
+
+		/* Quantizes _vertices into _packed (see VertexPacked). Positions are stored
+		 * relative to the bounds of _vertices, with 16 bits over the extent of each axis
+		 * (half floats keep 11 bits, relative to the distance from the origin); the
+		 * position is _position_offset + _position_scale * a_position.xyz.
+		 */
+		static void packVertices(const VertexBase* _vertices,
+								 uint32_t _vertex_count,
+								 VertexPacked* _packed,
+								 glm::vec3& _position_scale,
+								 glm::vec3& _position_offset);
+
+	};
+
+
+}
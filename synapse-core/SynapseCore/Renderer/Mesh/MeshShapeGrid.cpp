@@ -0,0 +1,172 @@
+#include "../../../pch.hpp"
+
+#include <cmath>
+#include <limits>
+
+#include "MeshShapeGrid.hpp"
+#include "MeshNormals.hpp"
+#include "../Renderer.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/MathUtils.hpp"
+#include "../../Utils/Timer/Timer.hpp"
+#include "../../Utils/Thread/ThreadPool.hpp"
+
+
+namespace Syn {
+
+
+	// rows per parallel task
+	static const uint32_t s_rowBlockSize = 16;
+
+
+	//-----------------------------------------------------------------------------------
+	MeshShapeGrid::MeshShapeGrid(const Linspace<float>& _x, const Linspace<float>& _z)
+	{
+		m_nx = _x.size();
+		m_nz = _z.size();
+		SYN_CORE_ASSERT(m_nx > 1 && m_nz > 1, "meshgrid needs at least 2x2 vertices.");
+
+		// normalized x and z
+		float xrange_i = 1.0f / _x.range();
+		float zrange_i = 1.0f / _z.range();
+		m_x.resize(m_nx);
+		m_z.resize(m_nz);
+		for (uint32_t j = 0; j < m_nx; j++)
+			m_x[j] = (_x[j] - _x.lim.min_) * xrange_i;
+		for (uint32_t i = 0; i < m_nz; i++)
+			m_z[i] = (_z[i] - _z.lim.min_) * zrange_i;
+
+		// flat surface until the first update
+		m_heights.resize(m_nx * m_nz, 0.0f);
+		m_vertices.resize(m_nx * m_nz);
+		uint32_t up = pack_snorm_2_10_10_10(glm::vec3(0.0f, 1.0f, 0.0f));
+		for (uint32_t i = 0; i < m_nz; i++)
+			for (uint32_t j = 0; j < m_nx; j++)
+				m_vertices[i * m_nx + j] = { glm::vec3(m_x[j], 0.0f, m_z[i]), up };
+
+		// the index buffer depends only on the grid shape and is never touched again
+		std::vector<uint32_t> indices((m_nx - 1) * (m_nz - 1) * 6);
+		for (uint32_t i = 0; i < m_nz - 1; i++)
+		{
+			for (uint32_t j = 0; j < m_nx - 1; j++)
+			{
+				uint32_t index = 6 * (i * (m_nx - 1) + j);
+				// upper left triangle
+				indices[index + 0] = i * m_nx + j;
+				indices[index + 1] = (i + 1) * m_nx + j;
+				indices[index + 2] = i * m_nx + j + 1;
+				// lower right triangle
+				indices[index + 3] = i * m_nx + j + 1;
+				indices[index + 4] = (i + 1) * m_nx + j;
+				indices[index + 5] = (i + 1) * m_nx + j + 1;
+			}
+		}
+
+		Ref<VertexBuffer> vertexBuffer = MakeRef<VertexBuffer>(GL_DYNAMIC_DRAW);
+		vertexBuffer->setBufferLayout({
+			{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
+			{ VERTEX_ATTRIB_LOCATION_NORMAL, ShaderDataType::Int_2_10_10_10, "a_normal", true },
+		});
+		vertexBuffer->setData(m_vertices.data(), sizeof(grid_vertex_t) * m_vertices.size());
+
+		Ref<IndexBuffer> indexBuffer = MakeRef<IndexBuffer>();
+		indexBuffer->setData(indices.data(), indices.size());
+
+		m_vertexArray = MakeRef<VertexArray>(vertexBuffer, indexBuffer);
+		Renderer::executeRenderCommands();
+
+		m_aabb = { glm::vec3(0.0f), glm::vec3(1.0f) };
+
+		// translate to origin
+		Transform t;
+		t.translate(glm::vec3(-0.5f));
+		setTransform(t);
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	void MeshShapeGrid::updateHeights(const float* _y)
+	{
+		#ifdef DEBUG_MESH
+			Timer timer("", false);
+		#endif
+
+		uint32_t nx = m_nx;
+		uint32_t nz = m_nz;
+		uint32_t blockCount = (nz + s_rowBlockSize - 1) / s_rowBlockSize;
+		ThreadPool& pool = ThreadPool::get();
+
+		// height range, reduced per block of rows
+		if (!m_fixedHeightRange)
+		{
+			std::vector<float> blockMin(blockCount, std::numeric_limits<float>::max());
+			std::vector<float> blockMax(blockCount, std::numeric_limits<float>::lowest());
+			pool.parallelFor(0, blockCount, [&](size_t b)
+			{
+				const float* y = _y + b * s_rowBlockSize * nx;
+				const float* end = _y + min((uint32_t)(b + 1) * s_rowBlockSize, nz) * nx;
+				float ymin = blockMin[b];
+				float ymax = blockMax[b];
+				for (; y < end; y++)
+				{
+					ymin = min(ymin, *y);
+					ymax = max(ymax, *y);
+				}
+				blockMin[b] = ymin;
+				blockMax[b] = ymax;
+			});
+			m_yMin = blockMin[0];
+			m_yMax = blockMax[0];
+			for (uint32_t b = 1; b < blockCount; b++)
+			{
+				m_yMin = min(m_yMin, blockMin[b]);
+				m_yMax = max(m_yMax, blockMax[b]);
+			}
+		}
+		float ymin = m_yMin;
+		float yrange_i = m_yMax > m_yMin ? 1.0f / (m_yMax - m_yMin) : 0.0f;
+
+		// normalized heights; all rows have to be done before the normals are computed
+		float* heights = m_heights.data();
+		pool.parallelFor(0, blockCount, [&](size_t b)
+		{
+			size_t begin = b * s_rowBlockSize * nx;
+			size_t end = min((uint32_t)(b + 1) * s_rowBlockSize, nz) * nx;
+			for (size_t k = begin; k < end; k++)
+				heights[k] = (_y[k] - ymin) * yrange_i;
+		});
+
+		// normals, see MeshNormals
+		float dx = m_x[1] - m_x[0];
+		float dz = m_z[1] - m_z[0];
+		pool.parallelFor(0, blockCount, [&](size_t b)
+		{
+			uint32_t rowBegin = (uint32_t)b * s_rowBlockSize;
+			uint32_t rowEnd = min(rowBegin + s_rowBlockSize, nz);
+			std::vector<glm::vec3> normals((rowEnd - rowBegin) * nx);
+			MeshNormals::computeGridNormals(heights, nx, nz, dx, dz, normals.data(), rowBegin, rowEnd);
+
+			grid_vertex_t* vertices = &m_vertices[rowBegin * nx];
+			const float* h = &heights[rowBegin * nx];
+			for (size_t k = 0; k < normals.size(); k++)
+			{
+				vertices[k].position.y = h[k];
+				vertices[k].normal = pack_snorm_2_10_10_10(normals[k]);
+			}
+		});
+
+		// re-specifying the storage orphans the previous buffer, so the upload doesn't
+		// wait for draws still reading it
+		const Ref<VertexBuffer>& vertexBuffer = m_vertexArray->getVertexBuffer();
+		uint32_t sizeBytes = sizeof(grid_vertex_t) * m_vertices.size();
+		vertexBuffer->startDataBlock(sizeBytes);
+		vertexBuffer->addSubData(m_vertices.data(), sizeBytes, 0);
+		vertexBuffer->endDataBlock();
+
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE(nx, "x", nz, " heights updated in ", timer.getDeltaTimeMs(), " ms.");
+		#endif
+	}
+
+
+}
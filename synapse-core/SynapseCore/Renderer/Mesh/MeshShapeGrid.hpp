@@ -0,0 +1,70 @@
+#pragma once
+
+
+#include <vector>
+
+#include "MeshShape.hpp"
+#include "../../Types/Linspace.hpp"
+
+
+namespace Syn {
+
+
+	/* Persistent meshgrid surface for heights that change every frame, e.g. simulation
+	 * output. The grid shape (x and z, and hence the index buffer) is fixed at
+	 * construction; updateHeights() only recomputes heights and normals, in parallel
+	 * over blocks of rows, and streams them into the existing vertex buffer.
+	 *
+	 * As with MeshCreator::createShapeMeshgrid(), the surface is normalized to the unit
+	 * cube and translated to the origin. Vertices are 16 bytes (float3 position and a
+	 * 2_10_10_10 normal, read as a normalized vec3 in the shader).
+	 */
+	class MeshShapeGrid : public MeshShape
+	{
+	public:
+		MeshShapeGrid(const Linspace<float>& _x, const Linspace<float>& _z);
+		~MeshShapeGrid() {}
+
+		/* Sets new heights; _y holds x.size() * z.size() values, row-major over z (i.e.
+		 * _y[i * nx + j] is the height at (x[j], z[i])). The upload is deferred to the
+		 * render command queue, so this should be called at most once per frame.
+		 */
+		void updateHeights(const float* _y);
+
+		/* Fixes the height range mapped to [0, 1]. Otherwise the range of every update is
+		 * used, which costs an extra pass over the heights.
+		 */
+		void setHeightRange(float _y_min, float _y_max) { m_yMin = _y_min; m_yMax = _y_max; m_fixedHeightRange = true; }
+		void clearHeightRange() { m_fixedHeightRange = false; }
+
+		// Accessors
+		inline uint32_t getNX() const { return m_nx; }
+		inline uint32_t getNZ() const { return m_nz; }
+		inline const float* getHeights() const { return m_heights.data(); }
+
+	private:
+		struct grid_vertex_t
+		{
+			glm::vec3 position;
+			uint32_t normal;
+		};
+
+		uint32_t m_nx = 0;
+		uint32_t m_nz = 0;
+
+		// normalized coordinates and heights
+		std::vector<float> m_x;
+		std::vector<float> m_z;
+		std::vector<float> m_heights;
+
+		// CPU copy of the vertex buffer; read by the deferred upload
+		std::vector<grid_vertex_t> m_vertices;
+
+		bool m_fixedHeightRange = false;
+		float m_yMin = 0.0f;
+		float m_yMax = 1.0f;
+
+	};
+
+
+}
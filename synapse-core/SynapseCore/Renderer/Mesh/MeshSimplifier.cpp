@@ -0,0 +1,317 @@
+#include "../../../pch.hpp"
+
+#include <cstring>
+#include <numeric>
+
+#include "MeshSimplifier.hpp"
+#include "../../Core.hpp"
+
+
+namespace Syn {
+
+
+	// Upper bound on collapse passes; each pass collapses an independent set of edges.
+	static const uint32_t s_maxPasses = 100;
+
+
+	//-----------------------------------------------------------------------------------
+	/* Symmetric 4x4 error quadric (upper triangle). Planes are weighted by triangle
+	 * area, and the accumulated weight normalizes the error to a mean squared
+	 * distance, hence the error stays in object space units.
+	 */
+	struct quadric_t
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+		double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+		double a22 = 0.0, a23 = 0.0;
+		double a33 = 0.0;
+		double w = 0.0;
+
+		void addPlane(double _a, double _b, double _c, double _d, double _w)
+		{
+			a00 += _w*_a*_a; a01 += _w*_a*_b; a02 += _w*_a*_c; a03 += _w*_a*_d;
+			a11 += _w*_b*_b; a12 += _w*_b*_c; a13 += _w*_b*_d;
+			a22 += _w*_c*_c; a23 += _w*_c*_d;
+			a33 += _w*_d*_d;
+			w += _w;
+		}
+
+		void operator+=(const quadric_t& _q)
+		{
+			a00 += _q.a00; a01 += _q.a01; a02 += _q.a02; a03 += _q.a03;
+			a11 += _q.a11; a12 += _q.a12; a13 += _q.a13;
+			a22 += _q.a22; a23 += _q.a23;
+			a33 += _q.a33;
+			w += _q.w;
+		}
+
+		// un-normalized v^T * Q * v, v = (p, 1)
+		double eval(const glm::vec3& _p) const
+		{
+			double x = _p.x, y = _p.y, z = _p.z;
+			return a00*x*x + 2.0*a01*x*y + 2.0*a02*x*z + 2.0*a03*x
+				 + a11*y*y + 2.0*a12*y*z + 2.0*a13*y
+				 + a22*z*z + 2.0*a23*z
+				 + a33;
+		}
+	};
+
+	//
+	struct position_key_t
+	{
+		uint32_t x, y, z;
+		bool operator==(const position_key_t& _k) const { return x == _k.x && y == _k.y && z == _k.z; }
+	};
+
+	struct position_key_hash
+	{
+		size_t operator()(const position_key_t& _k) const
+		{ return (_k.x * 73856093u) ^ (_k.y * 19349663u) ^ (_k.z * 83492791u); }
+	};
+
+	//
+	struct collapse_t
+	{
+		uint32_t v0;	// vertex removed
+		uint32_t v1;	// vertex kept
+		double cost;
+	};
+
+
+	//-----------------------------------------------------------------------------------
+	static inline uint64_t edge_key(uint32_t _a, uint32_t _b)
+	{
+		return _a < _b ? ((uint64_t)_a << 32) | _b : ((uint64_t)_b << 32) | _a;
+	}
+
+	//-----------------------------------------------------------------------------------
+	static inline double collapse_cost(const quadric_t& _q0, const quadric_t& _q1, const glm::vec3& _p)
+	{
+		double w = _q0.w + _q1.w;
+		return w > 0.0 ? std::fabs(_q0.eval(_p) + _q1.eval(_p)) / w : 0.0;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	std::vector<uint32_t> MeshSimplifier::simplify(const float* _positions,
+												   uint32_t _vertex_count,
+												   uint32_t _stride_bytes,
+												   const uint32_t* _indices,
+												   uint32_t _index_count,
+												   uint32_t _target_index_count,
+												   float _target_error,
+												   float* _result_error)
+	{
+		SYN_CORE_ASSERT(_index_count % 3 == 0, "index count must be a multiple of 3.");
+
+		std::vector<uint32_t> indices(_indices, _indices + _index_count);
+		if (_result_error)
+			*_result_error = 0.0f;
+		if (_index_count == 0 || _target_index_count >= _index_count)
+			return indices;
+
+		// gather positions
+		std::vector<glm::vec3> positions(_vertex_count);
+		const uint8_t* base = reinterpret_cast<const uint8_t*>(_positions);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+		{
+			const float* p = reinterpret_cast<const float*>(base + (size_t)v * _stride_bytes);
+			positions[v] = glm::vec3(p[0], p[1], p[2]);
+		}
+
+		// Remap vertices sharing a position (wedges, i.e. vertices split by normals or
+		// UVs) to a single representative, used for quadrics and topology.
+		std::vector<uint8_t> referenced(_vertex_count, 0);
+		for (uint32_t i = 0; i < _index_count; i++)
+			referenced[indices[i]] = 1;
+
+		std::vector<uint32_t> remap(_vertex_count);
+		std::vector<uint32_t> wedgeCount(_vertex_count, 0);
+		std::unordered_map<position_key_t, uint32_t, position_key_hash> positionMap;
+		positionMap.reserve(_vertex_count);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+		{
+			remap[v] = v;
+			if (!referenced[v])
+				continue;
+			position_key_t key;
+			std::memcpy(&key, &positions[v], sizeof(position_key_t));
+			remap[v] = positionMap.emplace(key, v).first->second;
+			wedgeCount[remap[v]]++;
+		}
+
+		// lock seams, borders and non-manifold edges
+		std::vector<uint8_t> locked(_vertex_count, 0);
+		for (uint32_t v = 0; v < _vertex_count; v++)
+			if (wedgeCount[v] > 1)
+				locked[v] = 1;
+
+		std::unordered_map<uint64_t, uint32_t> edgeCount;
+		edgeCount.reserve(_index_count);
+		for (uint32_t i = 0; i < _index_count; i += 3)
+		{
+			uint32_t r[3] = { remap[indices[i+0]], remap[indices[i+1]], remap[indices[i+2]] };
+			if (r[0] == r[1] || r[1] == r[2] || r[0] == r[2])
+				continue;
+			for (uint32_t k = 0; k < 3; k++)
+				edgeCount[edge_key(r[k], r[(k+1)%3])]++;
+		}
+		for (auto& it : edgeCount)
+		{
+			if (it.second != 2)
+			{
+				locked[(uint32_t)(it.first >> 32)] = 1;
+				locked[(uint32_t)(it.first & 0xffffffff)] = 1;
+			}
+		}
+
+		// per-vertex quadrics from incident triangle planes
+		std::vector<quadric_t> quadrics(_vertex_count);
+		for (uint32_t i = 0; i < _index_count; i += 3)
+		{
+			uint32_t r[3] = { remap[indices[i+0]], remap[indices[i+1]], remap[indices[i+2]] };
+			glm::vec3 n = glm::cross(positions[r[1]] - positions[r[0]], positions[r[2]] - positions[r[0]]);
+			float len = glm::length(n);
+			if (len == 0.0f)
+				continue;
+			n /= len;
+			double d = -glm::dot(n, positions[r[0]]);
+			for (uint32_t k = 0; k < 3; k++)
+				quadrics[r[k]].addPlane(n.x, n.y, n.z, d, 0.5 * len);
+		}
+
+		//
+		const double maxCost = (double)_target_error * (double)_target_error;
+		const uint32_t targetTriangleCount = _target_index_count / 3;
+		uint32_t triangleCount = _index_count / 3;
+		double resultCost = 0.0;
+
+		std::vector<uint32_t> adjOffsets;
+		std::vector<uint32_t> adjFill;
+		std::vector<uint32_t> adjTriangles;
+		std::vector<collapse_t> collapses;
+		std::vector<uint32_t> collapseTarget(_vertex_count);
+		std::vector<uint8_t> touched(_vertex_count);
+
+		for (uint32_t pass = 0; pass < s_maxPasses && triangleCount > targetTriangleCount; pass++)
+		{
+			// vertex -> triangle adjacency (in remapped space)
+			adjOffsets.assign(_vertex_count + 1, 0);
+			for (uint32_t idx : indices)
+				adjOffsets[remap[idx] + 1]++;
+			for (uint32_t v = 0; v < _vertex_count; v++)
+				adjOffsets[v + 1] += adjOffsets[v];
+			adjFill.assign(adjOffsets.begin(), adjOffsets.end() - 1);
+			adjTriangles.resize(indices.size());
+			for (uint32_t i = 0; i < indices.size(); i++)
+				adjTriangles[adjFill[remap[indices[i]]]++] = i / 3;
+
+			// candidate collapses, in both directions of every edge, sorted by cost
+			collapses.clear();
+			for (uint32_t i = 0; i < indices.size(); i += 3)
+			{
+				for (uint32_t k = 0; k < 3; k++)
+				{
+					uint32_t v0 = indices[i + k];
+					uint32_t v1 = indices[i + (k+1)%3];
+					uint32_t r0 = remap[v0];
+					uint32_t r1 = remap[v1];
+					if (!locked[r0])
+						collapses.push_back({ v0, v1, collapse_cost(quadrics[r0], quadrics[r1], positions[r1]) });
+					if (!locked[r1])
+						collapses.push_back({ v1, v0, collapse_cost(quadrics[r1], quadrics[r0], positions[r0]) });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const collapse_t& _a, const collapse_t& _b) { return _a.cost < _b.cost; });
+			if (collapses.empty())
+				break;
+
+			// Limit the pass to roughly the cheapest collapses needed to reach the target;
+			// taking every independent collapse in one pass trades error for speed.
+			size_t needed = std::max((triangleCount - targetTriangleCount) / 2, 1u);
+			double passCost = std::min(maxCost, collapses[std::min(needed, collapses.size()) - 1].cost * 1.5);
+
+			// greedily select an independent set of collapses
+			std::iota(collapseTarget.begin(), collapseTarget.end(), 0);
+			std::fill(touched.begin(), touched.end(), 0);
+			uint32_t collapseCount = 0;
+			uint32_t removedCount = 0;
+			for (const collapse_t& c : collapses)
+			{
+				if (c.cost > maxCost || (c.cost > passCost && collapseCount > 0))
+					break;
+				if (triangleCount - removedCount <= targetTriangleCount)
+					break;
+
+				// unlocked vertices are unique at their position, hence r0 == v0
+				uint32_t r0 = remap[c.v0];
+				uint32_t r1 = remap[c.v1];
+				if (touched[r0] || touched[r1])
+					continue;
+
+				// reject collapses flipping any remaining triangle of the one-ring
+				bool flipped = false;
+				uint32_t removed = 0;
+				for (uint32_t a = adjOffsets[r0]; a < adjOffsets[r0 + 1] && !flipped; a++)
+				{
+					uint32_t t = adjTriangles[a] * 3;
+					uint32_t r[3] = { remap[indices[t+0]], remap[indices[t+1]], remap[indices[t+2]] };
+					if (r[0] == r1 || r[1] == r1 || r[2] == r1)
+					{
+						removed++;
+						continue;
+					}
+					glm::vec3 p[3] = { positions[r[0]], positions[r[1]], positions[r[2]] };
+					glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+					for (uint32_t k = 0; k < 3; k++)
+						if (r[k] == r0)
+							p[k] = positions[r1];
+					glm::vec3 n1 = glm::cross(p[1] - p[0], p[2] - p[0]);
+					flipped = glm::dot(n0, n1) <= 0.0f;
+				}
+				if (flipped)
+					continue;
+
+				// commit
+				collapseTarget[c.v0] = c.v1;
+				quadrics[r1] += quadrics[r0];
+				resultCost = std::max(resultCost, c.cost);
+				for (uint32_t a = adjOffsets[r0]; a < adjOffsets[r0 + 1]; a++)
+				{
+					uint32_t t = adjTriangles[a] * 3;
+					for (uint32_t k = 0; k < 3; k++)
+						touched[remap[indices[t + k]]] = 1;
+				}
+				removedCount += removed;
+				collapseCount++;
+			}
+
+			if (collapseCount == 0)
+				break;
+
+			// apply collapses and remove triangles degenerate in position
+			size_t write = 0;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				uint32_t a = collapseTarget[indices[i+0]];
+				uint32_t b = collapseTarget[indices[i+1]];
+				uint32_t c = collapseTarget[indices[i+2]];
+				if (remap[a] == remap[b] || remap[b] == remap[c] || remap[a] == remap[c])
+					continue;
+				indices[write+0] = a;
+				indices[write+1] = b;
+				indices[write+2] = c;
+				write += 3;
+			}
+			indices.resize(write);
+			triangleCount = (uint32_t)(write / 3);
+		}
+
+		if (_result_error)
+			*_result_error = (float)std::sqrt(resultCost);
+
+		return indices;
+	}
+
+
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+
+#include <vector>
+#include <limits>
+#include <stdint.h>
+
+
+namespace Syn {
+
+
+	/* Quadric error metric (QEM) mesh simplification, after Garland & Heckbert (1997).
+	 *
+	 * Edges are collapsed onto one of their endpoints (no new vertices are created),
+	 * so the result is a new index list referencing the original vertex data, and
+	 * all levels of detail of a mesh may share the same vertex buffer. Vertices on
+	 * open borders and on attribute seams (several vertices sharing one position)
+	 * are locked, hence no cracks are introduced.
+	 */
+	class MeshSimplifier
+	{
+	public:
+		/* Simplifies the triangle list _indices (_index_count indices) towards
+		 * _target_index_count indices. Positions are read as 3 floats from _positions
+		 * every _stride_bytes. Simplification stops early if the next collapse would
+		 * exceed _target_error (in object space units). The error of the resulting
+		 * mesh (object space) is written to _result_error, if not nullptr.
+		 */
+		static std::vector<uint32_t> simplify(const float* _positions,
+											  uint32_t _vertex_count,
+											  uint32_t _stride_bytes,
+											  const uint32_t* _indices,
+											  uint32_t _index_count,
+											  uint32_t _target_index_count,
+											  float _target_error=std::numeric_limits<float>::max(),
+											  float* _result_error=nullptr);
+
+	};
+
+
+}
@@ -11,6 +11,8 @@
 #include "../Utils/Timer/TimeStep.hpp"
 #include "../Utils/Timer/Timer.hpp"
 #include "../Utils/MathUtils.hpp"
+#include "../Utils/Thread/ThreadPool.hpp"
+#include "./Mesh/MeshNormals.hpp"
 
 
 namespace Syn 
@@ -141,7 +143,8 @@ namespace Syn
 												uint32_t _vertices_size_bytes, 
 												uint32_t* _indices, 
 												uint32_t _index_count, 
-												uint32_t _mesh_attrib_flags)
+												uint32_t _mesh_attrib_flags,
+												const std::vector<float>& _lod_ratios)
 	{
 		// create mesh for vertex/index data
 		Ref<MeshShape> mesh = MakeRef<MeshShape>();
@@ -165,6 +168,10 @@ namespace Syn
 
 		delete[] raw; // clean your room!
 
+		// LODs share the vertex buffer, simplified from the untrimmed positions
+		if (!_lod_ratios.empty() && _index_count > 0)
+			mesh->generateLODs(&_vertex_data[0].position.x, sizeof(vertex_data), vertexCount, _indices, { { 0, 0, 0, _index_count } }, _lod_ratios);
+
 		return mesh;
 	}
 
@@ -358,7 +365,8 @@ namespace Syn
 	//-----------------------------------------------------------------------------------
 	Ref<MeshShape> MeshCreator::createShapeSphere(const glm::vec3& _center, float _radius, 
 												  uint32_t _stack_count, uint32_t _sector_count, 
-												  uint32_t _mesh_attrib_flags)
+												  uint32_t _mesh_attrib_flags,
+												  const std::vector<float>& _lod_ratios)
 	{
 		// remove unsupported vertex attributes (for now)
 		// TODO: implement these
@@ -437,7 +445,7 @@ namespace Syn
 
 
 		// return ref
-		Ref<MeshShape> mesh = createMeshShape(vertices.data(), vertices.size() * sizeof(vertex_data), indices.data(), indices.size(), flags);
+		Ref<MeshShape> mesh = createMeshShape(vertices.data(), vertices.size() * sizeof(vertex_data), indices.data(), indices.size(), flags, _lod_ratios);
 
 		// set position of sphere through the model matrix
 		Transform t;
@@ -460,7 +468,9 @@ namespace Syn
 													const Linspace<float>& _x,
 													const Linspace<float>& _z,
 											  		uint32_t _mesh_attrib_flags,
-													uint32_t _normal_flag)
+													uint32_t _normal_flag,
+													const std::vector<float>& _lod_ratios,
+													const glm::vec2* _y_gradients)
 	{
 		#ifdef DEBUG_MESH
 			Timer timer("", false);
@@ -530,7 +540,7 @@ namespace Syn
 		{
 			for (uint32_t i = 0; i < nx - 1; i++)
 			{
-				int index = 6 * (j * (nz - 1) + i);
+				int index = 6 * (j * (nx - 1) + i);
 				// upper left triangle
 				indices[index + 0] = j * nx + i;
 				indices[index + 1] = (j + 1) * nx + i;
@@ -542,129 +552,45 @@ namespace Syn
 			}
 		}
 		
-		// compute grid normals
-		for (uint32_t i = 0; i < nz; i++)
+		// compute grid normals, in parallel over blocks of rows
+		#ifdef DEBUG_MESH
+			Timer normalTimer("", false);
+		#endif
+		std::vector<glm::vec3> normals(vertexCount);
+		const uint32_t rowBlockSize = 64;
+		if ((_normal_flag & MESH_NORMALS_ANALYTIC) && _y_gradients != nullptr)
 		{
-			for (uint32_t j = 0; j < nx; j++)
+			ThreadPool::get().parallelFor(0, (nz + rowBlockSize - 1) / rowBlockSize, [&](size_t b)
 			{
-				int k = i * nx + j;
-
-				int L = i * nx + j - 1;
-				int R = i * nx + j + 1;
-				int U = (i - 1) * nx + j;
-				int D = (i + 1) * nx + j;
-
-				glm::vec3 sum;
-
-				// normals 'inside' borders
-				if (i > 0 && i < (nz-1) && j > 0 && j < (nx - 1))
-				{
-					if (_normal_flag & MESH_NORMALS_APPROX)
-					{
-						// L -> P :  [ x - (x-1),  f(x,z) - f(x-1,z),  z - z ] =
-						//           [ 1.0, f(x,z) - f(x-1,z), 0.0 ]
-						glm::vec3 LP = glm::vec3(x[j]-x[j-1], _y[k]-_y[L], 0.0f);
-						// P -> R :  [ (x+1) - x,  f(x+1,z) - f(x,z),  z - z ] =
-						//           [ 1.0, f(x+1,z) - f(x,z), 0.0 ]
-						glm::vec3 PR = glm::vec3(x[j+1]-x[j], _y[R]-_y[k], 0.0f);
-						// U -> P :  [ x - x,  f(x,z) - f(x,z-1),  z - (z-1) ] =
-						//           [ 0.0, f(x,z) - f(x,z-1), 1.0 ]
-						glm::vec3 UP = glm::vec3(0.0f, _y[k]-_y[U], z[i]-z[i-1]);
-						// P -> D :  [ x - x,  f(x,z+1) - f(x,z),  (z+1) - z ] =
-						//           [ 0.0, f(x,z+1) - f(x,z), 1.0 ]
-						glm::vec3 PD = glm::vec3(0.0f, _y[D]-_y[k], z[i+1]-z[i]);
-						
-						glm::vec3 UP_LP = glm::cross(UP, LP);
-						glm::vec3 UP_PR = glm::cross(UP, PR);
-						glm::vec3 PD_LP = glm::cross(PD, LP);
-						glm::vec3 PD_PR = glm::cross(PD, PR);
-
-						sum = UP_LP + UP_PR + PD_LP + PD_PR;
-					}
-					else if (_normal_flag & MESH_NORMALS_APPROX_FAST)
-					{
-						// * Simpler method, only calculating the vectors from U to D, and from L to R, 
-						// * respectively, and using their normalized cross product as the derivative,
-						// * which is faster.
-						//
-						// U -> D :  [ x - x,  f(x, z+1) - f(x, z-1),  (z+1) - (z-1) ] =
-						//           [ 0.0, f(x, z+1) - f(x, z-1), 2.0 ]
-						glm::vec3 UD = glm::vec3(0.0, _y[D]-_y[U], z[i+1]-z[i-1]);
-						// L -> R :  [ (x+1) - (x-1),  f(x+1, z) - f(x-1, z),  z - z ] =
-						//           [ 2.0, f(x+1, z) - f(x-1, z), 0.0 ]
-						glm::vec3 LR = glm::vec3(x[j+1]-x[j-1], _y[R]-_y[L], 0.0);
-						sum = glm::cross(UD, LR);
-					}
-				}
-
-				// z borders, excluding corners
-				else if (i > 0 && i < (nz-1) && (j == 0 || j == (nx-1)))
-				{
-					glm::vec3 PX;
-					if (j == 0) 	PX = { x[1]-x[0], _y[R]-_y[k], 0.0f };
-					else			PX = { x[nx-1]-x[nx-2], _y[k]-_y[L], 0.0f };
-					
-					glm::vec3 UP = glm::vec3(0.0f, _y[k]-_y[U], z[i]-z[i-1]);
-					glm::vec3 PD = glm::vec3(0.0f, _y[D]-_y[k], z[i+1]-z[i]);
-
-					glm::vec3 UP_PX = glm::cross(UP, PX);
-					glm::vec3 PD_PX = glm::cross(PD, PX);
-
-					sum = UP_PX + PD_PX;
-				}
-
-				// x borders, excluding corners
-				else if (j > 0 && j < (nx-1) && (i == 0 || i == (nz-1)))
-				{
-					glm::vec3 PZ;
-					if (i == 0)		PZ = glm::vec3(0.0f, _y[D]-_y[k], z[1]-z[0]);
-					else 			PZ = glm::vec3(0.0f, _y[k]-_y[U], z[nz-1]-z[nz-2]);
-
-					glm::vec3 PR = glm::vec3(x[j+1]-x[j], _y[R]-_y[k], 0.0f);
-					glm::vec3 LP = glm::vec3(x[j]-x[j-1], _y[k]-_y[L], 0.0f);
-
-					glm::vec3 PZ_LP = glm::cross(PZ, LP);					
-					glm::vec3 PZ_PR = glm::cross(PZ, PR);
-
-					sum = PZ_LP + PZ_PR;
-				}
-
-				// corners
-				else if (i == 0 && j == 0)
-				{
-					glm::vec3 PR = glm::vec3(x[1]-x[0], _y[R]-_y[k], 0.0f);
-					glm::vec3 PD = glm::vec3(0.0f, _y[D]-_y[k], z[1]-z[0]);
-					sum = glm::cross(PD, PR);
-				}
-				else if (i == 0 && j == (nx-1))
-				{
-					glm::vec3 LP = glm::vec3(x[nx-1]-x[nx-2], _y[k]-_y[L], 0.0f);
-					glm::vec3 PD = glm::vec3(0.0f, _y[D]-_y[k], z[1]-z[0]);
-					sum = glm::cross(PD, LP);
-				}
-				else if (i == (nz-1) && j == 0)
-				{
-					glm::vec3 PR = glm::vec3(x[1]-x[0], _y[R]-_y[k], 0.0f);
-					glm::vec3 UP = glm::vec3(0.0f, _y[k]-_y[U], z[nz-1]-z[nz-2]);
-					sum = glm::cross(UP, PR);
-				}
-				else if (i == (nz-1) && j == (nx-1))
-				{
-					glm::vec3 LP = glm::vec3(x[nx-1]-x[nx-2], _y[k]-_y[L], 0.0f);
-					glm::vec3 UP = glm::vec3(0.0f, _y[k]-_y[U], z[nz-1]-z[nz-2]);
-					sum = glm::cross(UP, LP);
-				}
-
-				// set vertex normal
-				vertices[k].normal = glm::normalize(sum);
+				uint32_t offset = b * rowBlockSize * nx;
+				uint32_t count = min(rowBlockSize, nz - (uint32_t)b * rowBlockSize) * nx;
+				MeshNormals::computeNormalsFromGradients(&_y_gradients[offset], count, &normals[offset]);
+			});
+		}
+		else
+		{
+			if (_normal_flag & MESH_NORMALS_ANALYTIC)
+			{
+				SYN_CORE_WARNING("no gradients supplied for analytic normals, using finite differences.");
 			}
+			ThreadPool::get().parallelFor(0, (nz + rowBlockSize - 1) / rowBlockSize, [&](size_t b)
+			{
+				uint32_t row = b * rowBlockSize;
+				MeshNormals::computeGridNormals(_y, nx, nz, x[1] - x[0], z[1] - z[0], &normals[row * nx], row, row + rowBlockSize);
+			});
 		}
+		for (int k = 0; k < vertexCount; k++)
+			vertices[k].normal = normals[k];
+		#ifdef DEBUG_MESH
+			SYN_CORE_TRACE("normals (", MeshNormals::getSIMDPath(), ") computed in ", normalTimer.getDeltaTimeMs(), " ms.");
+		#endif
 
 		Ref<MeshShape> mesh = createMeshShape(vertices, 
 											  sizeof(vertex_data) * vertexCount, 
 											  indices,
 											  indexCount, 
-											  _mesh_attrib_flags);
+											  _mesh_attrib_flags,
+											  _lod_ratios);
 
 		AABB aabb = {
 			{ (_x.lim.min_ - _x.lim.min_) * xrange_i, 
@@ -693,6 +619,17 @@ namespace Syn
 		return mesh;
 	}
 
+	//-----------------------------------------------------------------------------------
+	Ref<MeshShapeGrid> MeshCreator::createShapeMeshgridDynamic(const Linspace<float>& _x,
+															   const Linspace<float>& _z,
+															   const float* _y)
+	{
+		Ref<MeshShapeGrid> mesh = MakeRef<MeshShapeGrid>(_x, _z);
+		if (_y != nullptr)
+			mesh->updateHeights(_y);
+		return mesh;
+	}
+
 	//-----------------------------------------------------------------------------------
 	/*
 	Ref<MeshShape> MeshCreator::createShapeMeshgridNormals(long double* _y,
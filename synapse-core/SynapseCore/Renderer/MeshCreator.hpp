@@ -6,6 +6,7 @@
 #include "./Mesh/Mesh.hpp"
 #include "./Mesh/MeshDebug.hpp"
 #include "./Mesh/MeshShape.hpp"
+#include "./Mesh/MeshShapeGrid.hpp"
 #include "./Shader/Shader.hpp"
 #include "./Camera/Camera.hpp"
 #include "Renderer.hpp"
@@ -68,20 +69,38 @@ namespace Syn {
 
 		/*
 		Sphere, defined in polar coordinates; vertex positions calculated through number of
-		stacks (vertical) and sectors (horizontal) specified.
+		stacks (vertical) and sectors (horizontal) specified. If _lod_ratios is non-empty, a
+		LOD chain is generated (see Mesh::generateLODs()).
 		*/
 		static Ref<MeshShape> createShapeSphere(const glm::vec3& _center=glm::vec3(0.0f),
 												float _radius=10.0f,
 												uint32_t _stack_count=21,
 												uint32_t _sector_count=21,
-												uint32_t _mesh_attrib_flags=MESH_ATTRIB_POSITION|MESH_ATTRIB_NORMAL|MESH_ATTRIB_UV);
+												uint32_t _mesh_attrib_flags=MESH_ATTRIB_POSITION|MESH_ATTRIB_NORMAL|MESH_ATTRIB_UV,
+												const std::vector<float>& _lod_ratios={});
 
+		/*
+		Meshgrid from heights _y over _x and _z, normalized to the unit cube. If _lod_ratios
+		is non-empty, a LOD chain is generated (see Mesh::generateLODs()). Normals are
+		computed from finite differences (MESH_NORMALS_APPROX_FAST and MESH_NORMALS_APPROX
+		are equivalent on the uniform grid), or from the gradients (dy/dx, dy/dz) in
+		_y_gradients if MESH_NORMALS_ANALYTIC is set; see MeshNormals.
+		*/
 		static Ref<MeshShape> createShapeMeshgrid(float* _y,
 												  uint32_t _y_size,
 												  const Linspace<float>& _x,
 												  const Linspace<float>& _z,
 												  uint32_t _mesh_attrib_flags=MESH_ATTRIB_POSITION|MESH_ATTRIB_NORMAL,
-												  uint32_t _normal_flag=MESH_NORMALS_APPROX_FAST);
+												  uint32_t _normal_flag=MESH_NORMALS_APPROX_FAST,
+												  const std::vector<float>& _lod_ratios={},
+												  const glm::vec2* _y_gradients=nullptr);
+		/*
+		Persistent meshgrid over _x and _z for heights updated every frame, see
+		MeshShapeGrid::updateHeights(). Optionally initialized with heights _y.
+		*/
+		static Ref<MeshShapeGrid> createShapeMeshgridDynamic(const Linspace<float>& _x,
+															 const Linspace<float>& _z,
+															 const float* _y=nullptr);
 		/*
 		static Ref<MeshShape> createShapeMeshgridNormals(long double* _y,
 														 long double* _y_normals,
@@ -190,7 +209,8 @@ namespace Syn {
 											  uint32_t _vertices_size_bytes, 
 											  uint32_t* _indices, 
 											  uint32_t _index_count, 
-											  uint32_t _mesh_attrib_flags);
+											  uint32_t _mesh_attrib_flags,
+											  const std::vector<float>& _lod_ratios={});
 
 		// Setup static shaders used for rendering debug meshes.
 		static void createDebugShaders();
@@ -0,0 +1,438 @@
+
+#include "../../../pch.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "ParticleSystem.hpp"
+#include "../Renderer.hpp"
+#include "../Shader/ShaderLibrary.hpp"
+#include "../../Core.hpp"
+#include "../../Utils/CPUFeatures.hpp"
+#include "../../Utils/MathUtils.hpp"
+#include "../../Utils/Random/Random.hpp"
+#include "../../Utils/Timer/Timer.hpp"
+#include "../../Utils/Thread/ThreadPool.hpp"
+
+
+
+namespace Syn {
+
+
+	// array alignment, in bytes
+	static const size_t s_alignment = 64;
+
+
+	// Everything an integration kernel needs for one step.
+	struct particle_step_t
+	{
+		ParticleArrays a;
+		ParticleVertex* vertices;
+		uint8_t* deadMask;		// one bit per particle, one byte per 8 particles
+		float dt;
+		float damp;				// exp(-drag * dt)
+		glm::vec3 dv;			// gravity * dt
+	};
+
+	// Integrates particles [_begin, _end) up to the returned index, adding the number of
+	// dead particles to *_dead; the remainder is done by the scalar path. _begin is a
+	// multiple of 8.
+	typedef uint32_t (*integrate_kernel_t)(const particle_step_t&, uint32_t, uint32_t, uint32_t*);
+
+
+	//-----------------------------------------------------------------------------------
+	static void integrate_scalar(const particle_step_t& _s, uint32_t _begin, uint32_t _end, uint32_t* _dead)
+	{
+		const ParticleArrays& a = _s.a;
+		uint32_t dead = 0;
+		for (uint32_t i = _begin; i < _end; i++)
+		{
+			float vx = (a.vx[i] + _s.dv.x) * _s.damp;
+			float vy = (a.vy[i] + _s.dv.y) * _s.damp;
+			float vz = (a.vz[i] + _s.dv.z) * _s.damp;
+			float px = a.px[i] + vx * _s.dt;
+			float py = a.py[i] + vy * _s.dt;
+			float pz = a.pz[i] + vz * _s.dt;
+			float age = a.age[i] + _s.dt;
+
+			a.vx[i] = vx;	a.vy[i] = vy;	a.vz[i] = vz;
+			a.px[i] = px;	a.py[i] = py;	a.pz[i] = pz;
+			a.age[i] = age;
+			_s.vertices[i] = { glm::vec3(px, py, pz), a.color[i] };
+
+			uint32_t dying = age >= a.lifetime[i] ? 1 : 0;
+			if ((i & 7) == 0)
+				_s.deadMask[i >> 3] = 0;
+			_s.deadMask[i >> 3] |= (uint8_t)(dying << (i & 7));
+			dead += dying;
+		}
+		*_dead += dead;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static uint32_t integrate_none(const particle_step_t&, uint32_t _begin, uint32_t, uint32_t*)
+	{
+		return _begin;
+	}
+
+
+#ifdef SYN_SIMD_X86
+	//-----------------------------------------------------------------------------------
+	__attribute__((target("avx2")))
+	static uint32_t integrate_avx2(const particle_step_t& _s, uint32_t _begin, uint32_t _end, uint32_t* _dead)
+	{
+		const ParticleArrays& a = _s.a;
+		const __m256 dt = _mm256_set1_ps(_s.dt);
+		const __m256 damp = _mm256_set1_ps(_s.damp);
+		const __m256 dvx = _mm256_set1_ps(_s.dv.x);
+		const __m256 dvy = _mm256_set1_ps(_s.dv.y);
+		const __m256 dvz = _mm256_set1_ps(_s.dv.z);
+
+		// chunks start at multiples of 8 and the arrays are 64 byte aligned
+		uint32_t dead = 0;
+		uint32_t i = _begin;
+		for (; i + 8 <= _end; i += 8)
+		{
+			__m256 vx = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(a.vx + i), dvx), damp);
+			__m256 vy = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(a.vy + i), dvy), damp);
+			__m256 vz = _mm256_mul_ps(_mm256_add_ps(_mm256_load_ps(a.vz + i), dvz), damp);
+			__m256 px = _mm256_add_ps(_mm256_load_ps(a.px + i), _mm256_mul_ps(vx, dt));
+			__m256 py = _mm256_add_ps(_mm256_load_ps(a.py + i), _mm256_mul_ps(vy, dt));
+			__m256 pz = _mm256_add_ps(_mm256_load_ps(a.pz + i), _mm256_mul_ps(vz, dt));
+			__m256 age = _mm256_add_ps(_mm256_load_ps(a.age + i), dt);
+
+			_mm256_store_ps(a.vx + i, vx);
+			_mm256_store_ps(a.vy + i, vy);
+			_mm256_store_ps(a.vz + i, vz);
+			_mm256_store_ps(a.px + i, px);
+			_mm256_store_ps(a.py + i, py);
+			_mm256_store_ps(a.pz + i, pz);
+			_mm256_store_ps(a.age + i, age);
+
+			int dying = _mm256_movemask_ps(_mm256_cmp_ps(age, _mm256_load_ps(a.lifetime + i), _CMP_GE_OQ));
+			_s.deadMask[i >> 3] = (uint8_t)dying;
+			dead += (uint32_t)__builtin_popcount(dying);
+
+			// transpose (x, y, z, color) into 8 vertices
+			__m256 c = _mm256_load_ps((const float*)(a.color + i));
+			__m256 t0 = _mm256_unpacklo_ps(px, py);		// x0 y0 x1 y1 | x4 y4 x5 y5
+			__m256 t1 = _mm256_unpackhi_ps(px, py);		// x2 y2 x3 y3 | x6 y6 x7 y7
+			__m256 t2 = _mm256_unpacklo_ps(pz, c);
+			__m256 t3 = _mm256_unpackhi_ps(pz, c);
+			__m256 v0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));	// vertex 0 | 4
+			__m256 v1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));	// vertex 1 | 5
+			__m256 v2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));	// vertex 2 | 6
+			__m256 v3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));	// vertex 3 | 7
+			float* out = (float*)(_s.vertices + i);
+			_mm256_store_ps(out,      _mm256_permute2f128_ps(v0, v1, 0x20));
+			_mm256_store_ps(out + 8,  _mm256_permute2f128_ps(v2, v3, 0x20));
+			_mm256_store_ps(out + 16, _mm256_permute2f128_ps(v0, v1, 0x31));
+			_mm256_store_ps(out + 24, _mm256_permute2f128_ps(v2, v3, 0x31));
+		}
+		*_dead += dead;
+		return i;
+	}
+#endif
+
+
+	//-----------------------------------------------------------------------------------
+	struct particle_kernels_t
+	{
+		integrate_kernel_t integrate = integrate_none;
+		const char* name = "scalar";
+	};
+	//-----------------------------------------------------------------------------------
+	static const particle_kernels_t& get_kernels(bool _simd)
+	{
+		static const particle_kernels_t s_scalar;
+		if (!_simd)
+			return s_scalar;
+
+		static particle_kernels_t s_kernels = []()
+		{
+			particle_kernels_t kernels;
+			#if defined(SYN_SIMD_X86)
+				if (cpu_features().avx2)
+					kernels = { integrate_avx2, "AVX2" };
+			#endif
+			return kernels;
+		}();
+		return s_kernels;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	static inline size_t align_up(size_t _bytes)
+	{
+		return (_bytes + s_alignment - 1) & ~(s_alignment - 1);
+	}
+	//-----------------------------------------------------------------------------------
+	static inline uint32_t chunk_size(const ParticleParameters& _params)
+	{
+		return (max(_params.chunkSize, 8u) + 7u) & ~7u;
+	}
+
+
+	//-----------------------------------------------------------------------------------
+	ParticleSystem::ParticleSystem(uint32_t _capacity, const ParticleParameters& _params) :
+		m_capacity(_capacity), m_params(_params)
+	{
+		SYN_CORE_ASSERT(_capacity > 0, "particle capacity has to be at least 1.");
+
+		// nine arrays of 4 byte values and the vertices, every one 64 byte aligned
+		size_t arrayBytes = align_up(sizeof(float) * m_capacity);
+		size_t vertexBytes = align_up(sizeof(ParticleVertex) * m_capacity);
+		m_data = std::aligned_alloc(s_alignment, 9 * arrayBytes + vertexBytes);
+		SYN_CORE_ASSERT(m_data != nullptr, "could not allocate the particle arrays.");
+
+		uint8_t* p = (uint8_t*)m_data;
+		float** arrays[8] = { &m_arrays.px, &m_arrays.py, &m_arrays.pz,
+							  &m_arrays.vx, &m_arrays.vy, &m_arrays.vz,
+							  &m_arrays.age, &m_arrays.lifetime };
+		for (uint32_t k = 0; k < 8; k++, p += arrayBytes)
+			*arrays[k] = (float*)p;
+		m_arrays.color = (uint32_t*)p;
+		m_vertices = (ParticleVertex*)(p + arrayBytes);
+		m_deadMask.resize((m_capacity + 7) / 8);
+
+		m_stats.kernels = get_kernels(m_params.simd).name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	ParticleSystem::~ParticleSystem()
+	{
+		std::free(m_data);
+	}
+
+	//-----------------------------------------------------------------------------------
+	void ParticleSystem::setParameters(const ParticleParameters& _params)
+	{
+		m_params = _params;
+		m_stats.kernels = get_kernels(m_params.simd).name;
+	}
+
+	//-----------------------------------------------------------------------------------
+	uint32_t ParticleSystem::emit(uint32_t _count)
+	{
+		uint32_t n = min(_count, m_capacity - m_count);
+		uint32_t first = m_count;
+		size_t bytes = sizeof(float) * n;
+
+		std::memset(m_arrays.px + first, 0, bytes);
+		std::memset(m_arrays.py + first, 0, bytes);
+		std::memset(m_arrays.pz + first, 0, bytes);
+		std::memset(m_arrays.vx + first, 0, bytes);
+		std::memset(m_arrays.vy + first, 0, bytes);
+		std::memset(m_arrays.vz + first, 0, bytes);
+		std::memset(m_arrays.age + first, 0, bytes);
+		std::fill(m_arrays.lifetime + first, m_arrays.lifetime + first + n, 1.0f);
+		std::fill(m_arrays.color + first, m_arrays.color + first + n, 0xffffffff);
+
+		m_count += n;
+		m_emitted += n;
+		return n;
+	}
+
+	//-----------------------------------------------------------------------------------
+	uint32_t ParticleSystem::emitBurst(uint32_t _count,
+									   const glm::vec3& _position,
+									   const glm::vec3& _velocity,
+									   float _spread,
+									   float _lifetime,
+									   uint32_t _color)
+	{
+		uint32_t n = emit(_count);
+		const ParticleArrays& a = m_arrays;
+		for (uint32_t i = m_count - n; i < m_count; i++)
+		{
+			glm::vec3 v = _velocity + Random::rand3_f_r(-_spread, _spread);
+			a.px[i] = _position.x;	a.py[i] = _position.y;	a.pz[i] = _position.z;
+			a.vx[i] = v.x;			a.vy[i] = v.y;			a.vz[i] = v.z;
+			a.lifetime[i] = _lifetime;
+			a.color[i] = _color;
+		}
+		return n;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void ParticleSystem::update(float _dt)
+	{
+		Timer timer("", false);
+
+		const particle_kernels_t& kernels = get_kernels(m_params.simd);
+		m_stats.killed = 0;
+		m_stats.emitted = m_emitted;
+		m_emitted = 0;
+
+		if (m_count > 0)
+		{
+			particle_step_t step;
+			step.a = m_arrays;
+			step.vertices = m_vertices;
+			step.deadMask = m_deadMask.data();
+			step.dt = _dt;
+			step.damp = std::exp(-m_params.drag * _dt);
+			step.dv = m_params.gravity * _dt;
+
+			uint32_t chunk = chunk_size(m_params);
+			uint32_t count = m_count;
+			size_t chunkCount = (count + chunk - 1) / chunk;
+			m_chunkDead.assign(chunkCount, 0);
+
+			ThreadPool::get().parallelFor(0, chunkCount, [&](size_t c)
+			{
+				uint32_t begin = (uint32_t)c * chunk;
+				uint32_t end = min(begin + chunk, count);
+				uint32_t dead = 0;
+				uint32_t i = kernels.integrate(step, begin, end, &dead);
+				integrate_scalar(step, i, end, &dead);
+				m_chunkDead[c] = dead;
+			});
+			m_stats.integrateMs = timer.getDeltaTimeMs();
+
+			compact();
+			m_stats.compactMs = timer.getDeltaTimeMs() - m_stats.integrateMs;
+		}
+
+		m_stats.alive = m_count;
+		m_stats.updateMs = timer.getDeltaTimeMs();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void ParticleSystem::compact()
+	{
+		const ParticleArrays& a = m_arrays;
+		const uint8_t* deadMask = m_deadMask.data();
+		uint32_t chunk = chunk_size(m_params);
+		uint32_t n = m_count;
+
+		auto dead = [&](uint32_t _i) { return (deadMask[_i >> 3] >> (_i & 7)) & 1; };
+
+		// dead particles in ascending order, each replaced by the last live one; slots at
+		// and above n are never written, so their bits stay valid
+		for (size_t c = 0; c < m_chunkDead.size(); c++)
+		{
+			if ((uint32_t)c * chunk >= n)
+				break;
+			if (m_chunkDead[c] == 0)
+				continue;
+
+			uint32_t groupEnd = (min((uint32_t)(c + 1) * chunk, m_count) + 7) / 8;
+			for (uint32_t g = (uint32_t)c * chunk / 8; g < groupEnd && 8 * g < n; g++)
+			{
+				for (uint32_t bits = deadMask[g]; bits != 0; bits &= bits - 1)
+				{
+					uint32_t i = 8 * g + (uint32_t)__builtin_ctz(bits);
+					if (i >= n)
+						break;
+
+					while (n - 1 > i && dead(n - 1))
+						n--;
+					n--;
+					if (n == i)
+						continue;
+
+					a.px[i] = a.px[n];	a.py[i] = a.py[n];	a.pz[i] = a.pz[n];
+					a.vx[i] = a.vx[n];	a.vy[i] = a.vy[n];	a.vz[i] = a.vz[n];
+					a.age[i] = a.age[n];
+					a.lifetime[i] = a.lifetime[n];
+					a.color[i] = a.color[n];
+					m_vertices[i] = m_vertices[n];
+				}
+			}
+		}
+
+		m_stats.killed = m_count - n;
+		m_count = n;
+	}
+
+	//-----------------------------------------------------------------------------------
+	void ParticleSystem::upload()
+	{
+		m_uploadCount = m_count;
+		if (m_count == 0)
+			return;
+
+		if (m_vertexArray == nullptr)
+		{
+			Ref<VertexBuffer> vertexBuffer = MakeRef<VertexBuffer>(GL_STREAM_DRAW);
+			vertexBuffer->setBufferLayout({
+				{ VERTEX_ATTRIB_LOCATION_POSITION, ShaderDataType::Float3, "a_position" },
+				{ VERTEX_ATTRIB_LOCATION_COLOR, ShaderDataType::UByte4, "a_color", true },
+			});
+			vertexBuffer->setData(nullptr, sizeof(ParticleVertex) * m_capacity);
+			m_vertexArray = MakeRef<VertexArray>(vertexBuffer);
+			if (m_shader == nullptr)
+				m_shader = getDefaultShader();
+
+			// resolves the uniforms before use
+			Renderer::executeRenderCommands();
+		}
+
+		// re-specifying the storage (at the same size every frame) orphans the previous
+		// buffer, so the upload doesn't wait for draws still reading it
+		const Ref<VertexBuffer>& vertexBuffer = m_vertexArray->getVertexBuffer();
+		vertexBuffer->startDataBlock(sizeof(ParticleVertex) * m_capacity);
+		vertexBuffer->addSubData(m_vertices, sizeof(ParticleVertex) * m_count, 0);
+		vertexBuffer->endDataBlock();
+	}
+
+	//-----------------------------------------------------------------------------------
+	void ParticleSystem::render(const Ref<Camera>& _camera)
+	{
+		upload();
+		if (m_uploadCount == 0)
+			return;
+
+		m_shader->enable();
+		m_shader->setMatrix4fv("u_view_projection_matrix", _camera->getViewProjectionMatrix());
+		m_shader->setUniform1f("u_point_size", m_params.pointSize);
+		Renderer::drawArrays(m_vertexArray, m_uploadCount, 0, true, GL_POINTS);
+		m_shader->disable();
+	}
+
+	//-----------------------------------------------------------------------------------
+	Ref<Shader> ParticleSystem::getDefaultShader()
+	{
+		static const std::string name = "static_particle_point_shader";
+		Ref<Shader> shader = ShaderLibrary::getShader(name);
+		if (shader != nullptr)
+			return shader;
+
+		std::string src = R"(
+			#type VERTEX_SHADER
+			#version 330 core
+
+			layout(location = 0) in vec3 a_position;
+			layout(location = 5) in vec4 a_color;
+
+			uniform mat4 u_view_projection_matrix = mat4(1.0f);
+			uniform float u_point_size = 4.0f;
+
+			out vec4 v_color;
+
+			void main() {
+				gl_Position = u_view_projection_matrix * vec4(a_position, 1.0f);
+				gl_PointSize = u_point_size / max(gl_Position.w, 1e-3f);
+				v_color = a_color;
+			}
+
+			#type FRAGMENT_SHADER
+			#version 330 core
+
+			layout(location = 0) out vec4 out_color;
+
+			in vec4 v_color;
+
+			void main() {
+				out_color = v_color;
+			}
+		)";
+
+		return ShaderLibrary::loadFromSrc(name, src);
+	}
+
+
+}
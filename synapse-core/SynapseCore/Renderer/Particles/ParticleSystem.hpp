@@ -0,0 +1,165 @@
+#pragma once
+
+
+#include <stdint.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../../Memory.hpp"
+#include "../Buffers/VertexArray.hpp"
+#include "../Shader/Shader.hpp"
+#include "../Camera/Camera.hpp"
+
+
+namespace Syn {
+
+
+	// Vertices streamed to the GPU, 16 bytes : position and RGBA8 color (normalized).
+	typedef struct particle_vertex_
+	{
+		glm::vec3 position;
+		uint32_t color;
+	} ParticleVertex;
+
+	/* The particle arrays, one value per particle; particle i is at index i of every
+	 * array. Arrays start on 64 byte boundaries.
+	 */
+	struct ParticleArrays
+	{
+		float* px = nullptr;
+		float* py = nullptr;
+		float* pz = nullptr;
+		float* vx = nullptr;
+		float* vy = nullptr;
+		float* vz = nullptr;
+		float* age = nullptr;			// seconds
+		float* lifetime = nullptr;		// seconds, the particle dies when age >= lifetime
+		uint32_t* color = nullptr;		// RGBA8, see pack_unorm_4x8()
+	};
+
+
+	//
+	struct ParticleParameters
+	{
+		glm::vec3 gravity = glm::vec3(0.0f, -9.81f, 0.0f);
+		float drag = 0.0f;					// linear, velocities decay by exp(-drag * dt)
+		float pointSize = 4.0f;				// pixels at unit distance, see render()
+		uint32_t chunkSize = 16384;			// particles per ThreadPool task (a multiple of 8)
+		bool simd = true;					// AVX2 integration where supported, false forces the scalar path
+	};
+
+	// Statistics of the last update.
+	struct ParticleStats
+	{
+		uint32_t alive = 0;
+		uint32_t emitted = 0;				// between the last two updates
+		uint32_t killed = 0;
+		float integrateMs = 0.0f;			// including packing the vertices
+		float compactMs = 0.0f;
+		float updateMs = 0.0f;
+		const char* kernels = "scalar";
+	};
+
+
+	/* CPU particle system with a fixed capacity, stored as a structure of arrays. An
+	 * update integrates velocities (gravity and drag) and positions, ages the particles
+	 * and writes the vertices of the live ones to a staging array, in chunks over the
+	 * ThreadPool with AVX2 kernels (selected at runtime) and a scalar fallback. The
+	 * results are identical on both paths and for any number of threads.
+	 *
+	 * The integration also marks dead particles in a bit mask. They are then removed by
+	 * moving the last live particle into their slot, so removal costs O(dead) moves plus
+	 * a scan of the masks (one byte per 8 particles) of the chunks with dead particles;
+	 * the order of the particles is not preserved.
+	 *
+	 * render() streams the live vertices to a GL_STREAM_DRAW vertex buffer (orphaned, so
+	 * the upload doesn't wait for draws of the previous frame) and draws them as
+	 * GL_POINTS. Both are deferred to the render command queue, so update() must not be
+	 * called between render() and the execution of the render commands. The vertex
+	 * buffer and the shader are created by the first render() with live particles;
+	 * nothing else needs a GL context.
+	 */
+	class ParticleSystem
+	{
+	public:
+		ParticleSystem(uint32_t _capacity, const ParticleParameters& _params=ParticleParameters());
+		~ParticleSystem();
+
+		// not copyable, the arrays are owned
+		ParticleSystem(const ParticleSystem&) = delete;
+		ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+		/* Appends up to _count particles (fewer when the capacity is reached) and returns
+		 * the number added; they are the last ones, [getCount() - n, getCount()), of
+		 * getArrays(). Positions and velocities are zeroed, the age is 0 and the lifetime
+		 * 1; the rest is up to the caller, e.g. in parallel over the new range.
+		 */
+		uint32_t emit(uint32_t _count);
+		/* Emits _count particles at _position, with velocities _velocity plus a uniform
+		 * random offset in [-_spread, _spread] per axis. */
+		uint32_t emitBurst(uint32_t _count,
+						   const glm::vec3& _position,
+						   const glm::vec3& _velocity,
+						   float _spread,
+						   float _lifetime,
+						   uint32_t _color);
+
+		/* Advances the particles by _dt, removes the dead ones and writes the vertices
+		 * of the rest to the staging array (getVertices()). */
+		void update(float _dt);
+
+		/* Streams the vertices of the live particles to the vertex buffer and draws them
+		 * as points. The default shader scales the point size by 1 / distance and uses
+		 * the alpha of the particle color; blending is up to the caller. */
+		void render(const Ref<Camera>& _camera);
+
+		/* Removes all particles. */
+		inline void clear() { m_count = 0; }
+
+		// Accessors
+		inline const ParticleArrays& getArrays() const { return m_arrays; }
+		inline uint32_t getCount() const { return m_count; }
+		inline uint32_t getCapacity() const { return m_capacity; }
+		inline const ParticleVertex* getVertices() const { return m_vertices; }
+		/* Takes effect from the next update(). */
+		void setParameters(const ParticleParameters& _params);
+		inline const ParticleParameters& getParameters() const { return m_params; }
+		inline const ParticleStats& getStats() const { return m_stats; }
+		inline const Ref<VertexArray>& getVertexArray() const { return m_vertexArray; }
+		inline void setShader(const Ref<Shader>& _shader) { m_shader = _shader; }
+		inline const Ref<Shader>& getShader() const { return m_shader; }
+
+		/* The point shader used by render(), for drawing other ParticleVertex buffers
+		 * (u_view_projection_matrix and u_point_size). */
+		static Ref<Shader> getDefaultShader();
+
+
+	private:
+		// moves the last live particle into the slots of dead ones, found through the
+		// dead masks of the chunks with dead particles
+		void compact();
+		void upload();
+
+
+	private:
+		uint32_t m_capacity = 0;
+		uint32_t m_count = 0;
+		uint32_t m_emitted = 0;						// since the last update
+		ParticleParameters m_params;
+		ParticleStats m_stats;
+
+		void* m_data = nullptr;						// all arrays, one allocation
+		ParticleArrays m_arrays;
+		ParticleVertex* m_vertices = nullptr;		// staging, in the order of the particles
+		std::vector<uint32_t> m_chunkDead;			// dead particles per chunk
+		std::vector<uint8_t> m_deadMask;			// written by the integration, a bit per particle
+
+		uint32_t m_uploadCount = 0;					// vertices in the vertex buffer
+		Ref<VertexArray> m_vertexArray = nullptr;
+		Ref<Shader> m_shader = nullptr;
+
+	};
+
+
+}
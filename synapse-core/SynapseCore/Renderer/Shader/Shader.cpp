@@ -35,6 +35,45 @@ namespace Syn {
 		return ret;
 	}
 
+	//-----------------------------------------------------------------------------------
+	// GLSL shared between shaders, pasted by Shader::preprocess() in place of a line
+	// '#include <name>'.
+	static const std::unordered_map<std::string, std::string> s_shader_includes = {
+		// positions of meshes loaded with MESH_LOAD_PACKED_VERTICES, see MeshAssimp::render()
+		{ "packed_vertex",
+		  "uniform vec3 u_positionScale;\n"
+		  "uniform vec3 u_positionOffset;\n"
+		  "vec3 unpack_position(vec3 _p) { return u_positionOffset + u_positionScale * _p; }\n" },
+	};
+
+	//-----------------------------------------------------------------------------------
+	static std::string expand_includes(const std::string& _source)
+	{
+		const char* includeToken = "#include";
+		std::string expanded;
+		size_t begin = 0;
+		size_t pos;
+		while ((pos = _source.find(includeToken, begin)) != std::string::npos)
+		{
+			size_t eol = std::min(_source.find_first_of("\r\n", pos), _source.size());
+			size_t open = _source.find('<', pos);
+			size_t close = _source.find('>', pos);
+			expanded.append(_source, begin, pos - begin);
+			auto found = open < close && close < eol ? s_shader_includes.find(_source.substr(open + 1, close - open - 1)) : s_shader_includes.end();
+			if (found != s_shader_includes.end())
+				expanded.append(found->second);
+			else
+			{
+				// left for the compiler to report
+				SYN_CORE_WARNING("unknown shader include: ", _source.substr(pos, eol - pos));
+				expanded.append(_source, pos, eol - pos);
+			}
+			begin = eol;
+		}
+		expanded.append(_source, begin, std::string::npos);
+		return expanded;
+	}
+
 	//-----------------------------------------------------------------------------------
 	static std::string g_str;
 	inline const char* leading_blank_spaces(int _line_num, int _error_code=0)
@@ -266,7 +305,7 @@ namespace Syn {
 
 			size_t nextLinePos = _source.find_first_not_of("\r\n", eol);
 			pos = _source.find(typeToken, nextLinePos);
-			shaderSources[type] = _source.substr(nextLinePos, pos - (nextLinePos == std::string::npos ? _source.size() - 1 : nextLinePos));
+			shaderSources[type] = expand_includes(_source.substr(nextLinePos, pos - (nextLinePos == std::string::npos ? _source.size() - 1 : nextLinePos)));
 		}
 
 		return shaderSources;
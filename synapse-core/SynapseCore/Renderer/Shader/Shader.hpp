@@ -41,6 +41,8 @@ namespace Syn {
 
 		// accessors -- more below
 		GLint getUniformLocation(const std::string& _uniform_name);
+		/* True if the (linked) shader uses the uniform; no warning otherwise. */
+		bool hasUniform(const std::string& _uniform_name) const { return m_uniforms.find(_uniform_name) != m_uniforms.end(); }
 		const GLuint getShaderID() { return m_shaderID; }
 		const std::string& getName() { return m_shaderName; }
 		const bool isLoaded() { /*SYN_CORE_TRACE(m_shaderName, " - m_loaded = ", m_loaded);*/ return m_loaded; }
@@ -37,6 +37,18 @@ namespace Syn
 	{}
     };
 
+    // Quantized vertex: unsigned normalized 16-bit position relative to the bounds of
+    // the mesh (w = 1), half float UV and signed normalized 10:10:10:2 normal, tangent
+    // and bitangent. 24 bytes, vs. 56 for VertexBase.
+    struct VertexPacked
+    {
+	uint16_t position[4];
+	uint32_t normal;
+	uint32_t tangent;
+	uint32_t bitangent;
+	uint16_t uv[2];
+    };
+
     //
     struct Index
     {
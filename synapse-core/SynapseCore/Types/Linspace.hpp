@@ -3,6 +3,7 @@
 
 #include "../Core.hpp"
 #include "../Memory/MemoryTypes.hpp"
+#include "../Utils/MathUtils.hpp"
 
 
 namespace Syn
@@ -48,9 +49,9 @@ namespace Syn
         { updateLinspace(); }
         // copy constructor
         Linspace<T>(const Linspace<T>& _other) :
+            values(new T[_other.steps]),
             lim(_other.lim), 
-            steps(_other.steps), 
-            values(new T[_other.steps])
+            steps(_other.steps)
         {
             // deep copy of data
             std::copy(_other.values, _other.values + _other.steps, values);
@@ -79,7 +80,7 @@ namespace Syn
         const T operator[](uint32_t _index) const { return values[_index]; }
         const T get(uint32_t _index) const { return values[_index]; }
         T* getValues() const { return values; }
-        void print() const { SYN_CORE_TRACE("Linspace [ ", lim.min, "  ", lim.max, " ], n = ", steps); }
+        void print() const { SYN_CORE_TRACE("Linspace [ ", lim.min_, "  ", lim.max_, " ], n = ", steps); }
 
     public:
         void setLinspace(T _lim_min, T _lim_max, uint32_t _steps)
@@ -97,8 +98,8 @@ namespace Syn
             values = new T[steps];
             
             T step = lim.range() / (T)(steps - 1);
-            T f = lim.min;
-            for (int i = 0; i < steps; i++)
+            T f = lim.min_;
+            for (uint32_t i = 0; i < steps; i++)
             {
                 values[i] = f;
                 f += step;
@@ -0,0 +1,57 @@
+#pragma once
+
+/* CPU features for the runtime-selected SIMD kernels (MeshNormals, ParticleSystem, VxNoise,
+ * Noise grids, FluidSolverCPU, BarnesHut).
+ *
+ * SYN_SIMD_X86 is defined where x86 vector kernels can be compiled : GCC and clang, which
+ * compile them for their target (__attribute__((target("avx2"))) or #pragma GCC target)
+ * without raising the baseline of the rest of the build. The kernels are then picked once,
+ * at runtime, from cpu_features(), and every module keeps a scalar fallback.
+ * SYN_SIMD_NEON is defined on AArch64, where NEON is part of the baseline.
+ *
+ * Kernels that have a scalar twin are bit-exact with it : the same operations, in the same
+ * order, and no FMA (a fused multiply-add rounds once where the scalar path rounds twice, so
+ * GCC is kept from contracting them with fp-contract=off). Results then don't depend on the
+ * CPU a program runs on. Kernels that use FMA say so and are only equal within tolerance.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+	#define SYN_SIMD_X86
+	#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#define SYN_SIMD_NEON
+	#include <arm_neon.h>
+#endif
+
+
+namespace Syn {
+
+
+	struct CPUFeatures
+	{
+		bool avx2 = false;
+		bool fma = false;
+		bool avx512f = false;
+		bool neon = false;
+	};
+
+	/* The features of the running CPU, detected on the first call. */
+	inline const CPUFeatures& cpu_features()
+	{
+		static const CPUFeatures s_features = []()
+		{
+			CPUFeatures features;
+			#if defined(SYN_SIMD_X86)
+				__builtin_cpu_init();
+				features.avx2 = __builtin_cpu_supports("avx2");
+				features.fma = __builtin_cpu_supports("fma");
+				features.avx512f = __builtin_cpu_supports("avx512f");
+			#elif defined(SYN_SIMD_NEON)
+				features.neon = true;
+			#endif
+			return features;
+		}();
+		return s_features;
+	}
+
+
+}
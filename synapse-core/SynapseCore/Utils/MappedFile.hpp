@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+
+#ifdef __linux__
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+
+namespace Syn {
+
+
+	/* Read-only view of a whole file; memory mapped on Linux, read into memory
+	 * elsewhere. data() is nullptr if the file couldn't be opened or is empty.
+	 * _sequential hints the kernel to read ahead aggressively.
+	 */
+	class MappedFile
+	{
+	public:
+		MappedFile(const std::string& _file_path, bool _sequential=false)
+		{
+		#ifdef __linux__
+			int fd = open(_file_path.c_str(), O_RDONLY);
+			if (fd < 0)
+				return;
+			struct stat st;
+			if (fstat(fd, &st) == 0 && st.st_size > 0)
+			{
+				void* ptr = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (ptr != MAP_FAILED)
+				{
+					if (_sequential)
+						madvise(ptr, (size_t)st.st_size, MADV_SEQUENTIAL);
+					m_data = reinterpret_cast<const uint8_t*>(ptr);
+					m_size = (size_t)st.st_size;
+				}
+			}
+			close(fd);
+		#else
+			std::ifstream file(_file_path, std::ios::binary | std::ios::ate);
+			if (!file.is_open())
+				return;
+			m_buffer.resize((size_t)file.tellg());
+			file.seekg(0);
+			if (file.read(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size()))
+			{
+				m_data = m_buffer.data();
+				m_size = m_buffer.size();
+			}
+		#endif
+		}
+
+		~MappedFile()
+		{
+		#ifdef __linux__
+			if (m_data)
+				munmap(const_cast<uint8_t*>(m_data), m_size);
+		#endif
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		inline const uint8_t* data() const { return m_data; }
+		inline size_t size() const { return m_size; }
+
+	private:
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+		#ifndef __linux__
+			std::vector<uint8_t> m_buffer;
+		#endif
+	};
+
+
+}
@@ -20,6 +20,9 @@
 #define BIT_SHIFT(x) (1 << (x))
 
 
+#include <cstring>
+
+
 namespace Syn
 {
     /* Small, useful inlines.
@@ -65,4 +68,67 @@ namespace Syn
         return glm::vec3(x, y, z);
     }
 
+    /* Float to IEEE 754 half precision (binary16), round to nearest even.
+     * Overflow saturates to infinity.
+     */
+    inline uint16_t float_to_half(float _f)
+    {
+        uint32_t x;
+        std::memcpy(&x, &_f, sizeof(uint32_t));
+        uint32_t sign = (x >> 16) & 0x8000;
+        uint32_t mantissa = x & 0x007fffff;
+        int32_t exponent = (int32_t)((x >> 23) & 0xff) - 127 + 15;
+
+        if (((x >> 23) & 0xff) == 0xff)     // inf/nan
+            return sign | 0x7c00 | (mantissa ? 0x0200 : 0);
+        if (exponent >= 31)                 // overflow
+            return sign | 0x7c00;
+        if (exponent <= 0)                  // denormal or zero
+        {
+            if (exponent < -10)
+                return sign;
+            mantissa |= 0x00800000;
+            uint32_t shift = 14 - exponent;
+            uint32_t h = mantissa >> shift;
+            uint32_t rem = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (rem > halfway || (rem == halfway && (h & 1)))
+                h++;
+            return sign | h;
+        }
+        uint32_t h = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        uint32_t rem = mantissa & 0x1fff;
+        if (rem > 0x1000 || (rem == 0x1000 && (h & 1)))
+            h++;    // carry into the exponent is correct rounding
+        return sign | h;
+    }
+
+    /* Packs a vector in [-1, 1] as signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV,
+     * x in the low bits); _w in {-1, 0, 1}, e.g. the handedness of a tangent frame.
+     */
+    inline uint32_t pack_snorm_2_10_10_10(const glm::vec3& _v, float _w=0.0f)
+    {
+        auto snorm10 = [](float _x) -> uint32_t
+        { return (uint32_t)((int32_t)std::round(clamp(_x, -1.0f, 1.0f) * 511.0f) & 0x3ff); };
+        uint32_t w = (uint32_t)((int32_t)std::round(clamp(_w, -1.0f, 1.0f)) & 0x3);
+        return snorm10(_v.x) | (snorm10(_v.y) << 10) | (snorm10(_v.z) << 20) | (w << 30);
+    }
+
+    /* Quantizes _x in [0, 1] to unsigned normalized 16 bits (GL_UNSIGNED_SHORT,
+     * normalized), round to nearest.
+     */
+    inline uint16_t float_to_unorm16(float _x)
+    {
+        return (uint16_t)std::round(clamp(_x, 0.0f, 1.0f) * 65535.0f);
+    }
+
+    /* Packs a color in [0, 1] as RGBA8 (GL_UNSIGNED_BYTE x 4, normalized), red in the
+     * low byte.
+     */
+    inline uint32_t pack_unorm_4x8(const glm::vec4& _c)
+    {
+        auto unorm8 = [](float _x) -> uint32_t { return (uint32_t)std::round(clamp(_x, 0.0f, 1.0f) * 255.0f); };
+        return unorm8(_c.x) | (unorm8(_c.y) << 8) | (unorm8(_c.z) << 16) | (unorm8(_c.w) << 24);
+    }
+
 }
\ No newline at end of file
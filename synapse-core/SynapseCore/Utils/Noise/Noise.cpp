@@ -6,6 +6,8 @@
 
 #include "Noise.hpp"
 #include "NoiseGenerator.hpp"
+#include "NoiseKernels.hpp"
+#include "../Thread/ThreadPool.hpp"
 
 
 // buffer overflow in indexing 3 * size * size in save_noise_PNG()
@@ -41,39 +43,32 @@ namespace Syn
 
 
 	//---------------------------------------------------------------------------------------
-	// fBm noise without derivatives (using FastNoise function pointers).
+	// fBm noise without derivatives (using the fBm kernels, see NoiseKernels.hpp).
+	//---------------------------------------------------------------------------------------
+	// column-major rotation for the kernels; identity if not rotating
+	static void kernel_rotation(const glm::mat2& _m, bool _rotate, float* _rot)
+	{
+		for (int c = 0; c < 2; c++)
+			for (int r = 0; r < 2; r++)
+				_rot[c * 2 + r] = _rotate ? _m[c][r] : (c == r ? 1.0f : 0.0f);
+	}
+	static void kernel_rotation(const glm::mat3& _m, bool _rotate, float* _rot)
+	{
+		for (int c = 0; c < 3; c++)
+			for (int r = 0; r < 3; r++)
+				_rot[c * 3 + r] = _rotate ? _m[c][r] : (c == r ? 1.0f : 0.0f);
+	}
 	//---------------------------------------------------------------------------------------
 	float Noise::fbm_perlin2(const glm::vec2& _p, bool _rotate)
 	{
-		// noise parameters
-		glm::vec2 p = _p + glm::vec2(s_noise_param.offset.x, s_noise_param.offset.y);
-		//s_f_noise.SetFrequency(s_noise_param.baseFreq);
-		float  f = s_noise_param.baseFreq;
-		float df = s_noise_param.deltaFreq;
-		float  a = s_noise_param.baseAmp;
-		float da = s_noise_param.deltaAmp;
-		int    o = s_noise_param.octaveCount;
-		float  r = a;// accumulated amplitude, for normalization
-		// rotational fractal noise? no? then multiply each octave with identity.
-		glm::mat2 rotMat = _rotate ? s_rotation_mat2 : glm::mat2(1.0f);
-		
-		// first octave
-		float n = a * s_perlin2->eval(p, f);;
-		//float n = /* baseAmp * */FASTNOISE_MEMBER_FNC_PTR(s_f_noise_2D_ptr)(p.x, p.y);
-
-		// rest of octaves
-		for (int i = 1; i < o; i++)
-		{
-			f *= df;
-			a *= da;
-			p = rotMat * p;
-			n += a * s_perlin2->eval(p, f);
-			r += a;
-		}
-		// return normalized noise
-		return (n);// / r);
-		//return (n / r + 1.0f) * 0.5f;
+		float rot[4];
+		kernel_rotation(s_rotation_mat2, _rotate, rot);
+		NoiseRowFnc kernel = NoiseKernels::get(2, NoiseType::Perlin, s_noise_param.octaveCount);
 
+		// return noise (not normalized)
+		float n;
+		kernel(s_perlin2->getTables(), s_noise_param, rot, &_p.x, &_p.y, nullptr, &n, nullptr, 1);
+		return n;
 	}
 	//---------------------------------------------------------------------------------------
 	float Noise::single_2D(const glm::vec2& _p)
@@ -84,35 +79,80 @@ namespace Syn
 	//---------------------------------------------------------------------------------------
 	float Noise::fbm_perlin3(const glm::vec3& _p, bool _rotate)
 	{
-		// noise parameters
-		glm::vec3 p = _p + s_noise_param.offset;
-		//s_f_noise.SetFrequency(s_noise_param.baseFreq);
-		float  f = s_noise_param.baseFreq;
-		float df = s_noise_param.deltaFreq;
-		float  a = s_noise_param.baseAmp;
-		float da = s_noise_param.deltaAmp;
-		int    o = s_noise_param.octaveCount;
-		float  r = a;// accumulated amplitude, for normalization
-		// rotational fractal noise? no? then multiply each octave with identity.
-		glm::mat3 rotMat = _rotate ? s_rotation_mat3 : glm::mat3(1.0f);
-
-		// first octave
-		//float n = /* baseAmp * */FASTNOISE_MEMBER_FNC_PTR(s_f_noise_3D_ptr)(p.x, p.y, p.z);
-		float n = a * s_perlin3->eval(p, f);
-
-		// rest of octaves
-		for (int i = 1; i < o; i++)
+		float rot[9];
+		kernel_rotation(s_rotation_mat3, _rotate, rot);
+		NoiseRowFnc kernel = NoiseKernels::get(3, NoiseType::Perlin, s_noise_param.octaveCount);
+
+		float n;
+		kernel(s_perlin3->getTables(), s_noise_param, rot, &_p.x, &_p.y, &_p.z, &n, nullptr, 1);
+		return n;
+	}
+	//---------------------------------------------------------------------------------------
+	// fBm noise over grids, row by row.
+	//---------------------------------------------------------------------------------------
+	static void eval_grid(NoiseRowFnc _kernel, const NoiseTables& _tables, const NoiseParameters& _param, const float* _rot,
+						  const Linspace<float>& _x, const Linspace<float>& _y, const Linspace<float>* _z, float* _out)
+	{
+		uint32_t nx = _x.size();
+		uint32_t ny = _y.size();
+		size_t rows = (size_t)ny * (_z ? _z->size() : 1);
+		// rows per ThreadPool batch, ~16k samples
+		size_t grain = std::max((size_t)1, (size_t)16384 / std::max(nx, (uint32_t)1));
+
+		ThreadPool::get().parallelFor(0, rows, [&](size_t _row)
 		{
-			f *= df;						// update frequency every octave
-			r += a;							// total amplitude for scaling
-			a *= da;						// update (decrease) amplitude
-			p = rotMat * p;					// rotate for this octave
-			n += a * s_perlin3->eval(p, f);	// add next layer of noise
-			//n += baseAmp * FASTNOISE_MEMBER_FNC_PTR(s_f_noise_3D_ptr)(p.x, p.y, p.z);
+			// per thread row buffers of the (constant) y and z coordinates, only grown
+			static thread_local std::vector<float> y, z;
+			if (y.size() < nx) { y.resize(nx); z.resize(nx); }
+			std::fill_n(y.data(), nx, _y[(uint32_t)(_row % ny)]);
+			if (_z) std::fill_n(z.data(), nx, (*_z)[(uint32_t)(_row / ny)]);
+			_kernel(_tables, _param, _rot, _x.getValues(), y.data(), _z ? z.data() : nullptr, _out + _row * nx, nullptr, nx);
+		}, grain);
+	}
+	//---------------------------------------------------------------------------------------
+	void Noise::evalGrid(const Linspace<float>& _x, const Linspace<float>& _y, float* _out, NoiseType _type, bool _rotate)
+	{
+		evalGrid(s_noise_param, _x, _y, _out, _type, _rotate);
+	}
+	//---------------------------------------------------------------------------------------
+	void Noise::evalGrid(const Linspace<float>& _x, const Linspace<float>& _y, const Linspace<float>& _z, float* _out, NoiseType _type, bool _rotate)
+	{
+		evalGrid(s_noise_param, _x, _y, _z, _out, _type, _rotate);
+	}
+	//---------------------------------------------------------------------------------------
+	void Noise::evalGrid(const NoiseParameters& _param, const Linspace<float>& _x, const Linspace<float>& _y, float* _out, NoiseType _type, bool _rotate)
+	{
+		// kernel and parameters are selected once, for the whole grid
+		NoiseParameters param = _param;
+		NoiseRowFnc kernel = NoiseKernels::get(2, _type, param.octaveCount);
+		if (kernel == nullptr)
+		{
+			SYN_CORE_FATAL_ERROR("unsupported Syn::NoiseType for grids: ", (int)_type);
+			return;
 		}
-		// return normalized noise
-		return (n);// / r);
-		//return (n / r + 1.0f) * 0.5f;
+
+		float rot[4];
+		kernel_rotation(s_rotation_mat2, _rotate, rot);
+		NoiseTables tables = _type == NoiseType::Perlin ? s_perlin2->getTables() : s_value2->getTables();
+
+		eval_grid(kernel, tables, param, rot, _x, _y, nullptr, _out);
+	}
+	//---------------------------------------------------------------------------------------
+	void Noise::evalGrid(const NoiseParameters& _param, const Linspace<float>& _x, const Linspace<float>& _y, const Linspace<float>& _z, float* _out, NoiseType _type, bool _rotate)
+	{
+		NoiseParameters param = _param;
+		NoiseRowFnc kernel = NoiseKernels::get(3, _type, param.octaveCount);
+		if (kernel == nullptr)
+		{
+			SYN_CORE_FATAL_ERROR("unsupported Syn::NoiseType for grids: ", (int)_type);
+			return;
+		}
+
+		float rot[9];
+		kernel_rotation(s_rotation_mat3, _rotate, rot);
+		NoiseTables tables = _type == NoiseType::Perlin ? s_perlin3->getTables() : s_value3->getTables();
+
+		eval_grid(kernel, tables, param, rot, _x, _y, &_z, _out);
 	}
 	//---------------------------------------------------------------------------------------
 	float Noise::single_4D(const glm::vec4& _p)
@@ -10,6 +10,7 @@
 
 #include "../../Core.hpp"
 #include "../../Types.hpp"
+#include "../../Types/Linspace.hpp"
 #include "../Random/Random.hpp"
 
 
@@ -71,13 +72,27 @@ namespace Syn {
 		static FastNoise3DFncPtr s_f_noise_3D_ptr;
 		static FastNoise4DFncPtr s_f_noise_4D_ptr;
 
-		/* Generate 2D noise using preset noise function (s_f_noise_2D_ptr). */
+		/* 2D fBm Perlin noise, with the current noise parameters. */
 		static float fbm_perlin2(const glm::vec2& _p, bool _rotate=true);
 		static float single_2D(const glm::vec2& _p);
 
-		/* Generate 3D noise using preset noise function (s_f_noise_3D_ptr) */
+		/* 3D fBm Perlin noise, with the current noise parameters. */
 		static float fbm_perlin3(const glm::vec3& _p, bool _rotate=true);
 
+		/* fBm noise over a grid : fbm_perlin2() evaluated at every (_x[i], _y[j]), written
+		 * row-major (x fastest) to _out, which holds _x.size() * _y.size() values. _type
+		 * selects the generator (NoiseType::Perlin or NoiseType::Value); the fBm kernel
+		 * (NoiseKernels) is selected once per grid, and rows are distributed over the
+		 * ThreadPool and evaluated 8 points at a time with AVX2 where the CPU has it.
+		 * Identical to the per-point results. */
+		static void evalGrid(const Linspace<float>& _x, const Linspace<float>& _y, float* _out, NoiseType _type=NoiseType::Perlin, bool _rotate=true);
+		/* As above, fbm_perlin3() at every (_x[i], _y[j], _z[k]), x fastest, then y. */
+		static void evalGrid(const Linspace<float>& _x, const Linspace<float>& _y, const Linspace<float>& _z, float* _out, NoiseType _type=NoiseType::Perlin, bool _rotate=true);
+		/* As above, with explicit parameters instead of the current ones -- for evaluation off the 
+		 * main thread (e.g. NoiseTileCache), where the current parameters may change meanwhile. */
+		static void evalGrid(const NoiseParameters& _param, const Linspace<float>& _x, const Linspace<float>& _y, float* _out, NoiseType _type=NoiseType::Perlin, bool _rotate=true);
+		static void evalGrid(const NoiseParameters& _param, const Linspace<float>& _x, const Linspace<float>& _y, const Linspace<float>& _z, float* _out, NoiseType _type=NoiseType::Perlin, bool _rotate=true);
+
 		/* Generate 4D noise using preset noise function (s_f_noise_4D_ptr) */
 		static float single_4D(const glm::vec4& _p);
 		static float single_4D(float _x, float _y, float _z, float _w);
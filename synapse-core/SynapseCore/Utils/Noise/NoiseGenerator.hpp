@@ -2,6 +2,7 @@
 
 
 #include "Noise.hpp"
+#include "NoiseKernels.hpp"
 
 
 namespace Syn {
@@ -27,6 +28,17 @@ namespace Syn {
 		*/
 		virtual float eval_d(const T& _p, T& _dp, float _f = 1.0f) = 0;
 
+		/* Lookup tables, for the fBm kernels (NoiseKernels). */
+		NoiseTables getTables() const
+		{
+			NoiseTables tables;
+			tables.gradients = m_gradients;
+			tables.values = m_values;
+			tables.permutation = m_permutationTable;
+			tables.mask = m_tableMask;
+			return tables;
+		}
+
 	protected:
 		void initPerlinNoise(uint32_t _seed)
 		{
@@ -102,7 +114,7 @@ namespace Syn {
 	};
 
 	/* 2D Perlin noise */
-	class NoisePerlin2 : public NoiseGenerator<glm::vec2>
+	class NoisePerlin2 final : public NoiseGenerator<glm::vec2>
 	{
 	public:
 		NoisePerlin2(uint32_t _seed=191018);
@@ -112,7 +124,7 @@ namespace Syn {
 
 
 	/* 3D Perlin noise */
-	class NoisePerlin3 : public NoiseGenerator<glm::vec3>
+	class NoisePerlin3 final : public NoiseGenerator<glm::vec3>
 	{
 	public:
 		NoisePerlin3(uint32_t _seed=191010);
@@ -156,7 +168,7 @@ namespace Syn {
 
 
 	/* 2D value noise */
-	class NoiseValue2 : public NoiseGenerator<glm::vec2>
+	class NoiseValue2 final : public NoiseGenerator<glm::vec2>
 	{
 	public:
 		NoiseValue2(uint32_t _seed=191018);
@@ -166,7 +178,7 @@ namespace Syn {
 
 
 	/* 3D value noise */
-	class NoiseValue3 : public NoiseGenerator<glm::vec3>
+	class NoiseValue3 final : public NoiseGenerator<glm::vec3>
 	{
 	public:
 		NoiseValue3(uint32_t _seed = 191018);
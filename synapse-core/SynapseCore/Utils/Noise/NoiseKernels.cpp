@@ -0,0 +1,381 @@
+
+#include "../../../pch.hpp"
+
+#include "NoiseKernels.hpp"
+#include "../CPUFeatures.hpp"
+
+
+namespace Syn {
+
+
+	//-----------------------------------------------------------------------------------
+	template<int D, NoiseType T, NoiseStep S>
+	using noise_kernel_t = typename std::conditional<T == NoiseType::Perlin, NoiseKernelPerlin<D, S>, NoiseKernelValue<D, S>>::type;
+
+	//-----------------------------------------------------------------------------------
+	template<int D, NoiseType T, NoiseStep S, int O, bool Deriv>
+	static void fbm_row(const NoiseTables& _tables,
+						const NoiseParameters& _param,
+						const float* _rot,
+						const float* _x, const float* _y, const float* _z,
+						float* _out, float* _dout,
+						uint32_t _n)
+	{
+		noise_kernel_t<D, T, S> kernel(_tables);
+		for (uint32_t i = 0; i < _n; i++)
+		{
+			float p[D];
+			p[0] = _x[i];
+			p[1] = _y[i];
+			if constexpr (D == 3)
+				p[2] = _z[i];
+			_out[i] = kernel.template fbm<O, Deriv>(p, Deriv ? _dout + (size_t)i * D : nullptr, _param, _rot);
+		}
+	}
+
+	//-----------------------------------------------------------------------------------
+	// AVX2 rows without derivatives, 8 points at a time : the operations of
+	// NoiseKernelPerlin/NoiseKernelValue::sample() and NoiseKernel::fbm(), in the same order,
+	// so the results are bit-exact with fbm_row(). Return the number of points done, the
+	// remainder goes to the scalar kernel.
+#ifdef SYN_SIMD_X86
+	#if defined(__clang__)
+		#pragma clang attribute push(__attribute__((target("avx2"))), apply_to=function)
+	#else
+		#pragma GCC push_options
+		#pragma GCC target("avx2")
+		#pragma GCC optimize("fp-contract=off")
+	#endif
+	namespace noise_avx2
+	{
+		typedef __m256 vf;
+		typedef __m256i vi;
+
+		static inline vf set1(float x) { return _mm256_set1_ps(x); }
+		static inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+		static inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+		static inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+		static inline vi and_i(vi a, vi b) { return _mm256_and_si256(a, b); }
+		static inline vi add_i(vi a, vi b) { return _mm256_add_epi32(a, b); }
+
+		// the lattice cell of p : integer corner (masked) and fraction
+		struct cell_t
+		{
+			vi i0, i1;
+			vf t0;
+		};
+		static inline cell_t cell(vf _p, vi _mask)
+		{
+			vf f = _mm256_floor_ps(_p);
+			cell_t c;
+			c.i0 = and_i(_mm256_cvttps_epi32(f), _mask);
+			c.i1 = and_i(add_i(c.i0, _mm256_set1_epi32(1)), _mask);
+			c.t0 = sub(_p, f);
+			return c;
+		}
+
+		template<NoiseStep S>
+		static inline vf step(vf t)
+		{
+			if constexpr (S == NoiseStep::Perlin)
+				return mul(mul(mul(t, t), t), add(mul(t, sub(mul(t, set1(6.0f)), set1(15.0f))), set1(10.0f)));
+			else
+				return mul(mul(t, t), sub(set1(3.0f), mul(set1(2.0f), t)));
+		}
+
+		static inline vi perm(const uint32_t* _p, vi _i) { return _mm256_i32gather_epi32(reinterpret_cast<const int*>(_p), _i, 4); }
+		static inline vi hash2(const uint32_t* _p, vi _x, vi _y) { return perm(_p, add_i(perm(_p, _x), _y)); }
+		static inline vi hash3(const uint32_t* _p, vi _x, vi _y, vi _z) { return perm(_p, add_i(perm(_p, add_i(perm(_p, _x), _y)), _z)); }
+
+		// dot product of the gradient at hash _h with (_x, _y [, _z])
+		static inline vf grad2(const NoiseTables& _tables, vi _h, vf _x, vf _y)
+		{
+			const float* g = reinterpret_cast<const float*>(_tables.gradients);
+			vi i = add_i(_mm256_slli_epi32(_h, 1), _h);
+			return add(mul(_mm256_i32gather_ps(g, i, 4), _x), mul(_mm256_i32gather_ps(g + 1, i, 4), _y));
+		}
+		static inline vf grad3(const NoiseTables& _tables, vi _h, vf _x, vf _y, vf _z)
+		{
+			const float* g = reinterpret_cast<const float*>(_tables.gradients);
+			vi i = add_i(_mm256_slli_epi32(_h, 1), _h);
+			return add(add(mul(_mm256_i32gather_ps(g, i, 4), _x), mul(_mm256_i32gather_ps(g + 1, i, 4), _y)),
+					   mul(_mm256_i32gather_ps(g + 2, i, 4), _z));
+		}
+		static inline vf value(const NoiseTables& _tables, vi _h) { return _mm256_i32gather_ps(_tables.values, _h, 4); }
+
+		//-------------------------------------------------------------------------------
+		template<NoiseType T, NoiseStep S>
+		static inline vf sample2(const NoiseTables& _tables, vi _mask, const vf* _p, float _f)
+		{
+			const uint32_t* p = _tables.permutation;
+			cell_t cx = cell(mul(_p[0], set1(_f)), _mask);
+			cell_t cy = cell(mul(_p[1], set1(_f)), _mask);
+			vf tx = step<S>(cx.t0);
+			vf ty = step<S>(cy.t0);
+
+			vf a, b, c, d;
+			if constexpr (T == NoiseType::Perlin)
+			{
+				vf x1 = sub(tx, set1(1.0f));
+				vf y1 = sub(ty, set1(1.0f));
+				vf a0 = grad2(_tables, hash2(p, cx.i0, cy.i0), tx, ty);
+				vf b0 = grad2(_tables, hash2(p, cx.i1, cy.i0), x1, ty);
+				vf c0 = grad2(_tables, hash2(p, cx.i0, cy.i1), tx, y1);
+				vf d0 = grad2(_tables, hash2(p, cx.i1, cy.i1), x1, y1);
+				a = a0;
+				b = sub(b0, a0);
+				c = sub(c0, a0);
+				d = sub(sub(add(a0, d0), b0), c0);
+				return add(add(add(a, mul(b, tx)), mul(c, ty)), mul(mul(d, tx), ty));
+			}
+			else
+			{
+				vf h00 = value(_tables, hash2(p, cx.i0, cy.i0));
+				vf h10 = value(_tables, hash2(p, cx.i1, cy.i0));
+				vf h01 = value(_tables, hash2(p, cx.i0, cy.i1));
+				vf h11 = value(_tables, hash2(p, cx.i1, cy.i1));
+				a = h00;
+				b = sub(h10, h00);
+				c = sub(h01, h00);
+				d = add(sub(sub(h11, h01), h10), h00);
+				return add(add(a, mul(b, tx)), mul(add(c, mul(d, tx)), ty));
+			}
+		}
+
+		//-------------------------------------------------------------------------------
+		template<NoiseType T, NoiseStep S>
+		static inline vf sample3(const NoiseTables& _tables, vi _mask, const vf* _p, float _f)
+		{
+			const uint32_t* p = _tables.permutation;
+			cell_t cx = cell(mul(_p[0], set1(_f)), _mask);
+			cell_t cy = cell(mul(_p[1], set1(_f)), _mask);
+			cell_t cz = cell(mul(_p[2], set1(_f)), _mask);
+			vf tx = step<S>(cx.t0);
+			vf ty = step<S>(cy.t0);
+			vf tz = step<S>(cz.t0);
+
+			vf a, b, c, d, e, f, g, h;
+			if constexpr (T == NoiseType::Perlin)
+			{
+				vf x1 = sub(tx, set1(1.0f));
+				vf y1 = sub(ty, set1(1.0f));
+				vf z1 = sub(tz, set1(1.0f));
+				vf a0 = grad3(_tables, hash3(p, cx.i0, cy.i0, cz.i0), tx, ty, tz);
+				vf b0 = grad3(_tables, hash3(p, cx.i1, cy.i0, cz.i0), x1, ty, tz);
+				vf c0 = grad3(_tables, hash3(p, cx.i0, cy.i1, cz.i0), tx, y1, tz);
+				vf d0 = grad3(_tables, hash3(p, cx.i1, cy.i1, cz.i0), x1, y1, tz);
+				vf e0 = grad3(_tables, hash3(p, cx.i0, cy.i0, cz.i1), tx, ty, z1);
+				vf f0 = grad3(_tables, hash3(p, cx.i1, cy.i0, cz.i1), x1, ty, z1);
+				vf g0 = grad3(_tables, hash3(p, cx.i0, cy.i1, cz.i1), tx, y1, z1);
+				vf h0 = grad3(_tables, hash3(p, cx.i1, cy.i1, cz.i1), x1, y1, z1);
+				a = a0;
+				b = sub(b0, a0);
+				c = sub(c0, a0);
+				d = sub(e0, a0);
+				e = sub(sub(add(a0, d0), b0), c0);
+				f = sub(sub(add(a0, f0), b0), e0);
+				g = sub(sub(add(a0, g0), c0), e0);
+				h = sub(sub(sub(sub(add(add(add(b0, c0), e0), h0), a0), d0), f0), g0);
+			}
+			else
+			{
+				vf h000 = value(_tables, hash3(p, cx.i0, cy.i0, cz.i0));
+				vf h100 = value(_tables, hash3(p, cx.i1, cy.i0, cz.i0));
+				vf h010 = value(_tables, hash3(p, cx.i0, cy.i1, cz.i0));
+				vf h110 = value(_tables, hash3(p, cx.i1, cy.i1, cz.i0));
+				vf h001 = value(_tables, hash3(p, cx.i0, cy.i0, cz.i1));
+				vf h101 = value(_tables, hash3(p, cx.i1, cy.i0, cz.i1));
+				vf h011 = value(_tables, hash3(p, cx.i0, cy.i1, cz.i1));
+				vf h111 = value(_tables, hash3(p, cx.i1, cy.i1, cz.i1));
+				a = h000;
+				b = sub(h100, h000);
+				c = sub(h010, h000);
+				d = sub(h001, h000);
+				e = add(sub(sub(h110, h010), h100), h000);
+				f = add(sub(sub(h101, h001), h100), h000);
+				g = add(sub(sub(h011, h001), h010), h000);
+				h = sub(add(add(sub(add(sub(sub(h111, h011), h101), h001), h110), h010), h100), h000);
+			}
+			return add(add(add(a, mul(b, tx)), mul(add(c, mul(e, tx)), ty)),
+					   mul(add(add(d, mul(f, tx)), mul(add(g, mul(h, tx)), ty)), tz));
+		}
+
+		template<int D, NoiseType T, NoiseStep S>
+		static inline vf sample(const NoiseTables& _tables, vi _mask, const vf* _p, float _f)
+		{
+			if constexpr (D == 2)	return sample2<T, S>(_tables, _mask, _p, _f);
+			else					return sample3<T, S>(_tables, _mask, _p, _f);
+		}
+
+		//-------------------------------------------------------------------------------
+		template<int D, NoiseType T, NoiseStep S, int O>
+		static uint32_t fbm_row(const NoiseTables& _tables,
+								const NoiseParameters& _param,
+								const float* _rot,
+								const float* _x, const float* _y, const float* _z,
+								float* _out,
+								uint32_t _n)
+		{
+			const vi mask = _mm256_set1_epi32((int)_tables.mask);
+			const float offset[3] = { _param.offset.x, _param.offset.y, _param.offset.z };
+			const int octaves = O ? O : _param.octaveCount;
+
+			uint32_t i = 0;
+			for (; i + 8 <= _n; i += 8)
+			{
+				const float* in[3] = { _x + i, _y + i, _z ? _z + i : nullptr };
+				vf p[D];
+				for (int k = 0; k < D; k++)
+					p[k] = add(_mm256_loadu_ps(in[k]), set1(offset[k]));
+
+				float f = _param.baseFreq;
+				float a = _param.baseAmp;
+				vf n = mul(set1(a), sample<D, T, S>(_tables, mask, p, f));
+				for (int o = 1; o < octaves; o++)
+				{
+					f *= _param.deltaFreq;
+					a *= _param.deltaAmp;
+					// p = rot * p, as NoiseKernel::rotate()
+					vf r[D];
+					for (int k = 0; k < D; k++)
+					{
+						vf s = mul(set1(_rot[k]), p[0]);
+						for (int c = 1; c < D; c++)
+							s = add(s, mul(set1(_rot[c * D + k]), p[c]));
+						r[k] = s;
+					}
+					for (int k = 0; k < D; k++)
+						p[k] = r[k];
+					n = add(n, mul(set1(a), sample<D, T, S>(_tables, mask, p, f)));
+				}
+				_mm256_storeu_ps(_out + i, n);
+			}
+			return i;
+		}
+	}
+	#if defined(__clang__)
+		#pragma clang attribute pop
+	#else
+		#pragma GCC pop_options
+	#endif
+
+	//-----------------------------------------------------------------------------------
+	template<int D, NoiseType T, NoiseStep S, int O>
+	static void fbm_row_avx2(const NoiseTables& _tables,
+							 const NoiseParameters& _param,
+							 const float* _rot,
+							 const float* _x, const float* _y, const float* _z,
+							 float* _out, float*,
+							 uint32_t _n)
+	{
+		uint32_t i = noise_avx2::fbm_row<D, T, S, O>(_tables, _param, _rot, _x, _y, _z, _out, _n);
+		if (i < _n)
+			fbm_row<D, T, S, O, false>(_tables, _param, _rot, _x + i, _y + i, _z ? _z + i : nullptr, _out + i, nullptr, _n - i);
+	}
+#endif
+
+	//-----------------------------------------------------------------------------------
+	// [dimension][noise type][interpolant][octaves][derivatives]
+	static const uint32_t OCTAVE_SLOTS = NoiseKernels::MAX_OCTAVES + 1;
+	static const uint32_t KERNEL_COUNT = 2 * 2 * 2 * OCTAVE_SLOTS * 2;
+
+	static uint32_t kernel_index(uint32_t _dim, uint32_t _type, uint32_t _step, uint32_t _octaves, bool _derivatives)
+	{
+		return (((((_dim - 2) * 2 + _type) * 2 + _step) * OCTAVE_SLOTS) + _octaves) * 2 + (_derivatives ? 1 : 0);
+	}
+
+	//-----------------------------------------------------------------------------------
+	template<int D, NoiseType T, NoiseStep S, int... O>
+	static void fill_kernels(NoiseRowFnc* _table, std::integer_sequence<int, O...>)
+	{
+		uint32_t type = T == NoiseType::Perlin ? 1 : 0;
+		(( _table[kernel_index(D, type, (uint32_t)S, O, false)] = fbm_row<D, T, S, O, false>,
+		   _table[kernel_index(D, type, (uint32_t)S, O, true)]  = fbm_row<D, T, S, O, true> ), ...);
+	}
+
+#ifdef SYN_SIMD_X86
+	// the AVX2 kernels in the slots without derivatives
+	template<int D, NoiseType T, NoiseStep S, int... O>
+	static void fill_kernels_avx2(NoiseRowFnc* _table, std::integer_sequence<int, O...>)
+	{
+		uint32_t type = T == NoiseType::Perlin ? 1 : 0;
+		((_table[kernel_index(D, type, (uint32_t)S, O, false)] = fbm_row_avx2<D, T, S, O>), ...);
+	}
+#endif
+
+	//-----------------------------------------------------------------------------------
+	template<int D>
+	static void fill_kernels(NoiseRowFnc* _table)
+	{
+		using octaves_t = std::make_integer_sequence<int, OCTAVE_SLOTS>;
+		fill_kernels<D, NoiseType::Value,  NoiseStep::Smooth>(_table, octaves_t());
+		fill_kernels<D, NoiseType::Value,  NoiseStep::Perlin>(_table, octaves_t());
+		fill_kernels<D, NoiseType::Perlin, NoiseStep::Smooth>(_table, octaves_t());
+		fill_kernels<D, NoiseType::Perlin, NoiseStep::Perlin>(_table, octaves_t());
+	}
+#ifdef SYN_SIMD_X86
+	template<int D>
+	static void fill_kernels_avx2(NoiseRowFnc* _table)
+	{
+		using octaves_t = std::make_integer_sequence<int, OCTAVE_SLOTS>;
+		fill_kernels_avx2<D, NoiseType::Value,  NoiseStep::Smooth>(_table, octaves_t());
+		fill_kernels_avx2<D, NoiseType::Value,  NoiseStep::Perlin>(_table, octaves_t());
+		fill_kernels_avx2<D, NoiseType::Perlin, NoiseStep::Smooth>(_table, octaves_t());
+		fill_kernels_avx2<D, NoiseType::Perlin, NoiseStep::Perlin>(_table, octaves_t());
+	}
+#endif
+
+	//-----------------------------------------------------------------------------------
+	// the scalar kernels, and the SIMD ones where the CPU has them
+	static const std::array<NoiseRowFnc, KERNEL_COUNT>& get_kernels(bool _simd)
+	{
+		static const std::array<NoiseRowFnc, KERNEL_COUNT> s_scalar = []()
+		{
+			std::array<NoiseRowFnc, KERNEL_COUNT> kernels = {};
+			fill_kernels<2>(kernels.data());
+			fill_kernels<3>(kernels.data());
+			return kernels;
+		}();
+		static const std::array<NoiseRowFnc, KERNEL_COUNT> s_simd = []()
+		{
+			std::array<NoiseRowFnc, KERNEL_COUNT> kernels = s_scalar;
+			#if defined(SYN_SIMD_X86)
+				if (cpu_features().avx2)
+				{
+					fill_kernels_avx2<2>(kernels.data());
+					fill_kernels_avx2<3>(kernels.data());
+				}
+			#endif
+			return kernels;
+		}();
+		return _simd ? s_simd : s_scalar;
+	}
+
+	//-----------------------------------------------------------------------------------
+	NoiseRowFnc NoiseKernels::get(uint32_t _dim, NoiseType _type, NoiseStep _step, uint32_t _octaves, bool _derivatives, bool _simd)
+	{
+		const std::array<NoiseRowFnc, KERNEL_COUNT>& kernels = get_kernels(_simd);
+
+		if ((_dim != 2 && _dim != 3) || (_type != NoiseType::Value && _type != NoiseType::Perlin))
+			return nullptr;
+
+		// octave counts without an unrolled kernel use the generic one (slot 0)
+		if (_octaves > MAX_OCTAVES)
+			_octaves = 0;
+
+		return kernels[kernel_index(_dim, _type == NoiseType::Perlin ? 1 : 0, (uint32_t)_step, _octaves, _derivatives)];
+	}
+
+	//-----------------------------------------------------------------------------------
+	const char* NoiseKernels::simdPath()
+	{
+		#if defined(SYN_SIMD_X86)
+			if (cpu_features().avx2)
+				return "AVX2";
+		#endif
+		return "scalar";
+	}
+
+
+}
+
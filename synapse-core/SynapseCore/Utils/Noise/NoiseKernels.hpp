@@ -0,0 +1,464 @@
+
+#pragma once
+
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "../../Core.hpp"
+#include "../../Types.hpp"
+
+
+namespace Syn {
+
+
+	/* Interpolant of the lattice noises: Noise::smoothStep() (cubic, the default of value
+	 * noise) or Noise::perlinStep() (quintic, the default of Perlin noise). */
+	enum class NoiseStep
+	{
+		Smooth = 0,
+		Perlin,
+	};
+
+
+	/* Lookup tables of a NoiseGenerator, see NoiseGenerator::getTables(). */
+	struct NoiseTables
+	{
+		const glm::vec3* gradients = nullptr;
+		const float* values = nullptr;
+		const uint32_t* permutation = nullptr;		// 512 entries
+		uint32_t mask = 255;
+	};
+
+
+	/* fBm over _n points (_x[i], _y[i] [, _z[i]]): offset, base frequency and amplitude and
+	 * their per octave deltas from _param, the coordinates rotated by _rot (D x D, column-
+	 * major) between octaves -- as Noise::fbm_perlin2/3(). With derivatives, _dout receives
+	 * D partial derivatives per point (interleaved), with respect to the input coordinates.
+	 * _z and _dout may be nullptr when not used.
+	 */
+	typedef void(*NoiseRowFnc)(const NoiseTables& _tables,
+							   const NoiseParameters& _param,
+							   const float* _rot,
+							   const float* _x, const float* _y, const float* _z,
+							   float* _out, float* _dout,
+							   uint32_t _n);
+
+
+	/* Compile-time specialized fBm kernels (CRTP). The lattice noise (Derived::sample()),
+	 * dimension D, interpolant S, octave count O (0 : read from the parameters) and whether
+	 * derivatives are computed are all template parameters, so the octave loop unrolls and
+	 * the derivative math is dropped when unused. No virtual calls are involved.
+	 */
+	template<typename Derived, int D, NoiseStep S>
+	class NoiseKernel
+	{
+	public:
+		NoiseKernel(const NoiseTables& _tables) : m_tables(_tables) {}
+
+		template<int O, bool Deriv>
+		inline float fbm(const float* _p, float* _dp, const NoiseParameters& _param, const float* _rot) const
+		{
+			const float offset[3] = { _param.offset.x, _param.offset.y, _param.offset.z };
+			float p[D];
+			for (int k = 0; k < D; k++)
+				p[k] = _p[k] + offset[k];
+
+			float  f = _param.baseFreq;
+			float  a = _param.baseAmp;
+			float dn[D];
+			float  m[D * D];	// accumulated rotation, for the chain rule of the derivatives
+
+			// first octave
+			float n = a * derived().template sample<Deriv>(p, dn, f);
+			if constexpr (Deriv)
+			{
+				for (int k = 0; k < D * D; k++)
+					m[k] = (k % (D + 1) == 0) ? 1.0f : 0.0f;
+				for (int k = 0; k < D; k++)
+					_dp[k] = a * dn[k];
+			}
+
+			// rest of octaves
+			const int octaves = O ? O : _param.octaveCount;
+			for (int i = 1; i < octaves; i++)
+			{
+				f *= _param.deltaFreq;
+				a *= _param.deltaAmp;
+				rotate(_rot, p);
+				n += a * derived().template sample<Deriv>(p, dn, f);
+				if constexpr (Deriv)
+				{
+					// m = rot * m; d/dp sample(m * p) = m^T * dn
+					float r[D * D];
+					for (int c = 0; c < D; c++)
+						for (int k = 0; k < D; k++)
+						{
+							float s = 0.0f;
+							for (int j = 0; j < D; j++)
+								s += _rot[j * D + k] * m[c * D + j];
+							r[c * D + k] = s;
+						}
+					for (int k = 0; k < D * D; k++)
+						m[k] = r[k];
+					for (int c = 0; c < D; c++)
+					{
+						float s = 0.0f;
+						for (int k = 0; k < D; k++)
+							s += m[c * D + k] * dn[k];
+						_dp[c] += a * s;
+					}
+				}
+			}
+			return n;
+		}
+
+	protected:
+		inline const Derived& derived() const { return static_cast<const Derived&>(*this); }
+
+		// p = rot * p, in the order of glm's matrix-vector product
+		inline static void rotate(const float* _rot, float* _p)
+		{
+			float r[D];
+			for (int k = 0; k < D; k++)
+			{
+				float s = _rot[k] * _p[0];
+				for (int c = 1; c < D; c++)
+					s += _rot[c * D + k] * _p[c];
+				r[k] = s;
+			}
+			for (int k = 0; k < D; k++)
+				_p[k] = r[k];
+		}
+
+		inline static float step(float t)
+		{
+			if constexpr (S == NoiseStep::Perlin)	return t * t * t * (t * (t * 6 - 15) + 10);
+			else									return t * t * (3 - 2 * t);
+		}
+		inline static float step_d(float t)
+		{
+			if constexpr (S == NoiseStep::Perlin)	return 30 * t * t * (t * (t - 2) + 1);
+			else									return 6 * t * (1 - t);
+		}
+
+		inline uint32_t hash2(int _x, int _y) const
+		{ return m_tables.permutation[m_tables.permutation[_x] + _y]; }
+		inline uint32_t hash3(int _x, int _y, int _z) const
+		{ return m_tables.permutation[m_tables.permutation[m_tables.permutation[_x] + _y] + _z]; }
+
+	protected:
+		NoiseTables m_tables;
+	};
+
+
+	/* Gradient (Perlin) noise, as NoisePerlin2/3::eval(). The gradients are dotted with the
+	 * interpolated offsets, so the partial derivatives include the interpolant's derivative
+	 * in every term (unlike NoisePerlin2/3::eval_d()). */
+	template<int D, NoiseStep S>
+	class NoiseKernelPerlin : public NoiseKernel<NoiseKernelPerlin<D, S>, D, S>
+	{
+	public:
+		using NoiseKernel<NoiseKernelPerlin<D, S>, D, S>::NoiseKernel;
+
+		template<bool Deriv>
+		inline float sample(const float* _p, float* _dn, float _f) const
+		{
+			if constexpr (D == 2)	return sample2<Deriv>(_p, _dn, _f);
+			else					return sample3<Deriv>(_p, _dn, _f);
+		}
+
+	private:
+		using base_t = NoiseKernel<NoiseKernelPerlin<D, S>, D, S>;
+		using base_t::m_tables;
+		using base_t::step;
+		using base_t::step_d;
+		using base_t::hash2;
+		using base_t::hash3;
+
+		template<bool Deriv>
+		inline float sample2(const float* _p, float* _dn, float _f) const
+		{
+			float px = _p[0] * _f;
+			float py = _p[1] * _f;
+
+			int xf = (int)std::floor(px);
+			int yf = (int)std::floor(py);
+
+			int xi0 = xf & m_tables.mask;
+			int yi0 = yf & m_tables.mask;
+			int xi1 = (xi0 + 1) & m_tables.mask;
+			int yi1 = (yi0 + 1) & m_tables.mask;
+
+			float tx0 = px - xf;
+			float ty0 = py - yf;
+
+			float tx = step(tx0);
+			float ty = step(ty0);
+
+			float x0 = tx, x1 = tx - 1;
+			float y0 = ty, y1 = ty - 1;
+
+			const glm::vec3& g00 = m_tables.gradients[hash2(xi0, yi0)];
+			const glm::vec3& g10 = m_tables.gradients[hash2(xi1, yi0)];
+			const glm::vec3& g01 = m_tables.gradients[hash2(xi0, yi1)];
+			const glm::vec3& g11 = m_tables.gradients[hash2(xi1, yi1)];
+
+			float a0 = g00.x * x0 + g00.y * y0;
+			float b0 = g10.x * x1 + g10.y * y0;
+			float c0 = g01.x * x0 + g01.y * y1;
+			float d0 = g11.x * x1 + g11.y * y1;
+
+			float a = a0;
+			float b = (b0 - a0);
+			float c = (c0 - a0);
+			float d = a0 + d0 - b0 - c0;
+
+			if constexpr (Deriv)
+			{
+				float dtx = step_d(tx0);
+				float dty = step_d(ty0);
+				for (int k = 0; k < 2; k++)
+				{
+					float da = g00[k];
+					float db = g10[k] - g00[k];
+					float dc = g01[k] - g00[k];
+					float dd = g00[k] + g11[k] - g01[k] - g10[k];
+					_dn[k] = da + db * tx + (dc + dd * tx) * ty;
+				}
+				_dn[0] = (_dn[0] + b + d * ty) * dtx * _f;
+				_dn[1] = (_dn[1] + c + d * tx) * dty * _f;
+			}
+
+			return a + b * tx + c * ty + d * tx * ty;
+		}
+
+		template<bool Deriv>
+		inline float sample3(const float* _p, float* _dn, float _f) const
+		{
+			float px = _p[0] * _f;
+			float py = _p[1] * _f;
+			float pz = _p[2] * _f;
+
+			int xf = (int)std::floor(px);
+			int yf = (int)std::floor(py);
+			int zf = (int)std::floor(pz);
+
+			int xi0 = xf & m_tables.mask;
+			int yi0 = yf & m_tables.mask;
+			int zi0 = zf & m_tables.mask;
+			int xi1 = (xi0 + 1) & m_tables.mask;
+			int yi1 = (yi0 + 1) & m_tables.mask;
+			int zi1 = (zi0 + 1) & m_tables.mask;
+
+			float tx0 = px - xf;
+			float ty0 = py - yf;
+			float tz0 = pz - zf;
+
+			float tx = step(tx0);
+			float ty = step(ty0);
+			float tz = step(tz0);
+
+			float x0 = tx, x1 = tx - 1;
+			float y0 = ty, y1 = ty - 1;
+			float z0 = tz, z1 = tz - 1;
+
+			const glm::vec3& g000 = m_tables.gradients[hash3(xi0, yi0, zi0)];
+			const glm::vec3& g100 = m_tables.gradients[hash3(xi1, yi0, zi0)];
+			const glm::vec3& g010 = m_tables.gradients[hash3(xi0, yi1, zi0)];
+			const glm::vec3& g110 = m_tables.gradients[hash3(xi1, yi1, zi0)];
+			const glm::vec3& g001 = m_tables.gradients[hash3(xi0, yi0, zi1)];
+			const glm::vec3& g101 = m_tables.gradients[hash3(xi1, yi0, zi1)];
+			const glm::vec3& g011 = m_tables.gradients[hash3(xi0, yi1, zi1)];
+			const glm::vec3& g111 = m_tables.gradients[hash3(xi1, yi1, zi1)];
+
+			float a0 = g000.x * x0 + g000.y * y0 + g000.z * z0;
+			float b0 = g100.x * x1 + g100.y * y0 + g100.z * z0;
+			float c0 = g010.x * x0 + g010.y * y1 + g010.z * z0;
+			float d0 = g110.x * x1 + g110.y * y1 + g110.z * z0;
+			float e0 = g001.x * x0 + g001.y * y0 + g001.z * z1;
+			float f0 = g101.x * x1 + g101.y * y0 + g101.z * z1;
+			float g0 = g011.x * x0 + g011.y * y1 + g011.z * z1;
+			float h0 = g111.x * x1 + g111.y * y1 + g111.z * z1;
+
+			float a = a0;
+			float b = (b0 - a0);
+			float c = (c0 - a0);
+			float d = (e0 - a0);
+			float e = (a0 + d0 - b0 - c0);
+			float f = (a0 + f0 - b0 - e0);
+			float g = (a0 + g0 - c0 - e0);
+			float h = (b0 + c0 + e0 + h0 - a0 - d0 - f0 - g0);
+
+			if constexpr (Deriv)
+			{
+				float dtx = step_d(tx0);
+				float dty = step_d(ty0);
+				float dtz = step_d(tz0);
+				for (int k = 0; k < 3; k++)
+				{
+					float da = g000[k];
+					float db = g100[k] - g000[k];
+					float dc = g010[k] - g000[k];
+					float dd = g001[k] - g000[k];
+					float de = g110[k] - g010[k] - g100[k] + g000[k];
+					float df = g101[k] - g001[k] - g100[k] + g000[k];
+					float dg = g011[k] - g001[k] - g010[k] + g000[k];
+					float dh = g111[k] - g011[k] - g101[k] + g001[k] - g110[k] + g010[k] + g100[k] - g000[k];
+					_dn[k] = da + db * tx + (dc + de * tx) * ty + (dd + df * tx + (dg + dh * tx) * ty) * tz;
+				}
+				_dn[0] = (_dn[0] + b + e * ty + (f + h * ty) * tz) * dtx * _f;
+				_dn[1] = (_dn[1] + c + e * tx + (g + h * tx) * tz) * dty * _f;
+				_dn[2] = (_dn[2] + d + f * tx + (g + h * tx) * ty) * dtz * _f;
+			}
+
+			return a + b * tx + (c + e * tx) * ty + (d + f * tx + (g + h * tx) * ty) * tz;
+		}
+	};
+
+
+	/* Value noise, as NoiseValue2/3::eval() and eval_d(). */
+	template<int D, NoiseStep S>
+	class NoiseKernelValue : public NoiseKernel<NoiseKernelValue<D, S>, D, S>
+	{
+	public:
+		using NoiseKernel<NoiseKernelValue<D, S>, D, S>::NoiseKernel;
+
+		template<bool Deriv>
+		inline float sample(const float* _p, float* _dn, float _f) const
+		{
+			if constexpr (D == 2)	return sample2<Deriv>(_p, _dn, _f);
+			else					return sample3<Deriv>(_p, _dn, _f);
+		}
+
+	private:
+		using base_t = NoiseKernel<NoiseKernelValue<D, S>, D, S>;
+		using base_t::m_tables;
+		using base_t::step;
+		using base_t::step_d;
+		using base_t::hash2;
+		using base_t::hash3;
+
+		inline static int floori(float _x) { return (int)_x - (_x < 0 && _x != (int)_x); }
+
+		template<bool Deriv>
+		inline float sample2(const float* _p, float* _dn, float _f) const
+		{
+			float px = _p[0] * _f;
+			float py = _p[1] * _f;
+
+			int xi = floori(px);
+			int yi = floori(py);
+
+			float tx0 = px - xi;
+			float ty0 = py - yi;
+
+			int x0 = xi & m_tables.mask;
+			int y0 = yi & m_tables.mask;
+			int x1 = (x0 + 1) & m_tables.mask;
+			int y1 = (y0 + 1) & m_tables.mask;
+
+			float tx = step(tx0);
+			float ty = step(ty0);
+
+			float h00 = m_tables.values[hash2(x0, y0)];
+			float h10 = m_tables.values[hash2(x1, y0)];
+			float h01 = m_tables.values[hash2(x0, y1)];
+			float h11 = m_tables.values[hash2(x1, y1)];
+
+			float a = h00;
+			float b = h10 - h00;
+			float c = h01 - h00;
+			float d = h11 - h01 - h10 + h00;
+
+			if constexpr (Deriv)
+			{
+				_dn[0] = (b + d * ty) * step_d(tx0) * _f;
+				_dn[1] = (c + d * tx) * step_d(ty0) * _f;
+			}
+
+			return a + b * tx + (c + d * tx) * ty;
+		}
+
+		template<bool Deriv>
+		inline float sample3(const float* _p, float* _dn, float _f) const
+		{
+			float px = _p[0] * _f;
+			float py = _p[1] * _f;
+			float pz = _p[2] * _f;
+
+			int xi = floori(px);
+			int yi = floori(py);
+			int zi = floori(pz);
+
+			float tx0 = px - xi;
+			float ty0 = py - yi;
+			float tz0 = pz - zi;
+
+			int x0 = xi & m_tables.mask;
+			int y0 = yi & m_tables.mask;
+			int z0 = zi & m_tables.mask;
+			int x1 = (x0 + 1) & m_tables.mask;
+			int y1 = (y0 + 1) & m_tables.mask;
+			int z1 = (z0 + 1) & m_tables.mask;
+
+			float tx = step(tx0);
+			float ty = step(ty0);
+			float tz = step(tz0);
+
+			float h000 = m_tables.values[hash3(x0, y0, z0)];
+			float h100 = m_tables.values[hash3(x1, y0, z0)];
+			float h010 = m_tables.values[hash3(x0, y1, z0)];
+			float h110 = m_tables.values[hash3(x1, y1, z0)];
+			float h001 = m_tables.values[hash3(x0, y0, z1)];
+			float h101 = m_tables.values[hash3(x1, y0, z1)];
+			float h011 = m_tables.values[hash3(x0, y1, z1)];
+			float h111 = m_tables.values[hash3(x1, y1, z1)];
+
+			float a = h000;
+			float b = h100 - h000;
+			float c = h010 - h000;
+			float d = h001 - h000;
+			float e = h110 - h010 - h100 + h000;
+			float f = h101 - h001 - h100 + h000;
+			float g = h011 - h001 - h010 + h000;
+			float h = h111 - h011 - h101 + h001 - h110 + h010 + h100 - h000;
+
+			if constexpr (Deriv)
+			{
+				_dn[0] = (b + e * ty + (f + h * ty) * tz) * step_d(tx0) * _f;
+				_dn[1] = (c + e * tx + (g + h * tx) * tz) * step_d(ty0) * _f;
+				_dn[2] = (d + f * tx + (g + h * tx) * ty) * step_d(tz0) * _f;
+			}
+
+			return a + b * tx + (c + e * tx) * ty + (d + f * tx + (g + h * tx) * ty) * tz;
+		}
+	};
+
+
+	/* Runtime selection of the kernels: one NoiseRowFnc per combination of dimension (2, 3),
+	 * noise (NoiseType::Value, NoiseType::Perlin), interpolant, octave count and derivatives,
+	 * looked up once per evaluation (not per sample). Without derivatives, and with _simd,
+	 * rows of 8 or more points use AVX2 where the CPU has it; bit-exact with the scalar
+	 * kernels.
+	 */
+	class NoiseKernels
+	{
+	public:
+		/* Octave counts with an unrolled kernel; higher counts use a kernel reading the count
+		 * from the parameters. */
+		static const uint32_t MAX_OCTAVES = 8;
+
+		/* nullptr for unsupported dimensions and noise types. */
+		static NoiseRowFnc get(uint32_t _dim, NoiseType _type, NoiseStep _step, uint32_t _octaves, bool _derivatives, bool _simd=true);
+		/* With the default interpolant of the noise type. */
+		static NoiseRowFnc get(uint32_t _dim, NoiseType _type, uint32_t _octaves, bool _derivatives=false, bool _simd=true)
+		{ return get(_dim, _type, _type == NoiseType::Perlin ? NoiseStep::Perlin : NoiseStep::Smooth, _octaves, _derivatives, _simd); }
+		/* Instruction set of the kernels selected with _simd ("AVX2" or "scalar"). */
+		static const char* simdPath();
+	};
+
+
+}
+
@@ -0,0 +1,374 @@
+
+#include "../../../pch.hpp"
+
+#include "NoiseTileCache.hpp"
+#include "Noise.hpp"
+#include "../Thread/ThreadPool.hpp"
+
+
+namespace Syn {
+
+
+	//---------------------------------------------------------------------------------------
+	static inline uint64_t hash_mix(uint64_t _h, uint64_t _v)
+	{
+		_v *= 0xff51afd7ed558ccdULL;
+		_v ^= _v >> 33;
+		return (_h ^ _v) * 0x100000001b3ULL + 0x9e3779b97f4a7c15ULL;
+	}
+	//---------------------------------------------------------------------------------------
+	static inline uint64_t hash_mix(uint64_t _h, float _f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &_f, sizeof(float));
+		return hash_mix(_h, (uint64_t)bits);
+	}
+	//---------------------------------------------------------------------------------------
+	size_t NoiseTileKeyHash::operator()(const NoiseTileKey& _k) const
+	{
+		uint64_t h = hash_mix(0, ((uint64_t)_k.generator << 32) | _k.seed);
+		h = hash_mix(h, _k.paramsHash);
+		h = hash_mix(h, (uint64_t)(uint32_t)_k.lod);
+		h = hash_mix(h, ((uint64_t)(uint32_t)_k.tile.x << 32) | (uint32_t)_k.tile.y);
+		return (size_t)(h ^ (h >> 32));
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileCache::NoiseTileCache(uint32_t _tile_side, size_t _byte_budget) :
+		m_tileSide(std::max(_tile_side, 2u)), m_byteBudget(_byte_budget)
+	{
+		m_stats.byteBudget = m_byteBudget;
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileCache::~NoiseTileCache()
+	{
+		std::vector<Ref<pending_tile_t>> pending;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& it : m_pending)
+				pending.push_back(it.second);
+		}
+
+		// tasks not yet started are cancelled (they never touch the cache unless they claim
+		// the tile), running ones are waited for
+		for (auto& p : pending)
+		{
+			if (!p->claimed.exchange(true))
+				p->promise.set_value(nullptr);
+			else
+				p->future.wait();
+		}
+	}
+	//---------------------------------------------------------------------------------------
+	Ref<const NoiseTile> NoiseTileCache::find(const NoiseTileKey& _key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_tiles.find(_key);
+		if (it == m_tiles.end())
+			return nullptr;
+
+		m_stats.hits++;
+		m_lruList.splice(m_lruList.begin(), m_lruList, it->second);
+		return *it->second;
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileCache::TileFuture NoiseTileCache::request(const NoiseTileKey& _key, const TileFunc& _fnc)
+	{
+		Ref<pending_tile_t> pending = nullptr;
+		bool created = false;
+		Ref<const NoiseTile> tile;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			tile = lookup(_key, _fnc, pending, created);
+		}
+
+		if (tile != nullptr)
+		{
+			std::promise<Ref<const NoiseTile>> ready;
+			ready.set_value(tile);
+			return ready.get_future().share();
+		}
+
+		if (created)
+			dispatch(pending);
+		return pending->future;
+	}
+	//---------------------------------------------------------------------------------------
+	Ref<const NoiseTile> NoiseTileCache::get(const NoiseTileKey& _key, const TileFunc& _fnc)
+	{
+		Ref<pending_tile_t> pending = nullptr;
+		bool created = false;
+		Ref<const NoiseTile> tile;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			tile = lookup(_key, _fnc, pending, created);
+		}
+
+		if (tile != nullptr)
+			return tile;
+
+		// also covers created tiles : no point in queueing a tile only to wait for it
+		return wait(pending);
+	}
+	//---------------------------------------------------------------------------------------
+	bool NoiseTileCache::readWindow(const NoiseTileKey& _key, const glm::ivec2& _origin, const glm::ivec2& _size, float* _out, const TileFunc& _fnc, bool _wait)
+	{
+		if (_size.x <= 0 || _size.y <= 0)
+			return true;
+
+		glm::ivec2 t0 = tileOf(_origin);
+		glm::ivec2 t1 = tileOf(_origin + _size - glm::ivec2(1));
+
+		struct window_tile_t
+		{
+			glm::ivec2 tile;
+			Ref<const NoiseTile> data;
+			Ref<pending_tile_t> pending;
+		};
+		std::vector<window_tile_t> tiles;
+		std::vector<Ref<pending_tile_t>> created;
+
+		// look up all tiles first, so that missing ones are computed in parallel
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (int ty = t0.y; ty <= t1.y; ty++)
+			{
+				for (int tx = t0.x; tx <= t1.x; tx++)
+				{
+					window_tile_t t;
+					t.tile = glm::ivec2(tx, ty);
+					NoiseTileKey key = _key;
+					key.tile = t.tile;
+					bool is_new = false;
+					t.data = lookup(key, _fnc, t.pending, is_new);
+					if (is_new)
+						created.push_back(t.pending);
+					tiles.push_back(t);
+				}
+			}
+		}
+		for (auto& p : created)
+			dispatch(p);
+
+		bool complete = true;
+		int side = (int)m_tileSide;
+		for (auto& t : tiles)
+		{
+			if (t.data == nullptr)
+			{
+				if (_wait)
+					t.data = wait(t.pending);
+				else if (t.pending->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+					t.data = t.pending->future.get();
+			}
+			// not ready, or cancelled by destruction
+			if (t.data == nullptr)
+			{
+				complete = false;
+				continue;
+			}
+
+			// intersection of tile and window, in samples
+			glm::ivec2 lo = glm::max(t.tile * side, _origin);
+			glm::ivec2 hi = glm::min(t.tile * side + glm::ivec2(side), _origin + _size);
+			for (int y = lo.y; y < hi.y; y++)
+			{
+				const float* src = t.data->data.data() + (size_t)(y - t.tile.y * side) * side + (lo.x - t.tile.x * side);
+				float* dst = _out + (size_t)(y - _origin.y) * _size.x + (lo.x - _origin.x);
+				memcpy(dst, src, sizeof(float) * (hi.x - lo.x));
+			}
+		}
+
+		return complete;
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::clear()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_lruList.clear();
+		m_tiles.clear();
+		m_residentBytes = 0;
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::resetStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats = NoiseTileCacheStats();
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::setByteBudget(size_t _bytes)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_byteBudget = _bytes;
+		evict();
+	}
+	//---------------------------------------------------------------------------------------
+	size_t NoiseTileCache::getByteBudget() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_byteBudget;
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileCacheStats NoiseTileCache::getStats() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		NoiseTileCacheStats stats = m_stats;
+		stats.residentBytes = m_residentBytes;
+		stats.byteBudget = m_byteBudget;
+		stats.tileCount = (uint32_t)m_tiles.size();
+		stats.pendingCount = (uint32_t)m_pending.size();
+		return stats;
+	}
+	//---------------------------------------------------------------------------------------
+	glm::ivec2 NoiseTileCache::tileOf(const glm::ivec2& _sample) const
+	{
+		// floor division, also for negative samples
+		int side = (int)m_tileSide;
+		return glm::ivec2(_sample.x >= 0 ? _sample.x / side : (_sample.x + 1) / side - 1,
+						  _sample.y >= 0 ? _sample.y / side : (_sample.y + 1) / side - 1);
+	}
+	//---------------------------------------------------------------------------------------
+	uint64_t NoiseTileCache::hashParameters(const NoiseParameters& _param, bool _rotate)
+	{
+		uint64_t h = hash_mix(0, (uint64_t)_param.octaveCount);
+		h = hash_mix(h, _param.baseFreq);
+		h = hash_mix(h, _param.deltaFreq);
+		h = hash_mix(h, _param.baseAmp);
+		h = hash_mix(h, _param.deltaAmp);
+		h = hash_mix(h, _param.offset.x);
+		h = hash_mix(h, _param.offset.y);
+		h = hash_mix(h, _param.offset.z);
+		return hash_mix(h, (uint64_t)_rotate);
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileKey NoiseTileCache::noiseKey(NoiseType _type, bool _rotate, float _spacing)
+	{
+		NoiseTileKey key;
+		key.generator = (uint32_t)_type;
+		// the Noise generators are seeded once, with fixed seeds
+		key.seed = 0;
+		key.paramsHash = hash_mix(hashParameters(Noise::get_noise_parameters(), _rotate), _spacing);
+		return key;
+	}
+	//---------------------------------------------------------------------------------------
+	NoiseTileCache::TileFunc NoiseTileCache::noiseTileFunc(NoiseType _type, bool _rotate, float _spacing)
+	{
+		NoiseParameters param = Noise::get_noise_parameters();
+		return [param, _type, _rotate, _spacing](const NoiseTileKey& _key, uint32_t _side, float* _out)
+		{
+			float step = ldexpf(_spacing, _key.lod);
+			float x0 = (float)_key.tile.x * (float)_side * step;
+			float y0 = (float)_key.tile.y * (float)_side * step;
+			Linspace<float> x(x0, x0 + (float)(_side - 1) * step, _side);
+			Linspace<float> y(y0, y0 + (float)(_side - 1) * step, _side);
+			Noise::evalGrid(param, x, y, _out, _type, _rotate);
+		};
+	}
+	//---------------------------------------------------------------------------------------
+	Ref<const NoiseTile> NoiseTileCache::lookup(const NoiseTileKey& _key, const TileFunc& _fnc, Ref<pending_tile_t>& _pending, bool& _created)
+	{
+		_created = false;
+
+		auto it = m_tiles.find(_key);
+		if (it != m_tiles.end())
+		{
+			m_stats.hits++;
+			m_lruList.splice(m_lruList.begin(), m_lruList, it->second);
+			return *it->second;
+		}
+
+		auto pit = m_pending.find(_key);
+		if (pit != m_pending.end())
+		{
+			m_stats.pendingHits++;
+			_pending = pit->second;
+			return nullptr;
+		}
+
+		m_stats.misses++;
+		_pending = std::make_shared<pending_tile_t>();
+		_pending->key = _key;
+		_pending->fnc = _fnc;
+		_pending->future = _pending->promise.get_future().share();
+		m_pending[_key] = _pending;
+		_created = true;
+		return nullptr;
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::dispatch(const Ref<pending_tile_t>& _pending)
+	{
+		ThreadPool& pool = ThreadPool::get();
+		if (!pool.isRunning() || ThreadPool::isWorkerThread())
+		{
+			if (!_pending->claimed.exchange(true))
+				compute(_pending);
+			return;
+		}
+
+		// the task only touches the cache if it claims the tile, see ~NoiseTileCache()
+		Ref<pending_tile_t> pending = _pending;
+		pool.submit([this, pending]()
+		{
+			if (!pending->claimed.exchange(true))
+				compute(pending);
+		});
+	}
+	//---------------------------------------------------------------------------------------
+	Ref<const NoiseTile> NoiseTileCache::wait(const Ref<pending_tile_t>& _pending)
+	{
+		// computing a tile still in the queue here, rather than waiting for a worker to get
+		// to it, also keeps this from blocking all workers when called from worker tasks
+		if (!_pending->claimed.exchange(true))
+			compute(_pending);
+		return _pending->future.get();
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::compute(const Ref<pending_tile_t>& _pending)
+	{
+		Ref<NoiseTile> tile = std::make_shared<NoiseTile>();
+		tile->key = _pending->key;
+		tile->side = m_tileSide;
+		tile->data.resize((size_t)m_tileSide * m_tileSide);
+
+		try
+		{
+			_pending->fnc(tile->key, tile->side, tile->data.data());
+		}
+		catch (...)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_pending.erase(_pending->key);
+			}
+			_pending->promise.set_exception(std::current_exception());
+			return;
+		}
+		_pending->fnc = nullptr;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending.erase(_pending->key);
+			m_lruList.push_front(tile);
+			m_tiles[tile->key] = m_lruList.begin();
+			m_residentBytes += tile->bytes();
+			evict();
+		}
+
+		// waiters still get the tile if it was evicted right away (larger than the budget)
+		_pending->promise.set_value(tile);
+	}
+	//---------------------------------------------------------------------------------------
+	void NoiseTileCache::evict()
+	{
+		while (m_residentBytes > m_byteBudget && !m_lruList.empty())
+		{
+			Ref<const NoiseTile> lru = m_lruList.back();
+			m_tiles.erase(lru->key);
+			m_lruList.pop_back();
+			m_residentBytes -= lru->bytes();
+			m_stats.evictions++;
+		}
+	}
+
+
+}
+
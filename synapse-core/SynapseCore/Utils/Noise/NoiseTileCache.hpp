@@ -0,0 +1,183 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+
+#include "../../Core.hpp"
+#include "../../Types.hpp"
+#include "../../Memory/MemoryTypes.hpp"
+
+
+namespace Syn {
+
+
+	/* Identifies a tile of a noise field : which generator (user defined id, e.g. a NoiseType),
+	 * its seed, a hash of its parameters (see NoiseTileCache::hashParameters()), level of detail
+	 * and tile coordinate. At LOD l, a tile covers side * 2^l base samples in each dimension.
+	 */
+	struct NoiseTileKey
+	{
+		uint32_t generator = 0;
+		uint32_t seed = 0;
+		uint64_t paramsHash = 0;
+		int32_t lod = 0;
+		glm::ivec2 tile = glm::ivec2(0);
+
+		bool operator==(const NoiseTileKey& _other) const
+		{
+			return generator == _other.generator && seed == _other.seed && paramsHash == _other.paramsHash &&
+				   lod == _other.lod && tile.x == _other.tile.x && tile.y == _other.tile.y;
+		}
+	};
+
+	//
+	struct NoiseTileKeyHash
+	{
+		size_t operator()(const NoiseTileKey& _k) const;
+		bool operator()(const NoiseTileKey& _a, const NoiseTileKey& _b) const { return _a == _b; }
+	};
+
+	// A computed tile, side * side values, row-major (x fastest). Immutable once cached.
+	struct NoiseTile
+	{
+		NoiseTileKey key;
+		uint32_t side = 0;
+		std::vector<float> data;
+
+		size_t bytes() const { return sizeof(NoiseTile) + data.size() * sizeof(float); }
+		float at(uint32_t _x, uint32_t _y) const { return data[_y * side + _x]; }
+	};
+
+	// Cache statistics, see NoiseTileCache::getStats().
+	struct NoiseTileCacheStats
+	{
+		uint64_t hits = 0;				// lookups served by a resident tile
+		uint64_t pendingHits = 0;		// lookups joining a tile already being computed
+		uint64_t misses = 0;			// lookups starting a computation
+		uint64_t evictions = 0;
+		size_t residentBytes = 0;
+		size_t byteBudget = 0;
+		uint32_t tileCount = 0;
+		uint32_t pendingCount = 0;
+
+		uint64_t lookups() const { return hits + pendingHits + misses; }
+		// fraction of lookups that didn't compute a tile
+		float hitRate() const { return lookups() ? (float)(hits + pendingHits) / (float)lookups() : 0.0f; }
+	};
+
+
+	/* Cache of computed noise tiles, with LRU eviction by a byte budget. Tiles are computed
+	 * by a user supplied tile function on the ThreadPool (inline if the pool isn't running),
+	 * and any tile is computed at most once while resident : concurrent requests for the same
+	 * tile share the computation. All methods are thread safe.
+	 *
+	 * Typical use, a preview panned over a noise field :
+	 *
+	 *	NoiseTileCache cache(64);
+	 *	NoiseTileKey key = NoiseTileCache::noiseKey(NoiseType::Perlin);
+	 *	NoiseTileCache::TileFunc fnc = NoiseTileCache::noiseTileFunc(NoiseType::Perlin);
+	 *	cache.readWindow(key, origin, glm::ivec2(w, h), data, fnc);
+	 *
+	 * The tile function is called from worker threads and must be thread safe. It receives the
+	 * key and the tile side, and fills side * side values.
+	 */
+	class NoiseTileCache
+	{
+	public:
+		using TileFunc = std::function<void(const NoiseTileKey& _key, uint32_t _side, float* _out)>;
+		using TileFuture = std::shared_future<Ref<const NoiseTile>>;
+
+	public:
+		NoiseTileCache(uint32_t _tile_side=64, size_t _byte_budget=64*1024*1024);
+		~NoiseTileCache();
+
+		NoiseTileCache(const NoiseTileCache&) = delete;
+		NoiseTileCache& operator=(const NoiseTileCache&) = delete;
+
+		/* The tile if resident, else nullptr; never computes. Counted as a hit if found. */
+		Ref<const NoiseTile> find(const NoiseTileKey& _key);
+
+		/* Returns a future of the tile, computing it asynchronously if neither resident nor
+		 * already being computed. */
+		TileFuture request(const NoiseTileKey& _key, const TileFunc& _fnc);
+
+		/* As request(), but blocks until the tile is available. A tile that is requested but
+		 * not yet started is computed on the calling thread, so this is safe from worker tasks. */
+		Ref<const NoiseTile> get(const NoiseTileKey& _key, const TileFunc& _fnc);
+
+		/* Copies the window of _size samples starting at sample _origin (at the LOD of _key;
+		 * _key.tile is ignored) to _out, row-major. All missing tiles are requested before any is
+		 * waited for, so they are computed in parallel. If !_wait, tiles not yet available are
+		 * left untouched in _out and false is returned -- for previews refining over frames. */
+		bool readWindow(const NoiseTileKey& _key, const glm::ivec2& _origin, const glm::ivec2& _size, float* _out, const TileFunc& _fnc, bool _wait=true);
+
+		/* Drops all resident tiles; tiles being computed are cached when done. */
+		void clear();
+		void resetStats();
+
+		// accessors
+		void setByteBudget(size_t _bytes);
+		size_t getByteBudget() const;
+		uint32_t getTileSide() const { return m_tileSide; }
+		NoiseTileCacheStats getStats() const;
+
+		/* Tile coordinate containing sample _sample (at any LOD). */
+		glm::ivec2 tileOf(const glm::ivec2& _sample) const;
+
+		/* Hash of fBm parameters, for NoiseTileKey::paramsHash. */
+		static uint64_t hashParameters(const NoiseParameters& _param, bool _rotate=true);
+
+		/* Key and tile function for Noise::evalGrid() with the current Noise parameters. Sample
+		 * (i, j) of LOD l is at (i, j) * _spacing * 2^l. Both take the parameters at the time
+		 * of the call (copied into the function), so use them in matching pairs. */
+		static NoiseTileKey noiseKey(NoiseType _type, bool _rotate=true, float _spacing=1.0f);
+		static TileFunc noiseTileFunc(NoiseType _type, bool _rotate=true, float _spacing=1.0f);
+
+
+	private:
+		struct pending_tile_t
+		{
+			NoiseTileKey key;
+			TileFunc fnc;
+			// set by whichever thread computes the tile, worker task or waiter in get()
+			std::atomic<bool> claimed = false;
+			std::promise<Ref<const NoiseTile>> promise;
+			TileFuture future;
+		};
+
+		using lru_list_t = std::list<Ref<const NoiseTile>>;
+
+		/* Under m_mutex : the resident tile, or else the computation of it in _pending, which is
+		 * created (and _created set) if there is none. Updates the LRU order and statistics. */
+		Ref<const NoiseTile> lookup(const NoiseTileKey& _key, const TileFunc& _fnc, Ref<pending_tile_t>& _pending, bool& _created);
+		// computes the tile on a worker thread, inline if the pool isn't running or on a worker
+		void dispatch(const Ref<pending_tile_t>& _pending);
+		// computes the tile on the calling thread unless already claimed, then waits for it
+		Ref<const NoiseTile> wait(const Ref<pending_tile_t>& _pending);
+		void compute(const Ref<pending_tile_t>& _pending);
+		void evict();
+
+
+	private:
+		uint32_t m_tileSide = 64;
+		size_t m_byteBudget = 0;
+
+		mutable std::mutex m_mutex;
+		// resident tiles, LRU list (front is most recent)
+		lru_list_t m_lruList;
+		std::unordered_map<NoiseTileKey, lru_list_t::iterator, NoiseTileKeyHash, NoiseTileKeyHash> m_tiles;
+		std::unordered_map<NoiseTileKey, Ref<pending_tile_t>, NoiseTileKeyHash, NoiseTileKeyHash> m_pending;
+		size_t m_residentBytes = 0;
+
+		NoiseTileCacheStats m_stats;
+
+	};
+
+
+}
+
@@ -2,11 +2,15 @@
 #pragma once
 
 #include <thread>
+#include <atomic>
+#include <algorithm>
 #include <condition_variable>
 #include <mutex>
 #include <vector>
 #include <functional>
 #include <future>
+#include <memory>
+#include <exception>
 
 #include "../../Core.hpp"
 #include "ThreadSafeQueue.hpp"
@@ -30,19 +34,22 @@ namespace Syn
 
             void operator()()
             {
+                s_isWorker = true;
                 std::function<void()> func;
                 bool assigned_task;
                 while (!m_pool->m_done)
                 {
                     {
                         std::unique_lock<std::mutex> lock(m_pool->m_mutex);
-                        // if queue is empty, wait for work (i.e. to be notify_one():ed)
+                        // if queue is empty, wait for work (i.e. to be notify_one():ed). Since
+                        // submit() and shutdown() notify while holding m_mutex, the wakeup can't
+                        // be lost between the check and the wait.
                         if (m_pool->m_queue.empty())
                         {
                             #ifdef DEBUG_THREADPOOL
                                 SYN_CORE_TRACE("thread ", m_id, " waiting for work");
                             #endif
-                            m_pool->m_conditionalLock.wait(lock);
+                            m_pool->m_conditionalLock.wait(lock, [&]() { return m_pool->m_done || !m_pool->m_queue.empty(); });
                         }
                         // else grab something to do
                         assigned_task = m_pool->m_queue.pop(func);
@@ -63,9 +70,10 @@ namespace Syn
 
         ThreadSafeQueue<std::function<void()>> m_queue;
         std::vector<std::thread> m_threads;
-        bool m_done = false;
+        std::atomic<bool> m_done = false;
         std::mutex m_mutex;
         std::condition_variable m_conditionalLock;
+        inline static thread_local bool s_isWorker = false;
 
     public:
         // use the maximum number of threads, saving one for the main thread
@@ -87,9 +95,10 @@ namespace Syn
             return instance;
         }
 
-        //
+        // Starts the workers; also restarts a pool stopped by shutdown().
         void init()
         {
+            m_done = false;
             SYN_CORE_TRACE("initializing worker threads (", m_threads.size(),").");
 
             #ifdef DEBUG_THREADPOOL
@@ -99,10 +108,25 @@ namespace Syn
                 m_threads[i] = std::thread(ThreadWorker(this, i));
         }
 
+        // As above, with _thread_count workers instead of the count given at construction,
+        // e.g. to measure scaling. A running pool is shut down first. Not thread safe : must
+        // not be called while another thread is inside parallelFor() or submit(), which read
+        // m_threads and queue work for the workers being joined.
+        void init(size_t _thread_count)
+        {
+            if (isRunning())
+                shutdown();
+            m_threads = std::vector<std::thread>(_thread_count);
+            init();
+        }
+
         //
         void shutdown()
         {
-            m_done = true;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_done = true;
+            }
             m_conditionalLock.notify_all();
 
             for (size_t i = 0; i < m_threads.size(); i++)
@@ -125,14 +149,120 @@ namespace Syn
             // goes out of scope (in the current function).
             auto task_ptr = std::make_shared<std::packaged_task<decltype(_func(_args...))()>>(func);
             std::function<void()> wrapper_func = [task_ptr]() { (*task_ptr)(); };
-            // put into queue
-            m_queue.push(wrapper_func);
-            // wake one thread
+            // put into queue and wake one thread
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_queue.push(wrapper_func);
+            }
             m_conditionalLock.notify_one();
             // return a future from promise
             return task_ptr->get_future();
         }
 
+        // True if init() has been called and the workers are running.
+        bool isRunning() { return !m_threads.empty() && m_threads[0].joinable() && !m_done; }
+
+        // True on the worker threads of a pool.
+        static bool isWorkerThread() { return s_isWorker; }
+
+        // Calls _func(i) for every i in [_begin, _end), distributed over the worker threads
+        // and the calling thread, and blocks until all calls have returned. Indices are
+        // handed out dynamically in batches of _grain, so uneven work per index balances.
+        // Runs inline if the pool isn't running, or if called from a worker task, where
+        // waiting for tasks queued behind it could block all workers.
+        //
+        // The caller only waits for tasks that have started on the range; tasks still
+        // queued behind other work find it exhausted when they run, and return without
+        // touching _func (the shared state is kept alive by the tasks themselves). If a
+        // call throws, no further batches are handed out and the first exception is
+        // rethrown on the calling thread once all running calls have returned.
+        template<typename F>
+        void parallelFor(size_t _begin, size_t _end, F&& _func, size_t _grain = 1)
+        {
+            if (_end <= _begin)
+                return;
+
+            _grain = std::max(_grain, (size_t)1);
+            size_t batchCount = (_end - _begin + _grain - 1) / _grain;
+            size_t workerCount = isRunning() && !s_isWorker ? std::min(m_threads.size(), batchCount - 1) : 0;
+
+            if (workerCount == 0)
+            {
+                for (size_t i = _begin; i < _end; i++)
+                    _func(i);
+                return;
+            }
+
+            auto state = std::make_shared<ParallelForState>(_begin);
+            auto work = [state, _end, _grain, &_func]()
+            {
+                state->active++;
+                try
+                {
+                    size_t begin;
+                    while ((begin = state->next.fetch_add(_grain)) < _end)
+                    {
+                        size_t end = std::min(begin + _grain, _end);
+                        for (size_t i = begin; i < end; i++)
+                            _func(i);
+                    }
+                }
+                catch (...)
+                {
+                    state->fail(std::current_exception(), _end);
+                }
+                // the last one out wakes the caller; notifying under the mutex so the
+                // wakeup can't fall between the caller's check and its wait
+                if (--state->active == 0)
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    state->finished.notify_all();
+                }
+            };
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                for (size_t i = 0; i < workerCount; i++)
+                    m_queue.push(work);
+            }
+            m_conditionalLock.notify_all();
+
+            work();
+
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->finished.wait(lock, [&]() { return state->active == 0; });
+            }
+
+            if (state->exception)
+                std::rethrow_exception(state->exception);
+        }
+
+    private:
+        // Shared by the caller and the tasks of a parallelFor(); active counts the tasks
+        // (and the caller) currently taking batches of the range.
+        struct ParallelForState
+        {
+            std::atomic<size_t> next;
+            std::atomic<size_t> active = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::exception_ptr exception = nullptr;
+
+            ParallelForState(size_t _begin) : next(_begin) {}
+
+            // keeps the first exception and stops handing out batches
+            void fail(std::exception_ptr _exception, size_t _end)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (!exception)
+                        exception = _exception;
+                }
+                next = _end;
+            }
+        };
+
     };
 
 }